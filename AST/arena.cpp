@@ -0,0 +1,123 @@
+/*
+ * This file is part of the SimpleSQL package.
+ * Contains the statement-scoped arena that AST nodes are allocated from.
+ *
+ */
+
+#include "arena.h"
+#include <cstdlib>
+#include <cstdint>
+
+using std::size_t;
+using std::string;
+
+/*---------------------------------------------
+   Arena methods
+   ------------------------------------------*/
+
+// Creates an empty arena that allocates blocks of the given size. No memory
+// is allocated until the first node is.
+Arena::Arena(size_t block_size)
+  : _block_size(block_size), _first(nullptr), _current(nullptr),
+    _next(nullptr), _end(nullptr), _used_before(0) {}
+
+// Frees every block, and with them every object allocated in the arena
+Arena::~Arena() {
+  Block *block = _first;
+  while (block != nullptr) {
+    Block *next = block->next;
+    std::free(block);
+    block = next;
+  }
+}
+
+// Returns size bytes of memory aligned to alignment, which must be a power
+// of two. The memory is valid until the arena is reset or destroyed.
+void *Arena::allocate(size_t size, size_t alignment) {
+  std::uintptr_t next = reinterpret_cast<std::uintptr_t>(_next);
+  std::uintptr_t aligned = (next + alignment - 1) & ~(alignment - 1);
+  if (_next != nullptr && aligned + size <= reinterpret_cast<std::uintptr_t>(_end)) {
+    _next = reinterpret_cast<char *>(aligned + size);
+    return reinterpret_cast<void *>(aligned);
+  }
+  return allocate_slow(size, alignment);
+}
+
+// Moves on to the next block, reusing one retained by reset() if it is
+// large enough and allocating a new one otherwise
+void *Arena::allocate_slow(size_t size, size_t alignment) {
+  if (_current != nullptr) {
+    _used_before += _next - block_begin(_current);
+  }
+  size_t needed = size + alignment;
+  Block *next = _current == nullptr ? _first : _current->next;
+  if (next == nullptr || next->size < needed) {
+    size_t block_size = needed > _block_size ? needed : _block_size;
+    Block *block = static_cast<Block *>(std::malloc(sizeof(Block) + block_size));
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    block->size = block_size;
+    block->next = next;
+    if (_current == nullptr) {
+      _first = block;
+    } else {
+      _current->next = block;
+    }
+    next = block;
+  }
+  _current = next;
+  _next = block_begin(_current);
+  _end = _next + _current->size;
+  return allocate(size, alignment);
+}
+
+// Returns the first usable byte of the given block
+char *Arena::block_begin(Block *block) const {
+  return reinterpret_cast<char *>(block + 1);
+}
+
+// Frees everything allocated in the arena at once. The blocks themselves
+// are kept, so the next statement allocates without calling malloc.
+void Arena::reset() {
+  _current = nullptr;
+  _next = nullptr;
+  _end = nullptr;
+  _used_before = 0;
+}
+
+// Returns the number of bytes handed out since the arena was last reset
+size_t Arena::bytes_used() const {
+  if (_current == nullptr) {
+    return 0;
+  }
+  return _used_before + (_next - block_begin(_current));
+}
+
+/*---------------------------------------------
+   ArenaString methods
+   ------------------------------------------*/
+
+// Copies the given characters into the arena
+ArenaString::ArenaString(Arena& arena, const char *data, size_t length)
+  : _data(""), _length(length) {
+  if (length > 0) {
+    char *copy = static_cast<char *>(arena.allocate(length, 1));
+    std::memcpy(copy, data, length);
+    _data = copy;
+  }
+}
+
+// Copies the given string into the arena
+ArenaString::ArenaString(Arena& arena, const string& str)
+  : ArenaString(arena, str.data(), str.size()) {}
+
+// Returns true if both strings hold the same characters
+bool ArenaString::operator==(const ArenaString& other) const {
+  return _length == other._length && std::memcmp(_data, other._data, _length) == 0;
+}
+
+// Returns true if this string holds the same characters as other
+bool ArenaString::operator==(const string& other) const {
+  return _length == other.size() && std::memcmp(_data, other.data(), _length) == 0;
+}
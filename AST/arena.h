@@ -0,0 +1,104 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A monotonic bump allocator that owns every node of a statement's AST.
+// Allocation moves a pointer forward through a list of blocks, and the
+// whole tree is freed at once by reset() or the destructor, in O(1) for
+// reset. Destructors of objects made in an arena are never run, so
+// everything they own must live in the same arena: names are ArenaStrings
+// and lists are ArenaLists rather than std::strings and std::vectors.
+class Arena {
+ public:
+  explicit Arena(std::size_t block_size = DEFAULT_BLOCK_SIZE);
+  ~Arena();
+  void *allocate(std::size_t size, std::size_t alignment);
+  template <typename T, typename... Args>
+  T *make(Args&&... args);
+  void reset();
+  std::size_t bytes_used() const;
+
+  static const std::size_t DEFAULT_BLOCK_SIZE = 8192;
+ private:
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Blocks are chained through a header placed at their start
+  struct Block {
+    Block *next;
+    std::size_t size;
+  };
+  void *allocate_slow(std::size_t size, std::size_t alignment);
+  char *block_begin(Block *block) const;
+
+  const std::size_t _block_size;
+  Block *_first;
+  Block *_current;
+  char *_next;
+  char *_end;
+  // Bytes handed out in blocks before _current
+  std::size_t _used_before;
+};
+
+// Allocates a T in the arena, constructed from the given arguments
+template <typename T, typename... Args>
+T *Arena::make(Args&&... args) {
+  return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+// An immutable string whose characters live in an arena
+class ArenaString {
+ public:
+  ArenaString() : _data(""), _length(0) {}
+  ArenaString(Arena& arena, const char *data, std::size_t length);
+  ArenaString(Arena& arena, const std::string& str);
+  const char *data() const { return _data; }
+  std::size_t length() const { return _length; }
+  bool empty() const { return _length == 0; }
+  const std::string str() const { return std::string(_data, _length); }
+  bool operator==(const ArenaString& other) const;
+  bool operator!=(const ArenaString& other) const { return !(*this == other); }
+  bool operator==(const std::string& other) const;
+ private:
+  const char *_data;
+  std::size_t _length;
+};
+
+// An immutable list whose elements live in an arena. T must be trivially
+// destructible, which holds for pointers, ArenaStrings and ArenaLists.
+template <typename T>
+class ArenaList {
+ public:
+  typedef const T *const_iterator;
+  ArenaList() : _data(nullptr), _size(0) {}
+  ArenaList(Arena& arena, const std::vector<T>& elements);
+  const_iterator begin() const { return _data; }
+  const_iterator end() const { return _data + _size; }
+  const T& operator[](std::size_t i) const { return _data[i]; }
+  std::size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+ private:
+  const T *_data;
+  std::size_t _size;
+};
+
+// Copies the given elements into the arena
+template <typename T>
+ArenaList<T>::ArenaList(Arena& arena, const std::vector<T>& elements)
+  : _data(nullptr), _size(elements.size()) {
+  if (_size > 0) {
+    T *data = static_cast<T *>(arena.allocate(sizeof(T) * _size, alignof(T)));
+    for (std::size_t i = 0; i < _size; ++i) {
+      new (data + i) T(elements[i]);
+    }
+    _data = data;
+  }
+}
+
+#endif  // __ARENA_H__
@@ -1,4 +1,3 @@
+#include "ast.h"
+
 ASTNode::ASTNode() {}
-ASTNode::~ASTNode() {}
-//void ASTNode::accept(Visitor& v) {
-  
@@ -4,13 +4,15 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "arena.h"
 
 class Visitor;
 // Parent class for all ASTNode types. Allows a
-// visitor to visit this node.
+// visitor to visit this node. Nodes are allocated
+// in the Arena of the statement they belong to.
 class ASTNode {
 public:
-  virtual void accept(Visitor& v) = 0;
+  virtual void accept(Visitor& v) const = 0;
   virtual ~ASTNode() {}
  protected:
   ASTNode();
@@ -19,7 +21,7 @@ public:
 // Handles the possible types of a create or
 // drop statement. Either these are being
 // applied to a database or a table.
-enum ASTType {
+enum class ASTType {
   DATABASE,
   TABLE,
 };
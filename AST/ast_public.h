@@ -1,7 +1,10 @@
 #ifndef __AST_PUBLIC_H__
 #define __AST_PUBLIC_H__
 
+#include "arena.h"
 #include "ast.h"
+#include "value.h"
+#include "expression.h"
 #include "create.h"
 #include "delete.h"
 #include "drop.h"
@@ -13,7 +13,6 @@
 
 using std::string;
 using std::vector;
-using std::shared_ptr;
 
 
 /*---------------------------------------------
@@ -22,13 +21,13 @@ using std::shared_ptr;
 
 // Returns the name of the table or database to be created
 // by this statement
-const string Create::name() const {
+const ArenaString Create::name() const {
   return _name;
 }
 
 // Creates a new create statement with the given name of the table
 // or database to be created
-Create::Create(const string &name) : _name(name) {}
+Create::Create(const ArenaString &name) : _name(name) {}
 
 Create::~Create() { }
 
@@ -38,10 +37,10 @@ Create::~Create() { }
 
 //Creates a new Create Database statement to create a database of the given
 // name
-CreateDatabase::CreateDatabase(const string &name) : Create(name) {}
+CreateDatabase::CreateDatabase(const ArenaString &name) : Create(name) {}
 
 // Handles visitor acceptance logic for create database nodes
-void CreateDatabase::accept(Visitor& v) {
+void CreateDatabase::accept(Visitor& v) const {
   v.visitCreateDatabase(*this);
 }
 
@@ -51,30 +50,75 @@ void CreateDatabase::accept(Visitor& v) {
 
 // Creates a new Create Table statement to create a table of the given name,
 // using the given vector of Create elements.
-CreateTable::CreateTable(const string &name, const vector<shared_ptr<const CreateElement>> &els)
+CreateTable::CreateTable(const ArenaString &name, const ArenaList<const CreateElement*> &els)
   : Create(name), _elements(els) {}
 
+// Returns the columns and key declarations of the table
+const ArenaList<const CreateElement*>& CreateTable::elements() const {
+  return _elements;
+}
+
 // Handles visitor acceptance logic for create table nodes
-void CreateTable::accept(Visitor& v) {
+void CreateTable::accept(Visitor& v) const {
   v.visitCreateTable(*this);
 }
 
+/*-------------------------------------------------
+  CreateIndex Methods
+  ------------------------------------------------*/
+
+// Creates a new Create Index statement to index the given columns of a
+// table, in order, with an index of the given name and kind
+CreateIndex::CreateIndex(const ArenaString &name, const ArenaString &table_name,
+			 const ArenaList<ArenaString> &columns, IndexKind kind)
+  : Create(name), _table_name(table_name), _columns(columns), _kind(kind) {}
+
+// Returns the name of the table to be indexed
+const ArenaString CreateIndex::table_name() const {
+  return _table_name;
+}
+
+// Returns the indexed columns, in key order
+const ArenaList<ArenaString>& CreateIndex::columns() const {
+  return _columns;
+}
+
+// Returns the kind of index to be created
+IndexKind CreateIndex::kind() const {
+  return _kind;
+}
+
+// Handles visitor acceptance logic for create index nodes
+void CreateIndex::accept(Visitor& v) const {
+  v.visitCreateIndex(*this);
+}
+
 
 /*---------------------------------------------------
   CreateBuilder methods
   --------------------------------------------------*/
 
+// Creates a builder that allocates the statements it builds in arena
+CreateBuilder::CreateBuilder(Arena& arena) : _arena(arena), _type(ASTType::TABLE) {}
+
 // sets the type of the CreateBuilder to given type. Type
 // should be either DATABASE or TABLE. Returns a reference
 // to the instance of the CreateBuilder
-const CreateBuilder& CreateBuilder::type(const ASTType t) {
+CreateBuilder& CreateBuilder::type(const ASTType t) {
   _type = t;
   return *this;
 }
 
 // Sets the name of the table or database to be created for the
 // current CreateBuilder
-const CreateBuilder& CreateBuilder::name(const string &name) {
+CreateBuilder& CreateBuilder::name(const string &name) {
+  _name = ArenaString(_arena, name);
+  return *this;
+}
+
+// Sets the name of the table or database to be created to a name already
+// stored in the builder's arena
+CreateBuilder& CreateBuilder::name(const ArenaString &name) {
   _name = name;
   return *this;
 }
@@ -82,24 +126,24 @@ const CreateBuilder& CreateBuilder::name(const string &name) {
 // Sets the Create Table elements to the given vector of elements.
 // Only valid in the case that this builder is being used to create
 // a Create Table command.
-const CreateBuilder& CreateBuilder::elements(const vector<shared_ptr<const CreateElement>> &els) {
+CreateBuilder& CreateBuilder::elements(const vector<const CreateElement*> &els) {
   _els = els;
   return *this;
 }
 
-// Dynamically allocates a new Create command instance
+// Allocates a new Create command instance in the builder's arena
 // based on the data stored in the builder. If this is a create command
 // for a database, then the list of elements is assumed to be empty.
 // Otherwise, the list of elements is assumed non-empty. Behavior is
-// undefined otherwise. Client is responsible for deleting the returned value
+// undefined otherwise. The node lives as long as the arena's contents.
 const Create *CreateBuilder::build() {
   Create *c;
   if (_type == ASTType::DATABASE) {
     assert(_els.empty());
-    c = new CreateDatabase(_name);
+    c = _arena.make<CreateDatabase>(_name);
   } else {
     assert(!_els.empty());
-    c = new CreateTable(_name, _els);
+    c = _arena.make<CreateTable>(_name, ArenaList<const CreateElement*>(_arena, _els));
   }
   reset();
   return c;
@@ -108,7 +152,9 @@ const Create *CreateBuilder::build() {
 // Resets the CreateBuilder to default settings. Intended to be called
 // after using the builder to create a new statement.
 void CreateBuilder::reset() {
-  *this = CreateBuilder();
+  _type = ASTType::TABLE;
+  _name = ArenaString();
+  _els.clear();
 }
 
 
@@ -123,7 +169,7 @@ CreateElement::CreateElement() {}
   ------------------------------------------*/
 
 // Returns the name of the column declared
-const string ColumnDecl::name() const {
+const ArenaString ColumnDecl::name() const {
   return _name;
 }
 
@@ -143,57 +189,88 @@ int ColumnDecl::length() const {
   return _length;
 }
 
+// Returns the members of an ENUM or SET column, in declaration order
+const ArenaList<ArenaString>& ColumnDecl::members() const {
+  return _members;
+}
+
 
 // Handles visitor acceptance logic for ColumnDecl nodes
-void ColumnDecl::accept(Visitor& v) {
+void ColumnDecl::accept(Visitor& v) const {
   v.visitColumnDecl(*this);
 }
 
 
-// Returns a new ColumnDecl with the given name, nullability, type, and length
-ColumnDecl::ColumnDecl(const string& name, bool nullable, Datatype type, int length)
-  : _name(name), _nullable(nullable), _type(type), _length(length) {}
+// Returns a new ColumnDecl with the given name, nullability, type, length
+// and members
+ColumnDecl::ColumnDecl(const ArenaString& name, bool nullable, Datatype type, int length,
+		       const ArenaList<ArenaString>& members)
+  : _name(name), _nullable(nullable), _type(type), _length(length), _members(members) {}
 
 /*-------------------------------------------
   ColumnDeclBuilder methods
   ------------------------------------------*/
 
+// Creates a builder that allocates the declarations it builds in arena
+ColumnDeclBuilder::ColumnDeclBuilder(Arena& arena)
+  : _arena(arena), _length(0), _nullable(true), _type(Datatype::INT_T) {}
+
 // Sets the name of the ColumnDecl to build to be the given name, and returns
 // a reference to the builder
-const ColumnDeclBuilder& ColumnDeclBuilder::name(const std::string& name) {
+ColumnDeclBuilder& ColumnDeclBuilder::name(const std::string& name) {
+  _name = ArenaString(_arena, name);
+  return *this;
+}
+
+// Sets the name of the ColumnDecl to build to a name already stored in the
+// builder's arena, and returns a reference to the builder
+ColumnDeclBuilder& ColumnDeclBuilder::name(const ArenaString& name) {
   _name = name;
   return *this;
 }
 
 // Sets the nullability of the column, and returns a reference to the builder
-const ColumnDeclBuilder& ColumnDeclBuilder::nullable(bool nullable) {
+ColumnDeclBuilder& ColumnDeclBuilder::nullable(bool nullable) {
   _nullable = nullable;
   return *this;
 }
 
 // Sets the accepted type of the column, and returns a reference to the builder
-const ColumnDeclBuilder& ColumnDeclBuilder::type(Datatype type) {
+ColumnDeclBuilder& ColumnDeclBuilder::type(Datatype type) {
   _type = type;
   return *this;
 }
 
 // Sets the maximal length of the fields in the column and returns a reference
 // to the builder
-const ColumnDeclBuilder& ColumnDeclBuilder::length(int length) {
+ColumnDeclBuilder& ColumnDeclBuilder::length(int length) {
   _length = length;
   return *this;
 }
 
-// Returns a dynamically allocated column declaration that matches the arguments
-// given. Client is responsible for deleting the pointer.
+// Sets the members of an ENUM or SET column, which must already be stored
+// in the builder's arena, and returns a reference to the builder
+ColumnDeclBuilder& ColumnDeclBuilder::members(const vector<ArenaString>& members) {
+  _members = members;
+  return *this;
+}
+
+// Returns a column declaration allocated in the builder's arena that matches
+// the arguments given
 const ColumnDecl * ColumnDeclBuilder::build() {
-  ColumnDecl * c = new ColumnDecl(_name, _nullable, _type, _length);
+  ColumnDecl * c = _arena.make<ColumnDecl>(_name, _nullable, _type, _length,
+					   ArenaList<ArenaString>(_arena, _members));
   reset();
   return c;
 }
 
+// Resets the builder to default settings
 void ColumnDeclBuilder::reset() {
-  *this = ColumnDeclBuilder();
+  _length = 0;
+  _name = ArenaString();
+  _nullable = true;
+  _type = Datatype::INT_T;
+  _members.clear();
 }
 
 /*-------------------------------------------
@@ -201,42 +278,42 @@ void ColumnDeclBuilder::reset() {
   -----------------------------------------*/
 
 // Returns the keys that are declared to be primary by this declaration
-const vector<string> PrimaryKeyDecl::keys()  const {
+const ArenaList<ArenaString>& PrimaryKeyDecl::keys()  const {
   return _keys;
 }
 
 
 // Handles visitor acceptance logic for primary key declaration nodes
-void PrimaryKeyDecl::accept(Visitor& v) {
+void PrimaryKeyDecl::accept(Visitor& v) const {
   v.visitPrimaryKeyDecl(*this);
 }
 
 
 // Constructs a new PrimaryKeyDecl operating on the given vector of keys
-PrimaryKeyDecl::PrimaryKeyDecl(const vector<string>& keys) : _keys(keys) {}
+PrimaryKeyDecl::PrimaryKeyDecl(const ArenaList<ArenaString>& keys) : _keys(keys) {}
 
 /*------------------------------------------
   ForeignKeyDecl methods
   -----------------------------------------*/
 
 // Returns the name of the referenced table
-const string ForeignKeyDecl::foreign_table_name() const {
+const ArenaString ForeignKeyDecl::foreign_table_name() const {
   return _foreign_table_name;
 }
 
 
 // Handles visitor acceptance logic for foreign key declaration nodes
-void ForeignKeyDecl::accept(Visitor& v) {
+void ForeignKeyDecl::accept(Visitor& v) const {
   v.visitForeignKeyDecl(*this);
 }
 
 
 // Returns the list of keys that are being declared foreign
-const vector<string> ForeignKeyDecl::keys() const {
+const ArenaList<ArenaString>& ForeignKeyDecl::keys() const {
   return _keys;
 }
 
 // Constructs a new ForeignKeyDecl linking the given keys to the
 // given foreign table name
-ForeignKeyDecl::ForeignKeyDecl(const string& foreign_table_name, const vector<string>& keys)
+ForeignKeyDecl::ForeignKeyDecl(const ArenaString& foreign_table_name, const ArenaList<ArenaString>& keys)
   : _foreign_table_name(foreign_table_name), _keys(keys) {}
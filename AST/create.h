@@ -10,6 +10,7 @@ class Create;
 class CreateBuilder;
 class CreateDatabase;
 class CreateTable;
+class CreateIndex;
 class CreateElement;
 class ColumnDecl;
 class ForeignKeyDecl;
@@ -30,32 +31,43 @@ enum Datatype {
   SET_T
 };
 
+// Enumerates the kinds of secondary index. A hash index answers equality
+// lookups on all of its columns; an ordered index keeps its keys sorted,
+// and also answers lookups on its leading columns and range scans.
+enum class IndexKind {
+  HASH,
+  ORDERED
+};
+
 
 // Corresponds to a create statement
 // create_statement ::= <create_table> | <create_database>
 class Create : public ASTNode {
  public:
-  const std::string name() const;
+  const ArenaString name() const;
   virtual ~Create();
  protected:
-  Create(const std::string &name);
+  Create(const ArenaString &name);
  private:
-  const std::string _name;
+  const ArenaString _name;
   Create();
 };
 
-// Builder class for a create node
+// Builder class for a create node. Nodes are built in the given arena.
 class CreateBuilder {
  public:
-  const CreateBuilder& type(const ASTType t);
-  const CreateBuilder& name(const std::string &name);
-  const CreateBuilder& elements(const std::vector<std::shared_ptr<const CreateElement>> &els);
+  CreateBuilder(Arena& arena);
+  CreateBuilder& type(const ASTType t);
+  CreateBuilder& name(const std::string &name);
+  CreateBuilder& name(const ArenaString &name);
+  CreateBuilder& elements(const std::vector<const CreateElement*> &els);
   const Create *build();
  private:
-  CreateBuilder() {}
+  CreateBuilder() = delete;
+  Arena& _arena;
   ASTType _type;
-  std::string _name;
-  std::vector<std::shared_ptr<const CreateElement>> _els;
+  ArenaString _name;
+  std::vector<const CreateElement*> _els;
   void reset();
 };
 
@@ -65,23 +77,40 @@ class CreateBuilder {
 // create_table ::= CREATE TABLE <identifier> (<element> {, <element>}*)
 class CreateTable : public Create {
  public:
-  const std::vector<std::shared_ptr<const CreateElement>> elements() const;
-  CreateTable(const std::string& name, const std::vector<std::shared_ptr<const CreateElement>>& els);
-  void accept(Visitor& v);
+  const ArenaList<const CreateElement*>& elements() const;
+  CreateTable(const ArenaString& name, const ArenaList<const CreateElement*>& els);
+  void accept(Visitor& v) const;
  private:
-  void reset();
-  const std::vector<std::shared_ptr<const CreateElement>> _elements;
+  const ArenaList<const CreateElement*> _elements;
 };
 
 // Corresponds to a create database statement
 // create_database ::= CREATE DATABASE <identifier>
 class CreateDatabase : public Create {
  public:
-  CreateDatabase(const std::string& name);
-  void accept(Visitor& v);
+  CreateDatabase(const ArenaString& name);
+  void accept(Visitor& v) const;
 };
 
 
+// Corresponds to a create index statement
+// create_index ::= CREATE INDEX <identifier> ON <table_name>
+//                    (<column_name> {, <column_name>}*) [USING {HASH | BTREE}]
+// Indexes are ordered unless declared USING HASH.
+class CreateIndex : public Create {
+ public:
+  const ArenaString table_name() const;
+  const ArenaList<ArenaString>& columns() const;
+  IndexKind kind() const;
+  CreateIndex(const ArenaString& name, const ArenaString& table_name,
+	      const ArenaList<ArenaString>& columns, IndexKind kind);
+  void accept(Visitor& v) const;
+ private:
+  const ArenaString _table_name;
+  const ArenaList<ArenaString> _columns;
+  const IndexKind _kind;
+};
+
 // Elements in a create statement.
 // create_element ::= <column_decl> | <primary_key_decl> | <foreign_key_decl>
 class CreateElement : public ASTNode {
@@ -92,59 +121,74 @@ class CreateElement : public ASTNode {
 };
 
 // Corresponds to a column declaration for a create table statement
-// column_decl ::= <column_name> 
+// column_decl ::= <column_name> <datatype> [(<length>)] [[NOT] NULL]
+//               | <column_name> {ENUM | SET} (<string> {, <string>}*) [[NOT] NULL]
+// Only ENUM and SET columns have members.
 class ColumnDecl : public CreateElement {
  public:
-  const std::string name() const;
+  const ArenaString name() const;
   bool nullable() const;
   Datatype type() const;
   int length() const;
-  ColumnDecl(const std::string& name, bool nullable, Datatype type, int length);
-  void accept(Visitor& v);
+  const ArenaList<ArenaString>& members() const;
+  ColumnDecl(const ArenaString& name, bool nullable, Datatype type, int length,
+	     const ArenaList<ArenaString>& members);
+  void accept(Visitor& v) const;
  private:
   ColumnDecl();
-  const std::string _name;
+  const ArenaString _name;
   const bool _nullable;
   const Datatype _type;
   const int _length;
+  const ArenaList<ArenaString> _members;
 };
 
-// Builder class to construct ColumnDecls
+// Builder class to construct ColumnDecls. Nodes are built in the given
+// arena. Columns are nullable and have length 0 unless set otherwise.
 class ColumnDeclBuilder {
  public:
-  const ColumnDeclBuilder& name(const std::string& name);
-  const ColumnDeclBuilder& type(Datatype type);
-  const ColumnDeclBuilder& nullable(bool nullable);
-  const ColumnDeclBuilder& length(int length);
+  ColumnDeclBuilder(Arena& arena);
+  ColumnDeclBuilder& name(const std::string& name);
+  ColumnDeclBuilder& name(const ArenaString& name);
+  ColumnDeclBuilder& type(Datatype type);
+  ColumnDeclBuilder& nullable(bool nullable);
+  ColumnDeclBuilder& length(int length);
+  ColumnDeclBuilder& members(const std::vector<ArenaString>& members);
   const ColumnDecl *build();
  private:
+  ColumnDeclBuilder() = delete;
+  Arena& _arena;
   int _length;
-  std::string _name;
+  ArenaString _name;
   bool _nullable;
   Datatype _type;
-  void reset();  
-};  
+  std::vector<ArenaString> _members;
+  void reset();
+};
 
 // Corresponds to a primary key declaration in a create table statement
+// primary_key_decl ::= PRIMARY KEY (<column_name> {, <column_name>}*)
 class PrimaryKeyDecl : public CreateElement {
  public:
-  const std::vector<std::string> keys() const;
-  PrimaryKeyDecl(const std::vector<std::string>& keys);
-  void accept(Visitor& v);
+  const ArenaList<ArenaString>& keys() const;
+  PrimaryKeyDecl(const ArenaList<ArenaString>& keys);
+  void accept(Visitor& v) const;
  private:
-  const std::vector<std::string> _keys;
+  const ArenaList<ArenaString> _keys;
 };
 
 // Corresponds to a foreign key declaration in a create table statement
+// foreign_key_decl ::= FOREIGN KEY (<column_name> {, <column_name>}*)
+//                              REFERENCES <table_name>
 class ForeignKeyDecl : public CreateElement {
  public:
-  const std::string foreign_table_name() const;
-  const std::vector<std::string> keys() const;
-  ForeignKeyDecl(const std::string& foreign_table_name, const std::vector<std::string>& keys);
-  void accept(Visitor& v);
+  const ArenaString foreign_table_name() const;
+  const ArenaList<ArenaString>& keys() const;
+  ForeignKeyDecl(const ArenaString& foreign_table_name, const ArenaList<ArenaString>& keys);
+  void accept(Visitor& v) const;
  private:
-  const std::string _foreign_table_name;
-  const std::vector<std::string> _keys;
+  const ArenaString _foreign_table_name;
+  const ArenaList<ArenaString> _keys;
 };
 
 #endif  // __CREATE_H__
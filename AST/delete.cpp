@@ -0,0 +1,25 @@
+#include "delete.h"
+#include "visitor.h"
+
+/*****************************************
+ Delete Methods
+****************************************/
+
+// Returns the name of the table rows are deleted from
+const ArenaString Delete::table_name() const {
+  return _table_name;
+}
+
+// Returns the condition rows must meet to be deleted, or null if every row
+// is deleted
+const Expression * const Delete::exp() const {
+  return deleteExpression;
+}
+
+Delete::Delete(const ArenaString& table_name, const Expression *deleteExpression)
+  : _table_name(table_name), deleteExpression(deleteExpression) {}
+
+// Handles visitor acceptance logic for delete statements
+void Delete::accept(Visitor& v) const {
+  v.visitDelete(*this);
+}
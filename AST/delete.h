@@ -2,18 +2,21 @@
 #define __DELETE_H__
 
 #include "ast.h"
+#include "expression.h"
 
-class Expression;
 class Delete;
 
 // Corresponds to a delete statement
-// 
+// delete_stmt ::= DELETE FROM <table_name> [WHERE <expr>]
 class Delete : public ASTNode {
  public:
+  const ArenaString table_name() const;
   const Expression * const exp() const;
-  Delete(const Expression& deleteExpression);
+  Delete(const ArenaString& table_name, const Expression *deleteExpression);
+  void accept(Visitor& v) const;
  private:
   Delete();
+  const ArenaString _table_name;
   const Expression * const deleteExpression;
 };
 
@@ -1,22 +1,44 @@
 #include "drop.h"
+#include "visitor.h"
 
 using std::string;
 
 /**************************************
  Drop Methods
 *************************************/
-Drop::Drop(const string &name): _name(name) {}
+Drop::Drop(const ArenaString &name): _name(name) {}
 
-const string name() const {
-  return name;
+// Returns the name of the table or database to be dropped
+const ArenaString Drop::name() const {
+  return _name;
 }
 
 /************************
 DropTable Methods
 ************************/
-DropTable::DropTable(const string &name): Drop(name) {}
+DropTable::DropTable(const ArenaString &name): Drop(name) {}
+
+// Handles visitor acceptance logic for drop table nodes
+void DropTable::accept(Visitor& v) const {
+  v.visitDropTable(*this);
+}
 
 /************************
 DropDatabase Methods
 ************************/
-DropDatabase::DropDatabase(const string &name): Drop(name) {}
+DropDatabase::DropDatabase(const ArenaString &name): Drop(name) {}
+
+// Handles visitor acceptance logic for drop database nodes
+void DropDatabase::accept(Visitor& v) const {
+  v.visitDropDatabase(*this);
+}
+
+/************************
+DropIndex Methods
+************************/
+DropIndex::DropIndex(const ArenaString &name): Drop(name) {}
+
+// Handles visitor acceptance logic for drop index nodes
+void DropIndex::accept(Visitor& v) const {
+  v.visitDropIndex(*this);
+}
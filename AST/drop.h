@@ -5,21 +5,22 @@
 #include "ast.h"
 
 // Corresponds to a drop statement
-// <drop_statement> ::= DROP [TABLE | DATABASE] <name>
+// <drop_statement> ::= DROP [TABLE | DATABASE | INDEX] <name>
 class Drop : public ASTNode {
  public:
-  const std::string name() const;
+  const ArenaString name() const;
  protected:
-  Drop(std::string name);
+  Drop(const ArenaString& name);
  private:
   Drop();
-  const std::string _name;
+  const ArenaString _name;
 };
 
 // Corresponds to a drop table statement
 class DropTable : public Drop {
  public:
-  DropTable(std::string name);
+  DropTable(const ArenaString& name);
+  void accept(Visitor& v) const;
  private:
   DropTable();
 };
@@ -28,10 +29,20 @@ class DropTable : public Drop {
 // Corresponds to a drop database statement
 class DropDatabase : public Drop {
  public:
-  DropDatabase(std::string name);
+  DropDatabase(const ArenaString& name);
+  void accept(Visitor& v) const;
  private:
   DropDatabase();
 };
 
+// Corresponds to a drop index statement
+class DropIndex : public Drop {
+ public:
+  DropIndex(const ArenaString& name);
+  void accept(Visitor& v) const;
+ private:
+  DropIndex();
+};
+
 
 #endif  // __DROP_H__
@@ -0,0 +1,234 @@
+/*
+ * This file is part of the SimpleSQL package.
+ * Contains the expression nodes of the SQL parse tree.
+ *
+ */
+
+#include "expression.h"
+#include "visitor.h"
+
+/*---------------------------------------------
+   Expression methods
+   ------------------------------------------*/
+
+Expression::Expression() {}
+Expression::~Expression() {}
+
+/*---------------------------------------------
+   Literal methods
+   ------------------------------------------*/
+
+// Returns the value of the literal
+const Value& Literal::value() const {
+  return _value;
+}
+
+// Returns the type of value held by the literal
+ValueType Literal::type() const {
+  return _value.type();
+}
+
+// Creates a literal with the given value. A string value must already be
+// stored in the arena the literal is allocated in.
+Literal::Literal(const Value& value) : _value(value) {}
+
+// Handles visitor acceptance logic for literal nodes
+void Literal::accept(Visitor& v) const {
+  v.visitLiteral(*this);
+}
+
+/*---------------------------------------------
+   Placeholder methods
+   ------------------------------------------*/
+
+// Returns the index of the parameter in the statement's parameter list
+std::size_t Placeholder::index() const {
+  return _index;
+}
+
+// Creates a placeholder for the parameter at the given index
+Placeholder::Placeholder(std::size_t index) : _index(index) {}
+
+// Handles visitor acceptance logic for placeholder nodes
+void Placeholder::accept(Visitor& v) const {
+  v.visitPlaceholder(*this);
+}
+
+/*---------------------------------------------
+   ColumnRef methods
+   ------------------------------------------*/
+
+// Returns the name of the column referred to
+const ArenaString ColumnRef::name() const {
+  return _name;
+}
+
+// Creates a reference to the column of the given name
+ColumnRef::ColumnRef(const ArenaString& name) : _name(name) {}
+
+// Handles visitor acceptance logic for column references
+void ColumnRef::accept(Visitor& v) const {
+  v.visitColumnRef(*this);
+}
+
+/*---------------------------------------------
+   BinaryExpr methods
+   ------------------------------------------*/
+
+// Returns the operator applied
+BinaryOp BinaryExpr::op() const {
+  return _op;
+}
+
+// Returns the left operand
+const Expression *BinaryExpr::left() const {
+  return _left;
+}
+
+// Returns the right operand
+const Expression *BinaryExpr::right() const {
+  return _right;
+}
+
+// Creates an expression applying op to the given operands
+BinaryExpr::BinaryExpr(BinaryOp op, const Expression *left, const Expression *right)
+  : _op(op), _left(left), _right(right) {}
+
+// Handles visitor acceptance logic for binary expressions
+void BinaryExpr::accept(Visitor& v) const {
+  v.visitBinaryExpr(*this);
+}
+
+/*---------------------------------------------
+   NotExpr methods
+   ------------------------------------------*/
+
+// Returns the condition negated
+const Expression *NotExpr::operand() const {
+  return _operand;
+}
+
+// Creates the negation of operand
+NotExpr::NotExpr(const Expression *operand) : _operand(operand) {}
+
+// Handles visitor acceptance logic for negations
+void NotExpr::accept(Visitor& v) const {
+  v.visitNotExpr(*this);
+}
+
+/*---------------------------------------------
+   BetweenExpr methods
+   ------------------------------------------*/
+
+// Returns the value tested
+const Expression *BetweenExpr::value() const {
+  return _value;
+}
+
+// Returns the lower end of the range, which is in the range
+const Expression *BetweenExpr::low() const {
+  return _low;
+}
+
+// Returns the upper end of the range, which is in the range
+const Expression *BetweenExpr::high() const {
+  return _high;
+}
+
+// Returns true for NOT BETWEEN
+bool BetweenExpr::negated() const {
+  return _negated;
+}
+
+// Creates a test of whether value lies in [low, high], or with negated,
+// whether it does not
+BetweenExpr::BetweenExpr(const Expression *value, const Expression *low,
+			 const Expression *high, bool negated)
+  : _value(value), _low(low), _high(high), _negated(negated) {}
+
+// Handles visitor acceptance logic for range tests
+void BetweenExpr::accept(Visitor& v) const {
+  v.visitBetweenExpr(*this);
+}
+
+/*---------------------------------------------
+   InExpr methods
+   ------------------------------------------*/
+
+// Returns the value tested
+const Expression *InExpr::value() const {
+  return _value;
+}
+
+// Returns the values compared with, in the order written
+const ArenaList<const Expression*>& InExpr::list() const {
+  return _list;
+}
+
+// Returns true for NOT IN
+bool InExpr::negated() const {
+  return _negated;
+}
+
+// Creates a test of whether value is in list, or with negated, whether it
+// is not
+InExpr::InExpr(const Expression *value, const ArenaList<const Expression*>& list, bool negated)
+  : _value(value), _list(list), _negated(negated) {}
+
+// Handles visitor acceptance logic for list tests
+void InExpr::accept(Visitor& v) const {
+  v.visitInExpr(*this);
+}
+
+/*---------------------------------------------
+   IsNullExpr methods
+   ------------------------------------------*/
+
+// Returns the value tested
+const Expression *IsNullExpr::value() const {
+  return _value;
+}
+
+// Returns true for IS NOT NULL
+bool IsNullExpr::negated() const {
+  return _negated;
+}
+
+// Creates a test of whether value is null, or with negated, whether it is
+// not
+IsNullExpr::IsNullExpr(const Expression *value, bool negated)
+  : _value(value), _negated(negated) {}
+
+// Handles visitor acceptance logic for null tests
+void IsNullExpr::accept(Visitor& v) const {
+  v.visitIsNullExpr(*this);
+}
+
+/*---------------------------------------------
+   AggregateExpr methods
+   ------------------------------------------*/
+
+// Returns the function applied
+AggregateFunction AggregateExpr::function() const {
+  return _function;
+}
+
+// Returns the value aggregated, or null for COUNT(*)
+const Expression *AggregateExpr::argument() const {
+  return _argument;
+}
+
+// Returns true if repeated values are aggregated once
+bool AggregateExpr::distinct() const {
+  return _distinct;
+}
+
+// Creates an aggregate of argument over the rows of a group
+AggregateExpr::AggregateExpr(AggregateFunction function, const Expression *argument,
+			     bool distinct)
+  : _function(function), _argument(argument), _distinct(distinct) {}
+
+// Handles visitor acceptance logic for aggregates
+void AggregateExpr::accept(Visitor& v) const {
+  v.visitAggregateExpr(*this);
+}
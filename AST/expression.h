@@ -0,0 +1,187 @@
+#ifndef __EXPRESSION_H__
+#define __EXPRESSION_H__
+
+#include <cstddef>
+#include "ast.h"
+#include "value.h"
+
+class Expression;
+class Literal;
+class Placeholder;
+class ColumnRef;
+class BinaryExpr;
+class NotExpr;
+class BetweenExpr;
+class InExpr;
+class IsNullExpr;
+class AggregateExpr;
+
+// Parent class for expressions, which appear as values in
+// insert statements and as conditions in where clauses. Conditions follow
+// SQL's three-valued logic, in which a comparison with NULL is unknown.
+class Expression : public ASTNode {
+ public:
+  virtual ~Expression();
+ protected:
+  Expression();
+};
+
+// Corresponds to a constant in an expression
+// literal ::= NULL | <int> | <double> | <string>
+// String values are stored in the statement's arena.
+class Literal : public Expression {
+ public:
+  const Value& value() const;
+  ValueType type() const;
+  Literal(const Value& value);
+  void accept(Visitor& v) const;
+ private:
+  Literal();
+  const Value _value;
+};
+
+// Corresponds to a parameter of a prepared statement, whose value is
+// supplied when the statement is executed
+// placeholder ::= ? | $<n>
+class Placeholder : public Expression {
+ public:
+  std::size_t index() const;
+  Placeholder(std::size_t index);
+  void accept(Visitor& v) const;
+ private:
+  Placeholder();
+  const std::size_t _index;
+};
+
+// Corresponds to a reference to a column of the rows being processed
+// column_ref ::= <column_name>
+class ColumnRef : public Expression {
+ public:
+  const ArenaString name() const;
+  ColumnRef(const ArenaString& name);
+  void accept(Visitor& v) const;
+ private:
+  ColumnRef();
+  const ArenaString _name;
+};
+
+// The operators of binary expressions
+enum class BinaryOp {
+  EQUAL,
+  NEQUAL,
+  GTHAN,
+  LTHAN,
+  GEQ,
+  LEQ,
+  AND,
+  OR
+};
+
+// Corresponds to an operator applied to two expressions
+// binary_expr ::= <expr> <op> <expr>
+class BinaryExpr : public Expression {
+ public:
+  BinaryOp op() const;
+  const Expression *left() const;
+  const Expression *right() const;
+  BinaryExpr(BinaryOp op, const Expression *left, const Expression *right);
+  void accept(Visitor& v) const;
+ private:
+  BinaryExpr();
+  const BinaryOp _op;
+  const Expression *const _left;
+  const Expression *const _right;
+};
+
+// Corresponds to the negation of a condition. NOT of unknown is unknown.
+// not_expr ::= NOT <condition>
+class NotExpr : public Expression {
+ public:
+  const Expression *operand() const;
+  NotExpr(const Expression *operand);
+  void accept(Visitor& v) const;
+ private:
+  NotExpr();
+  const Expression *const _operand;
+};
+
+// Corresponds to a test that a value lies in a closed range, which is
+// true when value >= low AND value <= high
+// between_expr ::= <expr> [NOT] BETWEEN <expr> AND <expr>
+class BetweenExpr : public Expression {
+ public:
+  const Expression *value() const;
+  const Expression *low() const;
+  const Expression *high() const;
+  bool negated() const;
+  BetweenExpr(const Expression *value, const Expression *low, const Expression *high,
+	      bool negated);
+  void accept(Visitor& v) const;
+ private:
+  BetweenExpr();
+  const Expression *const _value;
+  const Expression *const _low;
+  const Expression *const _high;
+  const bool _negated;
+};
+
+// Corresponds to a test that a value is equal to one of a list, which is
+// true when value = e1 OR value = e2 ...
+// in_expr ::= <expr> [NOT] IN (<expr> {, <expr>}*)
+class InExpr : public Expression {
+ public:
+  const Expression *value() const;
+  const ArenaList<const Expression*>& list() const;
+  bool negated() const;
+  InExpr(const Expression *value, const ArenaList<const Expression*>& list, bool negated);
+  void accept(Visitor& v) const;
+ private:
+  InExpr();
+  const Expression *const _value;
+  const ArenaList<const Expression*> _list;
+  const bool _negated;
+};
+
+// Corresponds to a test for NULL, which is never unknown
+// is_null_expr ::= <expr> IS [NOT] NULL
+class IsNullExpr : public Expression {
+ public:
+  const Expression *value() const;
+  bool negated() const;
+  IsNullExpr(const Expression *value, bool negated);
+  void accept(Visitor& v) const;
+ private:
+  IsNullExpr();
+  const Expression *const _value;
+  const bool _negated;
+};
+
+// The aggregate functions
+enum class AggregateFunction {
+  COUNT,
+  SUM,
+  MIN,
+  MAX,
+  AVG
+};
+
+// Corresponds to an aggregate function of the rows of a group. The
+// argument is null for COUNT(*). Nulls are ignored, and with DISTINCT so
+// are repeated values.
+// aggregate_expr ::= COUNT(*) | <function>([DISTINCT] <expr>)
+// function ::= COUNT | SUM | MIN | MAX | AVG
+class AggregateExpr : public Expression {
+ public:
+  AggregateFunction function() const;
+  const Expression *argument() const;
+  bool distinct() const;
+  AggregateExpr(AggregateFunction function, const Expression *argument, bool distinct);
+  void accept(Visitor& v) const;
+ private:
+  AggregateExpr();
+  const AggregateFunction _function;
+  const Expression *const _argument;
+  const bool _distinct;
+};
+
+#endif  // __EXPRESSION_H__
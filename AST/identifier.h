@@ -1,9 +0,0 @@
-#ifndef __IDENTIFIER_H__
-#define __IDENTIFIER_H__
-
-
-class Identifer {
-
-};
-
-#endif  // __IDENTIFIER_H__
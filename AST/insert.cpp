@@ -1,24 +1,28 @@
 #include "insert.h"
+#include "visitor.h"
 #include <vector>
 #include <string>
 #include <memory>
 
 using std::string;
 using std::vector;
-using std::shared_ptr;
 
 /*****************************************
  Insert Methods
 ****************************************/
 
+// Returns the option describing the rows to insert
 const InsertOption * const Insert::option() const {
   return _option;
 }
 
+// Creates an insert statement with the given option. The option is
+// allocated in the same arena as the statement.
 Insert::Insert(const InsertOption * const option) : _option(option) {}
 
-Insert::~Insert() {
-  delete _option;
+// Handles visitor acceptance logic for insert statements
+void Insert::accept(Visitor& v) const {
+  v.visitInsert(*this);
 }
 
 
@@ -26,50 +30,111 @@ Insert::~Insert() {
 InsertOption Methods
 ****************************************/
 
-const string InsertOption::table_name const {
+// Returns the name of the table inserted into
+const ArenaString InsertOption::table_name() const {
   return _name;
 }
 
-InsertOption::InsertOption(const string &name) : _name(name) {}
+InsertOption::InsertOption(const ArenaString &name) : _name(name) {}
 
 
 /****************************************
 ValuesOption Methods
 ****************************************/
 
-const vector<string> ValuesOption::columns() const {
+// Returns the columns the values are given for; empty if the values are
+// given for every column in order
+const ArenaList<ArenaString>& ValuesOption::columns() const {
   return _columns;
 }
 
-const vector<shared_ptr<const Expression>> ValuesOption::values() const {
+// Returns the number of values in each row
+std::size_t ValuesOption::width() const {
+  return _width;
+}
+
+// Returns the number of rows to insert
+std::size_t ValuesOption::rows() const {
+  return _values.size() / _width;
+}
+
+// Returns the values of every row, one row after another. The values of
+// expressions that are not literals are null.
+const ArenaList<Value>& ValuesOption::values() const {
   return _values;
 }
 
-ValuesOption::ValuesOption(const vector<string> &columns,
-			   const vector<shared_ptr<const Expression>> &values)
-  : _columns(columns), _values(values) {}
+// Returns the values that are not literals, with their positions in
+// values()
+const ArenaList<RowExpression>& ValuesOption::expressions() const {
+  return _expressions;
+}
+
+ValuesOption::ValuesOption(const ArenaString &name, const ArenaList<ArenaString> &columns,
+			   std::size_t width, const ArenaList<Value> &values,
+			   const ArenaList<RowExpression> &expressions)
+  : InsertOption(name), _columns(columns), _width(width), _values(values),
+    _expressions(expressions) {}
+
+// Handles visitor acceptance logic for values options
+void ValuesOption::accept(Visitor& v) const {
+  v.visitValuesOption(*this);
+}
+
+/*****************************************
+SetClause Methods
+*****************************************/
+
+// Returns the name of the column assigned to
+const ArenaString SetClause::column() const {
+  return _column;
+}
+
+// Returns the value assigned
+const Expression *SetClause::value() const {
+  return _value;
+}
+
+SetClause::SetClause(const ArenaString& column, const Expression *value)
+  : _column(column), _value(value) {}
 
 /*****************************************
 SetOption Methods
 *****************************************/
 
-const vector<const std::pair<const string, const Expression>> SetOption::set() const {
+// Returns the column assignments of the option
+const ArenaList<SetClause>& SetOption::set() const {
   return _set;
 }
 
-SetOption::SetOption(const vector<const std::pair<const string, const Expression>> &set,
-		     const string &name) : InsertOption(name), _set(set) {}
+SetOption::SetOption(const ArenaList<SetClause> &set,
+		     const ArenaString &name) : InsertOption(name), _set(set) {}
+
+// Handles visitor acceptance logic for set options
+void SetOption::accept(Visitor& v) const {
+  v.visitSetOption(*this);
+}
 
 /*****************************************
 SelectOption Methods
 *****************************************/
 
-const vector<shared_ptr<const Identifier>> SelectOption::column_list() const {
+// Returns the columns the selected values are inserted into; empty if they
+// are inserted into every column in order
+const ArenaList<ArenaString>& SelectOption::column_list() const {
   return _column_list;
 }
 
-const Select SelectOption::select() const {
+// Returns the select statement producing the rows to insert
+const Select *SelectOption::select() const {
   return _select;
 }
 
-SelectOption::SelectOption(const Select &select) : _select(select) {}
+SelectOption::SelectOption(const ArenaString &name, const ArenaList<ArenaString> &column_list,
+			   const Select *select)
+  : InsertOption(name), _column_list(column_list), _select(select) {}
+
+// Handles visitor acceptance logic for select options
+void SelectOption::accept(Visitor& v) const {
+  v.visitSelectOption(*this);
+}
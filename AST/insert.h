@@ -1,27 +1,29 @@
 #ifndef __INSERT_H__
 #define __INSERT_H__
 
+#include <cstddef>
 #include <utility>
 #include <vector>
 #include <memory>
 #include <string>
 #include "ast.h"
+#include "expression.h"
 #include "select.h"
-#include "identifier.h"
 
 class Insert;
 class InsertOption;
 class ValuesOption;
 class SetOption;
+class SetClause;
 class SelectOption;
 
 // Corresponds to an Insert statement
 // insert_stmt ::= INSERT [INTO] { <values_option> | <set_option> | <select_option>}
-class Insert : ASTNode {
+class Insert : public ASTNode {
  public:
   const InsertOption * const option() const;
   Insert(const InsertOption * const option);
-  virtual ~Insert();
+  void accept(Visitor& v) const;
  private:
   const InsertOption * const _option;
   Insert() = delete;
@@ -30,39 +32,70 @@ class Insert : ASTNode {
 // Corresponds to one of the options for an insert statement
 // i.e. a values option, set option, or select option
 // All insert option contain a table name
-class InsertOption : ASTNode {
+class InsertOption : public ASTNode {
  public:
-  const std::string table_name() const;
+  const ArenaString table_name() const;
  protected:
-  InsertOption(const std::string &name);
+  InsertOption(const ArenaString &name);
  private:
-  const std::string _name;
+  const ArenaString _name;
   InsertOption();
 };
 
+// A value of a VALUES row that is not a literal, such as a placeholder,
+// and its position among the values of every row
+struct RowExpression {
+  std::size_t position;
+  const Expression *expression;
+};
+
 // Corresponds to a values option in an insert statement
 // values_option ::= <table_name> [(<column_name> {, <column_name>}*]
-//                            VALUES ( <expr> {,<expr>}*)
+//                            VALUES <row> {, <row>}*
+// row ::= ( <expr> {,<expr>}*)
+// The rows are kept one after another in a single list of width() values
+// each. Literals are converted to values as they are parsed, so rows cost
+// no AST nodes. Any other expression is kept in expressions(), and its
+// value in the list is null.
 class ValuesOption : public InsertOption {
  public:
-  const std::vector<std::string> columns() const;
-  const std::vector<std::shared_ptr<const Expression>> values() const;
-  ValuesOption(const std::vector<std::string> &columns,
-	       const std::vector<std::shared_ptr<const Expression>> &values);
+  const ArenaList<ArenaString>& columns() const;
+  std::size_t width() const;
+  std::size_t rows() const;
+  const ArenaList<Value>& values() const;
+  const ArenaList<RowExpression>& expressions() const;
+  ValuesOption(const ArenaString &name, const ArenaList<ArenaString> &columns,
+	       std::size_t width, const ArenaList<Value> &values,
+	       const ArenaList<RowExpression> &expressions);
+  void accept(Visitor& v) const;
+ private:
+  const ArenaList<ArenaString> _columns;
+  const std::size_t _width;
+  const ArenaList<Value> _values;
+  const ArenaList<RowExpression> _expressions;
+};
+
+// A single assignment in a set option
+// set_clause ::= <column_name>=<expr>
+class SetClause {
+ public:
+  const ArenaString column() const;
+  const Expression *value() const;
+  SetClause(const ArenaString& column, const Expression *value);
  private:
-  const std::vector<std::string> _columns;
-  const std::vector<std::shared_ptr<const Expression>> _values;
+  ArenaString _column;
+  const Expression *_value;
 };
 
 // Corresponds to a set option in an insert statement
-// set_option ::= <table_name> SET <column_name>=<expr> {,<column_name>=<expr>}*
+// set_option ::= <table_name> SET <set_clause> {, <set_clause>}*
 class SetOption : public InsertOption {
  public:
-  const std::vector<const std::pair<const std::string, const Expression>> set() const;
-  SetOption(const std::vector<const std::pair<const std::string, const Expression>>& set,
-	    const std::string& name);
+  const ArenaList<SetClause>& set() const;
+  SetOption(const ArenaList<SetClause>& set, const ArenaString& name);
+  void accept(Visitor& v) const;
  private:
-  const std::vector<const std::pair<const std::string, const Expression>> _set;
+  const ArenaList<SetClause> _set;
   
 };
 
@@ -70,12 +103,14 @@ class SetOption : public InsertOption {
 // select_option ::= <table_name> [(<column_name> {,<column_name>}*)] <select_stmt>
 class SelectOption : public InsertOption {
  public:
-  const std::vector<std::shared_ptr<const Identifier>> column_list() const;
-  const Select select() const;
-  SelectOption(const Select &select);
+  const ArenaList<ArenaString>& column_list() const;
+  const Select *select() const;
+  SelectOption(const ArenaString &name, const ArenaList<ArenaString> &column_list,
+	       const Select *select);
+  void accept(Visitor& v) const;
  private:
-  const std::vector<std::shared_ptr<const Identifier>> _column_list;
-  const Select _select;
+  const ArenaList<ArenaString> _column_list;
+  const Select *const _select;
 };
 
 
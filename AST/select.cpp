@@ -0,0 +1,215 @@
+/*
+ * This file is part of the SimpleSQL package.
+ * Contains the logic for Select statements in the SQL parse tree.
+ *
+ */
+
+#include "select.h"
+#include "visitor.h"
+
+/*---------------------------------------------
+   WhereExpr methods
+   ------------------------------------------*/
+
+// Returns the condition rows must meet to be selected
+const Expression *WhereExpr::condition() const {
+  return _condition;
+}
+
+// Creates a where clause selecting the rows that meet condition
+WhereExpr::WhereExpr(const Expression *condition) : _condition(condition) {}
+
+// Handles visitor acceptance logic for where clauses
+void WhereExpr::accept(Visitor& v) const {
+  v.visitWhereExpr(*this);
+}
+
+/*---------------------------------------------
+   GroupByExpr methods
+   ------------------------------------------*/
+
+// Returns the expressions rows are grouped by
+const ArenaList<const Expression*>& GroupByExpr::columns() const {
+  return _columns;
+}
+
+// Creates a group by clause grouping rows by columns
+GroupByExpr::GroupByExpr(const ArenaList<const Expression*>& columns) : _columns(columns) {}
+
+// Handles visitor acceptance logic for group by clauses
+void GroupByExpr::accept(Visitor& v) const {
+  v.visitGroupByExpr(*this);
+}
+
+/*---------------------------------------------
+   HavingExpr methods
+   ------------------------------------------*/
+
+// Returns the condition groups must meet to be selected
+const Expression *HavingExpr::condition() const {
+  return _condition;
+}
+
+// Creates a having clause selecting the groups that meet condition
+HavingExpr::HavingExpr(const Expression *condition) : _condition(condition) {}
+
+// Handles visitor acceptance logic for having clauses
+void HavingExpr::accept(Visitor& v) const {
+  v.visitHavingExpr(*this);
+}
+
+/*---------------------------------------------
+   OrderByItem methods
+   ------------------------------------------*/
+
+// Returns the expression rows are ordered by
+const Expression *OrderByItem::value() const {
+  return _value;
+}
+
+// Returns true if rows are ordered from the greatest value down
+bool OrderByItem::descending() const {
+  return _descending;
+}
+
+// Creates an item ordering rows by value, in the given direction
+OrderByItem::OrderByItem(const Expression *value, bool descending)
+  : _value(value), _descending(descending) {}
+
+/*---------------------------------------------
+   OrderByExpr methods
+   ------------------------------------------*/
+
+// Returns the expressions rows are ordered by, most significant first
+const ArenaList<OrderByItem>& OrderByExpr::items() const {
+  return _items;
+}
+
+// Creates an order by clause ordering rows by items
+OrderByExpr::OrderByExpr(const ArenaList<OrderByItem>& items) : _items(items) {}
+
+// Handles visitor acceptance logic for order by clauses
+void OrderByExpr::accept(Visitor& v) const {
+  v.visitOrderByExpr(*this);
+}
+
+/*---------------------------------------------
+   LimitExpr methods
+   ------------------------------------------*/
+
+// Returns the number of rows to skip before the first one returned
+int LimitExpr::offset() const {
+  return _offset;
+}
+
+// Returns the maximum number of rows to return
+int LimitExpr::rows() const {
+  return _rows;
+}
+
+// Creates a limit clause returning at most rows rows after skipping offset
+LimitExpr::LimitExpr(int offset, int rows) : _offset(offset), _rows(rows) {}
+
+// Handles visitor acceptance logic for limit clauses
+void LimitExpr::accept(Visitor& v) const {
+  v.visitLimitExpr(*this);
+}
+
+/*---------------------------------------------
+   JoinClause methods
+   ------------------------------------------*/
+
+// Returns the kind of join
+JoinKind JoinClause::kind() const {
+  return _kind;
+}
+
+// Returns the name of the table joined
+const ArenaString JoinClause::table() const {
+  return _table;
+}
+
+// Returns the condition rows are paired on
+const Expression *JoinClause::condition() const {
+  return _condition;
+}
+
+// Creates a join of table on condition
+JoinClause::JoinClause(JoinKind kind, const ArenaString& table, const Expression *condition)
+  : _kind(kind), _table(table), _condition(condition) {}
+
+/*---------------------------------------------
+   SelectExpression methods
+   ------------------------------------------*/
+
+// Returns the tables rows are selected from
+const ArenaList<ArenaString>& SelectExpression::table_list() const {
+  return _table_list;
+}
+
+// Returns the tables joined to those of the table list, in order
+const ArenaList<JoinClause>& SelectExpression::joins() const {
+  return _joins;
+}
+
+// Returns the where clause, or null if there is none
+const WhereExpr *SelectExpression::where_expr() const {
+  return _where;
+}
+
+// Returns the group by clause, or null if there is none
+const GroupByExpr *SelectExpression::group_by_expr() const {
+  return _group;
+}
+
+// Returns the having clause, or null if there is none
+const HavingExpr *SelectExpression::having_expr() const {
+  return _having;
+}
+
+// Returns the order by clause, or null if there is none
+const OrderByExpr *SelectExpression::order_by_expr() const {
+  return _order;
+}
+
+// Returns the limit clause, or null if there is none
+const LimitExpr *SelectExpression::limit_expr() const {
+  return _limit;
+}
+
+// Creates a select expression from its clauses; absent clauses are null
+SelectExpression::SelectExpression(const ArenaList<ArenaString>& table_list,
+				   const ArenaList<JoinClause>& joins, const WhereExpr *where,
+				   const GroupByExpr *group, const HavingExpr *having,
+				   const OrderByExpr *order, const LimitExpr *limit)
+  : _table_list(table_list), _joins(joins), _where(where), _group(group), _having(having),
+    _order(order), _limit(limit) {}
+
+// Handles visitor acceptance logic for select expressions
+void SelectExpression::accept(Visitor& v) const {
+  v.visitSelectExpression(*this);
+}
+
+/*---------------------------------------------
+   Select methods
+   ------------------------------------------*/
+
+// Returns the expressions to select; empty for SELECT *
+const ArenaList<const Expression*>& Select::select_list() const {
+  return _select_list;
+}
+
+// Returns the select expression, or null if there is none
+const SelectExpression *Select::exp() const {
+  return _selectExpression;
+}
+
+// Creates a select statement of the given expressions
+Select::Select(const ArenaList<const Expression*>& select_list,
+	       const SelectExpression *selectExpression)
+  : _select_list(select_list), _selectExpression(selectExpression) {}
+
+// Handles visitor acceptance logic for select statements
+void Select::accept(Visitor& v) const {
+  v.visitSelect(*this);
+}
@@ -5,70 +5,157 @@
 #include <memory>
 #include <vector>
 #include "ast.h"
-#include "identifier.h"
+#include "expression.h"
 
+// where_expression ::= <expr>
 class WhereExpr : public ASTNode {
-  
+ public:
+  const Expression *condition() const;
+  WhereExpr(const Expression *condition);
+  void accept(Visitor& v) const;
+ private:
+  WhereExpr();
+  const Expression *const _condition;
 };
 
+// Corresponds to the expressions rows are grouped by. Rows with equal
+// values, where NULLs count as equal, form one group.
+// group_by ::= GROUP BY <expr> {, <expr>}*
 class GroupByExpr : public ASTNode {
-
-
+ public:
+  const ArenaList<const Expression*>& columns() const;
+  GroupByExpr(const ArenaList<const Expression*>& columns);
+  void accept(Visitor& v) const;
+ private:
+  GroupByExpr();
+  const ArenaList<const Expression*> _columns;
 };
 
-// havingExpr :
+// Corresponds to the condition groups must meet to be selected, which may
+// use aggregates
+// having ::= HAVING <condition>
 class HavingExpr : public ASTNode {
-
+ public:
+  const Expression *condition() const;
+  HavingExpr(const Expression *condition);
+  void accept(Visitor& v) const;
+ private:
+  HavingExpr();
+  const Expression *const _condition;
 };
 
+// A single expression rows are ordered by, and its direction. NULLs come
+// first in ascending order and last in descending order.
+// order_by_item ::= <expr> [ASC | DESC]
+class OrderByItem {
+ public:
+  const Expression *value() const;
+  bool descending() const;
+  OrderByItem(const Expression *value, bool descending);
+ private:
+  const Expression *_value;
+  bool _descending;
+};
 
+// Corresponds to the expressions rows are ordered by, the first one
+// first, then the next for rows where it is equal, and so on
+// order_by ::= ORDER BY <order_by_item> {, <order_by_item>}*
 class OrderByExpr : public ASTNode {
-
+ public:
+  const ArenaList<OrderByItem>& items() const;
+  OrderByExpr(const ArenaList<OrderByItem>& items);
+  void accept(Visitor& v) const;
+ private:
+  OrderByExpr();
+  const ArenaList<OrderByItem> _items;
 };
 
 // limit ::= LIMIT [<offset>, ] <row_count>
 class LimitExpr : public ASTNode {
  public:
-  int offset();
-  int rows();
+  int offset() const;
+  int rows() const;
   LimitExpr(int offset, int rows);
+  void accept(Visitor& v) const;
  private:
-  _offset;
-  _rows;
+  const int _offset;
+  const int _rows;
   LimitExpr() = delete;  
 };
 
 
+// The kinds of join. Outer joins keep the rows of the left, right or both
+// tables that match no row of the other, with NULLs for its columns.
+enum class JoinKind {
+  INNER,
+  LEFT,
+  RIGHT,
+  FULL
+};
+
+// A table joined to the tables before it, pairing their rows with its rows
+// for which the condition is true
+// join ::= [INNER | {LEFT | RIGHT | FULL} [OUTER]] JOIN <table_name>
+//          ON <condition>
+class JoinClause {
+ public:
+  JoinKind kind() const;
+  const ArenaString table() const;
+  const Expression *condition() const;
+  JoinClause(JoinKind kind, const ArenaString& table, const Expression *condition);
+ private:
+  JoinKind _kind;
+  ArenaString _table;
+  const Expression *_condition;
+};
+
 // Correponds to the logical statement at the end of a select command
-// select_expr ::= FROM <table_list>
+// select_expr ::= FROM <table_list> {<join>}*
 //                        [WHERE <where_expression> ] [GROUP BY <group_defn>]
 //                        [HAVING <having_expr> ] [ORDER BY <order_by_defn>]
 //                        [LIMIT [<offset>, ] <row_count>] 
+// Clauses that are absent are null.
 class SelectExpression : public ASTNode  {
  public:
-  const std::vector<const std::unique_ptr<const Identifier>> table_list() const;
-  const WhereExpr where_expr() const;
+  const ArenaList<ArenaString>& table_list() const;
+  const ArenaList<JoinClause>& joins() const;
+  const WhereExpr *where_expr() const;
+  const GroupByExpr *group_by_expr() const;
+  const HavingExpr *having_expr() const;
+  const OrderByExpr *order_by_expr() const;
+  const LimitExpr *limit_expr() const;
+  SelectExpression(const ArenaList<ArenaString>& table_list,
+		   const ArenaList<JoinClause>& joins, const WhereExpr *where,
+		   const GroupByExpr *group, const HavingExpr *having,
+		   const OrderByExpr *order, const LimitExpr *limit);
+  void accept(Visitor& v) const;
  private:
   SelectExpression();
-  const std::vector<const std::unique_ptr<const Identifer>> _table_list;
-  const WhereExpr _where;
-  const GroupByExpr _group;
-  const HavingExpr _having;
-  const OrderByExpr _order;
-  const LimitExpr _limit;
+  const ArenaList<ArenaString> _table_list;
+  const ArenaList<JoinClause> _joins;
+  const WhereExpr *const _where;
+  const GroupByExpr *const _group;
+  const HavingExpr *const _having;
+  const OrderByExpr *const _order;
+  const LimitExpr *const _limit;
 };
 
 
 
 // Corresponds to a select statement
 // select_stmt ::= SELECT {<select_list> | *} [<select_expr>]
+// An empty select list stands for *.
 class Select : public ASTNode {
  public:
-  const SelectExpression exp() const;
-  Select(const SelectExpression selectExpression);
+  const ArenaList<const Expression*>& select_list() const;
+  const SelectExpression *exp() const;
+  Select(const ArenaList<const Expression*>& select_list,
+	 const SelectExpression *selectExpression);
+  void accept(Visitor& v) const;
  private:
   Select();
-  const SelectExpression _selectExpression;
+  const ArenaList<const Expression*> _select_list;
+  const SelectExpression *const _selectExpression;
 };
 
 class SelectExpressionBuilder {
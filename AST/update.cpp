@@ -0,0 +1,31 @@
+#include "update.h"
+#include "visitor.h"
+
+/*****************************************
+ Update Methods
+****************************************/
+
+// Returns the name of the table whose rows are updated
+const ArenaString Update::table_name() const {
+  return _table_name;
+}
+
+// Returns the column assignments made to every updated row
+const ArenaList<SetClause>& Update::set() const {
+  return _set;
+}
+
+// Returns the condition rows must meet to be updated, or null if every row
+// is updated
+const Expression *Update::exp() const {
+  return updateExpression;
+}
+
+Update::Update(const ArenaString& table_name, const ArenaList<SetClause>& set,
+	       const Expression *updateExpression)
+  : _table_name(table_name), _set(set), updateExpression(updateExpression) {}
+
+// Handles visitor acceptance logic for update statements
+void Update::accept(Visitor& v) const {
+  v.visitUpdate(*this);
+}
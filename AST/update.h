@@ -1,10 +1,26 @@
 #ifndef __UPDATE_H__
 #define __UPDATE_H__
 
+#include "ast.h"
+#include "expression.h"
+#include "insert.h"
 
 // Corresponds to an update statement
-class Update : ASTNode {
-  
+// update_stmt ::= UPDATE <table_name> SET <set_clause> {, <set_clause>}*
+//                   [WHERE <condition>]
+class Update : public ASTNode {
+ public:
+  const ArenaString table_name() const;
+  const ArenaList<SetClause>& set() const;
+  const Expression *exp() const;
+  Update(const ArenaString& table_name, const ArenaList<SetClause>& set,
+	 const Expression *updateExpression);
+  void accept(Visitor& v) const;
+ private:
+  Update();
+  const ArenaString _table_name;
+  const ArenaList<SetClause> _set;
+  const Expression *const updateExpression;
 };
 
 #endif  // __UPDATE_H__
@@ -0,0 +1,25 @@
+/*
+ * This file is part of the SimpleSQL package.
+ * Contains the representation of single SQL values.
+ *
+ */
+
+#include "value.h"
+
+using std::string;
+
+// Returns the value as it would be written in SQL
+const string Value::toString() const {
+  switch (_type) {
+  case ValueType::NUL:
+    return "NULL";
+  case ValueType::INT:
+    return std::to_string(_int);
+  case ValueType::UINT:
+    return std::to_string(_uint);
+  case ValueType::DOUBLE:
+    return std::to_string(_double);
+  default:
+    return "'" + string_value() + "'";
+  }
+}
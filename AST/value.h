@@ -0,0 +1,47 @@
+#ifndef __VALUE_H__
+#define __VALUE_H__
+
+#include <cstddef>
+#include <string>
+
+// The types of value an expression can produce
+enum class ValueType {
+  NUL,
+  INT,
+  UINT,
+  DOUBLE,
+  STRING
+};
+
+// A single SQL value. Strings are not owned: they refer to characters kept
+// alive elsewhere, such as a statement's arena or the command a parameter
+// was taken from, so values are cheap to copy.
+class Value {
+ public:
+  Value() : _type(ValueType::NUL), _int(0), _length(0) {}
+  explicit Value(long long value) : _type(ValueType::INT), _int(value), _length(0) {}
+  explicit Value(unsigned long long value) : _type(ValueType::UINT), _uint(value), _length(0) {}
+  explicit Value(double value) : _type(ValueType::DOUBLE), _double(value), _length(0) {}
+  Value(const char *data, std::size_t length)
+    : _type(ValueType::STRING), _string(data), _length(length) {}
+  ValueType type() const { return _type; }
+  bool is_null() const { return _type == ValueType::NUL; }
+  long long int_value() const { return _int; }
+  unsigned long long uint_value() const { return _uint; }
+  double double_value() const { return _double; }
+  const char *string_data() const { return _string; }
+  std::size_t string_length() const { return _length; }
+  const std::string string_value() const { return std::string(_string, _length); }
+  const std::string toString() const;
+ private:
+  ValueType _type;
+  union {
+    long long _int;
+    unsigned long long _uint;
+    double _double;
+    const char *_string;
+  };
+  std::size_t _length;
+};
+
+#endif  // __VALUE_H__
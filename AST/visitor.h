@@ -2,13 +2,43 @@
 #define __VISITOR_H__
 
 #include "ast_public.h"
+
+// Visits the nodes of an AST. Every visit does nothing by default, so
+// subclasses only override the nodes they handle.
 class Visitor {
  public:
-  virtual void visitCreateDatabase(const CreateDatabase& node);
-  virtual void visitCreateTable(const CreateTable& node);
-  virtual void visitColumnDecl(const ColumnDecl& node);
-  virtual void visitPrimaryKeyDecl(const PrimaryKeyDecl& node);
-  virtual void visitForeignKeyDecl(const ForeignKeyDecl& node);
+  virtual void visitCreateDatabase(const CreateDatabase& node) {}
+  virtual void visitCreateTable(const CreateTable& node) {}
+  virtual void visitCreateIndex(const CreateIndex& node) {}
+  virtual void visitColumnDecl(const ColumnDecl& node) {}
+  virtual void visitPrimaryKeyDecl(const PrimaryKeyDecl& node) {}
+  virtual void visitForeignKeyDecl(const ForeignKeyDecl& node) {}
+  virtual void visitDropTable(const DropTable& node) {}
+  virtual void visitDropDatabase(const DropDatabase& node) {}
+  virtual void visitDropIndex(const DropIndex& node) {}
+  virtual void visitInsert(const Insert& node) {}
+  virtual void visitValuesOption(const ValuesOption& node) {}
+  virtual void visitSetOption(const SetOption& node) {}
+  virtual void visitSelectOption(const SelectOption& node) {}
+  virtual void visitDelete(const Delete& node) {}
+  virtual void visitUpdate(const Update& node) {}
+  virtual void visitSelect(const Select& node) {}
+  virtual void visitSelectExpression(const SelectExpression& node) {}
+  virtual void visitWhereExpr(const WhereExpr& node) {}
+  virtual void visitGroupByExpr(const GroupByExpr& node) {}
+  virtual void visitHavingExpr(const HavingExpr& node) {}
+  virtual void visitOrderByExpr(const OrderByExpr& node) {}
+  virtual void visitLimitExpr(const LimitExpr& node) {}
+  virtual void visitLiteral(const Literal& node) {}
+  virtual void visitPlaceholder(const Placeholder& node) {}
+  virtual void visitColumnRef(const ColumnRef& node) {}
+  virtual void visitBinaryExpr(const BinaryExpr& node) {}
+  virtual void visitNotExpr(const NotExpr& node) {}
+  virtual void visitBetweenExpr(const BetweenExpr& node) {}
+  virtual void visitInExpr(const InExpr& node) {}
+  virtual void visitIsNullExpr(const IsNullExpr& node) {}
+  virtual void visitAggregateExpr(const AggregateExpr& node) {}
+  virtual ~Visitor() {}
 };
 
 #endif
@@ -0,0 +1,78 @@
+// SimpleSQL: Hash aggregation benchmarks
+//
+// Measures the rows per second GROUP BY aggregates, on the calling thread
+// alone and on a pool of the default number of threads, with few groups
+// and with about one group per hundred rows.
+
+#include <memory>
+#include <random>
+#include "bench.h"
+#include "../exec/aggregate.h"
+
+using std::size_t;
+using std::vector;
+
+namespace {
+
+const size_t ROWS = 1 << 20;
+
+// A table of ROWS rows with an integer key of the given number of distinct
+// values and an integer to add up
+struct GroupTable {
+  explicit GroupTable(long long groups);
+  std::unique_ptr<Table> table;
+  vector<size_t> rows;
+};
+
+GroupTable::GroupTable(long long groups) {
+  Schema schema;
+  schema.add_column(ColumnSchema{"k", INT_T, 0, false});
+  schema.add_column(ColumnSchema{"v", INT_T, 0, true});
+  table.reset(new Table("g", schema));
+  std::mt19937 random(42);
+  vector<vector<Value>> values;
+  for (size_t i = 0; i < ROWS; ++i) {
+    values.push_back({Value(static_cast<long long>(random() % groups)),
+	  Value(static_cast<long long>(random() % 1000))});
+    rows.push_back(i);
+  }
+  table->append(values);
+}
+
+// Returns a benchmark of COUNT(*), SUM(v) and MAX(v) grouped by a key of
+// groups values, on the threads of a pool of threads, or the calling
+// thread if threads is 0
+BenchmarkBody group_by(long long groups, size_t threads) {
+  auto table = std::make_shared<GroupTable>(groups);
+  std::shared_ptr<ThreadPool> pool;
+  if (threads) {
+    pool = std::make_shared<ThreadPool>(threads);
+  }
+  return [=]() {
+    vector<AggregateSpec> aggregates{{AggregateFunction::COUNT, -1, false},
+				     {AggregateFunction::SUM, 1, false},
+				     {AggregateFunction::MAX, 1, false}};
+    std::unique_ptr<Table> result = aggregate_rows(*table->table, table->rows, {0}, aggregates,
+						   pool.get());
+    do_not_optimize(result);
+    return ROWS;
+  };
+}
+
+const RegisterBenchmark few_serial("aggregate/few_groups/serial", "row", []() {
+    return group_by(16, 0);
+  });
+
+const RegisterBenchmark few_parallel("aggregate/few_groups/parallel", "row", []() {
+    return group_by(16, ThreadPool::default_threads());
+  });
+
+const RegisterBenchmark many_serial("aggregate/many_groups/serial", "row", []() {
+    return group_by(ROWS / 100, 0);
+  });
+
+const RegisterBenchmark many_parallel("aggregate/many_groups/parallel", "row", []() {
+    return group_by(ROWS / 100, ThreadPool::default_threads());
+  });
+
+}  // namespace
@@ -0,0 +1,58 @@
+// SimpleSQL: Allocation counting for benchmarks
+//
+// Replaces the global operator new and delete so that the harness can
+// report allocations per unit of work. Only linked into the benchmarks.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "bench.h"
+
+namespace {
+
+std::atomic<std::size_t> allocations(0);
+std::atomic<std::size_t> bytes(0);
+
+void *counted_allocate(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add(size, std::memory_order_relaxed);
+  void *p = std::malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+}  // namespace
+
+std::size_t allocation_count() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+std::size_t allocated_bytes() {
+  return bytes.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size) {
+  return counted_allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+  return counted_allocate(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  std::free(p);
+}
@@ -0,0 +1,102 @@
+// SimpleSQL: Benchmark harness
+
+#include "bench.h"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+// Returns every registered benchmark, in registration order
+vector<Benchmark>& benchmarks() {
+  static vector<Benchmark> all;
+  return all;
+}
+
+// Adds a benchmark measuring the given unit of work. setup makes the body
+// to time.
+void register_benchmark(const string& name, const string& unit,
+			std::function<BenchmarkBody()> setup) {
+  benchmarks().push_back(Benchmark{name, unit, setup});
+}
+
+RegisterBenchmark::RegisterBenchmark(const string& name, const string& unit,
+				     std::function<BenchmarkBody()> setup) {
+  register_benchmark(name, unit, setup);
+}
+
+namespace {
+
+// The metrics reported by the benchmark running
+std::vector<std::pair<string, double>> current_metrics;
+
+}  // namespace
+
+// Records a measurement particular to the running benchmark, such as a hit
+// ratio, to be reported along with its timings. Reporting the same name
+// again replaces the value.
+void report_metric(const string& name, double value) {
+  for (auto it = current_metrics.begin(); it != current_metrics.end(); ++it) {
+    if (it->first == name) {
+      it->second = value;
+      return;
+    }
+  }
+  current_metrics.push_back(std::make_pair(name, value));
+}
+
+// Returns the path of a file that does not exist yet, for benchmarks that
+// need one. The caller removes the file when done.
+const string scratch_file() {
+  char path[] = "/tmp/simplesql_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  std::remove(path);
+  return path;
+}
+
+// Sets up benchmark and runs its body once untimed to warm caches, then
+// repeatedly until min_seconds have passed
+BenchmarkResult run_benchmark(const Benchmark& benchmark, double min_seconds) {
+  current_metrics.clear();
+  BenchmarkBody body = benchmark.setup();
+  body();
+  BenchmarkResult result{benchmark.name, benchmark.unit, 0, 0, 0.0, 0, 0, {}};
+  size_t allocations_before = allocation_count();
+  size_t bytes_before = allocated_bytes();
+  auto start = std::chrono::steady_clock::now();
+  do {
+    result.units += body();
+    ++result.repetitions;
+    result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  } while (result.ns < min_seconds * 1e9);
+  result.allocations = allocation_count() - allocations_before;
+  result.allocated_bytes = allocated_bytes() - bytes_before;
+  result.metrics = current_metrics;
+  return result;
+}
+
+// Returns the result as a single line JSON object
+const string to_json(const BenchmarkResult& result) {
+  double units = result.units ? static_cast<double>(result.units) : 1.0;
+  std::ostringstream out;
+  out << "{\"benchmark\": \"" << result.name << "\""
+      << ", \"unit\": \"" << result.unit << "\""
+      << ", \"repetitions\": " << result.repetitions
+      << ", \"units\": " << result.units
+      << ", \"ns_per_unit\": " << result.ns / units
+      << ", \"allocs_per_unit\": " << result.allocations / units
+      << ", \"bytes_per_unit\": " << result.allocated_bytes / units
+      << ", \"units_per_sec\": " << units / (result.ns / 1e9);
+  for (auto it = result.metrics.begin(); it != result.metrics.end(); ++it) {
+    out << ", \"" << it->first << "\": " << it->second;
+  }
+  out << "}";
+  return out.str();
+}
@@ -0,0 +1,69 @@
+// SimpleSQL: Benchmark harness
+//
+// Benchmarks register themselves with a name and the unit of work they
+// measure, such as a statement or a row. The runner times each one over
+// enough repetitions to fill a minimum time, counts the heap allocations
+// made meanwhile, and prints one JSON object per benchmark so that results
+// can be compared between builds.
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Runs the measured work once and returns the number of units processed
+typedef std::function<std::size_t()> BenchmarkBody;
+
+// A registered benchmark. setup is called once, outside the timed region,
+// and returns the body to time.
+struct Benchmark {
+  std::string name;
+  std::string unit;
+  std::function<BenchmarkBody()> setup;
+};
+
+void register_benchmark(const std::string& name, const std::string& unit,
+			std::function<BenchmarkBody()> setup);
+
+// Registers a benchmark when constructed. Meant to be used for static
+// objects in the files defining the benchmarks.
+class RegisterBenchmark {
+ public:
+  RegisterBenchmark(const std::string& name, const std::string& unit,
+		    std::function<BenchmarkBody()> setup);
+};
+
+// The measurements of one benchmark
+struct BenchmarkResult {
+  std::string name;
+  std::string unit;
+  std::size_t repetitions;
+  std::size_t units;
+  double ns;
+  std::size_t allocations;
+  std::size_t allocated_bytes;
+  // Measurements particular to the benchmark, set with report_metric()
+  std::vector<std::pair<std::string, double>> metrics;
+};
+
+std::vector<Benchmark>& benchmarks();
+BenchmarkResult run_benchmark(const Benchmark& benchmark, double min_seconds);
+const std::string to_json(const BenchmarkResult& result);
+void report_metric(const std::string& name, double value);
+const std::string scratch_file();
+
+// Heap allocations made through operator new since the program started
+std::size_t allocation_count();
+std::size_t allocated_bytes();
+
+// Keeps value from being optimized away
+template <typename T>
+inline void do_not_optimize(const T& value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+#endif  // __BENCH_H__
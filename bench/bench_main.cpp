@@ -0,0 +1,52 @@
+// SimpleSQL: Benchmark runner
+//
+// Usage: simple_bench [--min-time seconds] [--list] [filter...]
+// Runs every registered benchmark whose name contains one of the filters,
+// or all of them if there are none, and prints one JSON object per line.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bench.h"
+
+using std::string;
+using std::vector;
+
+int main(int argc, char **argv) {
+  double min_seconds = 0.5;
+  bool list = false;
+  vector<string> filters;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--min-time" && i + 1 < argc) {
+      min_seconds = std::atof(argv[++i]);
+    } else if (arg == "--list") {
+      list = true;
+    } else {
+      filters.push_back(arg);
+    }
+  }
+
+  // Registration order depends on link order, so sort for stable output
+  vector<Benchmark> all = benchmarks();
+  std::stable_sort(all.begin(), all.end(), [](const Benchmark& a, const Benchmark& b) {
+      return a.name < b.name;
+    });
+  for (auto it = all.begin(); it != all.end(); ++it) {
+    bool selected = filters.empty();
+    for (auto filter = filters.begin(); filter != filters.end() && !selected; ++filter) {
+      selected = it->name.find(*filter) != string::npos;
+    }
+    if (!selected) {
+      continue;
+    }
+    if (list) {
+      std::cout << it->name << std::endl;
+    } else {
+      std::cout << to_json(run_benchmark(*it, min_seconds)) << std::endl;
+    }
+  }
+  return 0;
+}
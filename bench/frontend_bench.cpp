@@ -0,0 +1,167 @@
+// SimpleSQL: Front end benchmarks
+//
+// Measures lexing, parsing and AST construction over the synthetic
+// workloads. Scripts are generated during setup, so only the front end is
+// timed.
+
+#include <memory>
+#include <sstream>
+#include "bench.h"
+#include "workload.h"
+#include "../lexer/lexer.h"
+#include "../lexer/statement_reader.h"
+#include "../parser/parser.h"
+#include "../parser/plan_cache.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t STATEMENTS = 2000;
+const size_t WIDE_COLUMNS = 64;
+
+// The workloads every front end benchmark runs over
+enum class Script {
+  CREATE,
+  INSERT,
+  SELECT
+};
+
+// Returns the workload script of STATEMENTS statements of the given kind
+const string make_script(Script kind) {
+  Workload workload;
+  WorkloadTable table = workload.table("bench", WIDE_COLUMNS);
+  size_t tables = 0;
+  return Workload::script(STATEMENTS, [&]() {
+      switch (kind) {
+      case Script::CREATE:
+	return workload.create_table(workload.table("t" + std::to_string(tables++), WIDE_COLUMNS));
+      case Script::INSERT:
+	return workload.insert(table);
+      default:
+	return workload.select(table);
+      }
+    });
+}
+
+// Registers the benchmarks of one stage for every workload. stage_body makes a
+// benchmark body from a script.
+void register_stage(const string& stage, std::function<BenchmarkBody(const string&)> stage_body) {
+  static const std::pair<const char*, Script> scripts[] = {
+    {"create_table", Script::CREATE},
+    {"insert", Script::INSERT},
+    {"select", Script::SELECT}
+  };
+  for (auto& script : scripts) {
+    Script kind = script.second;
+    register_benchmark(stage + "/" + script.first, "statement", [=]() {
+	return stage_body(make_script(kind));
+      });
+  }
+}
+
+// Counts the statements in tokes
+size_t count_statements(const vector<FlatToken>& tokes) {
+  size_t statements = 0;
+  for (auto it = tokes.begin(); it != tokes.end(); ++it) {
+    statements += it->type == Tokens::SEMICOLON;
+  }
+  return statements;
+}
+
+int register_frontend() {
+  register_stage("tokenize_command", [](const string& sql) -> BenchmarkBody {
+      auto tokes = std::make_shared<vector<FlatToken>>();
+      return [=]() {
+	tokes->clear();
+	tokenize_command(sql, *tokes);
+	return count_statements(*tokes);
+      };
+    });
+
+  register_stage("statement_reader", [](const string& sql) -> BenchmarkBody {
+      return [=]() {
+	std::istringstream in(sql);
+	StatementReader reader(in);
+	vector<FlatToken> tokes;
+	while (reader.next(tokes)) {}
+	return reader.statements_read();
+      };
+    });
+
+  register_stage("parse", [](const string& sql) -> BenchmarkBody {
+      // The tokens point into the script, so it must outlive the body
+      auto script = std::make_shared<const string>(sql);
+      auto tokes = std::make_shared<vector<FlatToken>>();
+      tokenize_command(*script, *tokes);
+      auto arena = std::make_shared<Arena>();
+      return [=]() {
+	do_not_optimize(script);
+	size_t statements = parse(*tokes, *arena).size();
+	arena->reset();
+	return statements;
+      };
+    });
+
+  register_stage("parse_parallel", [](const string& sql) -> BenchmarkBody {
+      // The tokens point into the script, so it must outlive the body
+      auto script = std::make_shared<const string>(sql);
+      auto tokes = std::make_shared<vector<FlatToken>>();
+      tokenize_command(*script, *tokes);
+      auto pool = std::make_shared<ThreadPool>();
+      return [=]() {
+	do_not_optimize(script);
+	vector<std::unique_ptr<Arena>> arenas;
+	return parse(*tokes, arenas, *pool).size();
+      };
+    });
+
+  // Builds wide CREATE TABLE ASTs directly, without the lexer or parser
+  register_benchmark("builders/create_table", "statement", []() -> BenchmarkBody {
+      Workload workload;
+      auto table = std::make_shared<WorkloadTable>(workload.table("bench", WIDE_COLUMNS));
+      auto arena = std::make_shared<Arena>();
+      return [=]() {
+	CreateBuilder create(*arena);
+	ColumnDeclBuilder column(*arena);
+	for (size_t i = 0; i < STATEMENTS; ++i) {
+	  vector<const CreateElement*> elements;
+	  for (auto it = table->columns.begin(); it != table->columns.end(); ++it) {
+	    elements.push_back(column.name(it->name).type(it->type).length(it->length)
+			       .nullable(it->nullable).build());
+	  }
+	  do_not_optimize(create.type(ASTType::TABLE).name(table->name).elements(elements).build());
+	}
+	arena->reset();
+	return STATEMENTS;
+      };
+    });
+
+  // Looks up ad-hoc statements that differ only in their constants
+  register_benchmark("plan_cache/lookup_select", "statement", []() -> BenchmarkBody {
+      Workload workload;
+      WorkloadTable table = workload.table("bench", WIDE_COLUMNS);
+      auto statements = std::make_shared<vector<string>>();
+      for (size_t i = 0; i < STATEMENTS; ++i) {
+	statements->push_back("SELECT id FROM bench WHERE id = " + std::to_string(i) +
+			      " AND c1 > " + workload.value(table.columns[1]) + ";");
+      }
+      auto cache = std::make_shared<PlanCache>();
+      auto arena = std::make_shared<Arena>();
+      return [=]() {
+	vector<Value> parameters;
+	for (auto it = statements->begin(); it != statements->end(); ++it) {
+	  do_not_optimize(cache->lookup(*it, parameters, *arena));
+	}
+	arena->reset();
+	return statements->size();
+      };
+    });
+  return 0;
+}
+
+const int registered = register_frontend();
+
+}  // namespace
@@ -0,0 +1,108 @@
+// SimpleSQL: Hash join benchmarks
+//
+// Measures the rows per second, of both sides together, that a hash join
+// of orders to their customers joins, on the calling thread alone and on a
+// pool of the default number of threads, with a key of one integer column
+// and with a key of a string column.
+
+#include <memory>
+#include <random>
+#include <string>
+#include "bench.h"
+#include "../exec/join.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t ORDERS = 1 << 20;
+const size_t CUSTOMERS = 1 << 18;
+
+// The orders and customers tables, each with an integer and a string key
+// naming the order's customer, and the rows of each
+struct OrderTables {
+  OrderTables();
+  std::unique_ptr<Table> orders;
+  std::unique_ptr<Table> customers;
+  vector<size_t> order_rows;
+  vector<size_t> customer_rows;
+};
+
+OrderTables::OrderTables() {
+  Schema order_schema;
+  order_schema.add_column(ColumnSchema{"customer", INT_T, 0, false});
+  order_schema.add_column(ColumnSchema{"name", STRING_T, 16, false});
+  order_schema.add_column(ColumnSchema{"total", INT_T, 0, false});
+  Schema customer_schema;
+  customer_schema.add_column(ColumnSchema{"id", INT_T, 0, false});
+  customer_schema.add_column(ColumnSchema{"name", STRING_T, 16, false});
+  orders.reset(new Table("orders", order_schema));
+  customers.reset(new Table("customers", customer_schema));
+  vector<string> names;
+  vector<vector<Value>> values;
+  for (size_t i = 0; i < CUSTOMERS; ++i) {
+    names.push_back("customer" + std::to_string(i));
+  }
+  for (size_t i = 0; i < CUSTOMERS; ++i) {
+    values.push_back({Value(static_cast<long long>(i)),
+	  Value(names[i].data(), names[i].size())});
+    customer_rows.push_back(i);
+  }
+  customers->append(values);
+  values.clear();
+  std::mt19937 random(42);
+  for (size_t i = 0; i < ORDERS; ++i) {
+    size_t customer = random() % CUSTOMERS;
+    values.push_back({Value(static_cast<long long>(customer)),
+	  Value(names[customer].data(), names[customer].size()),
+	  Value(static_cast<long long>(random() % 1000))});
+    order_rows.push_back(i);
+  }
+  orders->append(values);
+}
+
+// Returns a benchmark of joining the orders to their customers on the
+// given key columns, on the threads of a pool of threads, or the calling
+// thread if threads is 0
+BenchmarkBody join(const JoinKey& key, size_t threads) {
+  auto tables = std::make_shared<OrderTables>();
+  std::shared_ptr<ThreadPool> pool;
+  if (threads) {
+    pool = std::make_shared<ThreadPool>(threads);
+  }
+  auto schema = std::make_shared<Schema>();
+  for (size_t i = 0; i < tables->orders->schema().size(); ++i) {
+    ColumnSchema column = tables->orders->schema().column(i);
+    column.name = "orders." + column.name;
+    schema->add_column(column);
+  }
+  for (size_t i = 0; i < tables->customers->schema().size(); ++i) {
+    ColumnSchema column = tables->customers->schema().column(i);
+    column.name = "customers." + column.name;
+    schema->add_column(column);
+  }
+  return [=]() {
+    std::unique_ptr<Table> result =
+      join_tables(*schema, JoinKind::INNER, *tables->orders, tables->order_rows,
+		  *tables->customers, tables->customer_rows, {key}, nullptr, vector<Value>(),
+		  nullptr, pool.get());
+    do_not_optimize(result);
+    return ORDERS + CUSTOMERS;
+  };
+}
+
+const RegisterBenchmark int_serial("join/int_key/serial", "row", []() {
+    return join(JoinKey{0, 0}, 0);
+  });
+
+const RegisterBenchmark int_parallel("join/int_key/parallel", "row", []() {
+    return join(JoinKey{0, 0}, ThreadPool::default_threads());
+  });
+
+const RegisterBenchmark string_serial("join/string_key/serial", "row", []() {
+    return join(JoinKey{1, 1}, 0);
+  });
+
+}  // namespace
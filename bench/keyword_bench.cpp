@@ -0,0 +1,121 @@
+// SimpleSQL: keyword lookup micro-benchmark
+//
+// Compares the perfect hash keyword lookup against the previous
+// implementation, which lowercased a copy of every word with boost and
+// looked it up in a std::map. Two inputs are measured: a keyword-heavy one,
+// where every word is a keyword in random case, and an identifier-heavy one,
+// where every word is a plausible column or table name.
+
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../lexer/lexer_static_data.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const std::size_t NUM_WORDS = 1 << 16;
+const int ROUNDS = 50;
+
+// The previous lookup path
+const std::map<const string, const Tokens>& legacy_keywords() {
+  static std::map<const string, const Tokens> keywords;
+  if (keywords.empty()) {
+    for (std::size_t i = 0; i < NUM_KEYWORDS; ++i) {
+      keywords.insert(std::make_pair(string(kws[i].name), kws[i].token));
+    }
+  }
+  return keywords;
+}
+
+Tokens legacy_keyword_type(const string& word) {
+  string lowercase_word = boost::algorithm::to_lower_copy(word);
+  auto it = legacy_keywords().find(lowercase_word);
+  if (it == legacy_keywords().end()) {
+    return Tokens::IDENTIFIER;
+  }
+  return it->second;
+}
+
+// Returns NUM_WORDS keywords, each in a random mix of upper and lower case
+vector<string> keyword_heavy(std::mt19937& rng) {
+  vector<string> words;
+  for (std::size_t i = 0; i < NUM_WORDS; ++i) {
+    string word = kws[rng() % NUM_KEYWORDS].name;
+    for (auto it = word.begin(); it != word.end(); ++it) {
+      if (rng() & 1) {
+	*it = std::toupper(*it);
+      }
+    }
+    words.push_back(word);
+  }
+  return words;
+}
+
+// Returns NUM_WORDS identifiers built from common column name fragments
+vector<string> identifier_heavy(std::mt19937& rng) {
+  const char *fragments[] = {"user", "order", "id", "name", "created", "at",
+			     "price", "qty", "status", "customer", "ts", "c"};
+  const std::size_t num_fragments = sizeof(fragments) / sizeof(fragments[0]);
+  vector<string> words;
+  for (std::size_t i = 0; i < NUM_WORDS; ++i) {
+    string word = fragments[rng() % num_fragments];
+    if (rng() & 1) {
+      word += "_";
+      word += fragments[rng() % num_fragments];
+    }
+    if (rng() % 4 == 0) {
+      word += std::to_string(rng() % 100);
+    }
+    words.push_back(word);
+  }
+  return words;
+}
+
+// Runs lookup over every word ROUNDS times and returns ns per lookup
+template <typename Lookup>
+double time_lookups(const vector<string>& words, Lookup lookup) {
+  unsigned long long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < ROUNDS; ++round) {
+    for (auto it = words.cbegin(); it != words.cend(); ++it) {
+      checksum += lookup(*it);
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  // Keep the lookups from being optimized away
+  if (checksum == 0) {
+    std::cerr << "";
+  }
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  return ns / (words.size() * ROUNDS);
+}
+
+void report(const string& input, const vector<string>& words) {
+  double legacy = time_lookups(words, [](const string& w) {
+      return legacy_keyword_type(w);
+    });
+  double hashed = time_lookups(words, [](const string& w) {
+      return keyword_type(w.data(), w.size());
+    });
+  std::cout << "{\"benchmark\": \"keyword_lookup\", \"input\": \"" << input
+	    << "\", \"legacy_ns\": " << legacy
+	    << ", \"perfect_hash_ns\": " << hashed
+	    << ", \"speedup\": " << legacy / hashed << "}" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::mt19937 rng(42);
+  report("keyword_heavy", keyword_heavy(rng));
+  report("identifier_heavy", identifier_heavy(rng));
+  return 0;
+}
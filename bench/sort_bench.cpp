@@ -0,0 +1,128 @@
+// SimpleSQL: ORDER BY benchmarks
+//
+// Measures the rows per second of a table that ORDER BY ts DESC LIMIT 50
+// answers from: with a full sort of every row, with the bounded heap, and
+// by scanning an ordered index on ts backwards, which stops after 50 rows.
+// Also measures the rows per second a full sort by two keys sorts, with
+// the default memory limit and with one that spills about 40 runs.
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include "bench.h"
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include "../exec/sort.h"
+#include "../exec/where.h"
+#include "../storage/catalog.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t ROWS = 1 << 20;
+const size_t LIMIT = 50;
+const char *const QUERY = "SELECT id, ts FROM events ORDER BY ts DESC LIMIT 50";
+
+// A table of ROWS events with random timestamps, and the query run on it,
+// whose names refer to its text
+struct EventTable {
+  Catalog catalog;
+  string sql;
+  vector<FlatToken> tokes;
+  Arena arena;
+  const ASTNode *query;
+};
+
+// Runs the statements of sql against catalog
+void run(Catalog& catalog, const string& sql) {
+  vector<FlatToken> tokes;
+  tokenize_command(sql, tokes);
+  Arena arena;
+  vector<const ASTNode*> statements = parse(tokes, arena);
+  for (auto it = statements.begin(); it != statements.end(); ++it) {
+    (*it)->accept(catalog);
+  }
+}
+
+// Returns the table of events, with an ordered index on ts if indexed
+std::shared_ptr<EventTable> event_table(bool indexed) {
+  auto table = std::make_shared<EventTable>();
+  run(table->catalog, "CREATE TABLE events (id INT NOT NULL, ts INT NOT NULL)");
+  if (indexed) {
+    run(table->catalog, "CREATE INDEX by_ts ON events (ts) USING BTREE");
+  }
+  std::mt19937_64 random(42);
+  vector<vector<Value>> rows;
+  for (size_t i = 0; i < ROWS; ++i) {
+    rows.push_back({Value(static_cast<long long>(i)),
+	  Value(static_cast<long long>(random() % 1000000000))});
+  }
+  table->catalog.table("events")->append(rows);
+  table->sql = QUERY;
+  tokenize_command(table->sql, table->tokes);
+  table->query = parse(table->tokes, table->arena).front();
+  return table;
+}
+
+// Returns a benchmark of the query, answered with an index if indexed and
+// with the bounded heap otherwise
+BenchmarkBody order_limit(bool indexed) {
+  auto table = event_table(indexed);
+  return [=]() {
+    table->query->accept(table->catalog);
+    std::unique_ptr<QueryResult> result = table->catalog.take_result();
+    do_not_optimize(result);
+    return ROWS;
+  };
+}
+
+const RegisterBenchmark full_sort("order_limit/full_sort", "row", []() {
+    auto table = event_table(false);
+    return [=]() {
+      const Table& events = *table->catalog.table("events");
+      vector<size_t> rows;
+      select_rows(events, nullptr, vector<Value>(), rows);
+      sort_rows(events, rows, {SortKey{1, true}}, SIZE_MAX, nullptr);
+      rows.resize(LIMIT);
+      do_not_optimize(rows);
+      return ROWS;
+    };
+  });
+
+const RegisterBenchmark heap("order_limit/heap", "row", []() {
+    return order_limit(false);
+  });
+
+const RegisterBenchmark index("order_limit/index", "row", []() {
+    return order_limit(true);
+  });
+
+// Returns a benchmark of sorting every event by ts, then id descending,
+// holding keys in memory bytes at most
+BenchmarkBody sort_all(size_t memory) {
+  auto table = event_table(false);
+  return [=]() {
+    const Table& events = *table->catalog.table("events");
+    vector<size_t> rows;
+    select_rows(events, nullptr, vector<Value>(), rows);
+    size_t previous = sort_memory_limit();
+    set_sort_memory_limit(memory);
+    sort_rows(events, rows, {SortKey{1, false}, SortKey{0, true}}, SIZE_MAX, nullptr);
+    set_sort_memory_limit(previous);
+    do_not_optimize(rows);
+    return ROWS;
+  };
+}
+
+const RegisterBenchmark in_memory("sort/all/in_memory", "row", []() {
+    return sort_all(sort_memory_limit());
+  });
+
+const RegisterBenchmark spilled("sort/all/spilled", "row", []() {
+    return sort_all(size_t(1) << 20);
+  });
+
+}  // namespace
@@ -0,0 +1,324 @@
+// SimpleSQL: Storage benchmarks
+//
+// Measures appending rows to in-memory tables, loading them through
+// INSERT statements, primary key lookups, and the hit ratio of the buffer
+// pool's eviction policies. Rows are generated during setup, as values or
+// as SQL, so only the engine is timed.
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <sstream>
+#include "bench.h"
+#include "workload.h"
+#include "../lexer/lexer.h"
+#include "../lexer/statement_reader.h"
+#include "../parser/parser.h"
+#include "../storage/buffer_pool.h"
+#include "../storage/catalog.h"
+#include "../storage/index_key.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t ROWS = 100000;
+const size_t COLUMNS = 16;
+
+// The columns of the table the INSERT benchmarks load, and the rows of
+// each multi-row INSERT
+const size_t INSERT_COLUMNS = 4;
+const size_t BULK_ROWS = 1000;
+
+// The buffer pool workload: a file of FILE_PAGES pages cached in
+// POOL_PAGES frames. Most fetches go to a small hot set, and the rest
+// scan the whole file, as an index lookup mixed with a table scan would.
+const size_t PAGE_SIZE = 4096;
+const size_t FILE_PAGES = 8192;
+const size_t POOL_PAGES = 512;
+const size_t HOT_PAGES = 384;
+const size_t HOT_FETCHES = 4;
+const size_t FETCHES = 100000;
+
+// Lookups made by each key lookup benchmark
+const size_t LOOKUPS = 1000;
+
+// Rows of values, along with the strings their string values point into
+struct Rows {
+  vector<string> strings;
+  vector<vector<Value>> values;
+};
+
+// Returns ROWS rows of values for the given table
+std::shared_ptr<const Rows> make_rows(Workload& workload, const WorkloadTable& table) {
+  auto made = std::make_shared<Rows>();
+  vector<string>& strings = made->strings;
+  vector<vector<Value>>& rows = made->values;
+  // Values point into the strings, so they must never move
+  strings.reserve(ROWS * table.columns.size());
+  for (size_t i = 0; i < ROWS; ++i) {
+    vector<Value> row;
+    row.push_back(Value(static_cast<long long>(i)));
+    for (auto it = table.columns.begin() + 1; it != table.columns.end(); ++it) {
+      string literal = workload.value(*it);
+      if (literal == "NULL") {
+	row.push_back(Value());
+      } else if (literal[0] == '\'') {
+	string unquoted;
+	for (size_t i = 1; i + 1 < literal.size(); ++i) {
+	  unquoted += literal[i];
+	  i += literal[i] == '\'';
+	}
+	strings.push_back(unquoted);
+	row.push_back(Value(strings.back().data(), strings.back().size()));
+      } else if (it->type == Datatype::DOUBLE_T) {
+	row.push_back(Value(std::stod(literal)));
+      } else if (it->type == Datatype::UINT_T) {
+	row.push_back(Value(std::stoull(literal)));
+      } else {
+	row.push_back(Value(std::stoll(literal)));
+      }
+    }
+    rows.push_back(row);
+  }
+  return made;
+}
+
+// Returns the table of the workload's CREATE TABLE statement
+std::unique_ptr<Table> make_table(Workload& workload, const WorkloadTable& table) {
+  string sql = workload.create_table(table);
+  vector<FlatToken> tokes;
+  tokenize_command(sql, tokes);
+  Arena arena;
+  TableBuilder builder;
+  return builder.build(static_cast<const CreateTable&>(*parse(tokes, arena).front()));
+}
+
+// Appends every row in one call, filling chunks a column at a time
+const RegisterBenchmark append_batch("table/append_batch", "row", []() -> BenchmarkBody {
+    auto workload = std::make_shared<Workload>();
+    auto table = std::make_shared<WorkloadTable>(workload->table("bench", COLUMNS));
+    auto rows = make_rows(*workload, *table);
+    return [=]() {
+      std::unique_ptr<Table> physical = make_table(*workload, *table);
+      physical->append(rows->values);
+      return physical->rows();
+    };
+  });
+
+// Appends rows one at a time
+const RegisterBenchmark append_row("table/append_row", "row", []() -> BenchmarkBody {
+    auto workload = std::make_shared<Workload>();
+    auto table = std::make_shared<WorkloadTable>(workload->table("bench", COLUMNS));
+    auto rows = make_rows(*workload, *table);
+    return [=]() {
+      std::unique_ptr<Table> physical = make_table(*workload, *table);
+      for (auto it = rows->values.begin(); it != rows->values.end(); ++it) {
+	physical->append(*it);
+      }
+      return physical->rows();
+    };
+  });
+
+// Returns a benchmark of loading ROWS rows of the workload into a table
+// of the given number of columns through INSERT statements of
+// rows_per_statement rows each, timing lexing, parsing and appending. The
+// statements are read and loaded as the shell loads them.
+BenchmarkBody insert_rows(size_t columns, size_t rows_per_statement) {
+  Workload workload;
+  WorkloadTable table = workload.table("bench", columns);
+  auto create = std::make_shared<const string>(workload.create_table(table));
+  auto script = std::make_shared<const string>(Workload::script(ROWS / rows_per_statement, [&]() {
+	return workload.insert(table, rows_per_statement);
+      }));
+  // Kept between runs, as the shell reuses them between statements
+  auto tokes = std::make_shared<vector<FlatToken>>();
+  auto arena = std::make_shared<Arena>();
+  return [=]() {
+    Catalog catalog;
+    tokes->clear();
+    tokenize_command(*create, *tokes);
+    catalog.create_table(static_cast<const CreateTable&>(*parse(*tokes, *arena).front()));
+    arena->reset();
+    std::istringstream input(*script);
+    StatementReader reader(input);
+    ValuesLoader loader(catalog);
+    while (reader.next(*tokes)) {
+      loader.start(tokes->data(), tokes->data() + tokes->size());
+      while (true) {
+	const FlatToken *end = tokes->data() + tokes->size();
+	const FlatToken *rest = loader.load(tokes->data(), end, !reader.partial());
+	if (!reader.partial()) {
+	  break;
+	}
+	if (rest != end) {
+	  reader.resume_at(*rest);
+	}
+	reader.next(*tokes);
+      }
+    }
+    return catalog.table("bench")->rows();
+  };
+}
+
+// Loads rows one INSERT at a time
+const RegisterBenchmark insert_row("insert/row_per_statement", "row", []() {
+    return insert_rows(INSERT_COLUMNS, 1);
+  });
+
+// Loads rows through multi-row INSERTs, as a dump would
+const RegisterBenchmark insert_bulk("insert/bulk_values", "row", []() {
+    return insert_rows(INSERT_COLUMNS, BULK_ROWS);
+  });
+
+const RegisterBenchmark insert_bulk_wide("insert/bulk_values/wide", "row", []() {
+    return insert_rows(COLUMNS, BULK_ROWS);
+  });
+
+// Copies the ROWS rows of a table of the workload into a new table
+// through INSERT ... SELECT, which appends them as the scan finds them
+const RegisterBenchmark insert_select("insert/select", "row", []() -> BenchmarkBody {
+    Workload workload;
+    WorkloadTable table = workload.table("bench", INSERT_COLUMNS);
+    string setup = workload.create_table(table) + workload.insert(table, ROWS);
+    table.name = "copy";
+    const string create_copy = workload.create_table(table);
+    setup += create_copy;
+    auto catalog = std::make_shared<Catalog>();
+    vector<FlatToken> tokes;
+    tokenize_command(setup, tokes);
+    Arena arena;
+    vector<const ASTNode*> statements = parse(tokes, arena);
+    for (auto it = statements.begin(); it != statements.end(); ++it) {
+      (*it)->accept(*catalog);
+    }
+    auto copy = std::make_shared<const string>("DROP TABLE copy; " + create_copy +
+					       "INSERT INTO copy SELECT * FROM bench;");
+    auto copy_tokes = std::make_shared<vector<FlatToken>>();
+    tokenize_command(*copy, *copy_tokes);
+    auto copy_arena = std::make_shared<Arena>();
+    return [=]() {
+      // The tokens point into the statements, so they must outlive the body
+      do_not_optimize(copy);
+      vector<const ASTNode*> statements = parse(*copy_tokes, *copy_arena);
+      for (auto it = statements.begin(); it != statements.end(); ++it) {
+	(*it)->accept(*catalog);
+      }
+      copy_arena->reset();
+      return catalog->table("copy")->rows();
+    };
+  });
+
+// Inserts ROWS random integer keys into a B+-tree
+const RegisterBenchmark btree_insert("btree/insert", "key", []() -> BenchmarkBody {
+    auto keys = std::make_shared<vector<string>>();
+    std::mt19937 random(42);
+    for (size_t i = 0; i < ROWS; ++i) {
+      keys->push_back(encode_key({Value(static_cast<long long>(random()))}));
+    }
+    return [=]() {
+      BTree tree;
+      for (size_t i = 0; i < keys->size(); ++i) {
+	tree.insert((*keys)[i], i);
+      }
+      return tree.size();
+    };
+  });
+
+// Returns a benchmark looking up LOOKUPS random ids in a table of ROWS
+// rows, either through its primary key or by scanning its id column
+BenchmarkBody lookup_ids(bool use_index) {
+  auto workload = std::make_shared<Workload>();
+  auto table = std::make_shared<WorkloadTable>(workload->table("bench", COLUMNS));
+  auto rows = make_rows(*workload, *table);
+  std::shared_ptr<Table> physical(make_table(*workload, *table));
+  physical->append(rows->values);
+  auto ids = std::make_shared<vector<long long>>();
+  std::mt19937 random(42);
+  for (size_t i = 0; i < LOOKUPS; ++i) {
+    ids->push_back(random() % ROWS);
+  }
+  return [=]() {
+    size_t found = 0;
+    for (auto it = ids->begin(); it != ids->end(); ++it) {
+      size_t row;
+      if (use_index) {
+	found += physical->find({Value(*it)}, row);
+	continue;
+      }
+      size_t base = 0;
+      for (size_t c = 0; c < physical->chunk_count(); ++c) {
+	const Chunk& chunk = physical->chunk(c);
+	const ColumnChunk& id = chunk.column(0);
+	for (size_t i = 0; i < chunk.size(); ++i) {
+	  if (id.at<std::int64_t>(i) == *it) {
+	    row = base + i;
+	    ++found;
+	  }
+	}
+	base += chunk.size();
+      }
+      do_not_optimize(row);
+    }
+    do_not_optimize(found);
+    return LOOKUPS;
+  };
+}
+
+const RegisterBenchmark lookup_index("table/lookup_index", "lookup", []() -> BenchmarkBody {
+    return lookup_ids(true);
+  });
+
+const RegisterBenchmark lookup_scan("table/lookup_scan", "lookup", []() -> BenchmarkBody {
+    return lookup_ids(false);
+  });
+
+// A buffer pool over a scratch page file, which is removed afterwards
+struct ScratchPool {
+  ScratchPool(EvictionPolicy policy) : path(scratch_file()), file(path, PAGE_SIZE),
+				       pool(file, POOL_PAGES * PAGE_SIZE, policy) {
+    file.allocate(FILE_PAGES);
+  }
+  ~ScratchPool() {
+    std::remove(path.c_str());
+  }
+
+  string path;
+  PageFile file;
+  BufferPool pool;
+};
+
+// Returns a benchmark fetching pages of the workload under policy, and
+// reporting the pool's hit ratio
+BenchmarkBody fetch_pages(EvictionPolicy policy) {
+  auto scratch = std::make_shared<ScratchPool>(policy);
+  auto random = std::make_shared<std::mt19937>(42);
+  auto scan = std::make_shared<PageId>(0);
+  return [=]() {
+    BufferPool& pool = scratch->pool;
+    for (size_t i = 0; i < FETCHES; ++i) {
+      PageId id;
+      if (i % (HOT_FETCHES + 1) < HOT_FETCHES) {
+	id = 1 + (*random)() % HOT_PAGES;
+      } else {
+	id = 1 + HOT_PAGES + *scan;
+	*scan = (*scan + 1) % (FILE_PAGES - HOT_PAGES);
+      }
+      do_not_optimize(pool.fetch(id).data());
+    }
+    report_metric("hit_ratio", pool.hit_ratio());
+    return FETCHES;
+  };
+}
+
+const RegisterBenchmark fetch_clock("buffer_pool/fetch_clock", "fetch", []() -> BenchmarkBody {
+    return fetch_pages(EvictionPolicy::CLOCK);
+  });
+
+const RegisterBenchmark fetch_lru_k("buffer_pool/fetch_lru_k", "fetch", []() -> BenchmarkBody {
+    return fetch_pages(EvictionPolicy::LRU_K);
+  });
+
+}  // namespace
@@ -0,0 +1,82 @@
+// SimpleSQL: Write-ahead log benchmarks
+//
+// Measures committing INSERT statements to a write-ahead log from one or
+// many threads, and reports the commit latency percentiles and the rate
+// of syncs, which show how well group commit batches concurrent commits.
+
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include "bench.h"
+#include "../storage/wal.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t COMMITS = 2000;
+
+// A write-ahead log in a scratch file, which is removed afterwards
+struct ScratchLog {
+  ScratchLog(std::chrono::microseconds commit_delay, size_t batch_size)
+    : path(scratch_file()), log(path, commit_delay, batch_size) {}
+  ~ScratchLog() {
+    std::remove(path.c_str());
+  }
+
+  string path;
+  WriteAheadLog log;
+};
+
+// Returns a benchmark committing COMMITS parameterized INSERTs from the
+// given number of threads
+BenchmarkBody commit(size_t threads, std::chrono::microseconds commit_delay,
+		     size_t batch_size = WriteAheadLog::DEFAULT_BATCH_SIZE) {
+  auto scratch = std::make_shared<ScratchLog>(commit_delay, batch_size);
+  auto sql = std::make_shared<const string>("INSERT INTO bench VALUES (?, ?, ?);");
+  auto tokes = std::make_shared<vector<FlatToken>>();
+  tokenize_command(*sql, *tokes);
+  return [=]() {
+    do_not_optimize(sql);
+    vector<std::thread> committers;
+    for (size_t t = 0; t < threads; ++t) {
+      committers.push_back(std::thread([=]() {
+	    string name = "name";
+	    for (size_t i = t; i < COMMITS; i += threads) {
+	      vector<Value> parameters{Value(static_cast<long long>(i)),
+				       Value(name.data(), name.size()), Value(i * 0.5)};
+	      scratch->log.commit(LogRecord(tokes->data(), tokes->data() + tokes->size(),
+					    parameters));
+	    }
+	  }));
+    }
+    for (auto it = committers.begin(); it != committers.end(); ++it) {
+      it->join();
+    }
+    WriteAheadLog& log = scratch->log;
+    report_metric("p50_commit_us", log.commit_latency(50));
+    report_metric("p99_commit_us", log.commit_latency(99));
+    report_metric("p999_commit_us", log.commit_latency(99.9));
+    report_metric("fsyncs_per_sec", log.fsyncs_per_second());
+    report_metric("commits_per_fsync", static_cast<double>(log.commits()) / log.fsyncs());
+    return COMMITS;
+  };
+}
+
+const RegisterBenchmark commit_1_thread("wal/commit_1_thread", "commit", []() -> BenchmarkBody {
+    return commit(1, WriteAheadLog::DEFAULT_COMMIT_DELAY);
+  });
+
+const RegisterBenchmark commit_16_threads("wal/commit_16_threads", "commit", []() -> BenchmarkBody {
+    return commit(16, WriteAheadLog::DEFAULT_COMMIT_DELAY);
+  });
+
+// No commit delay: a batch is whatever arrived while the last was synced
+const RegisterBenchmark commit_16_threads_no_delay("wal/commit_16_threads_no_delay", "commit",
+						   []() -> BenchmarkBody {
+    return commit(16, std::chrono::microseconds(0));
+  });
+
+}  // namespace
@@ -0,0 +1,263 @@
+// SimpleSQL: WHERE benchmarks
+//
+// Measures selecting the rows of a table that meet a condition on a column
+// that is not the primary key, through a hash index, through an ordered
+// index, and by scanning the table, and scanning the table with a
+// condition that no index helps, on the calling thread alone and in
+// morsels on a pool of the default number of threads. Also compares
+// scanning a status column declared as a string with scanning it declared
+// as an ENUM, and scanning a time series whose columns are encoded with
+// scanning it plain. Conditions on the recent times of the series, or on
+// a window of them, read only the zones those times are in.
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include "bench.h"
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include "../exec/where.h"
+#include "../storage/catalog.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t ROWS = 100000;
+// Every value of the indexed column is shared by ROWS / GROUPS rows
+const size_t GROUPS = 1000;
+const size_t LOOKUPS = 200;
+
+// A table of ROWS rows and a statement whose condition compares its
+// indexed column with a parameter
+struct IndexedTable {
+  Catalog catalog;
+  Arena arena;
+  const Expression *condition;
+};
+
+// Runs the statements of sql against catalog
+void run(Catalog& catalog, const string& sql) {
+  vector<FlatToken> tokes;
+  tokenize_command(sql, tokes);
+  Arena arena;
+  vector<const ASTNode*> statements = parse(tokes, arena);
+  for (auto it = statements.begin(); it != statements.end(); ++it) {
+    (*it)->accept(catalog);
+  }
+}
+
+// Returns a benchmark selecting the rows with LOOKUPS random values of the
+// grouping column, indexed by the given CREATE INDEX statement unless it
+// is empty
+BenchmarkBody select_groups(const string& create_index) {
+  auto indexed = std::make_shared<IndexedTable>();
+  run(indexed->catalog, "CREATE TABLE t (id INT, grp INT, name VARCHAR(16), PRIMARY KEY (id))");
+  Table& table = *indexed->catalog.table("t");
+  vector<vector<Value>> rows;
+  for (size_t i = 0; i < ROWS; ++i) {
+    rows.push_back({Value(static_cast<long long>(i)), Value(static_cast<long long>(i % GROUPS)),
+	  Value("row", 3)});
+  }
+  table.append(rows);
+  if (!create_index.empty()) {
+    run(indexed->catalog, create_index);
+  }
+  vector<FlatToken> tokes;
+  tokenize_command("DELETE FROM t WHERE grp = ?", tokes);
+  const Delete *statement = static_cast<const Delete*>(parse(tokes, indexed->arena).front());
+  indexed->condition = statement->exp();
+
+  auto groups = std::make_shared<vector<vector<Value>>>();
+  std::mt19937 random(42);
+  for (size_t i = 0; i < LOOKUPS; ++i) {
+    groups->push_back({Value(static_cast<long long>(random() % GROUPS))});
+  }
+  return [=]() {
+    const Table& table = *indexed->catalog.table("t");
+    vector<size_t> selected;
+    size_t found = 0;
+    for (auto it = groups->begin(); it != groups->end(); ++it) {
+      select_rows(table, indexed->condition, *it, selected);
+      found += selected.size();
+    }
+    do_not_optimize(found);
+    return LOOKUPS;
+  };
+}
+
+const RegisterBenchmark equal_hash("where/equal_hash_index", "lookup", []() -> BenchmarkBody {
+    return select_groups("CREATE INDEX t_grp ON t (grp) USING HASH");
+  });
+
+const RegisterBenchmark equal_ordered("where/equal_ordered_index", "lookup", []() -> BenchmarkBody {
+    return select_groups("CREATE INDEX t_grp ON t (grp)");
+  });
+
+const RegisterBenchmark equal_scan("where/equal_scan", "lookup", []() -> BenchmarkBody {
+    return select_groups("");
+  });
+
+// Returns a benchmark of scanning the table with a condition of ranges and
+// lists, so every row goes through the filters, on the threads of a pool
+// of threads, or the calling thread if threads is 0
+BenchmarkBody range_scan(size_t threads) {
+  auto indexed = std::make_shared<IndexedTable>();
+  std::shared_ptr<ThreadPool> pool;
+  if (threads) {
+    pool = std::make_shared<ThreadPool>(threads);
+  }
+  run(indexed->catalog, "CREATE TABLE t (id INT, grp INT, name VARCHAR(16), PRIMARY KEY (id))");
+  Table& table = *indexed->catalog.table("t");
+  vector<vector<Value>> rows;
+  for (size_t i = 0; i < ROWS; ++i) {
+    rows.push_back({Value(static_cast<long long>(i)), Value(static_cast<long long>(i % GROUPS)),
+	  Value("row", 3)});
+  }
+  table.append(rows);
+  vector<FlatToken> tokes;
+  tokenize_command("DELETE FROM t WHERE grp BETWEEN 100 AND 199 OR grp IN (5, 7, 900)", tokes);
+  const Delete *statement = static_cast<const Delete*>(parse(tokes, indexed->arena).front());
+  indexed->condition = statement->exp();
+  return [=]() {
+    vector<size_t> selected;
+    select_rows(*indexed->catalog.table("t"), indexed->condition, vector<Value>(), selected,
+		nullptr, pool.get());
+    do_not_optimize(selected.size());
+    return ROWS;
+  };
+}
+
+const RegisterBenchmark range_serial("where/range_scan", "row", []() {
+    return range_scan(0);
+  });
+
+const RegisterBenchmark range_parallel("where/range_scan/parallel", "row", []() {
+    return range_scan(ThreadPool::default_threads());
+  });
+
+// The statuses of the rows of the status benchmarks, in turn
+const char *const STATUSES[] = {"new", "open", "held", "closed", "void"};
+
+// Returns a benchmark of scanning a table whose status column has the
+// given type with a condition on it
+BenchmarkBody status_scan(const string& type, const string& condition) {
+  auto indexed = std::make_shared<IndexedTable>();
+  run(indexed->catalog, "CREATE TABLE t (id INT, status " + type + " NOT NULL, PRIMARY KEY (id))");
+  Table& table = *indexed->catalog.table("t");
+  vector<vector<Value>> rows;
+  for (size_t i = 0; i < ROWS; ++i) {
+    const char *status = STATUSES[i % 5];
+    rows.push_back({Value(static_cast<long long>(i)), Value(status, std::strlen(status))});
+  }
+  table.append(rows);
+  vector<FlatToken> tokes;
+  tokenize_command("DELETE FROM t WHERE " + condition, tokes);
+  const Delete *statement = static_cast<const Delete*>(parse(tokes, indexed->arena).front());
+  indexed->condition = statement->exp();
+  return [=]() {
+    vector<size_t> selected;
+    select_rows(*indexed->catalog.table("t"), indexed->condition, vector<Value>(), selected);
+    do_not_optimize(selected.size());
+    return ROWS;
+  };
+}
+
+const char *const STATUS_ENUM = "ENUM('new', 'open', 'held', 'closed', 'void')";
+
+const RegisterBenchmark status_equal_string("where/status_equal/string", "row", []() {
+    return status_scan("VARCHAR(8)", "status = 'open'");
+  });
+
+const RegisterBenchmark status_equal_enum("where/status_equal/enum", "row", []() {
+    return status_scan(STATUS_ENUM, "status = 'open'");
+  });
+
+const RegisterBenchmark status_in_string("where/status_in/string", "row", []() {
+    return status_scan("VARCHAR(8)", "status IN ('new', 'held', 'void')");
+  });
+
+const RegisterBenchmark status_in_enum("where/status_in/enum", "row", []() {
+    return status_scan(STATUS_ENUM, "status IN ('new', 'held', 'void')");
+  });
+
+// The rows of the time series, a whole number of chunks
+const size_t SERIES_ROWS = 4 * Table::DEFAULT_CHUNK_ROWS;
+
+// A time series and a statement whose condition is on its columns
+struct SeriesTable {
+  std::unique_ptr<Table> table;
+  Arena arena;
+  const Expression *condition;
+};
+
+// Returns a benchmark of scanning a time series of readings, with times
+// that only increase and few sensors, with a condition on it. With
+// encoded, its chunks are all full and so encoded; without, it is a single
+// chunk that never fills, and stays plain.
+BenchmarkBody series_scan(bool encoded, const string& condition) {
+  auto series = std::make_shared<SeriesTable>();
+  Catalog catalog;
+  run(catalog, "CREATE TABLE series (ts INT, sensor INT, reading DOUBLE)");
+  series->table.reset(new Table("series", catalog.table("series")->schema(),
+				encoded ? Table::DEFAULT_CHUNK_ROWS : SERIES_ROWS + 1));
+  vector<vector<Value>> rows;
+  for (size_t i = 0; i < SERIES_ROWS; ++i) {
+    rows.push_back({Value(static_cast<long long>(1600000000 + i * 5)),
+	  Value(static_cast<long long>(i % 16)), Value(static_cast<double>(i % 200) / 4)});
+  }
+  series->table->append(rows);
+  vector<FlatToken> tokes;
+  tokenize_command("DELETE FROM series WHERE " + condition, tokes);
+  const Delete *statement = static_cast<const Delete*>(parse(tokes, series->arena).front());
+  series->condition = statement->exp();
+  return [=]() {
+    vector<size_t> selected;
+    select_rows(*series->table, series->condition, vector<Value>(), selected);
+    do_not_optimize(selected.size());
+    return SERIES_ROWS;
+  };
+}
+
+// The last 2% of the time series
+const string RECENT = "ts >= " + std::to_string(1600000000 + SERIES_ROWS * 5 / 50 * 49);
+
+// 1% of the time series, from its middle
+const string WINDOW = "ts BETWEEN " + std::to_string(1600000000 + SERIES_ROWS * 5 / 2) + " AND "
+  + std::to_string(1600000000 + SERIES_ROWS * 5 / 2 + SERIES_ROWS * 5 / 100);
+
+const RegisterBenchmark series_sensor_plain("where/series/sensor/plain", "row", []() {
+    return series_scan(false, "sensor = 3");
+  });
+
+const RegisterBenchmark series_sensor_encoded("where/series/sensor/encoded", "row", []() {
+    return series_scan(true, "sensor = 3");
+  });
+
+const RegisterBenchmark series_recent_plain("where/series/recent/plain", "row", []() {
+    return series_scan(false, RECENT);
+  });
+
+const RegisterBenchmark series_recent_encoded("where/series/recent/encoded", "row", []() {
+    return series_scan(true, RECENT);
+  });
+
+const RegisterBenchmark series_window_plain("where/series/window/plain", "row", []() {
+    return series_scan(false, WINDOW);
+  });
+
+const RegisterBenchmark series_window_encoded("where/series/window/encoded", "row", []() {
+    return series_scan(true, WINDOW);
+  });
+
+const RegisterBenchmark series_reading_plain("where/series/reading/plain", "row", []() {
+    return series_scan(false, "reading > 40");
+  });
+
+const RegisterBenchmark series_reading_encoded("where/series/reading/encoded", "row", []() {
+    return series_scan(true, "reading > 40");
+  });
+
+}  // namespace
@@ -0,0 +1,166 @@
+// SimpleSQL: Synthetic workload generator
+
+#include "workload.h"
+#include <cstdio>
+
+using std::size_t;
+using std::string;
+
+Workload::Workload(unsigned seed) : _rng(seed), _next_id(1) {}
+
+// Returns a table with the given number of columns, at least one, of
+// randomly chosen types
+WorkloadTable Workload::table(const string& name, size_t columns) {
+  WorkloadTable table{name, {}};
+  table.columns.push_back(WorkloadColumn{"id", Datatype::INT_T, 0, false});
+  for (size_t i = 1; i < columns; ++i) {
+    WorkloadColumn column{"c" + std::to_string(i), Datatype::INT_T, 0, uniform(4) != 0};
+    switch (uniform(5)) {
+    case 0:
+      break;
+    case 1:
+      column.type = Datatype::UINT_T;
+      break;
+    case 2:
+      column.type = Datatype::DOUBLE_T;
+      break;
+    case 3:
+      column.type = Datatype::CHAR_T;
+      column.length = 1;
+      break;
+    default:
+      column.type = Datatype::VARCHAR_T;
+      column.length = 8 + uniform(57);
+    }
+    table.columns.push_back(column);
+  }
+  return table;
+}
+
+// Returns the CREATE TABLE statement for table
+const string Workload::create_table(const WorkloadTable& table) {
+  string sql = "CREATE TABLE " + table.name + " (";
+  for (auto it = table.columns.begin(); it != table.columns.end(); ++it) {
+    sql += it->name;
+    switch (it->type) {
+    case Datatype::UINT_T:
+      sql += " UNSIGNED INT";
+      break;
+    case Datatype::DOUBLE_T:
+      sql += " DOUBLE";
+      break;
+    case Datatype::CHAR_T:
+      sql += " CHAR";
+      break;
+    case Datatype::VARCHAR_T:
+      sql += " VARCHAR(" + std::to_string(it->length) + ")";
+      break;
+    default:
+      sql += " INT";
+    }
+    sql += it->nullable ? ", " : " NOT NULL, ";
+  }
+  sql += "PRIMARY KEY (" + table.columns.front().name + "));";
+  return sql;
+}
+
+// Returns an INSERT of the given number of rows into table. Primary keys
+// are consecutive.
+const string Workload::insert(const WorkloadTable& table, size_t rows) {
+  string columns;
+  for (auto it = table.columns.begin() + 1; it != table.columns.end(); ++it) {
+    columns += ", " + it->name;
+  }
+  string sql = "INSERT INTO " + table.name + " (" + table.columns.front().name + columns +
+    ") VALUES ";
+  for (size_t i = 0; i < rows; ++i) {
+    sql += (i ? ", (" : "(") + std::to_string(_next_id++);
+    for (auto it = table.columns.begin() + 1; it != table.columns.end(); ++it) {
+      sql += ", " + value(*it);
+    }
+    sql += ")";
+  }
+  return sql + ";";
+}
+
+// Returns a SELECT of a few columns of table, filtered on one or two
+// comparisons and sometimes limited
+const string Workload::select(const WorkloadTable& table) {
+  static const char *comparisons[] = {"=", "<>", "<", ">", "<=", ">="};
+  string sql = "SELECT " + table.columns.front().name;
+  size_t projected = 1 + uniform(4);
+  for (size_t i = 0; i < projected; ++i) {
+    sql += ", " + table.columns[uniform(table.columns.size())].name;
+  }
+  sql += " FROM " + table.name + " WHERE ";
+  size_t conditions = 1 + uniform(2);
+  for (size_t i = 0; i < conditions; ++i) {
+    if (i > 0) {
+      sql += uniform(3) ? " AND " : " OR ";
+    }
+    const WorkloadColumn& column = table.columns[uniform(table.columns.size())];
+    sql += column.name + " " + comparisons[uniform(6)] + " ";
+    string v = value(column);
+    sql += v == "NULL" ? "0" : v;
+  }
+  if (uniform(2)) {
+    sql += " LIMIT " + std::to_string(1 + uniform(1000));
+  }
+  return sql + ";";
+}
+
+// Returns a random literal for column. Nullable columns are sometimes
+// NULL, and strings sometimes contain an escaped quote.
+const string Workload::value(const WorkloadColumn& column) {
+  if (column.nullable && uniform(10) == 0) {
+    return "NULL";
+  }
+  switch (column.type) {
+  case Datatype::UINT_T:
+    return std::to_string(uniform(4000000000u));
+  case Datatype::DOUBLE_T: {
+    // Drawn one at a time, since argument evaluation order is unspecified
+    size_t whole = uniform(100000);
+    size_t fraction = uniform(100);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%zu.%02zu", whole, fraction);
+    return buffer;
+  }
+  case Datatype::CHAR_T:
+    return "'" + word(1) + "'";
+  case Datatype::VARCHAR_T: {
+    string s = word(1 + uniform(column.length - 1));
+    if (uniform(16) == 0) {
+      s.insert(uniform(s.size()), "''");
+    }
+    return "'" + s + "'";
+  }
+  default:
+    return std::to_string(uniform(1000000));
+  }
+}
+
+// Returns a script of the given number of statements, each made by
+// calling statement
+const string Workload::script(size_t statements, const std::function<const string()>& statement) {
+  string sql;
+  for (size_t i = 0; i < statements; ++i) {
+    sql += statement();
+    sql += '\n';
+  }
+  return sql;
+}
+
+// Returns a number in [0, n)
+size_t Workload::uniform(size_t n) {
+  return _rng() % n;
+}
+
+// Returns a random lowercase word of the given length
+const string Workload::word(size_t length) {
+  string s(length, 'a');
+  for (auto it = s.begin(); it != s.end(); ++it) {
+    *it = 'a' + uniform(26);
+  }
+  return s;
+}
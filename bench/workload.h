@@ -0,0 +1,53 @@
+// SimpleSQL: Synthetic workload generator
+//
+// Generates SQL for the benchmarks: wide CREATE TABLEs, INSERTs of rows
+// matching them, and SELECTs filtered on their columns. The output depends
+// only on the seed, so every run of a benchmark sees the same statements.
+
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "../AST/create.h"
+
+// A column of a generated table
+struct WorkloadColumn {
+  std::string name;
+  Datatype type;
+  int length;
+  bool nullable;
+};
+
+// A generated table. Its first column is a non-null INT primary key.
+struct WorkloadTable {
+  std::string name;
+  std::vector<WorkloadColumn> columns;
+};
+
+class Workload {
+ public:
+  explicit Workload(unsigned seed = DEFAULT_SEED);
+  WorkloadTable table(const std::string& name, std::size_t columns);
+  const std::string create_table(const WorkloadTable& table);
+  const std::string insert(const WorkloadTable& table, std::size_t rows = 1);
+  const std::string select(const WorkloadTable& table);
+  const std::string value(const WorkloadColumn& column);
+  static const std::string script(std::size_t statements,
+				  const std::function<const std::string()>& statement);
+
+  static const unsigned DEFAULT_SEED = 42;
+ private:
+  std::size_t uniform(std::size_t n);
+  const std::string word(std::size_t length);
+
+  // The generator's output is fixed by the standard, unlike that of the
+  // standard distributions, so only it is used
+  std::mt19937 _rng;
+  long long _next_id;
+};
+
+#endif  // __WORKLOAD_H__
@@ -0,0 +1,565 @@
+// SimpleSQL: Hash aggregation
+
+#include "aggregate.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "../storage/index_key.h"
+#include "morsel.h"
+
+using std::int64_t;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const size_t MIN_SLOTS = 64;
+// Slots hold 16 bits of the group's hash above the group's position plus
+// one, so that empty slots are 0
+const int TAG_SHIFT = 48;
+const uint64_t POSITION_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+// Groups are appended to the result this many at a time
+const size_t OUTPUT_ROWS = 4096;
+
+// The running state of one aggregate of one group
+struct State {
+  // The number of values aggregated
+  uint64_t count;
+  union {
+    // The sum, or the least or greatest value, of a numeric column
+    int64_t int_value;
+    uint64_t uint_value;
+    double double_value;
+    // The sum of the values of AVG
+    long double total;
+    // The row holding the least or greatest string
+    size_t row;
+    // The position of the set of values of a DISTINCT aggregate
+    size_t set;
+  };
+  State() : count(0), total(0) {}
+};
+
+// The groups found in some rows, with the states of their aggregates
+class GroupTable {
+ public:
+  explicit GroupTable(size_t aggregates);
+  size_t size() const;
+  size_t find_or_add(const char *key, size_t length, uint64_t hash, size_t row, bool& added);
+  uint64_t hash(size_t group) const;
+  const char *key(size_t group) const;
+  size_t key_length(size_t group) const;
+  size_t row(size_t group) const;
+  State *states(size_t group);
+  size_t add_set();
+  std::unordered_map<string, size_t>& set(size_t index);
+ private:
+  GroupTable(const GroupTable&) = delete;
+  GroupTable& operator=(const GroupTable&) = delete;
+  void grow();
+
+  struct Group {
+    uint64_t hash;
+    // The position of the key in _keys, and its length
+    size_t key;
+    size_t length;
+    // A row of the group
+    size_t row;
+  };
+  const size_t _aggregates;
+  vector<uint64_t> _slots;
+  vector<Group> _groups;
+  string _keys;
+  // The states of every group's aggregates, one group after another
+  vector<State> _states;
+  // The values of DISTINCT aggregates, by key, with a row holding each
+  vector<std::unordered_map<string, size_t>> _sets;
+};
+
+GroupTable::GroupTable(size_t aggregates)
+  : _aggregates(aggregates), _slots(MIN_SLOTS, 0) {}
+
+// Returns the number of groups
+size_t GroupTable::size() const {
+  return _groups.size();
+}
+
+// Returns the position of the group with the given key and hash. If there
+// is none, adds one with row as its row and sets added.
+size_t GroupTable::find_or_add(const char *key, size_t length, uint64_t hash, size_t row,
+			       bool& added) {
+  if ((_groups.size() + 1) * 4 > _slots.size() * 3) {
+    grow();
+  }
+  const size_t mask = _slots.size() - 1;
+  const uint64_t tag = hash >> TAG_SHIFT;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    uint64_t slot = _slots[i];
+    if (slot == 0) {
+      size_t group = _groups.size();
+      _groups.push_back(Group{hash, _keys.size(), length, row});
+      _keys.append(key, length);
+      _states.resize(_states.size() + _aggregates);
+      _slots[i] = (tag << TAG_SHIFT) | (group + 1);
+      added = true;
+      return group;
+    }
+    if (slot >> TAG_SHIFT == tag) {
+      size_t group = (slot & POSITION_MASK) - 1;
+      const Group& candidate = _groups[group];
+      if (candidate.hash == hash && candidate.length == length &&
+	  std::memcmp(_keys.data() + candidate.key, key, length) == 0) {
+	added = false;
+	return group;
+      }
+    }
+  }
+}
+
+// Returns the hash of a group's key
+uint64_t GroupTable::hash(size_t group) const {
+  return _groups[group].hash;
+}
+
+// Returns the bytes of a group's key
+const char *GroupTable::key(size_t group) const {
+  return _keys.data() + _groups[group].key;
+}
+
+size_t GroupTable::key_length(size_t group) const {
+  return _groups[group].length;
+}
+
+// Returns a row of the group, from which its key values can be read
+size_t GroupTable::row(size_t group) const {
+  return _groups[group].row;
+}
+
+// Returns the states of a group's aggregates
+State *GroupTable::states(size_t group) {
+  return &_states[group * _aggregates];
+}
+
+// Adds an empty set of values and returns its position
+size_t GroupTable::add_set() {
+  _sets.emplace_back();
+  return _sets.size() - 1;
+}
+
+std::unordered_map<string, size_t>& GroupTable::set(size_t index) {
+  return _sets[index];
+}
+
+// Doubles the number of slots
+void GroupTable::grow() {
+  vector<uint64_t> slots(_slots.size() * 2, 0);
+  const size_t mask = slots.size() - 1;
+  for (size_t group = 0; group < _groups.size(); ++group) {
+    uint64_t hash = _groups[group].hash;
+    size_t i = hash & mask;
+    while (slots[i] != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = ((hash >> TAG_SHIFT) << TAG_SHIFT) | (group + 1);
+  }
+  _slots.swap(slots);
+}
+
+// Returns true if string a sorts before string b
+bool string_less(const Value& a, const Value& b) {
+  size_t length = std::min(a.string_length(), b.string_length());
+  int order = length == 0 ? 0 : std::memcmp(a.string_data(), b.string_data(), length);
+  return order < 0 || (order == 0 && a.string_length() < b.string_length());
+}
+
+// Computes the aggregates of a table's rows into the states of groups
+class Aggregator {
+ public:
+  Aggregator(const Table& table, const vector<AggregateSpec>& specs);
+  size_t size() const;
+  ColumnSchema column(size_t aggregate) const;
+  void start(GroupTable& groups, size_t group) const;
+  void add(GroupTable& groups, size_t group, size_t row) const;
+  void merge(GroupTable& into, size_t into_group, GroupTable& from, size_t from_group) const;
+  void finish(GroupTable& groups, size_t group) const;
+  Value result(const State& state, size_t aggregate) const;
+ private:
+  void accumulate(State& state, size_t aggregate, const Value& value, size_t row) const;
+  void combine(State& into, const State& from, size_t aggregate) const;
+
+  const Table& _table;
+  const vector<AggregateSpec> _specs;
+  // The physical type of each aggregate's column
+  vector<PhysicalType> _types;
+};
+
+// Plans aggregates of table's columns. Throws a StorageError if a sum or
+// average is of strings.
+Aggregator::Aggregator(const Table& table, const vector<AggregateSpec>& specs)
+  : _table(table), _specs(specs) {
+  for (auto it = specs.begin(); it != specs.end(); ++it) {
+    if (it->column < 0) {
+      _types.push_back(PhysicalType::INT64);
+      continue;
+    }
+    const ColumnSchema& column = table.schema().column(it->column);
+    PhysicalType type = physical_type(column.type);
+    if (reads_as_string(type) &&
+	(it->function == AggregateFunction::SUM || it->function == AggregateFunction::AVG)) {
+      throw StorageError("Cannot add up the strings of column " + column.name);
+    }
+    _types.push_back(type);
+  }
+}
+
+// Returns the number of aggregates
+size_t Aggregator::size() const {
+  return _specs.size();
+}
+
+// Returns the column holding the results of an aggregate
+ColumnSchema Aggregator::column(size_t aggregate) const {
+  const AggregateSpec& spec = _specs[aggregate];
+  ColumnSchema column{"#" + std::to_string(aggregate), Datatype::INT_T, 0, true};
+  switch (spec.function) {
+  case AggregateFunction::COUNT:
+    break;
+  case AggregateFunction::AVG:
+    column.type = Datatype::DOUBLE_T;
+    break;
+  case AggregateFunction::SUM:
+    column.type = _types[aggregate] == PhysicalType::UINT64 ? Datatype::UINT_T
+      : _types[aggregate] == PhysicalType::DOUBLE ? Datatype::DOUBLE_T : Datatype::INT_T;
+    break;
+  default: {
+    const string name = column.name;
+    column = _table.schema().column(spec.column);
+    column.name = name;
+    column.nullable = true;
+    break;
+  }
+  }
+  return column;
+}
+
+// Prepares the states of a new group
+void Aggregator::start(GroupTable& groups, size_t group) const {
+  for (size_t i = 0; i < _specs.size(); ++i) {
+    if (_specs[i].distinct) {
+      size_t set = groups.add_set();
+      groups.states(group)[i].set = set;
+    }
+  }
+}
+
+// Adds row to a group
+void Aggregator::add(GroupTable& groups, size_t group, size_t row) const {
+  State *states = groups.states(group);
+  for (size_t i = 0; i < _specs.size(); ++i) {
+    const AggregateSpec& spec = _specs[i];
+    if (spec.column < 0) {
+      ++states[i].count;
+      continue;
+    }
+    Value value = _table.value(row, spec.column);
+    if (value.is_null()) {
+      continue;
+    }
+    if (spec.distinct) {
+      string key;
+      append_key(key, value);
+      groups.set(states[i].set).emplace(std::move(key), row);
+      continue;
+    }
+    accumulate(states[i], i, value, row);
+  }
+}
+
+// Adds the rows of a group of another table to a group
+void Aggregator::merge(GroupTable& into, size_t into_group, GroupTable& from,
+		       size_t from_group) const {
+  State *target = into.states(into_group);
+  State *source = from.states(from_group);
+  for (size_t i = 0; i < _specs.size(); ++i) {
+    if (_specs[i].distinct) {
+      auto& values = from.set(source[i].set);
+      into.set(target[i].set).insert(values.begin(), values.end());
+    } else {
+      combine(target[i], source[i], i);
+    }
+  }
+}
+
+// Aggregates the distinct values of a group, once all its rows are added
+void Aggregator::finish(GroupTable& groups, size_t group) const {
+  State *states = groups.states(group);
+  for (size_t i = 0; i < _specs.size(); ++i) {
+    if (!_specs[i].distinct) {
+      continue;
+    }
+    const auto& values = groups.set(states[i].set);
+    State state;
+    for (auto it = values.begin(); it != values.end(); ++it) {
+      accumulate(state, i, _table.value(it->second, _specs[i].column), it->second);
+    }
+    states[i] = state;
+  }
+}
+
+// Returns the value of an aggregate from its final state
+Value Aggregator::result(const State& state, size_t aggregate) const {
+  const AggregateSpec& spec = _specs[aggregate];
+  if (spec.function == AggregateFunction::COUNT) {
+    return Value(static_cast<long long>(state.count));
+  }
+  if (state.count == 0) {
+    return Value();
+  }
+  if (spec.function == AggregateFunction::AVG) {
+    return Value(static_cast<double>(state.total / state.count));
+  }
+  switch (_types[aggregate]) {
+  case PhysicalType::INT64:
+    return Value(static_cast<long long>(state.int_value));
+  case PhysicalType::UINT64:
+    return Value(static_cast<unsigned long long>(state.uint_value));
+  case PhysicalType::DOUBLE:
+    return Value(state.double_value);
+  default:
+    return _table.value(state.row, spec.column);
+  }
+}
+
+// Adds a value that is not null, from row, to the state of an aggregate.
+// Throws a StorageError if an integer sum overflows.
+void Aggregator::accumulate(State& state, size_t aggregate, const Value& value,
+			    size_t row) const {
+  const AggregateFunction function = _specs[aggregate].function;
+  const PhysicalType type = _types[aggregate];
+  const bool first = state.count++ == 0;
+  switch (function) {
+  case AggregateFunction::COUNT:
+    return;
+  case AggregateFunction::AVG:
+    state.total += type == PhysicalType::INT64 ? value.int_value()
+      : type == PhysicalType::UINT64 ? value.uint_value() : value.double_value();
+    return;
+  case AggregateFunction::SUM:
+    // A new state's sum is 0 whatever its type
+    switch (type) {
+    case PhysicalType::INT64:
+      if (__builtin_add_overflow(state.int_value, value.int_value(), &state.int_value)) {
+	throw StorageError("SUM is out of range");
+      }
+      return;
+    case PhysicalType::UINT64:
+      if (__builtin_add_overflow(state.uint_value, value.uint_value(), &state.uint_value)) {
+	throw StorageError("SUM is out of range");
+      }
+      return;
+    default:
+      state.double_value += value.double_value();
+      return;
+    }
+  default:
+    break;
+  }
+  // MIN and MAX keep the new value if it sorts before, or after, the old
+  const bool min = function == AggregateFunction::MIN;
+  switch (type) {
+  case PhysicalType::INT64:
+    if (first || (value.int_value() < state.int_value) == min) {
+      state.int_value = value.int_value();
+    }
+    return;
+  case PhysicalType::UINT64:
+    if (first || (value.uint_value() < state.uint_value) == min) {
+      state.uint_value = value.uint_value();
+    }
+    return;
+  case PhysicalType::DOUBLE:
+    if (first || (value.double_value() < state.double_value) == min) {
+      state.double_value = value.double_value();
+    }
+    return;
+  default:
+    if (first ||
+	string_less(value, _table.value(state.row, _specs[aggregate].column)) == min) {
+      state.row = row;
+    }
+    return;
+  }
+}
+
+// Adds the values aggregated in from to into
+void Aggregator::combine(State& into, const State& from, size_t aggregate) const {
+  if (from.count == 0) {
+    return;
+  }
+  if (into.count == 0) {
+    into = from;
+    return;
+  }
+  const AggregateFunction function = _specs[aggregate].function;
+  switch (function) {
+  case AggregateFunction::COUNT:
+    into.count += from.count;
+    return;
+  case AggregateFunction::AVG:
+    into.count += from.count;
+    into.total += from.total;
+    return;
+  default:
+    break;
+  }
+  // The other state's sum or extreme is added like a single value
+  const uint64_t count = into.count + from.count;
+  Value value;
+  switch (_types[aggregate]) {
+  case PhysicalType::INT64:
+    value = Value(static_cast<long long>(from.int_value));
+    break;
+  case PhysicalType::UINT64:
+    value = Value(static_cast<unsigned long long>(from.uint_value));
+    break;
+  case PhysicalType::DOUBLE:
+    value = Value(from.double_value);
+    break;
+  default:
+    value = _table.value(from.row, _specs[aggregate].column);
+    break;
+  }
+  accumulate(into, aggregate, value, from.row);
+  into.count = count;
+}
+
+// Returns the partition of a group's hash among count partitions. The bits
+// used are neither the slot's nor the tag's.
+size_t partition(uint64_t hash, size_t count) {
+  return (hash >> 20) % count;
+}
+
+}  // namespace
+
+// Groups the given rows of table, which must not be deleted, by the values
+// of the key columns, and returns a table with a row per group: the key
+// values, followed by the results of the aggregates. With no key columns,
+// every row is in the one group there always is. Runs on the threads of
+// pool, or on the calling thread only if pool is null. Throws a
+// StorageError if an aggregate cannot be computed.
+unique_ptr<Table> aggregate_rows(const Table& table, const vector<size_t>& rows,
+				 const vector<size_t>& keys, const vector<AggregateSpec>& aggregates,
+				 ThreadPool *pool) {
+  const Aggregator aggregator(table, aggregates);
+  // Every driver aggregates its morsels into a table of its own
+  const size_t shares = morsel_drivers(pool, rows.size());
+
+  // Phase 1: the morsels of every driver into a table of its own
+  vector<unique_ptr<GroupTable>> locals;
+  for (size_t i = 0; i < shares; ++i) {
+    locals.emplace_back(new GroupTable(aggregator.size()));
+  }
+  run_morsels(pool, rows.size(), MORSEL_ROWS, shares, [&](size_t begin, size_t end,
+							 size_t share) {
+      GroupTable& groups = *locals[share];
+      string key;
+      for (size_t i = begin; i < end; ++i) {
+	key.clear();
+	for (auto it = keys.begin(); it != keys.end(); ++it) {
+	  append_key(key, table.value(rows[i], *it));
+	}
+	bool added;
+	size_t group = groups.find_or_add(key.data(), key.size(), hash_key(key.data(), key.size()),
+					  rows[i], added);
+	if (added) {
+	  aggregator.start(groups, group);
+	}
+	aggregator.add(groups, group, rows[i]);
+      }
+    });
+  // The groups of every local table in each partition
+  vector<vector<vector<size_t>>> partitions(shares, vector<vector<size_t>>(shares));
+  if (shares > 1) {
+    run_tasks(pool, shares, [&](size_t share) {
+	const GroupTable& groups = *locals[share];
+	for (size_t group = 0; group < groups.size(); ++group) {
+	  partitions[share][partition(groups.hash(group), shares)].push_back(group);
+	}
+      });
+  }
+
+  // Phase 2: each partition of every local table into one table
+  vector<unique_ptr<GroupTable>> merged;
+  if (shares == 1) {
+    merged.push_back(std::move(locals.front()));
+  } else {
+    for (size_t i = 0; i < shares; ++i) {
+      merged.emplace_back(new GroupTable(aggregator.size()));
+    }
+  }
+  run_tasks(pool, shares, [&](size_t part) {
+      GroupTable& groups = *merged[part];
+      if (shares > 1) {
+	for (size_t share = 0; share < shares; ++share) {
+	  GroupTable& local = *locals[share];
+	  const vector<size_t>& members = partitions[share][part];
+	  for (auto it = members.begin(); it != members.end(); ++it) {
+	    bool added;
+	    size_t group = groups.find_or_add(local.key(*it), local.key_length(*it),
+					      local.hash(*it), local.row(*it), added);
+	    if (added) {
+	      aggregator.start(groups, group);
+	    }
+	    aggregator.merge(groups, group, local, *it);
+	  }
+	}
+      }
+      for (size_t group = 0; group < groups.size(); ++group) {
+	aggregator.finish(groups, group);
+      }
+    });
+
+  Schema schema;
+  for (auto it = keys.begin(); it != keys.end(); ++it) {
+    ColumnSchema column = table.schema().column(*it);
+    column.nullable = true;
+    schema.add_column(column);
+  }
+  for (size_t i = 0; i < aggregator.size(); ++i) {
+    schema.add_column(aggregator.column(i));
+  }
+  unique_ptr<Table> result(new Table("groups", schema));
+  vector<vector<Value>> output;
+  auto emit = [&](const State *states, size_t row) {
+    vector<Value> values;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+      values.push_back(table.value(row, *it));
+    }
+    for (size_t i = 0; i < aggregator.size(); ++i) {
+      values.push_back(aggregator.result(states[i], i));
+    }
+    output.push_back(std::move(values));
+    if (output.size() == OUTPUT_ROWS) {
+      result->append(output);
+      output.clear();
+    }
+  };
+  size_t groups = 0;
+  for (auto it = merged.begin(); it != merged.end(); ++it) {
+    for (size_t group = 0; group < (*it)->size(); ++group) {
+      emit((*it)->states(group), (*it)->row(group));
+    }
+    groups += (*it)->size();
+  }
+  if (keys.empty() && groups == 0) {
+    vector<State> empty(aggregator.size());
+    emit(empty.data(), 0);
+  }
+  result->append(output);
+  return result;
+}
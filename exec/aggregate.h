@@ -0,0 +1,45 @@
+// SimpleSQL: Hash aggregation
+//
+// Groups rows of a table by the values of key columns and computes
+// aggregates over every group, on the threads of a pool in two phases.
+// First each driver (see morsel.h) aggregates the morsels of rows it takes
+// into a group table of its own, without locks, and sorts its groups into
+// partitions by hash. Then each thread merges one partition of every
+// thread's table, so no group is touched by two threads and the merged
+// groups need no locks either.
+//
+// Group tables use open addressing with linear probing over slots of eight
+// bytes: 16 bits of the group's hash, which rule out most other groups
+// without reading them, and the group's position in the table. Groups keep
+// their key, the encoding of their values (see index_key.h), in a shared
+// string, along with a row of the group, from which the values are read
+// back, and the states of their aggregates in a shared array.
+//
+// Aggregates ignore nulls. COUNT is 0 and the other aggregates are NULL
+// for groups without values. Sums of integers are exact, and an error if
+// they overflow; averages are doubles.
+
+#ifndef __AGGREGATE_H__
+#define __AGGREGATE_H__
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "../AST/expression.h"
+#include "../storage/table.h"
+#include "../util/thread_pool.h"
+
+// An aggregate to compute for every group
+struct AggregateSpec {
+  AggregateFunction function;
+  // The column aggregated, or -1 for COUNT(*)
+  int column;
+  bool distinct;
+};
+
+std::unique_ptr<Table> aggregate_rows(const Table& table, const std::vector<std::size_t>& rows,
+				      const std::vector<std::size_t>& keys,
+				      const std::vector<AggregateSpec>& aggregates,
+				      ThreadPool *pool);
+
+#endif  // __AGGREGATE_H__
@@ -0,0 +1,1136 @@
+// SimpleSQL: Vectorized filters
+
+#include "filter.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include "../AST/visitor.h"
+#include "kernels.h"
+
+using std::size_t;
+using std::string;
+using std::uint8_t;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// The truth values of conditions; unknown is null
+const Value TRUE_VALUE(1LL);
+const Value FALSE_VALUE(0LL);
+
+// The longest IN list compared with encoded values one constant at a time
+// rather than looked up row by row
+const size_t MAX_ENCODED_IN = 8;
+
+// Compares two numbers of possibly different types
+int compare_numbers(const Value& a, const Value& b) {
+  if (a.type() == ValueType::INT && b.type() == ValueType::INT) {
+    return a.int_value() < b.int_value() ? -1 : a.int_value() > b.int_value();
+  }
+  if (a.type() == ValueType::UINT && b.type() == ValueType::UINT) {
+    return a.uint_value() < b.uint_value() ? -1 : a.uint_value() > b.uint_value();
+  }
+  if (a.type() == ValueType::INT && b.type() == ValueType::UINT) {
+    if (a.int_value() < 0) {
+      return -1;
+    }
+    return compare_numbers(Value(static_cast<unsigned long long>(a.int_value())), b);
+  }
+  if (a.type() == ValueType::UINT && b.type() == ValueType::INT) {
+    return -compare_numbers(b, a);
+  }
+  // A long double holds every 64-bit integer exactly
+  auto widen = [](const Value& v) -> long double {
+    switch (v.type()) {
+    case ValueType::INT:
+      return v.int_value();
+    case ValueType::UINT:
+      return v.uint_value();
+    default:
+      return v.double_value();
+    }
+  };
+  long double x = widen(a);
+  long double y = widen(b);
+  return x < y ? -1 : x > y;
+}
+
+// Compares two values that are not null. Throws a StorageError if a
+// string is compared with a number.
+int compare(const Value& a, const Value& b) {
+  bool a_string = a.type() == ValueType::STRING;
+  bool b_string = b.type() == ValueType::STRING;
+  if (a_string != b_string) {
+    throw StorageError("Cannot compare " + a.toString() + " with " + b.toString());
+  }
+  if (!a_string) {
+    return compare_numbers(a, b);
+  }
+  size_t length = std::min(a.string_length(), b.string_length());
+  int order = length == 0 ? 0 : std::memcmp(a.string_data(), b.string_data(), length);
+  if (order != 0) {
+    return order;
+  }
+  return a.string_length() < b.string_length() ? -1 : a.string_length() > b.string_length();
+}
+
+// Returns true if order, the result of comparing two values, satisfies op
+bool satisfies(int order, BinaryOp op) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return order == 0;
+  case BinaryOp::NEQUAL:
+    return order != 0;
+  case BinaryOp::GTHAN:
+    return order > 0;
+  case BinaryOp::LTHAN:
+    return order < 0;
+  case BinaryOp::GEQ:
+    return order >= 0;
+  default:
+    return order <= 0;
+  }
+}
+
+// Returns the truth value of a condition that is a single value. Numbers
+// are true unless they are zero. Throws a StorageError for strings.
+Value truth(const Value& value) {
+  if (value.is_null()) {
+    return value;
+  }
+  if (value.type() == ValueType::STRING) {
+    throw StorageError("The string " + value.toString() + " is not a condition");
+  }
+  return compare_numbers(value, FALSE_VALUE) != 0 ? TRUE_VALUE : FALSE_VALUE;
+}
+
+// Returns the operator that gives the same result with its operands
+// swapped
+BinaryOp mirror(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::GTHAN:
+    return BinaryOp::LTHAN;
+  case BinaryOp::LTHAN:
+    return BinaryOp::GTHAN;
+  case BinaryOp::GEQ:
+    return BinaryOp::LEQ;
+  case BinaryOp::LEQ:
+    return BinaryOp::GEQ;
+  default:
+    return op;
+  }
+}
+
+// Converts a value that is not null to the representation of a column of
+// the given physical type, and returns true, or returns false if the
+// conversion would not be exact
+bool convert_exactly(PhysicalType type, const Value& value, Value& converted) {
+  // 2^63, which doubles represent exactly
+  const double TWO_63 = 9223372036854775808.0;
+  switch (type) {
+  case PhysicalType::INT64:
+    if (value.type() == ValueType::INT) {
+      converted = value;
+    } else if (value.type() == ValueType::UINT && value.uint_value() <= INT64_MAX) {
+      converted = Value(static_cast<long long>(value.uint_value()));
+    } else if (value.type() == ValueType::DOUBLE && std::trunc(value.double_value()) == value.double_value() &&
+	       value.double_value() >= -TWO_63 && value.double_value() < TWO_63) {
+      converted = Value(static_cast<long long>(value.double_value()));
+    } else {
+      return false;
+    }
+    return true;
+  case PhysicalType::UINT64:
+    if (value.type() == ValueType::UINT) {
+      converted = value;
+    } else if (value.type() == ValueType::INT && value.int_value() >= 0) {
+      converted = Value(static_cast<unsigned long long>(value.int_value()));
+    } else if (value.type() == ValueType::DOUBLE && std::trunc(value.double_value()) == value.double_value() &&
+	       value.double_value() >= 0 && value.double_value() < 2 * TWO_63) {
+      converted = Value(static_cast<unsigned long long>(value.double_value()));
+    } else {
+      return false;
+    }
+    return true;
+  case PhysicalType::DOUBLE:
+    if (value.type() == ValueType::DOUBLE) {
+      converted = value;
+      return true;
+    }
+    if (value.type() == ValueType::INT || value.type() == ValueType::UINT) {
+      double d = value.type() == ValueType::INT ? static_cast<double>(value.int_value())
+	: static_cast<double>(value.uint_value());
+      if (compare_numbers(Value(d), value) != 0) {
+	return false;
+      }
+      converted = Value(d);
+      return true;
+    }
+    return false;
+  case PhysicalType::STRING:
+    converted = value;
+    return value.type() == ValueType::STRING;
+  case PhysicalType::ENUM:
+  case PhysicalType::SET:
+    // Compared by code or mask rather than converted
+    break;
+  }
+  return false;
+}
+
+// Sets mask to the mask of the SET value that is equal to a constant, and
+// returns true, or returns false if no value of the column is: if the
+// constant is not a string, names something other than a member, or lists
+// members out of declaration order
+bool set_mask_exactly(const Dictionary& dictionary, const Value& value, uint64_t& mask) {
+  if (value.type() != ValueType::STRING ||
+      !dictionary.set_mask(value.string_data(), value.string_length(), mask)) {
+    return false;
+  }
+  return compare(dictionary.set_value(mask), value) == 0;
+}
+
+// Returns a number of the C++ type of a column, from a value converted to
+// the column's type
+template <typename T>
+T number(const Value& value);
+
+template <>
+std::int64_t number<std::int64_t>(const Value& value) {
+  return value.int_value();
+}
+
+template <>
+uint64_t number<uint64_t>(const Value& value) {
+  return value.uint_value();
+}
+
+template <>
+double number<double>(const Value& value) {
+  return value.double_value();
+}
+
+/*------------------------------------------------
+  Selection vectors
+  ----------------------------------------------*/
+
+// Returns true if row of a chunk is not null in the column whose validity
+// bitmap is given, which is null for columns without nulls
+inline bool is_valid(const uint64_t *validity, size_t row) {
+  return !validity || bit_is_set(validity, row);
+}
+
+// Writes to out the rows in sel whose test is equal to want and that are
+// not null in the column with the given validity bitmap. Every row is
+// written and only kept by advancing the count, so the loop has no
+// branches to mispredict.
+template <typename Test>
+size_t keep_rows(Test test, const uint64_t *validity, size_t offset, const BatchRow *sel,
+		 size_t count, bool want, BatchRow *out) {
+  size_t n = 0;
+  if (!validity) {
+    for (size_t i = 0; i < count; ++i) {
+      BatchRow row = sel[i];
+      out[n] = row;
+      n += test(row) == want;
+    }
+    return n;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    BatchRow row = sel[i];
+    out[n] = row;
+    n += (test(row) == want) & bit_is_set(validity, offset + row);
+  }
+  return n;
+}
+
+// Like keep_rows, for tests of two columns, both of which must not be
+// null
+template <typename Test>
+size_t keep_rows(Test test, const uint64_t *left_validity, const uint64_t *right_validity,
+		 size_t offset, const BatchRow *sel, size_t count, bool want, BatchRow *out) {
+  if (!left_validity || !right_validity) {
+    return keep_rows(test, left_validity ? left_validity : right_validity, offset, sel, count,
+		     want, out);
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < count; ++i) {
+    BatchRow row = sel[i];
+    out[n] = row;
+    n += (test(row) == want) & bit_is_set(left_validity, offset + row) &
+      bit_is_set(right_validity, offset + row);
+  }
+  return n;
+}
+
+// Writes to out the rows in sel whose bits in matches, a bitmap of the
+// rows of the batch from first, a multiple of 64, are equal to want and
+// that are not null in the columns with the given validity bitmaps, either
+// of which may be null. Consecutive rows are read off the set bits, and
+// others are tested one by one.
+size_t select_matches(uint64_t *matches, size_t first, const uint64_t *left_validity,
+		      const uint64_t *right_validity, size_t offset, const BatchRow *sel,
+		      size_t count, bool want, BatchRow *out) {
+  const size_t end = sel[count - 1] + 1;
+  const size_t words = (end - first + 63) / 64;
+  const uint64_t flip = want ? 0 : ~0ULL;
+  // Batches start at multiples of BATCH_SIZE, so the validity words line up
+  const size_t base = (offset + first) / 64;
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t word = matches[w] ^ flip;
+    if (left_validity) {
+      word &= left_validity[base + w];
+    }
+    if (right_validity) {
+      word &= right_validity[base + w];
+    }
+    matches[w] = word;
+  }
+  size_t n = 0;
+  if (count == end - sel[0]) {
+    matches[0] &= ~0ULL << (sel[0] - first);
+    if ((end - first) % 64 != 0) {
+      matches[words - 1] &= ~(~0ULL << ((end - first) % 64));
+    }
+    for (size_t w = 0; w < words; ++w) {
+      for (uint64_t word = matches[w]; word; word &= word - 1) {
+	out[n++] = static_cast<BatchRow>(first + w * 64 + __builtin_ctzll(word));
+      }
+    }
+    return n;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    BatchRow row = sel[i];
+    out[n] = row;
+    n += (matches[(row - first) / 64] >> ((row - first) % 64)) & 1;
+  }
+  return n;
+}
+
+// Returns count values of a numeric column of C++ type T, starting with
+// the one at first: the column's own if it is plain, or else decoded into
+// buffer
+template <typename T>
+const T *column_values(const ColumnChunk& column, size_t first, size_t count, T *buffer) {
+  if (!column.encoded()) {
+    return column.values<T>() + first;
+  }
+  column.decode(first, count, buffer);
+  return buffer;
+}
+
+// ENUM codes are never encoded
+const uint8_t *column_values(const ColumnChunk& column, size_t first, size_t, uint8_t*) {
+  return column.values<uint8_t>() + first;
+}
+
+// Compares count values of an encoded column, starting with the one at
+// first, with constant, writing bits as a kernel does
+template <typename T>
+void compare_encoded(const EncodedColumn& column, BinaryOp op, T constant, size_t first,
+		     size_t count, uint64_t *bits) {
+  column.compare(op, constant, first, count, bits);
+}
+
+void compare_encoded(const EncodedColumn&, BinaryOp, uint8_t, size_t, size_t, uint64_t*) {
+  assert(!"ENUM codes are never encoded");
+}
+
+// Returns true if test, called with zones, is true for any of the zones of
+// a column that the rows of batch are in
+template <typename Test>
+bool any_zone(const Batch& batch, size_t column, Test test) {
+  const ColumnChunk& values = batch.chunk->column(column);
+  const size_t end = batch.offset + batch.size;
+  for (size_t zone = batch.offset / ZONE_ROWS; zone * ZONE_ROWS < end; ++zone) {
+    if (test(values.zone(zone))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns false if comparing the rows of a zone of a numeric column of C++
+// type T with constant using op holds for none of them
+template <typename T>
+bool zone_may_hold(const Zone& zone, BinaryOp op, T constant) {
+  if (zone.nulls == zone.rows) {
+    return false;
+  }
+  if (zone.low.is_null() || op == BinaryOp::NEQUAL) {
+    return true;
+  }
+  const T low = number<T>(zone.low);
+  const T high = number<T>(zone.high);
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return low <= constant && constant <= high;
+  case BinaryOp::LTHAN:
+    return low < constant;
+  case BinaryOp::LEQ:
+    return low <= constant;
+  case BinaryOp::GTHAN:
+    return high > constant;
+  default:
+    return high >= constant;
+  }
+}
+
+// ENUM zones keep no range
+bool zone_may_hold(const Zone& zone, BinaryOp, uint8_t) {
+  return zone.nulls < zone.rows;
+}
+
+// Writes the rows of sel that are not in removed, a subsequence of sel, to
+// out and returns how many there are
+size_t difference(const BatchRow *sel, size_t count, const BatchRow *removed, size_t n,
+		  BatchRow *out) {
+  size_t written = 0;
+  size_t j = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (j < n && removed[j] == sel[i]) {
+      ++j;
+    } else {
+      out[written++] = sel[i];
+    }
+  }
+  return written;
+}
+
+// Merges two increasing selection vectors with no rows in common into out,
+// which must be neither of them, and returns the number of rows
+size_t merge(const BatchRow *a, size_t a_count, const BatchRow *b, size_t b_count, BatchRow *out) {
+  return std::merge(a, a + a_count, b, b + b_count, out) - out;
+}
+
+/*------------------------------------------------
+  Filters
+  ----------------------------------------------*/
+
+// A condition that has the same truth value for every row
+class ConstantFilter : public Filter {
+ public:
+  explicit ConstantFilter(const Value& truth) : _truth(truth) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    if (_truth.is_null() || (_truth.int_value() != 0) != want) {
+      return 0;
+    }
+    std::copy(sel, sel + count, out);
+    return count;
+  }
+  bool may_select(const Batch&) const {
+    return !_truth.is_null() && _truth.int_value() != 0;
+  }
+ private:
+  const Value _truth;
+};
+
+// AND or OR of two conditions. The result that decides the operator
+// whatever the other operand is, false for AND and true for OR, is the
+// union of the rows where the left operand has it and the rest of the rows
+// where the right one does. The other result needs both operands to have
+// it, so the right operand only sees the rows the left one kept.
+class LogicFilter : public Filter {
+ public:
+  LogicFilter(BinaryOp op, unique_ptr<Filter> left, unique_ptr<Filter> right)
+    : _decisive(op == BinaryOp::OR), _left(std::move(left)), _right(std::move(right)) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    if (want != _decisive) {
+      size_t n = _left->select(batch, sel, count, want, out);
+      return _right->select(batch, out, n, want, out);
+    }
+    BatchRow left[BATCH_SIZE];
+    BatchRow rest[BATCH_SIZE];
+    size_t left_count = _left->select(batch, sel, count, want, left);
+    size_t rest_count = difference(sel, count, left, left_count, rest);
+    rest_count = _right->select(batch, rest, rest_count, want, rest);
+    return merge(left, left_count, rest, rest_count, out);
+  }
+  bool may_select(const Batch& batch) const {
+    if (_decisive) {
+      return _left->may_select(batch) || _right->may_select(batch);
+    }
+    return _left->may_select(batch) && _right->may_select(batch);
+  }
+ private:
+  const bool _decisive;
+  const unique_ptr<Filter> _left;
+  const unique_ptr<Filter> _right;
+};
+
+class NotFilter : public Filter {
+ public:
+  explicit NotFilter(unique_ptr<Filter> operand) : _operand(std::move(operand)) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    return _operand->select(batch, sel, count, !want, out);
+  }
+ private:
+  const unique_ptr<Filter> _operand;
+};
+
+// Tests whether a column is null, or with negated, whether it is not
+class IsNullFilter : public Filter {
+ public:
+  IsNullFilter(size_t column, bool negated) : _column(column), _negated(negated) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    bool want_null = want != _negated;
+    const uint64_t *validity = batch.chunk->column(_column).validity();
+    if (!validity) {
+      return want_null ? 0 : std::copy(sel, sel + count, out) - out;
+    }
+    size_t offset = batch.offset;
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+      BatchRow row = sel[i];
+      out[n] = row;
+      n += bit_is_set(validity, offset + row) != want_null;
+    }
+    return n;
+  }
+  bool may_select(const Batch& batch) const {
+    return any_zone(batch, _column, [this](const Zone& zone) {
+	return _negated ? zone.nulls < zone.rows : zone.nulls > 0;
+      });
+  }
+ private:
+  const size_t _column;
+  const bool _negated;
+};
+
+// Compares a numeric column of C++ type T with a constant
+template <typename T>
+class ConstantCompareFilter : public Filter {
+ public:
+  ConstantCompareFilter(size_t column, BinaryOp op, T constant)
+    : _column(column), _op(op), _kernel(constant_kernel<T>(op)), _constant(constant) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    if (count == 0) {
+      return 0;
+    }
+    const ColumnChunk& column = batch.chunk->column(_column);
+    size_t first = sel[0] / 64 * 64;
+    size_t rows = sel[count - 1] + 1 - first;
+    uint64_t matches[BATCH_SIZE / 64];
+    if (column.encoded()) {
+      compare_encoded(*column.encoded(), _op, _constant, batch.offset + first, rows, matches);
+    } else {
+      _kernel(column.values<T>() + batch.offset + first, _constant, rows, matches);
+    }
+    return select_matches(matches, first, column.validity(), nullptr, batch.offset, sel, count,
+			  want, out);
+  }
+  bool may_select(const Batch& batch) const {
+    return any_zone(batch, _column, [this](const Zone& zone) {
+	return zone_may_hold(zone, _op, _constant);
+      });
+  }
+ private:
+  const size_t _column;
+  const BinaryOp _op;
+  const ConstantKernel<T> _kernel;
+  const T _constant;
+};
+
+// Compares two numeric columns of C++ type T
+template <typename T>
+class ColumnCompareFilter : public Filter {
+ public:
+  ColumnCompareFilter(size_t left, BinaryOp op, size_t right)
+    : _left(left), _kernel(column_kernel<T>(op)), _right(right) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    if (count == 0) {
+      return 0;
+    }
+    const ColumnChunk& left = batch.chunk->column(_left);
+    const ColumnChunk& right = batch.chunk->column(_right);
+    size_t first = sel[0] / 64 * 64;
+    uint64_t matches[BATCH_SIZE / 64];
+    size_t rows = sel[count - 1] + 1 - first;
+    T left_buffer[BATCH_SIZE];
+    T right_buffer[BATCH_SIZE];
+    _kernel(column_values(left, batch.offset + first, rows, left_buffer),
+	    column_values(right, batch.offset + first, rows, right_buffer), rows, matches);
+    return select_matches(matches, first, left.validity(), right.validity(), batch.offset, sel,
+			  count, want, out);
+  }
+ private:
+  const size_t _left;
+  const ColumnKernel<T> _kernel;
+  const size_t _right;
+};
+
+// Compares the strings of a column with a constant, or with another string
+// column
+class StringCompareFilter : public Filter {
+ public:
+  StringCompareFilter(size_t column, BinaryOp op, const string& constant)
+    : _column(column), _op(op), _other(-1), _constant(constant) {}
+  StringCompareFilter(size_t column, BinaryOp op, size_t other)
+    : _column(column), _op(op), _other(static_cast<int>(other)) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    const ColumnChunk& column = batch.chunk->column(_column);
+    const size_t offset = batch.offset;
+    const BinaryOp op = _op;
+    if (_other < 0) {
+      const Value c(_constant.data(), _constant.size());
+      return keep_rows([&](BatchRow r) {
+	  Value v(column.string_data(offset + r), column.string_length(offset + r));
+	  return satisfies(compare(v, c), op);
+	}, column.validity(), offset, sel, count, want, out);
+    }
+    const ColumnChunk& other = batch.chunk->column(_other);
+    return keep_rows([&](BatchRow r) {
+	Value a(column.string_data(offset + r), column.string_length(offset + r));
+	Value b(other.string_data(offset + r), other.string_length(offset + r));
+	return satisfies(compare(a, b), op);
+      }, column.validity(), other.validity(), offset, sel, count, want, out);
+  }
+ private:
+  const size_t _column;
+  const BinaryOp _op;
+  // The column compared with, or -1 for the constant
+  const int _other;
+  const string _constant;
+};
+
+// Tests whether a numeric column of C++ type T is equal to one of a list
+// of constants. A NULL in the list makes the test unknown rather than
+// false for values not in it.
+template <typename T>
+class InFilter : public Filter {
+ public:
+  InFilter(size_t column, const vector<T>& constants, bool has_null)
+    : _column(column), _constants(constants), _has_null(has_null) {
+    std::sort(_constants.begin(), _constants.end());
+  }
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    if (!want && _has_null) {
+      return 0;
+    }
+    if (count == 0) {
+      return 0;
+    }
+    const ColumnChunk& column = batch.chunk->column(_column);
+    if (column.encoded() && _constants.size() <= MAX_ENCODED_IN) {
+      // Each constant is compared with the encoded values in turn
+      size_t first = sel[0] / 64 * 64;
+      size_t rows = sel[count - 1] + 1 - first;
+      uint64_t matches[BATCH_SIZE / 64] = {};
+      uint64_t equal[BATCH_SIZE / 64];
+      for (auto it = _constants.begin(); it != _constants.end(); ++it) {
+	column.encoded()->compare(BinaryOp::EQUAL, *it, batch.offset + first, rows, equal);
+	for (size_t w = 0; w < (rows + 63) / 64; ++w) {
+	  matches[w] |= equal[w];
+	}
+      }
+      return select_matches(matches, first, column.validity(), nullptr, batch.offset, sel, count,
+			    want, out);
+    }
+    const size_t low = sel[0];
+    T buffer[BATCH_SIZE];
+    const T *values = column_values(column, batch.offset + low, sel[count - 1] + 1 - low,
+				    buffer);
+    const T *begin = _constants.data();
+    const T *end = begin + _constants.size();
+    return keep_rows([=](BatchRow r) { return std::binary_search(begin, end, values[r - low]); },
+		     column.validity(), batch.offset, sel, count, want, out);
+  }
+ private:
+  const size_t _column;
+  vector<T> _constants;
+  const bool _has_null;
+};
+
+// A set of ENUM codes, with bit code % 64 of word code / 64 set for each
+typedef std::array<uint64_t, 4> CodeSet;
+
+// Tests whether the code of an ENUM column is in a set of codes, those of
+// the members a condition holds for. A NULL in an IN list makes the test
+// unknown rather than false for codes not in the set.
+class CodeSetFilter : public Filter {
+ public:
+  CodeSetFilter(size_t column, const CodeSet& codes, bool has_null)
+    : _column(column), _codes(codes), _has_null(has_null) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    if (!want && _has_null) {
+      return 0;
+    }
+    const ColumnChunk& column = batch.chunk->column(_column);
+    const uint8_t *codes = column.values<uint8_t>() + batch.offset;
+    const CodeSet& set = _codes;
+    return keep_rows([&](BatchRow r) { return ((set[codes[r] / 64] >> (codes[r] % 64)) & 1) != 0; },
+		     column.validity(), batch.offset, sel, count, want, out);
+  }
+ private:
+  const size_t _column;
+  const CodeSet _codes;
+  const bool _has_null;
+};
+
+// One side of a comparison: a column, or a constant
+struct Operand {
+  // The position of the column, or -1 for a constant
+  int column;
+  Value value;
+};
+
+// Compares two operands of any types row by row, as Values. Used when the
+// operands' types differ in a way no typed loop covers.
+class ValueCompareFilter : public Filter {
+ public:
+  ValueCompareFilter(const Operand& left, BinaryOp op, const Operand& right)
+    : _left(left), _op(op), _right(right) {}
+  size_t select(const Batch& batch, const BatchRow *sel, size_t count, bool want,
+		BatchRow *out) const {
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+      Value a = value(_left, batch, sel[i]);
+      Value b = value(_right, batch, sel[i]);
+      if (!a.is_null() && !b.is_null() && satisfies(compare(a, b), _op) == want) {
+	out[n++] = sel[i];
+      }
+    }
+    return n;
+  }
+ private:
+  static Value value(const Operand& operand, const Batch& batch, BatchRow row) {
+    if (operand.column < 0) {
+      return operand.value;
+    }
+    return batch.chunk->column(operand.column).value(batch.offset + row);
+  }
+  const Operand _left;
+  const BinaryOp _op;
+  const Operand _right;
+};
+
+/*------------------------------------------------
+  Compilation
+  ----------------------------------------------*/
+
+// Compiles a condition into filters
+class FilterCompiler : public Visitor {
+ public:
+  FilterCompiler(const Table& table, const vector<Value>& parameters,
+		 const ExpressionColumns *bindings);
+  unique_ptr<Filter> compile(const Expression *condition);
+  void visitLiteral(const Literal& node);
+  void visitPlaceholder(const Placeholder& node);
+  void visitColumnRef(const ColumnRef& node);
+  void visitBinaryExpr(const BinaryExpr& node);
+  void visitNotExpr(const NotExpr& node);
+  void visitBetweenExpr(const BetweenExpr& node);
+  void visitInExpr(const InExpr& node);
+  void visitIsNullExpr(const IsNullExpr& node);
+  void visitAggregateExpr(const AggregateExpr& node);
+ private:
+  void column(size_t column);
+  Operand operand(const Expression *expression);
+  void check_condition() const;
+  PhysicalType column_type(size_t column) const;
+  const Dictionary& dictionary(size_t column) const;
+  unique_ptr<Filter> comparison(const Operand& left, BinaryOp op, const Operand& right) const;
+  unique_ptr<Filter> constant_comparison(size_t column, BinaryOp op, const Value& constant) const;
+  unique_ptr<Filter> enum_comparison(size_t column, BinaryOp op, const Value& constant) const;
+  unique_ptr<Filter> set_comparison(size_t column, BinaryOp op, const Value& constant) const;
+  template <typename T>
+  unique_ptr<Filter> in_list(size_t column, const vector<Operand>& list) const;
+  unique_ptr<Filter> enum_in_list(size_t column, const vector<Operand>& list) const;
+  unique_ptr<Filter> set_in_list(size_t column, const vector<Operand>& list) const;
+
+  const Table& _table;
+  const vector<Value>& _parameters;
+  const ExpressionColumns *const _bindings;
+  // The filter of the condition last compiled
+  unique_ptr<Filter> _filter;
+  // True while an operand is being read, and the operand read
+  bool _reading;
+  Operand _operand;
+};
+
+FilterCompiler::FilterCompiler(const Table& table, const vector<Value>& parameters,
+			       const ExpressionColumns *bindings)
+  : _table(table), _parameters(parameters), _bindings(bindings), _reading(false),
+    _operand{-1, Value()} {}
+
+// Returns the filter of condition
+unique_ptr<Filter> FilterCompiler::compile(const Expression *condition) {
+  condition->accept(*this);
+  return std::move(_filter);
+}
+
+void FilterCompiler::visitLiteral(const Literal& node) {
+  _operand = Operand{-1, node.value()};
+  if (!_reading) {
+    _filter.reset(new ConstantFilter(truth(node.value())));
+  }
+}
+
+void FilterCompiler::visitPlaceholder(const Placeholder& node) {
+  if (node.index() >= _parameters.size()) {
+    throw StorageError("No value for parameter " + std::to_string(node.index() + 1));
+  }
+  _operand = Operand{-1, _parameters[node.index()]};
+  if (!_reading) {
+    _filter.reset(new ConstantFilter(truth(_operand.value)));
+  }
+}
+
+void FilterCompiler::visitColumnRef(const ColumnRef& node) {
+  if (_bindings && _bindings->count(&node)) {
+    column(_bindings->at(&node));
+    return;
+  }
+  int index = _table.schema().index_of(node.name().str());
+  if (index < 0) {
+    throw StorageError("Table " + _table.name() + " has no column " + node.name().str());
+  }
+  column(index);
+}
+
+// Aggregates are only allowed where they are bound to columns
+void FilterCompiler::visitAggregateExpr(const AggregateExpr& node) {
+  auto bound = _bindings ? _bindings->find(&node) : ExpressionColumns::const_iterator();
+  if (!_bindings || bound == _bindings->end()) {
+    throw StorageError("Aggregates are not allowed here");
+  }
+  column(bound->second);
+}
+
+// Reads the column at the given position. A column used as a condition is
+// true when it is not zero.
+void FilterCompiler::column(size_t column) {
+  _operand = Operand{static_cast<int>(column), Value()};
+  if (!_reading) {
+    _filter = comparison(_operand, BinaryOp::NEQUAL, Operand{-1, FALSE_VALUE});
+  }
+}
+
+void FilterCompiler::visitBinaryExpr(const BinaryExpr& node) {
+  check_condition();
+  if (node.op() == BinaryOp::AND || node.op() == BinaryOp::OR) {
+    unique_ptr<Filter> left = compile(node.left());
+    unique_ptr<Filter> right = compile(node.right());
+    _filter.reset(new LogicFilter(node.op(), std::move(left), std::move(right)));
+    return;
+  }
+  Operand left = operand(node.left());
+  _filter = comparison(left, node.op(), operand(node.right()));
+}
+
+void FilterCompiler::visitNotExpr(const NotExpr& node) {
+  check_condition();
+  _filter.reset(new NotFilter(compile(node.operand())));
+}
+
+void FilterCompiler::visitBetweenExpr(const BetweenExpr& node) {
+  check_condition();
+  Operand value = operand(node.value());
+  Operand low = operand(node.low());
+  Operand high = operand(node.high());
+  _filter.reset(new LogicFilter(BinaryOp::AND, comparison(value, BinaryOp::GEQ, low),
+				comparison(value, BinaryOp::LEQ, high)));
+  if (node.negated()) {
+    _filter.reset(new NotFilter(std::move(_filter)));
+  }
+}
+
+void FilterCompiler::visitInExpr(const InExpr& node) {
+  check_condition();
+  Operand value = operand(node.value());
+  vector<Operand> list;
+  bool constants = true;
+  for (auto it = node.list().begin(); it != node.list().end(); ++it) {
+    list.push_back(operand(*it));
+    constants = constants && list.back().column < 0;
+  }
+  if (value.column >= 0 && constants) {
+    switch (column_type(value.column)) {
+    case PhysicalType::INT64:
+      _filter = in_list<std::int64_t>(value.column, list);
+      break;
+    case PhysicalType::UINT64:
+      _filter = in_list<uint64_t>(value.column, list);
+      break;
+    case PhysicalType::DOUBLE:
+      _filter = in_list<double>(value.column, list);
+      break;
+    case PhysicalType::STRING:
+      _filter.reset();
+      break;
+    case PhysicalType::ENUM:
+      _filter = enum_in_list(value.column, list);
+      break;
+    case PhysicalType::SET:
+      _filter = set_in_list(value.column, list);
+      break;
+    }
+  } else {
+    _filter.reset();
+  }
+  if (!_filter) {
+    _filter = comparison(value, BinaryOp::EQUAL, list.front());
+    for (auto it = list.begin() + 1; it != list.end(); ++it) {
+      _filter.reset(new LogicFilter(BinaryOp::OR, std::move(_filter),
+				    comparison(value, BinaryOp::EQUAL, *it)));
+    }
+  }
+  if (node.negated()) {
+    _filter.reset(new NotFilter(std::move(_filter)));
+  }
+}
+
+void FilterCompiler::visitIsNullExpr(const IsNullExpr& node) {
+  check_condition();
+  Operand value = operand(node.value());
+  if (value.column >= 0) {
+    _filter.reset(new IsNullFilter(value.column, node.negated()));
+  } else {
+    _filter.reset(new ConstantFilter(value.value.is_null() != node.negated() ? TRUE_VALUE
+				     : FALSE_VALUE));
+  }
+}
+
+// Returns the operand an expression stands for
+Operand FilterCompiler::operand(const Expression *expression) {
+  _reading = true;
+  expression->accept(*this);
+  _reading = false;
+  return _operand;
+}
+
+// Throws a StorageError if a condition is being read as an operand
+void FilterCompiler::check_condition() const {
+  if (_reading) {
+    throw StorageError("Conditions cannot be used as values");
+  }
+}
+
+// Returns the physical type of the column at the given position
+PhysicalType FilterCompiler::column_type(size_t column) const {
+  return physical_type(_table.schema().column(column).type);
+}
+
+// Returns the members of the ENUM or SET column at the given position
+const Dictionary& FilterCompiler::dictionary(size_t column) const {
+  return *_table.schema().column(column).dictionary;
+}
+
+// Returns the filter comparing two operands
+unique_ptr<Filter> FilterCompiler::comparison(const Operand& left, BinaryOp op,
+					      const Operand& right) const {
+  if (left.column < 0 && right.column < 0) {
+    if (left.value.is_null() || right.value.is_null()) {
+      return unique_ptr<Filter>(new ConstantFilter(Value()));
+    }
+    bool result = satisfies(compare(left.value, right.value), op);
+    return unique_ptr<Filter>(new ConstantFilter(result ? TRUE_VALUE : FALSE_VALUE));
+  }
+  if (left.column < 0) {
+    return constant_comparison(right.column, mirror(op), left.value);
+  }
+  if (right.column < 0) {
+    return constant_comparison(left.column, op, right.value);
+  }
+  PhysicalType type = column_type(left.column);
+  if (type != column_type(right.column)) {
+    return unique_ptr<Filter>(new ValueCompareFilter(left, op, right));
+  }
+  switch (type) {
+  case PhysicalType::INT64:
+    return unique_ptr<Filter>(new ColumnCompareFilter<std::int64_t>(left.column, op, right.column));
+  case PhysicalType::UINT64:
+    return unique_ptr<Filter>(new ColumnCompareFilter<uint64_t>(left.column, op, right.column));
+  case PhysicalType::DOUBLE:
+    return unique_ptr<Filter>(new ColumnCompareFilter<double>(left.column, op, right.column));
+  case PhysicalType::ENUM:
+  case PhysicalType::SET:
+    // Codes and masks are equal when their strings are if the columns have
+    // the same members, but are not ordered like them
+    if ((op != BinaryOp::EQUAL && op != BinaryOp::NEQUAL) ||
+	dictionary(left.column).members() != dictionary(right.column).members()) {
+      return unique_ptr<Filter>(new ValueCompareFilter(left, op, right));
+    }
+    if (type == PhysicalType::ENUM) {
+      return unique_ptr<Filter>(new ColumnCompareFilter<uint8_t>(left.column, op, right.column));
+    }
+    return unique_ptr<Filter>(new ColumnCompareFilter<uint64_t>(left.column, op, right.column));
+  default:
+    return unique_ptr<Filter>(new StringCompareFilter(left.column, op,
+						      static_cast<size_t>(right.column)));
+  }
+}
+
+// Returns the filter comparing a column with a constant
+unique_ptr<Filter> FilterCompiler::constant_comparison(size_t column, BinaryOp op,
+						       const Value& constant) const {
+  if (constant.is_null()) {
+    return unique_ptr<Filter>(new ConstantFilter(Value()));
+  }
+  if (column_type(column) == PhysicalType::ENUM) {
+    return enum_comparison(column, op, constant);
+  }
+  if (column_type(column) == PhysicalType::SET) {
+    return set_comparison(column, op, constant);
+  }
+  Value converted;
+  if (!convert_exactly(column_type(column), constant, converted)) {
+    return unique_ptr<Filter>(new ValueCompareFilter(Operand{static_cast<int>(column), Value()},
+						     op, Operand{-1, constant}));
+  }
+  switch (column_type(column)) {
+  case PhysicalType::INT64:
+    return unique_ptr<Filter>(new ConstantCompareFilter<std::int64_t>(column, op, converted.int_value()));
+  case PhysicalType::UINT64:
+    return unique_ptr<Filter>(new ConstantCompareFilter<uint64_t>(column, op, converted.uint_value()));
+  case PhysicalType::DOUBLE:
+    return unique_ptr<Filter>(new ConstantCompareFilter<double>(column, op, converted.double_value()));
+  default:
+    return unique_ptr<Filter>(new StringCompareFilter(column, op, converted.string_value()));
+  }
+}
+
+// Returns the filter comparing an ENUM column with a constant that is not
+// null. Equality with a member compares codes. Other comparisons are
+// worked out for every member when compiled, and test whether a row's
+// code is one of those they hold for.
+unique_ptr<Filter> FilterCompiler::enum_comparison(size_t column, BinaryOp op,
+						   const Value& constant) const {
+  if (constant.type() != ValueType::STRING) {
+    return unique_ptr<Filter>(new ValueCompareFilter(Operand{static_cast<int>(column), Value()},
+						     op, Operand{-1, constant}));
+  }
+  const Dictionary& members = dictionary(column);
+  int index = members.index_of(constant.string_data(), constant.string_length());
+  if (index >= 0 && (op == BinaryOp::EQUAL || op == BinaryOp::NEQUAL)) {
+    return unique_ptr<Filter>(new ConstantCompareFilter<uint8_t>(column, op, index + 1));
+  }
+  CodeSet codes{};
+  for (size_t i = 0; i < members.size(); ++i) {
+    Value member(members.member(i).data(), members.member(i).size());
+    if (satisfies(compare(member, constant), op)) {
+      codes[(i + 1) / 64] |= uint64_t(1) << ((i + 1) % 64);
+    }
+  }
+  return unique_ptr<Filter>(new CodeSetFilter(column, codes, false));
+}
+
+// Returns the filter comparing a SET column with a constant that is not
+// null. Equality with a set's string compares masks; other comparisons
+// compare strings.
+unique_ptr<Filter> FilterCompiler::set_comparison(size_t column, BinaryOp op,
+						  const Value& constant) const {
+  uint64_t mask;
+  if ((op == BinaryOp::EQUAL || op == BinaryOp::NEQUAL) &&
+      set_mask_exactly(dictionary(column), constant, mask)) {
+    return unique_ptr<Filter>(new ConstantCompareFilter<uint64_t>(column, op, mask));
+  }
+  return unique_ptr<Filter>(new ValueCompareFilter(Operand{static_cast<int>(column), Value()},
+						   op, Operand{-1, constant}));
+}
+
+// Returns the filter testing whether a numeric column of C++ type T is in
+// a list of constants, or null if a constant does not convert exactly to
+// the column's type
+template <typename T>
+unique_ptr<Filter> FilterCompiler::in_list(size_t column, const vector<Operand>& list) const {
+  vector<T> constants;
+  bool has_null = false;
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    Value converted;
+    if (it->value.is_null()) {
+      has_null = true;
+    } else if (convert_exactly(column_type(column), it->value, converted)) {
+      constants.push_back(number<T>(converted));
+    } else {
+      return nullptr;
+    }
+  }
+  return unique_ptr<Filter>(new InFilter<T>(column, constants, has_null));
+}
+
+// Returns the filter testing whether an ENUM column is in a list of
+// constants, or null if a constant is not a string. Strings that are not
+// members match no row, and are left out.
+unique_ptr<Filter> FilterCompiler::enum_in_list(size_t column, const vector<Operand>& list) const {
+  const Dictionary& members = dictionary(column);
+  CodeSet codes{};
+  bool has_null = false;
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    if (it->value.is_null()) {
+      has_null = true;
+      continue;
+    }
+    if (it->value.type() != ValueType::STRING) {
+      return nullptr;
+    }
+    int index = members.index_of(it->value.string_data(), it->value.string_length());
+    if (index >= 0) {
+      codes[(index + 1) / 64] |= uint64_t(1) << ((index + 1) % 64);
+    }
+  }
+  return unique_ptr<Filter>(new CodeSetFilter(column, codes, has_null));
+}
+
+// Returns the filter testing whether a SET column is in a list of
+// constants, by mask, or null if a constant is not a string. Strings that
+// are equal to no set match no row, and are left out.
+unique_ptr<Filter> FilterCompiler::set_in_list(size_t column, const vector<Operand>& list) const {
+  vector<uint64_t> masks;
+  bool has_null = false;
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    uint64_t mask;
+    if (it->value.is_null()) {
+      has_null = true;
+    } else if (it->value.type() != ValueType::STRING) {
+      return nullptr;
+    } else if (set_mask_exactly(dictionary(column), it->value, mask)) {
+      masks.push_back(mask);
+    }
+  }
+  return unique_ptr<Filter>(new InFilter<uint64_t>(column, masks, has_null));
+}
+
+}  // namespace
+
+// Compiles condition into filters over the rows of table, with the values
+// of its placeholders taken from parameters. Throws a StorageError if the
+// condition names a column the table does not have, or compares values
+// that cannot be compared. Expressions in bindings, which may be null, stand
+// for the columns they are bound to.
+unique_ptr<Filter> compile_filter(const Table& table, const Expression *condition,
+				  const vector<Value>& parameters,
+				  const ExpressionColumns *bindings) {
+  FilterCompiler compiler(table, parameters, bindings);
+  return compiler.compile(condition);
+}
+
+// Writes the rows of batch that are not deleted to sel, and returns how
+// many there are
+size_t select_all(const Batch& batch, BatchRow *sel) {
+  size_t n = 0;
+  if (batch.chunk->deleted_rows() == 0) {
+    for (size_t i = 0; i < batch.size; ++i) {
+      sel[i] = static_cast<BatchRow>(i);
+    }
+    return batch.size;
+  }
+  for (size_t i = 0; i < batch.size; ++i) {
+    sel[n] = static_cast<BatchRow>(i);
+    n += !batch.chunk->is_deleted(batch.offset + i);
+  }
+  return n;
+}
@@ -0,0 +1,93 @@
+// SimpleSQL: Vectorized filters
+//
+// A WHERE condition compiled against a table into a tree of filters that
+// process rows a batch at a time. A batch is up to BATCH_SIZE consecutive
+// rows of one chunk, and the rows of a batch still under consideration are
+// listed in a selection vector, by position in the batch, in increasing
+// order. Each filter narrows a selection vector to the rows for which its
+// condition has a given truth value, with one loop per column type and
+// operator over the chunk's column arrays, so no per-row dispatch remains.
+//
+// Selecting by truth value, rather than only keeping true rows, is what
+// three-valued logic needs: NOT keeps the rows its operand is false for,
+// and rows for which a condition is unknown are selected by neither.
+//
+// Comparisons of a numeric column with a constant of the column's type, or
+// of two numeric columns of the same type, run the kernels of kernels.h
+// over the rows from the first to the last selected one, and the selection
+// is then read off the bitmap they produce. Strings are compared in typed
+// loops of their own. Constants are converted to the
+// column's type where that is exact. Other comparisons, such as an integer
+// column with 2.5, fall back to comparing Values row by row. BETWEEN is
+// compiled as two comparisons, and IN as a search of its sorted constants,
+// or as equalities joined by OR when its list is not all constants of the
+// column's type.
+//
+// ENUM and SET values compare as their strings, but conditions on them are
+// rewritten to work on their codes and masks. Equality with an ENUM member
+// runs the kernels over the codes, and other comparisons with a constant,
+// and IN lists, are worked out for every member when compiled, leaving a
+// test of each row's code against the set of codes they hold for.
+// Equalities and IN lists of SET values compare masks.
+//
+// A batch can be ruled out before any of its rows are read, from the
+// zones of its columns (see column.h). A comparison of a numeric column
+// with a constant holds for no row of a zone whose range lies wholly on
+// the wrong side of the constant, and no comparison for a zone that is all
+// nulls. IS NULL holds for no row of a zone without nulls, and IS NOT NULL
+// for none of one with only nulls. AND rules a batch out if either operand
+// does, and OR if both do. Other conditions never rule batches out.
+//
+// Expressions can be bound to columns of the table, as the aggregates of a
+// HAVING clause are to the columns of grouped rows. Column references that
+// are bound stand for their column rather than the one of their name, which
+// is how qualified names and the columns of joined rows are resolved.
+
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "../AST/expression.h"
+#include "../storage/table.h"
+
+// The most rows in a batch
+const std::size_t BATCH_SIZE = 1024;
+
+// The position of a row in its batch
+typedef std::uint16_t BatchRow;
+
+// The columns expressions are bound to
+typedef std::unordered_map<const Expression*, std::size_t> ExpressionColumns;
+
+// Up to BATCH_SIZE consecutive rows of a chunk
+struct Batch {
+  const Chunk *chunk;
+  // The position of the batch's first row in the chunk
+  std::size_t offset;
+  std::size_t size;
+};
+
+// A condition evaluated on batches
+class Filter {
+ public:
+  virtual ~Filter() {}
+  // Writes to out the count rows in sel for which the condition is true,
+  // if want is true, or false otherwise, keeping their order, and returns
+  // how many were written. Out may be sel itself.
+  virtual std::size_t select(const Batch& batch, const BatchRow *sel, std::size_t count,
+			     bool want, BatchRow *out) const = 0;
+  // Returns false if the zones of the batch's columns show that the
+  // condition is true for none of its rows
+  virtual bool may_select(const Batch&) const { return true; }
+};
+
+std::unique_ptr<Filter> compile_filter(const Table& table, const Expression *condition,
+				       const std::vector<Value>& parameters,
+				       const ExpressionColumns *bindings = nullptr);
+std::size_t select_all(const Batch& batch, BatchRow *sel);
+
+#endif  // __FILTER_H__
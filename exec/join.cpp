@@ -0,0 +1,483 @@
+// SimpleSQL: Hash joins
+
+#include "join.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include "../storage/index_key.h"
+#include "morsel.h"
+#include "where.h"
+
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// The most rows of the smaller side in a partition, so that its tuples,
+// heads and links, 24 bytes a row, fit in 256KB of cache
+const size_t PARTITION_ROWS = 1 << 13;
+const int MAX_RADIX_BITS = 12;
+// How many rows ahead of the probing one the buckets are prefetched
+const size_t PREFETCH_DISTANCE = 8;
+// Joined rows are appended to the result this many at a time
+const size_t OUTPUT_ROWS = 4096;
+// A join with no key checks its condition on this many pairs of rows at a
+// time
+const size_t NESTED_LOOP_PAIRS = 1 << 16;
+// Stands for the missing row of an outer join's unmatched row
+const size_t NO_POSITION = SIZE_MAX;
+
+// The hash of a row's key, and the row
+struct Tuple {
+  uint64_t hash;
+  size_t row;
+};
+
+// A row of the left table and a row of the right one
+typedef std::pair<size_t, size_t> RowPair;
+
+// The rows of one table taking part in a join, and its key columns
+struct Side {
+  const Table& table;
+  const vector<size_t>& rows;
+  vector<size_t> columns;
+};
+
+// Returns true if a join on the given keys can hash them as words, which
+// is when there is one key and both its columns hold numbers of one type
+bool word_keys(const Table& left, const Table& right, const vector<JoinKey>& keys) {
+  if (keys.size() != 1) {
+    return false;
+  }
+  PhysicalType type = physical_type(left.schema().column(keys.front().left).type);
+  return !reads_as_string(type)
+    && type == physical_type(right.schema().column(keys.front().right).type);
+}
+
+// Returns a value of a key column in the form keys are hashed and compared
+// in. Numbers that are whole become INT values, or UINT values past the
+// range of INT, so that numbers of different types that compare as equal
+// in filters (see compare_numbers() in filter.cpp) have equal keys.
+Value key_value(const Value& value) {
+  switch (value.type()) {
+  case ValueType::UINT:
+    if (value.uint_value() <= static_cast<unsigned long long>(INT64_MAX)) {
+      return Value(static_cast<long long>(value.uint_value()));
+    }
+    return value;
+  case ValueType::DOUBLE: {
+    const double number = value.double_value();
+    // 2^63 and 2^64, the first numbers past the ranges of INT and UINT
+    const double int_end = 9223372036854775808.0;
+    const double uint_end = 18446744073709551616.0;
+    if (number != std::trunc(number) || number < -int_end || number >= uint_end) {
+      return value;
+    }
+    if (number < int_end) {
+      return Value(static_cast<long long>(number));
+    }
+    return Value(static_cast<unsigned long long>(number));
+  }
+  default:
+    return value;
+  }
+}
+
+// Sets hash to the hash of the key of a row of side, and returns true, or
+// returns false if the key has a NULL and so matches nothing. NaNs match
+// nothing either, and negative zero is hashed as zero, which it equals.
+bool hash_row(const Side& side, size_t row, bool word, string& key, uint64_t& hash) {
+  if (word) {
+    const size_t chunk_rows = side.table.chunk_rows();
+    const ColumnChunk& column = side.table.chunk(row / chunk_rows).column(side.columns.front());
+    const size_t offset = row % chunk_rows;
+    if (column.is_null(offset)) {
+      return false;
+    }
+    uint64_t bits;
+    switch (column.type()) {
+    case PhysicalType::INT64:
+      bits = static_cast<uint64_t>(column.at<std::int64_t>(offset));
+      break;
+    case PhysicalType::UINT64:
+      bits = column.at<uint64_t>(offset);
+      break;
+    default: {
+      double value = column.at<double>(offset);
+      if (std::isnan(value)) {
+	return false;
+      }
+      if (value == 0) {
+	value = 0;
+      }
+      std::memcpy(&bits, &value, sizeof(bits));
+      break;
+    }
+    }
+    hash = hash_word(bits);
+    return true;
+  }
+  key.clear();
+  for (auto it = side.columns.begin(); it != side.columns.end(); ++it) {
+    const Value value = side.table.value(row, *it);
+    if (value.is_null() ||
+	(value.type() == ValueType::DOUBLE && std::isnan(value.double_value()))) {
+      return false;
+    }
+    append_key(key, key_value(value));
+  }
+  hash = hash_key(key.data(), key.size());
+  return true;
+}
+
+// Returns true if the keys of two rows are equal
+bool equal_keys(const Side& one, size_t one_row, const Side& other, size_t other_row) {
+  for (size_t i = 0; i < one.columns.size(); ++i) {
+    const Value a = key_value(one.table.value(one_row, one.columns[i]));
+    const Value b = key_value(other.table.value(other_row, other.columns[i]));
+    if (a.type() != b.type()) {
+      return false;
+    }
+    bool equal;
+    switch (a.type()) {
+    case ValueType::INT:
+      equal = a.int_value() == b.int_value();
+      break;
+    case ValueType::UINT:
+      equal = a.uint_value() == b.uint_value();
+      break;
+    case ValueType::DOUBLE:
+      equal = a.double_value() == b.double_value();
+      break;
+    case ValueType::STRING:
+      equal = a.string_length() == b.string_length()
+	&& std::memcmp(a.string_data(), b.string_data(), a.string_length()) == 0;
+      break;
+    default:
+      equal = false;
+    }
+    if (!equal) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the partition of a hash among 1 << bits partitions
+size_t partition(uint64_t hash, int bits) {
+  return bits == 0 ? 0 : static_cast<size_t>(hash >> (64 - bits));
+}
+
+// Hashes the rows of side and scatters the ones that can match into
+// 1 << bits partitions by the high bits of their hashes, returning the
+// tuples of each partition one after another. Starts is set to where each
+// partition starts, followed by the end of the last.
+//
+// Every morsel of the rows is hashed into tuples of its own while counting
+// how many fall in each partition. The counts give every morsel the place
+// of its tuples in every partition, so the morsels are then scattered
+// without synchronization.
+vector<Tuple> partition_side(const Side& side, bool word, int bits, ThreadPool *pool,
+			     size_t drivers, vector<size_t>& starts) {
+  const size_t partitions = size_t(1) << bits;
+  const size_t morsels = (side.rows.size() + MORSEL_ROWS - 1) / MORSEL_ROWS;
+  vector<vector<Tuple>> hashed(morsels);
+  vector<vector<size_t>> counts(morsels, vector<size_t>(partitions));
+  run_morsels(pool, side.rows.size(), MORSEL_ROWS, drivers, [&](size_t begin, size_t end,
+								size_t) {
+      const size_t morsel = begin / MORSEL_ROWS;
+      vector<Tuple>& tuples = hashed[morsel];
+      tuples.reserve(end - begin);
+      string key;
+      for (size_t i = begin; i < end; ++i) {
+	Tuple tuple;
+	tuple.row = side.rows[i];
+	if (hash_row(side, tuple.row, word, key, tuple.hash)) {
+	  tuples.push_back(tuple);
+	  ++counts[morsel][partition(tuple.hash, bits)];
+	}
+      }
+    });
+
+  // Turn the counts into where each morsel's tuples go in each partition
+  starts.assign(partitions + 1, 0);
+  size_t total = 0;
+  for (size_t part = 0; part < partitions; ++part) {
+    starts[part] = total;
+    for (size_t morsel = 0; morsel < morsels; ++morsel) {
+      const size_t count = counts[morsel][part];
+      counts[morsel][part] = total;
+      total += count;
+    }
+  }
+  starts[partitions] = total;
+
+  vector<Tuple> tuples(total);
+  run_morsels(pool, morsels, 1, drivers, [&](size_t morsel, size_t, size_t) {
+      vector<size_t>& next = counts[morsel];
+      const vector<Tuple>& from = hashed[morsel];
+      for (auto it = from.begin(); it != from.end(); ++it) {
+	tuples[next[partition(it->hash, bits)]++] = *it;
+      }
+      vector<Tuple>().swap(hashed[morsel]);
+    });
+  return tuples;
+}
+
+// The hash table over the tuples of one partition of the building side,
+// reused from partition to partition by a driver. Chains of tuples with a
+// bucket in common are linked by position plus one, so that 0 ends them.
+class PartitionTable {
+ public:
+  PartitionTable() : _mask(0) {}
+  void build(const Tuple *tuples, size_t count);
+  template <typename Match>
+  void probe(const Tuple *tuples, const Tuple *probes, size_t count, Match match) const;
+ private:
+  PartitionTable(const PartitionTable&) = delete;
+  PartitionTable& operator=(const PartitionTable&) = delete;
+
+  uint64_t _mask;
+  vector<uint32_t> _heads;
+  vector<uint32_t> _links;
+};
+
+// Builds the table over count tuples, with a bucket or more per tuple
+void PartitionTable::build(const Tuple *tuples, size_t count) {
+  size_t buckets = 1;
+  while (buckets < count) {
+    buckets <<= 1;
+  }
+  _mask = buckets - 1;
+  _heads.assign(buckets, 0);
+  _links.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t& head = _heads[tuples[i].hash & _mask];
+    _links[i] = head;
+    head = static_cast<uint32_t>(i + 1);
+  }
+}
+
+// Calls match with every probe and every tuple the table was built over
+// whose hash equals the probe's, prefetching the bucket of the probe
+// PREFETCH_DISTANCE ahead while the chain of the current one is walked
+template <typename Match>
+void PartitionTable::probe(const Tuple *tuples, const Tuple *probes, size_t count,
+			   Match match) const {
+  for (size_t i = 0; i < count; ++i) {
+    if (i + PREFETCH_DISTANCE < count) {
+      __builtin_prefetch(&_heads[probes[i + PREFETCH_DISTANCE].hash & _mask]);
+    }
+    const uint64_t hash = probes[i].hash;
+    for (uint32_t at = _heads[hash & _mask]; at != 0; at = _links[at - 1]) {
+      if (tuples[at - 1].hash == hash) {
+	match(probes[i], tuples[at - 1]);
+      }
+    }
+  }
+}
+
+// Returns a table of the given schema with a row per pair, the columns of
+// the left row followed by those of the right one, which are NULL for
+// NO_POSITION
+unique_ptr<Table> join_rows(const Schema& schema, const Table& left, const Table& right,
+			    const vector<RowPair>& pairs) {
+  const size_t left_columns = left.schema().size();
+  const size_t right_columns = right.schema().size();
+  unique_ptr<Table> result(new Table("join", schema));
+  vector<vector<Value>> output;
+  for (auto it = pairs.begin(); it != pairs.end(); ++it) {
+    vector<Value> values;
+    values.reserve(left_columns + right_columns);
+    for (size_t i = 0; i < left_columns; ++i) {
+      values.push_back(it->first == NO_POSITION ? Value() : left.value(it->first, i));
+    }
+    for (size_t i = 0; i < right_columns; ++i) {
+      values.push_back(it->second == NO_POSITION ? Value() : right.value(it->second, i));
+    }
+    output.push_back(std::move(values));
+    if (output.size() == OUTPUT_ROWS) {
+      result->append(output);
+      output.clear();
+    }
+  }
+  result->append(output);
+  return result;
+}
+
+// Adds a pair for every row of side that no pair has, with NO_POSITION for
+// the row of the other side
+void add_unmatched(const Side& side, bool left, vector<RowPair>& pairs) {
+  vector<bool> matched(side.table.rows());
+  const size_t count = pairs.size();
+  for (size_t i = 0; i < count; ++i) {
+    const size_t row = left ? pairs[i].first : pairs[i].second;
+    if (row != NO_POSITION) {
+      matched[row] = true;
+    }
+  }
+  for (auto it = side.rows.begin(); it != side.rows.end(); ++it) {
+    if (!matched[*it]) {
+      pairs.push_back(left ? RowPair(*it, NO_POSITION) : RowPair(NO_POSITION, *it));
+    }
+  }
+}
+
+// Returns the pairs of a row of left_side and a row of right_side whose
+// keys are equal. Keys are hashed as words if word is set.
+vector<RowPair> hash_pairs(const Side& left_side, const Side& right_side, bool word,
+			   ThreadPool *pool) {
+  // The smaller side builds, the larger probes
+  const bool build_left = left_side.rows.size() <= right_side.rows.size();
+  const Side& build = build_left ? left_side : right_side;
+  const Side& probe = build_left ? right_side : left_side;
+
+  const size_t drivers = morsel_drivers(pool, left_side.rows.size() + right_side.rows.size());
+  // Enough partitions for the smaller side's to fit in cache, and for the
+  // drivers to balance their work between
+  int bits = 0;
+  while (bits < MAX_RADIX_BITS && (build.rows.size() >> bits) > PARTITION_ROWS) {
+    ++bits;
+  }
+  while (bits < MAX_RADIX_BITS && drivers > 1 && (size_t(1) << bits) < drivers * 4) {
+    ++bits;
+  }
+  const size_t partitions = size_t(1) << bits;
+
+  vector<size_t> build_starts, probe_starts;
+  const vector<Tuple> build_tuples = partition_side(build, word, bits, pool, drivers,
+						    build_starts);
+  const vector<Tuple> probe_tuples = partition_side(probe, word, bits, pool, drivers,
+						    probe_starts);
+
+  // Partitions are the morsels of this phase, and every driver builds its
+  // partitions in a table of its own
+  vector<vector<RowPair>> matches(partitions);
+  const size_t join_drivers = std::min(drivers, partitions);
+  vector<PartitionTable> tables(join_drivers);
+  run_morsels(pool, partitions, 1, join_drivers, [&](size_t part, size_t, size_t driver) {
+      const size_t build_size = build_starts[part + 1] - build_starts[part];
+      const size_t probe_size = probe_starts[part + 1] - probe_starts[part];
+      if (build_size == 0 || probe_size == 0) {
+	return;
+      }
+      const Tuple *tuples = build_tuples.data() + build_starts[part];
+      vector<RowPair>& found = matches[part];
+      PartitionTable& table = tables[driver];
+      table.build(tuples, build_size);
+      table.probe(tuples, probe_tuples.data() + probe_starts[part], probe_size,
+		  [&](const Tuple& from, const Tuple& to) {
+		    if (word || equal_keys(probe, from.row, build, to.row)) {
+		      found.push_back(build_left ? RowPair(to.row, from.row)
+				      : RowPair(from.row, to.row));
+		    }
+		  });
+    });
+  vector<RowPair> pairs;
+  size_t total = 0;
+  for (auto it = matches.begin(); it != matches.end(); ++it) {
+    total += it->size();
+  }
+  pairs.reserve(total);
+  for (auto it = matches.begin(); it != matches.end(); ++it) {
+    pairs.insert(pairs.end(), it->begin(), it->end());
+    vector<RowPair>().swap(*it);
+  }
+  return pairs;
+}
+
+// Appends the pairs of block for which condition is true to pairs, and
+// clears block
+void filter_pairs(const Schema& schema, const Side& left, const Side& right,
+		  const Expression *condition, const vector<Value>& parameters,
+		  const ExpressionColumns *bindings, ThreadPool *pool, vector<RowPair>& block,
+		  vector<RowPair>& pairs) {
+  unique_ptr<Table> candidates = join_rows(schema, left.table, right.table, block);
+  vector<size_t> kept;
+  select_rows(*candidates, condition, parameters, kept, bindings, pool);
+  for (auto it = kept.begin(); it != kept.end(); ++it) {
+    pairs.push_back(block[*it]);
+  }
+  block.clear();
+}
+
+// Returns every pair of a row of left and a row of right for which
+// condition is true, for joins whose condition has no key to hash. The
+// pairs are checked NESTED_LOOP_PAIRS at a time, so that only so many are
+// ever joined at once.
+vector<RowPair> nested_loop(const Schema& schema, const Side& left, const Side& right,
+			    const Expression *condition, const vector<Value>& parameters,
+			    const ExpressionColumns *bindings, ThreadPool *pool) {
+  vector<RowPair> pairs;
+  vector<RowPair> block;
+  block.reserve(std::min(NESTED_LOOP_PAIRS, left.rows.size() * right.rows.size()));
+  for (auto l = left.rows.begin(); l != left.rows.end(); ++l) {
+    for (auto r = right.rows.begin(); r != right.rows.end(); ++r) {
+      block.push_back(RowPair(*l, *r));
+      if (block.size() == NESTED_LOOP_PAIRS) {
+	filter_pairs(schema, left, right, condition, parameters, bindings, pool, block, pairs);
+      }
+    }
+  }
+  if (!block.empty()) {
+    filter_pairs(schema, left, right, condition, parameters, bindings, pool, block, pairs);
+  }
+  return pairs;
+}
+
+}  // namespace
+
+// Joins the given rows of left and right, which must not be deleted, and
+// returns the joined rows in a table of the given schema, whose columns are
+// those of left followed by those of right. Rows match when the columns of
+// every key are equal and condition, if not null, is true for the joined
+// row. With no keys, every pair of rows is checked against condition
+// instead. Condition is evaluated on the joined rows, with the values of its
+// placeholders taken from parameters and its expressions in bindings
+// standing for the columns they are bound to. Runs on the threads of pool,
+// or on the calling thread only if pool is null. Throws a StorageError if
+// the condition cannot be evaluated.
+unique_ptr<Table> join_tables(const Schema& schema, JoinKind kind, const Table& left,
+			      const vector<size_t>& left_rows, const Table& right,
+			      const vector<size_t>& right_rows, const vector<JoinKey>& keys,
+			      const Expression *condition, const vector<Value>& parameters,
+			      const ExpressionColumns *bindings, ThreadPool *pool) {
+  Side left_side{left, left_rows, {}};
+  Side right_side{right, right_rows, {}};
+  for (auto it = keys.begin(); it != keys.end(); ++it) {
+    left_side.columns.push_back(it->left);
+    right_side.columns.push_back(it->right);
+  }
+  vector<RowPair> pairs;
+  if (keys.empty()) {
+    pairs = nested_loop(schema, left_side, right_side, condition, parameters, bindings, pool);
+  } else {
+    pairs = hash_pairs(left_side, right_side, word_keys(left, right, keys), pool);
+  }
+  if (condition && !keys.empty()) {
+    unique_ptr<Table> candidates = join_rows(schema, left, right, pairs);
+    vector<size_t> kept;
+    select_rows(*candidates, condition, parameters, kept, bindings, pool);
+    if (kind == JoinKind::INNER && kept.size() == pairs.size()) {
+      return candidates;
+    }
+    for (size_t i = 0; i < kept.size(); ++i) {
+      pairs[i] = pairs[kept[i]];
+    }
+    pairs.resize(kept.size());
+  }
+  if (kind == JoinKind::LEFT || kind == JoinKind::FULL) {
+    add_unmatched(left_side, true, pairs);
+  }
+  if (kind == JoinKind::RIGHT || kind == JoinKind::FULL) {
+    add_unmatched(right_side, false, pairs);
+  }
+  return join_rows(schema, left, right, pairs);
+}
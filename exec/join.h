@@ -0,0 +1,55 @@
+// SimpleSQL: Hash joins
+//
+// Joins two tables on equalities between their columns with a radix
+// partitioned hash join. The rows of both sides are first scattered into
+// partitions by the high bits of the hashes of their keys, into enough
+// partitions that the hash table over one partition of the smaller side
+// fits in the CPU's cache. The partitions are then joined independently, as
+// the morsels of the drivers of morsel.h: a chained hash table is built
+// over the smaller side's partition, and the other side's partition probes
+// it, prefetching the buckets of the rows a few ahead. Every random access
+// of the build and the probe falls within one partition's table, so they
+// hit the cache rather than memory however large the tables are.
+//
+// A key of one numeric column, whose columns on both sides have the same
+// type, is its 64 bits, hashed with a bijection, so rows whose hashes are
+// equal have equal keys and keys are never compared. Other keys are hashed
+// as index keys (see index_key.h), and their values compared when their
+// hashes are equal. Numbers are first put in one form whatever their type,
+// so that an INT equals the DOUBLE or UNSIGNED of the same value, as it
+// does in filters. Rows with a NULL in their key match nothing.
+//
+// A condition with no equality between columns of the two sides is
+// checked on every pair of rows by a nested loop instead.
+//
+// Conditions of the ON clause besides the key equalities are checked on
+// the pairs of rows the keys match, with the filters of filter.h. Outer
+// joins then mark the rows of each side that are still matched, and add
+// the others with NULLs for the columns of the other side.
+
+#ifndef __JOIN_H__
+#define __JOIN_H__
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "../AST/select.h"
+#include "../storage/table.h"
+#include "../util/thread_pool.h"
+#include "filter.h"
+
+// A column of each side whose values must be equal for rows to match. Both
+// columns must hold numbers, or both strings.
+struct JoinKey {
+  std::size_t left;
+  std::size_t right;
+};
+
+std::unique_ptr<Table> join_tables(const Schema& schema, JoinKind kind, const Table& left,
+				   const std::vector<std::size_t>& left_rows, const Table& right,
+				   const std::vector<std::size_t>& right_rows,
+				   const std::vector<JoinKey>& keys, const Expression *condition,
+				   const std::vector<Value>& parameters,
+				   const ExpressionColumns *bindings, ThreadPool *pool);
+
+#endif  // __JOIN_H__
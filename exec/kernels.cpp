@@ -0,0 +1,465 @@
+// SimpleSQL: Comparison kernels
+//
+// Operators are types whose apply() compares two values, and operand
+// shapes are types indexed like arrays, so one template per implementation
+// covers every combination. The scalar kernels build each word of the
+// bitmap from 64 comparisons; the AVX2 kernels from 16 comparisons of four
+// values, or two of 32 ENUM codes, using the sign bit masks of the results,
+// and likewise from comparisons of 8 or 16 codes of encoded columns.
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMPLESQL_X86_KERNELS
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+using std::int64_t;
+using std::size_t;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace {
+
+#ifdef SIMPLESQL_X86_KERNELS
+
+/*------------------------------------------------
+  AVX2 lanes
+  ----------------------------------------------*/
+
+// WIDTH values of type T in a vector, and their comparisons as masks with
+// a bit per value
+template <typename T>
+struct Lanes;
+
+template <>
+struct Lanes<int64_t> {
+  typedef __m256i Vector;
+  static const size_t WIDTH = 4;
+  AVX2_TARGET static Vector load(const int64_t *values) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values));
+  }
+  AVX2_TARGET static Vector broadcast(int64_t value) {
+    return _mm256_set1_epi64x(value);
+  }
+  AVX2_TARGET static int equal(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b)));
+  }
+  AVX2_TARGET static int greater(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b)));
+  }
+  AVX2_TARGET static int not_equal(Vector a, Vector b) {
+    return equal(a, b) ^ 0xf;
+  }
+  AVX2_TARGET static int less(Vector a, Vector b) {
+    return greater(b, a);
+  }
+  AVX2_TARGET static int greater_equal(Vector a, Vector b) {
+    return greater(b, a) ^ 0xf;
+  }
+  AVX2_TARGET static int less_equal(Vector a, Vector b) {
+    return greater(a, b) ^ 0xf;
+  }
+};
+
+// Unsigned values are compared as signed ones with their sign bits
+// flipped, which keeps their order
+template <>
+struct Lanes<uint64_t> : Lanes<int64_t> {
+  AVX2_TARGET static Vector load(const uint64_t *values) {
+    return _mm256_xor_si256(Lanes<int64_t>::load(reinterpret_cast<const int64_t *>(values)),
+			    _mm256_set1_epi64x(INT64_MIN));
+  }
+  AVX2_TARGET static Vector broadcast(uint64_t value) {
+    return _mm256_set1_epi64x(static_cast<int64_t>(value ^ (1ULL << 63)));
+  }
+};
+
+// ENUM codes, 32 to a vector. Like unsigned words, they are compared as
+// signed bytes with their sign bits flipped.
+template <>
+struct Lanes<uint8_t> {
+  typedef __m256i Vector;
+  static const size_t WIDTH = 32;
+  AVX2_TARGET static Vector load(const uint8_t *values) {
+    return _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)),
+			    _mm256_set1_epi8(INT8_MIN));
+  }
+  AVX2_TARGET static Vector broadcast(uint8_t value) {
+    return _mm256_set1_epi8(static_cast<char>(value ^ 0x80));
+  }
+  AVX2_TARGET static int equal(Vector a, Vector b) {
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+  }
+  AVX2_TARGET static int greater(Vector a, Vector b) {
+    return _mm256_movemask_epi8(_mm256_cmpgt_epi8(a, b));
+  }
+  AVX2_TARGET static int not_equal(Vector a, Vector b) {
+    return ~equal(a, b);
+  }
+  AVX2_TARGET static int less(Vector a, Vector b) {
+    return greater(b, a);
+  }
+  AVX2_TARGET static int greater_equal(Vector a, Vector b) {
+    return ~greater(b, a);
+  }
+  AVX2_TARGET static int less_equal(Vector a, Vector b) {
+    return ~greater(a, b);
+  }
+};
+
+// Codes of encoded columns, 16 to a vector. The comparisons of two lanes
+// are packed into one byte each for their masks.
+template <>
+struct Lanes<uint16_t> {
+  typedef __m256i Vector;
+  static const size_t WIDTH = 16;
+  AVX2_TARGET static Vector load(const uint16_t *values) {
+    return _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)),
+			    _mm256_set1_epi16(INT16_MIN));
+  }
+  AVX2_TARGET static Vector broadcast(uint16_t value) {
+    return _mm256_set1_epi16(static_cast<short>(value ^ 0x8000));
+  }
+  AVX2_TARGET static int mask(Vector comparison) {
+    int bytes = _mm256_movemask_epi8(_mm256_packs_epi16(comparison, _mm256_setzero_si256()));
+    return (bytes & 0xff) | ((bytes >> 8) & 0xff00);
+  }
+  AVX2_TARGET static int equal(Vector a, Vector b) {
+    return mask(_mm256_cmpeq_epi16(a, b));
+  }
+  AVX2_TARGET static int greater(Vector a, Vector b) {
+    return mask(_mm256_cmpgt_epi16(a, b));
+  }
+  AVX2_TARGET static int not_equal(Vector a, Vector b) {
+    return equal(a, b) ^ 0xffff;
+  }
+  AVX2_TARGET static int less(Vector a, Vector b) {
+    return greater(b, a);
+  }
+  AVX2_TARGET static int greater_equal(Vector a, Vector b) {
+    return greater(b, a) ^ 0xffff;
+  }
+  AVX2_TARGET static int less_equal(Vector a, Vector b) {
+    return greater(a, b) ^ 0xffff;
+  }
+};
+
+// Codes of encoded columns, eight to a vector
+template <>
+struct Lanes<uint32_t> {
+  typedef __m256i Vector;
+  static const size_t WIDTH = 8;
+  AVX2_TARGET static Vector load(const uint32_t *values) {
+    return _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)),
+			    _mm256_set1_epi32(INT32_MIN));
+  }
+  AVX2_TARGET static Vector broadcast(uint32_t value) {
+    return _mm256_set1_epi32(static_cast<int>(value ^ 0x80000000u));
+  }
+  AVX2_TARGET static int equal(Vector a, Vector b) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+  }
+  AVX2_TARGET static int greater(Vector a, Vector b) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)));
+  }
+  AVX2_TARGET static int not_equal(Vector a, Vector b) {
+    return equal(a, b) ^ 0xff;
+  }
+  AVX2_TARGET static int less(Vector a, Vector b) {
+    return greater(b, a);
+  }
+  AVX2_TARGET static int greater_equal(Vector a, Vector b) {
+    return greater(b, a) ^ 0xff;
+  }
+  AVX2_TARGET static int less_equal(Vector a, Vector b) {
+    return greater(a, b) ^ 0xff;
+  }
+};
+
+// Ordered predicates, except for not equal, match C++'s comparisons of
+// NaN
+template <>
+struct Lanes<double> {
+  typedef __m256d Vector;
+  static const size_t WIDTH = 4;
+  AVX2_TARGET static Vector load(const double *values) {
+    return _mm256_loadu_pd(values);
+  }
+  AVX2_TARGET static Vector broadcast(double value) {
+    return _mm256_set1_pd(value);
+  }
+  AVX2_TARGET static int equal(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+  }
+  AVX2_TARGET static int not_equal(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ));
+  }
+  AVX2_TARGET static int greater(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+  }
+  AVX2_TARGET static int less(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+  }
+  AVX2_TARGET static int greater_equal(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ));
+  }
+  AVX2_TARGET static int less_equal(Vector a, Vector b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ));
+  }
+};
+
+#define LANES(name)							\
+  template <typename L>							\
+  AVX2_TARGET static int lanes(typename L::Vector a, typename L::Vector b) { \
+    return L::name(a, b);						\
+  }
+#else
+#define LANES(name)
+#endif  // SIMPLESQL_X86_KERNELS
+
+/*------------------------------------------------
+  Operators and operands
+  ----------------------------------------------*/
+
+struct Equal {
+  template <typename T>
+  static bool apply(T a, T b) { return a == b; }
+  LANES(equal)
+};
+
+struct NotEqual {
+  template <typename T>
+  static bool apply(T a, T b) { return a != b; }
+  LANES(not_equal)
+};
+
+struct Greater {
+  template <typename T>
+  static bool apply(T a, T b) { return a > b; }
+  LANES(greater)
+};
+
+struct Less {
+  template <typename T>
+  static bool apply(T a, T b) { return a < b; }
+  LANES(less)
+};
+
+struct GreaterEqual {
+  template <typename T>
+  static bool apply(T a, T b) { return a >= b; }
+  LANES(greater_equal)
+};
+
+struct LessEqual {
+  template <typename T>
+  static bool apply(T a, T b) { return a <= b; }
+  LANES(less_equal)
+};
+
+// The same value for every row
+template <typename T>
+struct ConstantOperand {
+  T value;
+  T operator[](size_t) const { return value; }
+  ConstantOperand from(size_t) const { return *this; }
+#ifdef SIMPLESQL_X86_KERNELS
+  template <typename L>
+  AVX2_TARGET typename L::Vector lanes(size_t) const { return L::broadcast(value); }
+#endif
+};
+
+// The values of a column
+template <typename T>
+struct ColumnOperand {
+  const T *values;
+  T operator[](size_t row) const { return values[row]; }
+  ColumnOperand from(size_t row) const { return ColumnOperand{values + row}; }
+#ifdef SIMPLESQL_X86_KERNELS
+  template <typename L>
+  AVX2_TARGET typename L::Vector lanes(size_t row) const { return L::load(values + row); }
+#endif
+};
+
+/*------------------------------------------------
+  Kernels
+  ----------------------------------------------*/
+
+template <typename Op, typename T, typename Right>
+void compare_scalar(const T *left, Right right, size_t rows, uint64_t *bits) {
+  size_t words = rows / 64;
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t word = 0;
+    for (size_t j = 0; j < 64; ++j) {
+      word |= static_cast<uint64_t>(Op::apply(left[w * 64 + j], right[w * 64 + j])) << j;
+    }
+    bits[w] = word;
+  }
+  if (rows % 64 != 0) {
+    uint64_t word = 0;
+    for (size_t j = 0; j < rows % 64; ++j) {
+      word |= static_cast<uint64_t>(Op::apply(left[words * 64 + j], right[words * 64 + j])) << j;
+    }
+    bits[words] = word;
+  }
+}
+
+template <typename Op, typename T>
+void constant_scalar(const T *values, T constant, size_t rows, uint64_t *bits) {
+  compare_scalar<Op>(values, ConstantOperand<T>{constant}, rows, bits);
+}
+
+template <typename Op, typename T>
+void column_scalar(const T *left, const T *right, size_t rows, uint64_t *bits) {
+  compare_scalar<Op>(left, ColumnOperand<T>{right}, rows, bits);
+}
+
+#ifdef SIMPLESQL_X86_KERNELS
+
+// Rows past the last full word are compared by the scalar kernel
+template <typename Op, typename T, typename Right>
+AVX2_TARGET void compare_avx2(const T *left, Right right, size_t rows, uint64_t *bits) {
+  typedef Lanes<T> L;
+  size_t words = rows / 64;
+  for (size_t w = 0; w < words; ++w) {
+    const size_t first = w * 64;
+    uint64_t word = 0;
+    for (size_t j = 0; j < 64; j += L::WIDTH) {
+      int mask = Op::template lanes<L>(L::load(left + first + j),
+				       right.template lanes<L>(first + j));
+      word |= static_cast<uint64_t>(static_cast<uint32_t>(mask)) << j;
+    }
+    bits[w] = word;
+  }
+  if (rows % 64 != 0) {
+    compare_scalar<Op>(left + words * 64, right.from(words * 64), rows % 64, bits + words);
+  }
+}
+
+template <typename Op, typename T>
+AVX2_TARGET void constant_avx2(const T *values, T constant, size_t rows, uint64_t *bits) {
+  compare_avx2<Op>(values, ConstantOperand<T>{constant}, rows, bits);
+}
+
+template <typename Op, typename T>
+AVX2_TARGET void column_avx2(const T *left, const T *right, size_t rows, uint64_t *bits) {
+  compare_avx2<Op>(left, ColumnOperand<T>{right}, rows, bits);
+}
+
+#endif  // SIMPLESQL_X86_KERNELS
+
+/*------------------------------------------------
+  Selection
+  ----------------------------------------------*/
+
+// Returns true if the CPU supports the given implementation
+bool supported(KernelLevel level) {
+  switch (level) {
+  case KernelLevel::SCALAR:
+    return true;
+#ifdef SIMPLESQL_X86_KERNELS
+  case KernelLevel::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+// The implementation in use, selected on first use
+KernelLevel& selected_level() {
+  static KernelLevel level = supported(KernelLevel::AVX2) ? KernelLevel::AVX2
+    : KernelLevel::SCALAR;
+  return level;
+}
+
+template <typename Op, typename T>
+ConstantKernel<T> constant_kernel_of() {
+#ifdef SIMPLESQL_X86_KERNELS
+  if (selected_level() == KernelLevel::AVX2) {
+    return constant_avx2<Op, T>;
+  }
+#endif
+  return constant_scalar<Op, T>;
+}
+
+template <typename Op, typename T>
+ColumnKernel<T> column_kernel_of() {
+#ifdef SIMPLESQL_X86_KERNELS
+  if (selected_level() == KernelLevel::AVX2) {
+    return column_avx2<Op, T>;
+  }
+#endif
+  return column_scalar<Op, T>;
+}
+
+}  // namespace
+
+// Returns the kernel comparing values with a constant using op, which must
+// be a comparison operator
+template <typename T>
+ConstantKernel<T> constant_kernel(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return constant_kernel_of<Equal, T>();
+  case BinaryOp::NEQUAL:
+    return constant_kernel_of<NotEqual, T>();
+  case BinaryOp::GTHAN:
+    return constant_kernel_of<Greater, T>();
+  case BinaryOp::LTHAN:
+    return constant_kernel_of<Less, T>();
+  case BinaryOp::GEQ:
+    return constant_kernel_of<GreaterEqual, T>();
+  default:
+    return constant_kernel_of<LessEqual, T>();
+  }
+}
+
+// Returns the kernel comparing the values of two columns using op, which
+// must be a comparison operator
+template <typename T>
+ColumnKernel<T> column_kernel(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return column_kernel_of<Equal, T>();
+  case BinaryOp::NEQUAL:
+    return column_kernel_of<NotEqual, T>();
+  case BinaryOp::GTHAN:
+    return column_kernel_of<Greater, T>();
+  case BinaryOp::LTHAN:
+    return column_kernel_of<Less, T>();
+  case BinaryOp::GEQ:
+    return column_kernel_of<GreaterEqual, T>();
+  default:
+    return column_kernel_of<LessEqual, T>();
+  }
+}
+
+template ConstantKernel<int64_t> constant_kernel<int64_t>(BinaryOp op);
+template ConstantKernel<uint64_t> constant_kernel<uint64_t>(BinaryOp op);
+template ConstantKernel<double> constant_kernel<double>(BinaryOp op);
+template ConstantKernel<uint8_t> constant_kernel<uint8_t>(BinaryOp op);
+template ConstantKernel<uint16_t> constant_kernel<uint16_t>(BinaryOp op);
+template ConstantKernel<uint32_t> constant_kernel<uint32_t>(BinaryOp op);
+template ColumnKernel<int64_t> column_kernel<int64_t>(BinaryOp op);
+template ColumnKernel<uint64_t> column_kernel<uint64_t>(BinaryOp op);
+template ColumnKernel<double> column_kernel<double>(BinaryOp op);
+template ColumnKernel<uint8_t> column_kernel<uint8_t>(BinaryOp op);
+
+// Returns the implementation currently in use
+KernelLevel kernel_level() {
+  return selected_level();
+}
+
+// Switches to the given implementation if the CPU supports it
+bool set_kernel_level(KernelLevel level) {
+  if (!supported(level)) {
+    return false;
+  }
+  selected_level() = level;
+  return true;
+}
@@ -0,0 +1,53 @@
+// SimpleSQL: Comparison kernels
+//
+// The inner loops of the filters that compare fixed-width columns. A
+// kernel compares a run of consecutive values with a constant, or with the
+// values of another column, and writes one bit per value to a bitmap, bit
+// i % 64 of word i / 64 set if value i satisfies the operator. Kernels are
+// instantiated at compile time for every column type, operator and operand
+// shape, so their loops have no branches or switches and can be
+// vectorized; the operator is chosen once, when a condition is compiled.
+//
+// On x86 the kernels also have explicit AVX2 versions, comparing four
+// words, or 32 ENUM codes, per instruction. The widest implementation the CPU
+// supports is selected the first time a kernel is looked up, and can be
+// changed with set_kernel_level(), which benchmarks use to compare them.
+// Kernels already looked up are not affected.
+
+#ifndef __KERNELS_H__
+#define __KERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "../AST/expression.h"
+
+// The implementations of the kernels that can be selected
+enum class KernelLevel {
+  SCALAR,
+  AVX2
+};
+
+// Compares rows values with constant
+template <typename T>
+using ConstantKernel = void (*)(const T *values, T constant, std::size_t rows,
+				std::uint64_t *bits);
+
+// Compares rows values of left with the values of right
+template <typename T>
+using ColumnKernel = void (*)(const T *left, const T *right, std::size_t rows,
+			      std::uint64_t *bits);
+
+// Returns the kernel for a comparison operator. T is one of std::int64_t,
+// std::uint64_t, double and std::uint8_t, the type of ENUM codes, and for
+// constant kernels also std::uint16_t and std::uint32_t, which with
+// std::uint8_t are the types of the codes of encoded columns (see
+// encoding.h).
+template <typename T>
+ConstantKernel<T> constant_kernel(BinaryOp op);
+template <typename T>
+ColumnKernel<T> column_kernel(BinaryOp op);
+
+KernelLevel kernel_level();
+bool set_kernel_level(KernelLevel level);
+
+#endif  // __KERNELS_H__
@@ -0,0 +1,64 @@
+// SimpleSQL: Morsel-driven scheduling
+
+#include "morsel.h"
+#include <algorithm>
+#include <atomic>
+
+using std::size_t;
+
+// Returns how many drivers to run count items on in morsels of the given
+// size: one per morsel, but no more than the pool has workers, and one if
+// there is no pool
+size_t morsel_drivers(const ThreadPool *pool, size_t count, size_t morsel) {
+  if (!pool) {
+    return 1;
+  }
+  const size_t morsels = (count + morsel - 1) / morsel;
+  return std::max<size_t>(1, std::min(pool->size(), morsels));
+}
+
+// Calls body with every morsel of [0, count), on the given number of
+// drivers, which must be at least 1, and returns once they are all done.
+// Every driver requeues itself after each morsel. Runs on the calling
+// thread alone if pool is null or there is one driver. Rethrows the first
+// exception body throws, after the drivers have stopped.
+void run_morsels(ThreadPool *pool, size_t count, size_t morsel, size_t drivers,
+		 const MorselBody& body) {
+  if (!pool || drivers <= 1) {
+    for (size_t begin = 0; begin < count; begin += morsel) {
+      body(begin, std::min(count, begin + morsel), 0);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  TaskGroup group(pool);
+  std::function<void(size_t)> drive = [&](size_t driver) {
+    const size_t begin = next.fetch_add(morsel);
+    if (begin >= count) {
+      return;
+    }
+    body(begin, std::min(count, begin + morsel), driver);
+    group.run([&drive, driver]() { drive(driver); });
+  };
+  for (size_t driver = 0; driver < drivers; ++driver) {
+    group.run([&drive, driver]() { drive(driver); });
+  }
+  group.wait();
+}
+
+// Calls task with every number below count, as tasks of pool, and returns
+// once they are all done. Runs on the calling thread alone if pool is null
+// or count is 1. Rethrows the first exception a task throws.
+void run_tasks(ThreadPool *pool, size_t count, const std::function<void(size_t)>& task) {
+  if (!pool || count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+  TaskGroup group(pool);
+  for (size_t i = 0; i < count; ++i) {
+    group.run([&task, i]() { task(i); });
+  }
+  group.wait();
+}
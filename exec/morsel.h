@@ -0,0 +1,37 @@
+// SimpleSQL: Morsel-driven scheduling
+//
+// Runs the parallel parts of a query on the threads of a pool. Work over
+// rows is split into morsels of MORSEL_ROWS rows, and a few drivers, no
+// more than there are workers, take the next morsel until none are left.
+// A driver is a task that runs one morsel and then queues itself again
+// behind the tasks already waiting, so the drivers of queries that share
+// the pool take turns a morsel at a time, and none of them holds a worker
+// for longer than a morsel. Stealing (see thread_pool.h) moves drivers to
+// the workers that are free, so fast and slow morsels balance out.
+//
+// A driver runs its morsels one at a time, so it may keep state of its own,
+// such as the hash table a share of the rows is aggregated into. The
+// pipeline breakers, such as the build of a join, the end of aggregation
+// and the runs of a sort, wait for every driver of their input before
+// they start.
+
+#ifndef __MORSEL_H__
+#define __MORSEL_H__
+
+#include <cstddef>
+#include <functional>
+#include "../util/thread_pool.h"
+
+// The rows in a morsel
+const std::size_t MORSEL_ROWS = 1 << 16;
+
+// Runs a morsel of [begin, end) on a driver
+typedef std::function<void(std::size_t begin, std::size_t end, std::size_t driver)> MorselBody;
+
+std::size_t morsel_drivers(const ThreadPool *pool, std::size_t count,
+			   std::size_t morsel = MORSEL_ROWS);
+void run_morsels(ThreadPool *pool, std::size_t count, std::size_t morsel, std::size_t drivers,
+		 const MorselBody& body);
+void run_tasks(ThreadPool *pool, std::size_t count, const std::function<void(std::size_t)>& task);
+
+#endif  // __MORSEL_H__
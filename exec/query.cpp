@@ -0,0 +1,788 @@
+// SimpleSQL: Query execution
+
+#include "query.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include "../AST/visitor.h"
+#include "../storage/catalog.h"
+#include "aggregate.h"
+#include "join.h"
+#include "sort.h"
+#include "where.h"
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Result rows are appended this many at a time
+const size_t OUTPUT_ROWS = 4096;
+
+// The kinds of expression that can be selected
+enum class ItemKind {
+  COLUMN,
+  CONSTANT,
+  AGGREGATE
+};
+
+// A selected expression, or an operand of one
+struct Item {
+  ItemKind kind;
+  // The name of a column
+  string column;
+  // The value of a constant
+  Value value;
+  const AggregateExpr *aggregate;
+  // The heading of the item's column in the result
+  string heading;
+};
+
+// Returns the name of an aggregate function
+const char *function_name(AggregateFunction function) {
+  switch (function) {
+  case AggregateFunction::COUNT:
+    return "COUNT";
+  case AggregateFunction::SUM:
+    return "SUM";
+  case AggregateFunction::MIN:
+    return "MIN";
+  case AggregateFunction::MAX:
+    return "MAX";
+  default:
+    return "AVG";
+  }
+}
+
+// Reads expressions as the items they select
+class ItemReader : public Visitor {
+ public:
+  explicit ItemReader(const vector<Value>& parameters);
+  Item read(const Expression *expression);
+  void visitLiteral(const Literal& node);
+  void visitPlaceholder(const Placeholder& node);
+  void visitColumnRef(const ColumnRef& node);
+  void visitBinaryExpr(const BinaryExpr& node);
+  void visitNotExpr(const NotExpr& node);
+  void visitBetweenExpr(const BetweenExpr& node);
+  void visitInExpr(const InExpr& node);
+  void visitIsNullExpr(const IsNullExpr& node);
+  void visitAggregateExpr(const AggregateExpr& node);
+ private:
+  void condition();
+
+  const vector<Value>& _parameters;
+  Item _item;
+};
+
+ItemReader::ItemReader(const vector<Value>& parameters) : _parameters(parameters) {}
+
+// Returns the item an expression selects. Throws a StorageError if the
+// expression cannot be selected.
+Item ItemReader::read(const Expression *expression) {
+  expression->accept(*this);
+  return _item;
+}
+
+void ItemReader::visitLiteral(const Literal& node) {
+  _item = Item{ItemKind::CONSTANT, string(), node.value(), nullptr, node.value().toString()};
+}
+
+void ItemReader::visitPlaceholder(const Placeholder& node) {
+  if (node.index() >= _parameters.size()) {
+    throw StorageError("No value for parameter " + std::to_string(node.index() + 1));
+  }
+  const Value& value = _parameters[node.index()];
+  _item = Item{ItemKind::CONSTANT, string(), value, nullptr, value.toString()};
+}
+
+void ItemReader::visitColumnRef(const ColumnRef& node) {
+  _item = Item{ItemKind::COLUMN, node.name().str(), Value(), nullptr, node.name().str()};
+}
+
+void ItemReader::visitBinaryExpr(const BinaryExpr& node) {
+  condition();
+}
+
+void ItemReader::visitNotExpr(const NotExpr& node) {
+  condition();
+}
+
+void ItemReader::visitBetweenExpr(const BetweenExpr& node) {
+  condition();
+}
+
+void ItemReader::visitInExpr(const InExpr& node) {
+  condition();
+}
+
+void ItemReader::visitIsNullExpr(const IsNullExpr& node) {
+  condition();
+}
+
+// The heading of an aggregate is written the way it is in SQL
+void ItemReader::visitAggregateExpr(const AggregateExpr& node) {
+  string argument = "*";
+  if (node.argument()) {
+    argument = read(node.argument()).heading;
+  }
+  string heading = string(function_name(node.function())) + "(" +
+    (node.distinct() ? "DISTINCT " : "") + argument + ")";
+  _item = Item{ItemKind::AGGREGATE, string(), Value(), &node, heading};
+}
+
+// Conditions are only evaluated in WHERE and HAVING clauses
+void ItemReader::condition() {
+  throw StorageError("Conditions cannot be selected");
+}
+
+// Finds the aggregates in a condition
+class AggregateFinder : public Visitor {
+ public:
+  vector<const AggregateExpr*> find(const Expression *condition);
+  void visitBinaryExpr(const BinaryExpr& node);
+  void visitNotExpr(const NotExpr& node);
+  void visitBetweenExpr(const BetweenExpr& node);
+  void visitInExpr(const InExpr& node);
+  void visitIsNullExpr(const IsNullExpr& node);
+  void visitAggregateExpr(const AggregateExpr& node);
+ private:
+  vector<const AggregateExpr*> _aggregates;
+};
+
+// Returns the aggregates in condition, in the order they are written
+vector<const AggregateExpr*> AggregateFinder::find(const Expression *condition) {
+  _aggregates.clear();
+  condition->accept(*this);
+  return _aggregates;
+}
+
+void AggregateFinder::visitBinaryExpr(const BinaryExpr& node) {
+  node.left()->accept(*this);
+  node.right()->accept(*this);
+}
+
+void AggregateFinder::visitNotExpr(const NotExpr& node) {
+  node.operand()->accept(*this);
+}
+
+void AggregateFinder::visitBetweenExpr(const BetweenExpr& node) {
+  node.value()->accept(*this);
+  node.low()->accept(*this);
+  node.high()->accept(*this);
+}
+
+void AggregateFinder::visitInExpr(const InExpr& node) {
+  node.value()->accept(*this);
+  for (auto it = node.list().begin(); it != node.list().end(); ++it) {
+    (*it)->accept(*this);
+  }
+}
+
+void AggregateFinder::visitIsNullExpr(const IsNullExpr& node) {
+  node.value()->accept(*this);
+}
+
+void AggregateFinder::visitAggregateExpr(const AggregateExpr& node) {
+  _aggregates.push_back(&node);
+}
+
+// The tables of a FROM clause, whose columns are joined into rows in the
+// order of the tables
+class Scope {
+ public:
+  void add(const Table& table);
+  size_t tables() const;
+  const Table& table(size_t index) const;
+  size_t size() const;
+  Schema schema() const;
+  size_t resolve(const string& name) const;
+ private:
+  vector<const Table*> _tables;
+  // The position of each table's first column in the joined rows
+  vector<size_t> _starts;
+  size_t _size = 0;
+};
+
+// Adds a table after the others. Throws a StorageError if it is one of
+// them already, since tables cannot be told apart without aliases.
+void Scope::add(const Table& table) {
+  for (auto it = _tables.begin(); it != _tables.end(); ++it) {
+    if ((*it)->name() == table.name()) {
+      throw StorageError("Table " + table.name() + " is joined twice");
+    }
+  }
+  _tables.push_back(&table);
+  _starts.push_back(_size);
+  _size += table.schema().size();
+}
+
+// Returns the number of tables
+size_t Scope::tables() const {
+  return _tables.size();
+}
+
+// Returns a table by its position in the FROM clause
+const Table& Scope::table(size_t index) const {
+  return *_tables[index];
+}
+
+// Returns the number of columns of every table
+size_t Scope::size() const {
+  return _size;
+}
+
+// Returns the schema of the joined rows, in which every column is named
+// after its table and may be NULL
+Schema Scope::schema() const {
+  Schema schema;
+  for (auto it = _tables.begin(); it != _tables.end(); ++it) {
+    for (size_t i = 0; i < (*it)->schema().size(); ++i) {
+      ColumnSchema column = (*it)->schema().column(i);
+      column.name = (*it)->name() + "." + column.name;
+      column.nullable = true;
+      schema.add_column(column);
+    }
+  }
+  return schema;
+}
+
+// Returns the position in the joined rows of a column, named either
+// table.column or by its name alone if only one table has it. Throws a
+// StorageError if there is no such column or more than one.
+size_t Scope::resolve(const string& name) const {
+  const size_t dot = name.find('.');
+  const string table = dot == string::npos ? string() : name.substr(0, dot);
+  const string column = dot == string::npos ? name : name.substr(dot + 1);
+  size_t found = SIZE_MAX;
+  bool named = false;
+  for (size_t i = 0; i < _tables.size(); ++i) {
+    if (!table.empty() && _tables[i]->name() != table) {
+      continue;
+    }
+    named = true;
+    int index = _tables[i]->schema().index_of(column);
+    if (index < 0) {
+      continue;
+    }
+    if (found != SIZE_MAX) {
+      throw StorageError("Column " + name + " is ambiguous");
+    }
+    found = _starts[i] + index;
+  }
+  if (found != SIZE_MAX) {
+    return found;
+  }
+  if (!named) {
+    throw StorageError("Table " + table + " is not in the FROM clause");
+  }
+  if (_tables.size() == 1 || !table.empty()) {
+    throw StorageError("Table " + (table.empty() ? _tables.front()->name() : table) +
+		       " has no column " + column);
+  }
+  throw StorageError("No table has a column " + column);
+}
+
+// Binds the column references of a condition to the columns of the rows
+// it is evaluated on. Aggregates are left to be bound as a whole.
+class ColumnBinder : public Visitor {
+ public:
+  typedef std::function<size_t(const string&)> Resolver;
+  ColumnBinder(const Resolver& resolve, ExpressionColumns& bindings);
+  void bind(const Expression *condition);
+  void visitColumnRef(const ColumnRef& node);
+  void visitBinaryExpr(const BinaryExpr& node);
+  void visitNotExpr(const NotExpr& node);
+  void visitBetweenExpr(const BetweenExpr& node);
+  void visitInExpr(const InExpr& node);
+  void visitIsNullExpr(const IsNullExpr& node);
+ private:
+  const Resolver _resolve;
+  ExpressionColumns& _bindings;
+};
+
+ColumnBinder::ColumnBinder(const Resolver& resolve, ExpressionColumns& bindings)
+  : _resolve(resolve), _bindings(bindings) {}
+
+// Binds the column references of condition, which may be null. Throws a
+// StorageError if one cannot be resolved.
+void ColumnBinder::bind(const Expression *condition) {
+  if (condition) {
+    condition->accept(*this);
+  }
+}
+
+void ColumnBinder::visitColumnRef(const ColumnRef& node) {
+  _bindings[&node] = _resolve(node.name().str());
+}
+
+void ColumnBinder::visitBinaryExpr(const BinaryExpr& node) {
+  node.left()->accept(*this);
+  node.right()->accept(*this);
+}
+
+void ColumnBinder::visitNotExpr(const NotExpr& node) {
+  node.operand()->accept(*this);
+}
+
+void ColumnBinder::visitBetweenExpr(const BetweenExpr& node) {
+  node.value()->accept(*this);
+  node.low()->accept(*this);
+  node.high()->accept(*this);
+}
+
+void ColumnBinder::visitInExpr(const InExpr& node) {
+  node.value()->accept(*this);
+  for (auto it = node.list().begin(); it != node.list().end(); ++it) {
+    (*it)->accept(*this);
+  }
+}
+
+void ColumnBinder::visitIsNullExpr(const IsNullExpr& node) {
+  node.value()->accept(*this);
+}
+
+// Splits the condition of a join into the equalities between a column of
+// each side that the join's keys are made of, and the rest
+class KeyFinder : public Visitor {
+ public:
+  KeyFinder(const Schema& schema, size_t left_columns, const ExpressionColumns& bindings);
+  vector<JoinKey> find(const Expression *condition, bool& residual);
+  void visitBinaryExpr(const BinaryExpr& node);
+ private:
+  void split(const Expression *condition);
+  bool column(const Expression *expression, size_t& position) const;
+
+  const Schema& _schema;
+  const size_t _left_columns;
+  const ExpressionColumns& _bindings;
+  vector<JoinKey> _keys;
+  bool _residual;
+  // True once a conjunct is taken apart or taken as a key
+  bool _split;
+};
+
+KeyFinder::KeyFinder(const Schema& schema, size_t left_columns,
+		     const ExpressionColumns& bindings)
+  : _schema(schema), _left_columns(left_columns), _bindings(bindings) {}
+
+// Returns the keys in the conjuncts of condition, whose column references
+// must be bound, and sets residual if it has other conjuncts as well
+vector<JoinKey> KeyFinder::find(const Expression *condition, bool& residual) {
+  _keys.clear();
+  _residual = false;
+  split(condition);
+  residual = _residual;
+  return _keys;
+}
+
+void KeyFinder::split(const Expression *condition) {
+  _split = false;
+  condition->accept(*this);
+  _residual = _residual || !_split;
+}
+
+// Sets position to the column an expression is bound to, if it is bound
+bool KeyFinder::column(const Expression *expression, size_t& position) const {
+  auto found = _bindings.find(expression);
+  if (found == _bindings.end()) {
+    return false;
+  }
+  position = found->second;
+  return true;
+}
+
+void KeyFinder::visitBinaryExpr(const BinaryExpr& node) {
+  if (node.op() == BinaryOp::AND) {
+    split(node.left());
+    split(node.right());
+    _split = true;
+    return;
+  }
+  size_t left, right;
+  if (node.op() != BinaryOp::EQUAL || !column(node.left(), left) ||
+      !column(node.right(), right)) {
+    return;
+  }
+  if (left > right) {
+    std::swap(left, right);
+  }
+  if (left >= _left_columns || right < _left_columns) {
+    return;
+  }
+  // Numbers of any types compare with each other, and ENUM and SET values
+  // compare as strings
+  if (reads_as_string(physical_type(_schema.column(left).type)) !=
+      reads_as_string(physical_type(_schema.column(right).type))) {
+    return;
+  }
+  _keys.push_back(JoinKey{left, right - _left_columns});
+  _split = true;
+}
+
+// Returns the position of the named column among the key columns of the
+// groups. Throws a StorageError if it is not one of them.
+size_t grouped_column(const Scope& scope, const vector<size_t>& keys, const string& name) {
+  auto key = std::find(keys.begin(), keys.end(), scope.resolve(name));
+  if (key == keys.end()) {
+    throw StorageError("Column " + name + " is neither grouped by nor aggregated");
+  }
+  return key - keys.begin();
+}
+
+// Returns the aggregate of the joined rows an AggregateExpr computes.
+// Throws a StorageError if its argument is neither one of their columns
+// nor, for COUNT, a constant.
+AggregateSpec aggregate_spec(const Scope& scope, const AggregateExpr& node,
+			     ItemReader& reader) {
+  AggregateSpec spec{node.function(), -1, node.distinct()};
+  if (!node.argument()) {
+    return spec;
+  }
+  Item argument = reader.read(node.argument());
+  if (argument.kind == ItemKind::COLUMN) {
+    spec.column = static_cast<int>(scope.resolve(argument.column));
+    return spec;
+  }
+  // COUNT of a constant counts every row, unless the constant is NULL
+  if (argument.kind == ItemKind::CONSTANT && node.function() == AggregateFunction::COUNT &&
+      !argument.value.is_null() && !node.distinct()) {
+    return spec;
+  }
+  throw StorageError("Only columns can be aggregated");
+}
+
+// Returns the named table of catalog. Throws a StorageError if there is
+// none.
+const Table& find_table(const Catalog& catalog, const string& name) {
+  const Table *table = catalog.table(name);
+  if (!table) {
+    throw StorageError("Table " + name + " does not exist");
+  }
+  return *table;
+}
+
+// Returns the column type of a constant
+ColumnSchema constant_column(const Value& value) {
+  ColumnSchema column{string(), Datatype::INT_T, 0, true};
+  switch (value.type()) {
+  case ValueType::UINT:
+    column.type = Datatype::UINT_T;
+    break;
+  case ValueType::DOUBLE:
+    column.type = Datatype::DOUBLE_T;
+    break;
+  case ValueType::STRING:
+    column.type = Datatype::STRING_T;
+    break;
+  default:
+    break;
+  }
+  return column;
+}
+
+// Returns the schema of the columns selected from the rows of source.
+// Selected columns are given by position, with -1 for the constants in
+// values.
+Schema projected_schema(const Table& source, const vector<int>& columns,
+			const vector<Value>& values) {
+  Schema schema;
+  for (size_t i = 0; i < columns.size(); ++i) {
+    ColumnSchema column = columns[i] < 0 ? constant_column(values[i])
+      : source.schema().column(columns[i]);
+    column.name = "#" + std::to_string(i);
+    column.nullable = true;
+    schema.add_column(column);
+  }
+  return schema;
+}
+
+// Passes the selected columns of the rows of source in [begin, end) to
+// sink, OUTPUT_ROWS rows at a time. Columns are selected as for
+// projected_schema().
+void project(const Table& source, vector<size_t>::const_iterator begin,
+	     vector<size_t>::const_iterator end, const vector<int>& columns,
+	     const vector<Value>& values, RowSink& sink) {
+  const size_t width = columns.size();
+  vector<Value> output;
+  output.reserve(std::min<size_t>(end - begin, OUTPUT_ROWS) * width);
+  for (auto row = begin; row != end; ++row) {
+    for (size_t i = 0; i < width; ++i) {
+      output.push_back(columns[i] < 0 ? values[i] : source.value(*row, columns[i]));
+    }
+    if (output.size() == OUTPUT_ROWS * width) {
+      sink.append(output.data(), OUTPUT_ROWS);
+      output.clear();
+    }
+  }
+  if (!output.empty()) {
+    sink.append(output.data(), output.size() / width);
+  }
+}
+
+// Sets columns and values to the selection of items, as for project(),
+// from the rows of the query or, if grouped, from its groups by keys
+void select_columns(const Scope& scope, const vector<Item>& items, bool grouped,
+		    const vector<size_t>& keys, vector<int>& columns, vector<Value>& values) {
+  size_t aggregate = 0;
+  for (auto it = items.begin(); it != items.end(); ++it) {
+    values.push_back(it->value);
+    switch (it->kind) {
+    case ItemKind::CONSTANT:
+      columns.push_back(-1);
+      break;
+    case ItemKind::AGGREGATE:
+      columns.push_back(static_cast<int>(keys.size() + aggregate++));
+      break;
+    case ItemKind::COLUMN:
+      columns.push_back(static_cast<int>(grouped ? grouped_column(scope, keys, it->column)
+					 : scope.resolve(it->column)));
+      break;
+    }
+  }
+}
+
+// Keeps the rows of a query in a table
+class TableSink : public RowSink {
+ public:
+  void start(const Schema& columns);
+  void append(const Value *rows, size_t count);
+  unique_ptr<Table> take();
+ private:
+  unique_ptr<Table> _table;
+};
+
+void TableSink::start(const Schema& columns) {
+  _table.reset(new Table("result", columns));
+}
+
+void TableSink::append(const Value *rows, size_t count) {
+  _table->append(rows, count);
+}
+
+// Returns the table of the rows received
+unique_ptr<Table> TableSink::take() {
+  return std::move(_table);
+}
+
+}  // namespace
+
+// Runs a SELECT statement against the tables of catalog, with the values of
+// its placeholders taken from parameters, and returns the rows selected.
+// Aggregation and sorting use the threads of pool, or only the calling
+// thread if it is null. Throws a StorageError if the statement cannot be
+// run.
+QueryResult run_select(const Catalog& catalog, const Select& node,
+		       const vector<Value>& parameters, ThreadPool *pool) {
+  TableSink sink;
+  QueryResult result;
+  result.headings = run_select(catalog, node, parameters, pool, sink);
+  result.rows = sink.take();
+  return result;
+}
+
+// Runs a SELECT statement as above, but passes the rows selected to sink
+// as they are found, and returns the headings of their columns. Rows
+// already passed to sink stay there if the statement fails.
+vector<string> run_select(const Catalog& catalog, const Select& node,
+			  const vector<Value>& parameters, ThreadPool *pool, RowSink& sink) {
+  ItemReader reader(parameters);
+  vector<Item> items;
+  for (auto it = node.select_list().begin(); it != node.select_list().end(); ++it) {
+    items.push_back(reader.read(*it));
+  }
+  vector<string> headings;
+  const SelectExpression *exp = node.exp();
+  if (!exp) {
+    vector<int> columns;
+    vector<Value> values;
+    for (auto it = items.begin(); it != items.end(); ++it) {
+      if (it->kind != ItemKind::CONSTANT) {
+	throw StorageError("Only constants can be selected without FROM");
+      }
+      headings.push_back(it->heading);
+      columns.push_back(-1);
+      values.push_back(it->value);
+    }
+    Table none("none", Schema());
+    const vector<size_t> row(1);
+    sink.start(projected_schema(none, columns, values));
+    project(none, row.begin(), row.end(), columns, values, sink);
+    return headings;
+  }
+  if (exp->table_list().size() != 1) {
+    throw StorageError("Tables can only be joined with JOIN ... ON");
+  }
+  Scope scope;
+  const Table *table = &find_table(catalog, exp->table_list().begin()->str());
+  scope.add(*table);
+  // The column references of the ON and WHERE conditions
+  ExpressionColumns bound;
+  ColumnBinder binder([&scope](const string& name) { return scope.resolve(name); }, bound);
+  // Each table is joined to the rows the ones before it are joined into
+  unique_ptr<Table> joined;
+  for (auto it = exp->joins().begin(); it != exp->joins().end(); ++it) {
+    const Table& right = find_table(catalog, it->table().str());
+    const size_t left_columns = scope.size();
+    scope.add(right);
+    binder.bind(it->condition());
+    const Schema schema = scope.schema();
+    bool residual;
+    KeyFinder finder(schema, left_columns, bound);
+    // Joins with no keys check the whole condition on every pair of rows
+    vector<JoinKey> keys = finder.find(it->condition(), residual);
+    vector<size_t> left_rows, right_rows;
+    select_rows(*table, nullptr, parameters, left_rows, nullptr, pool);
+    select_rows(right, nullptr, parameters, right_rows, nullptr, pool);
+    joined = join_tables(schema, it->kind(), *table, left_rows, right, right_rows, keys,
+			 residual || keys.empty() ? it->condition() : nullptr, parameters, &bound,
+			 pool);
+    table = joined.get();
+  }
+  if (items.empty()) {
+    for (size_t i = 0; i < scope.tables(); ++i) {
+      const Table& from = scope.table(i);
+      for (size_t j = 0; j < from.schema().size(); ++j) {
+	const string& column = from.schema().column(j).name;
+	items.push_back(Item{ItemKind::COLUMN, from.name() + "." + column, Value(), nullptr,
+			     column});
+      }
+    }
+  }
+  // The items rows are ordered by, and whether each is descending
+  vector<Item> order;
+  vector<bool> descending;
+  if (exp->order_by_expr()) {
+    const auto& order_items = exp->order_by_expr()->items();
+    for (auto it = order_items.begin(); it != order_items.end(); ++it) {
+      order.push_back(reader.read(it->value()));
+      descending.push_back(it->descending());
+      if (order.back().kind == ItemKind::CONSTANT) {
+	throw StorageError("Only columns and aggregates can be ordered by");
+      }
+    }
+  }
+  bool grouped = exp->group_by_expr() || exp->having_expr();
+  for (auto it = items.begin(); it != items.end(); ++it) {
+    grouped = grouped || it->kind == ItemKind::AGGREGATE;
+  }
+  for (auto it = order.begin(); it != order.end(); ++it) {
+    grouped = grouped || it->kind == ItemKind::AGGREGATE;
+  }
+  // The rows wanted, before and after the offset, or every row
+  size_t offset = 0;
+  size_t wanted = SIZE_MAX;
+  if (exp->limit_expr()) {
+    offset = std::max(exp->limit_expr()->offset(), 0);
+    wanted = offset + std::max(exp->limit_expr()->rows(), 0);
+  }
+
+  const Expression *where = exp->where_expr() ? exp->where_expr()->condition() : nullptr;
+  binder.bind(where);
+  for (auto it = items.begin(); it != items.end(); ++it) {
+    headings.push_back(it->heading);
+  }
+  if (!grouped && order.empty()) {
+    // Nothing waits for every row, so rows are passed on as they are found
+    vector<int> columns;
+    vector<Value> values;
+    select_columns(scope, items, false, vector<size_t>(), columns, values);
+    sink.start(projected_schema(*table, columns, values));
+    size_t found = 0;
+    scan_rows(*table, where, parameters, [&](const vector<size_t>& rows) {
+	size_t first = std::min(rows.size(), offset - std::min(offset, found));
+	size_t last = std::min(rows.size(), wanted - found);
+	project(*table, rows.begin() + first, rows.begin() + std::max(first, last), columns,
+		values, sink);
+	found += rows.size();
+	return found < wanted;
+      }, &bound, pool);
+    return headings;
+  }
+  vector<SortKey> sort_keys;
+  vector<size_t> rows;
+  bool sorted = false;
+  if (!grouped) {
+    for (size_t i = 0; i < order.size(); ++i) {
+      sort_keys.push_back(SortKey{scope.resolve(order[i].column), descending[i]});
+    }
+    // Stop early when an index yields the rows in order
+    sorted = !order.empty() && wanted != SIZE_MAX &&
+      select_ordered_rows(*table, where, parameters, sort_keys, wanted, rows, &bound);
+  }
+  if (!sorted) {
+    select_rows(*table, where, parameters, rows, &bound, pool);
+  }
+
+  const Table *source = table;
+  unique_ptr<Table> groups;
+  // The columns of the rows grouped by, in the order of GROUP BY
+  vector<size_t> keys;
+  if (grouped) {
+    if (exp->group_by_expr()) {
+      const auto& columns = exp->group_by_expr()->columns();
+      for (auto it = columns.begin(); it != columns.end(); ++it) {
+	Item key = reader.read(*it);
+	if (key.kind != ItemKind::COLUMN) {
+	  throw StorageError("Only columns can be grouped by");
+	}
+	size_t column = scope.resolve(key.column);
+	if (std::find(keys.begin(), keys.end(), column) == keys.end()) {
+	  keys.push_back(column);
+	}
+      }
+    }
+    vector<const AggregateExpr*> aggregates;
+    for (auto it = items.begin(); it != items.end(); ++it) {
+      if (it->kind == ItemKind::AGGREGATE) {
+	aggregates.push_back(it->aggregate);
+      }
+    }
+    if (exp->having_expr()) {
+      AggregateFinder finder;
+      vector<const AggregateExpr*> found = finder.find(exp->having_expr()->condition());
+      aggregates.insert(aggregates.end(), found.begin(), found.end());
+    }
+    for (auto it = order.begin(); it != order.end(); ++it) {
+      if (it->kind == ItemKind::AGGREGATE) {
+	aggregates.push_back(it->aggregate);
+      }
+    }
+    vector<AggregateSpec> specs;
+    ExpressionColumns bindings;
+    for (auto it = aggregates.begin(); it != aggregates.end(); ++it) {
+      bindings[*it] = keys.size() + specs.size();
+      specs.push_back(aggregate_spec(scope, **it, reader));
+    }
+    groups = aggregate_rows(*table, rows, keys, specs, pool);
+    source = groups.get();
+    const Expression *having = exp->having_expr() ? exp->having_expr()->condition() : nullptr;
+    ColumnBinder grouped_binder([&scope, &keys](const string& name) {
+	return grouped_column(scope, keys, name);
+      }, bindings);
+    grouped_binder.bind(having);
+    select_rows(*groups, having, parameters, rows, &bindings, pool);
+    for (size_t i = 0; i < order.size(); ++i) {
+      size_t column = order[i].kind == ItemKind::AGGREGATE ? bindings[order[i].aggregate]
+	: grouped_column(scope, keys, order[i].column);
+      sort_keys.push_back(SortKey{column, descending[i]});
+    }
+  }
+
+  if (!order.empty() && !sorted) {
+    sort_rows(*source, rows, sort_keys, wanted, pool);
+  }
+  if (wanted != SIZE_MAX) {
+    rows.resize(std::min(rows.size(), wanted));
+    rows.erase(rows.begin(), rows.begin() + std::min(rows.size(), offset));
+  }
+
+  vector<int> columns;
+  vector<Value> values;
+  select_columns(scope, items, grouped, keys, columns, values);
+  sink.start(projected_schema(*source, columns, values));
+  project(*source, rows.begin(), rows.end(), columns, values, sink);
+  return headings;
+}
@@ -0,0 +1,63 @@
+// SimpleSQL: Query execution
+//
+// Runs SELECT statements against the tables of a catalog. The tables of
+// JOIN clauses are joined to the one in the FROM clause, in order, on the
+// equalities between their columns in the ON conditions (see join.h), and
+// the joined rows have the columns of every table, which are named either
+// table.column or by name alone if only one table has a column of that
+// name. The rows that meet the WHERE condition are found as for UPDATE and
+// DELETE (see where.h). If the statement groups rows, with
+// GROUP BY or by selecting aggregates, the rows are aggregated (see
+// aggregate.h), and the groups that meet the HAVING condition are found in
+// the same way, with every aggregate standing for the column of its
+// results. LIMIT is applied last, and the selected expressions are copied
+// into the result.
+//
+// Unless rows are grouped or ordered, nothing has to be waited for before
+// the first rows are known, so the rows are passed on a morsel at a time
+// as the scan finds them (see where.h) and the scan stops once LIMIT rows
+// are found. The result can be handed to a RowSink batch by batch instead
+// of being kept in a table, as INSERT ... SELECT does.
+//
+// Columns, constants and aggregates can be selected. The columns of a
+// grouped statement must be ones it groups by, and aggregates take a
+// column, or a constant for COUNT. A SELECT without FROM returns one row
+// of constants.
+
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../AST/select.h"
+#include "../storage/table.h"
+#include "../util/thread_pool.h"
+
+class Catalog;
+
+// The rows a query returns, with a heading for each column
+struct QueryResult {
+  std::vector<std::string> headings;
+  std::unique_ptr<Table> rows;
+};
+
+// Receives the rows a query selects, a batch at a time, as they are found
+class RowSink {
+ public:
+  virtual ~RowSink() {}
+  // Called once, before any rows, with the types of the selected columns
+  virtual void start(const Schema& columns) = 0;
+  // Called with count rows stored one after another, each with a value for
+  // every selected column. Strings are only valid during the call.
+  virtual void append(const Value *rows, std::size_t count) = 0;
+};
+
+QueryResult run_select(const Catalog& catalog, const Select& node,
+		       const std::vector<Value>& parameters, ThreadPool *pool);
+std::vector<std::string> run_select(const Catalog& catalog, const Select& node,
+				    const std::vector<Value>& parameters, ThreadPool *pool,
+				    RowSink& sink);
+
+#endif  // __QUERY_H__
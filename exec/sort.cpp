@@ -0,0 +1,602 @@
+// SimpleSQL: Sorting
+
+#include "sort.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "../storage/index_key.h"
+#include "morsel.h"
+
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Rows are only split between threads in shares of at least this many
+const size_t MIN_SHARE = 1 << 14;
+// Spilled runs are written and read through buffers of this many bytes
+const size_t IO_BUFFER_SIZE = 1 << 16;
+const size_t DEFAULT_MEMORY_LIMIT = size_t(64) << 20;
+// The most runs merged at once, which bounds the files open and the
+// buffers held; more runs are merged in passes
+const size_t MAX_FAN_IN = 128;
+
+std::atomic<size_t> memory_limit(DEFAULT_MEMORY_LIMIT);
+
+// Throws a StorageError describing the failed system call
+[[noreturn]] void io_error(const string& what) {
+  throw StorageError(what + " a sort run: " + std::strerror(errno));
+}
+
+// Compares two values of the same column: NULLs first, then numbers by
+// value, with NaN after every other number, and strings bytewise
+int compare_values(const Value& a, const Value& b) {
+  if (a.is_null() || b.is_null()) {
+    return b.is_null() - a.is_null();
+  }
+  switch (a.type()) {
+  case ValueType::INT:
+    return (a.int_value() > b.int_value()) - (a.int_value() < b.int_value());
+  case ValueType::UINT:
+    return (a.uint_value() > b.uint_value()) - (a.uint_value() < b.uint_value());
+  case ValueType::DOUBLE: {
+    bool a_nan = std::isnan(a.double_value());
+    bool b_nan = std::isnan(b.double_value());
+    if (a_nan || b_nan) {
+      return a_nan - b_nan;
+    }
+    return (a.double_value() > b.double_value()) - (a.double_value() < b.double_value());
+  }
+  default: {
+    size_t length = std::min(a.string_length(), b.string_length());
+    int order = length == 0 ? 0 : std::memcmp(a.string_data(), b.string_data(), length);
+    if (order != 0) {
+      return order;
+    }
+    return (a.string_length() > b.string_length()) - (a.string_length() < b.string_length());
+  }
+  }
+}
+
+// The order of rows by the sort keys, then by row number
+class RowOrder {
+ public:
+  RowOrder(const Table& table, const vector<SortKey>& keys) : _table(table), _keys(keys) {}
+
+  // Returns true if row a comes before row b
+  bool operator()(size_t a, size_t b) const {
+    for (auto it = _keys.begin(); it != _keys.end(); ++it) {
+      int order = compare_values(_table.value(a, it->column), _table.value(b, it->column));
+      if (order != 0) {
+	return it->descending ? order > 0 : order < 0;
+      }
+    }
+    return a < b;
+  }
+ private:
+  const Table& _table;
+  const vector<SortKey>& _keys;
+};
+
+// Adds the rows in [begin, end) to heap, which holds at most limit rows,
+// keeping the first of them in order. The top of the heap is the last of
+// the rows it holds.
+void add_to_heap(const RowOrder& order, const size_t *begin, const size_t *end, size_t limit,
+		 vector<size_t>& heap) {
+  for (const size_t *row = begin; row != end; ++row) {
+    if (heap.size() < limit) {
+      heap.push_back(*row);
+      std::push_heap(heap.begin(), heap.end(), order);
+    } else if (order(*row, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), order);
+      heap.back() = *row;
+      std::push_heap(heap.begin(), heap.end(), order);
+    }
+  }
+}
+
+/*------------------------------------------------
+  Sort keys
+  ----------------------------------------------*/
+
+// Appends the sort key of row to key: the index key of each sort column,
+// with every byte inverted for descending columns, then the row number, 8
+// bytes big endian. No index key is a prefix of another, so inverting one
+// exactly reverses its order, NULLs included, and the row number breaks
+// ties in row order.
+void append_sort_key(const Table& table, const vector<SortKey>& keys, size_t row,
+		     string& key) {
+  for (auto it = keys.begin(); it != keys.end(); ++it) {
+    size_t start = key.size();
+    append_key(key, table.value(row, it->column));
+    if (it->descending) {
+      for (size_t i = start; i < key.size(); ++i) {
+	key[i] = ~key[i];
+      }
+    }
+  }
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    key += static_cast<char>(static_cast<uint64_t>(row) >> shift);
+  }
+}
+
+// Returns the row number a sort key ends with
+size_t key_row(const char *key, size_t length) {
+  uint64_t row = 0;
+  for (size_t i = length - sizeof(row); i < length; ++i) {
+    row = row << 8 | static_cast<unsigned char>(key[i]);
+  }
+  return static_cast<size_t>(row);
+}
+
+// Compares two sort keys bytewise
+int compare_keys(const char *a, size_t a_length, const char *b, size_t b_length) {
+  int order = std::memcmp(a, b, std::min(a_length, b_length));
+  if (order != 0) {
+    return order;
+  }
+  return (a_length > b_length) - (a_length < b_length);
+}
+
+// A sort key held in memory. The first 8 bytes of the key are kept
+// alongside it as a big-endian integer, which decides most comparisons
+// without following the pointer.
+struct KeyEntry {
+  uint64_t head;
+  size_t offset;
+  size_t length;
+};
+
+/*------------------------------------------------
+  Runs
+  ----------------------------------------------*/
+
+// A temporary file, removed as soon as it is created, holding sorted runs
+// of keys one after another. Each key is preceded by its length as 4
+// bytes in native byte order. Keys are appended through a buffer and read
+// back with pread().
+class RunFile {
+ public:
+  RunFile();
+  ~RunFile();
+  void append(const char *key, size_t length);
+  uint64_t finish();
+  size_t read(uint64_t offset, char *data, size_t length) const;
+ private:
+  RunFile(const RunFile&) = delete;
+  RunFile& operator=(const RunFile&) = delete;
+  void flush();
+
+  int _fd;
+  string _buffer;
+  uint64_t _size;
+};
+
+// Creates an empty file in the directory named by TMPDIR, or /tmp
+RunFile::RunFile() : _size(0) {
+  const char *directory = std::getenv("TMPDIR");
+  string path = string(directory && *directory ? directory : "/tmp") + "/simplesql-sort-XXXXXX";
+  _fd = ::mkstemp(&path[0]);
+  if (_fd < 0) {
+    io_error("Could not create");
+  }
+  ::unlink(path.c_str());
+  _buffer.reserve(IO_BUFFER_SIZE);
+}
+
+RunFile::~RunFile() {
+  ::close(_fd);
+}
+
+// Appends a key to the run being written
+void RunFile::append(const char *key, size_t length) {
+  uint32_t stored = static_cast<uint32_t>(length);
+  if (_buffer.size() + sizeof(stored) + length > IO_BUFFER_SIZE) {
+    flush();
+  }
+  _buffer.append(reinterpret_cast<const char*>(&stored), sizeof(stored));
+  _buffer.append(key, length);
+}
+
+// Writes the keys still buffered, and returns the size of the file, where
+// the next run starts
+uint64_t RunFile::finish() {
+  flush();
+  return _size;
+}
+
+void RunFile::flush() {
+  size_t written = 0;
+  while (written < _buffer.size()) {
+    ssize_t count = ::pwrite(_fd, _buffer.data() + written, _buffer.size() - written,
+			     _size + written);
+    if (count < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      io_error("Could not write");
+    }
+    written += count;
+  }
+  _size += written;
+  _buffer.clear();
+}
+
+// Reads up to length bytes at offset into data, and returns the number
+// read, which is 0 at the end of the file
+size_t RunFile::read(uint64_t offset, char *data, size_t length) const {
+  while (true) {
+    ssize_t count = ::pread(_fd, data, length, offset);
+    if (count >= 0) {
+      return count;
+    }
+    if (errno != EINTR) {
+      io_error("Could not read");
+    }
+  }
+}
+
+// A sorted run of keys: in memory, or spilled to the bytes [begin, end) of
+// a file once the keys reach the memory limit
+struct Run {
+  string keys;
+  vector<KeyEntry> entries;
+  std::shared_ptr<RunFile> file;
+  uint64_t begin;
+  uint64_t end;
+
+  Run() : begin(0), end(0) {}
+};
+
+// Returns the head of a key: its first 8 bytes, big endian, padded with
+// zeroes
+uint64_t key_head(const char *key, size_t length) {
+  uint64_t head = 0;
+  for (size_t i = 0; i < sizeof(head); ++i) {
+    head = head << 8 | (i < length ? static_cast<unsigned char>(key[i]) : 0);
+  }
+  return head;
+}
+
+// Builds the sorted runs of the sort keys of rows. A run is spilled to a
+// file of the runs of these rows when its keys use memory bytes, and the
+// last is kept in memory.
+void build_runs(const Table& table, const vector<SortKey>& keys, const size_t *begin,
+		const size_t *end, size_t memory, vector<Run>& runs) {
+  std::shared_ptr<RunFile> file;
+  Run run;
+  string key;
+  auto sort_run = [](Run& run) {
+    const char *keys = run.keys.data();
+    std::sort(run.entries.begin(), run.entries.end(),
+	      [keys](const KeyEntry& a, const KeyEntry& b) {
+		if (a.head != b.head) {
+		  return a.head < b.head;
+		}
+		return compare_keys(keys + a.offset, a.length, keys + b.offset, b.length) < 0;
+	      });
+  };
+  for (const size_t *row = begin; row != end; ++row) {
+    key.clear();
+    append_sort_key(table, keys, *row, key);
+    run.entries.push_back(KeyEntry{key_head(key.data(), key.size()), run.keys.size(),
+	  key.size()});
+    run.keys += key;
+    if (run.keys.size() + run.entries.size() * sizeof(KeyEntry) >= memory) {
+      sort_run(run);
+      if (!file) {
+	file = std::make_shared<RunFile>();
+      }
+      Run spilled;
+      spilled.file = file;
+      spilled.begin = file->finish();
+      for (auto it = run.entries.begin(); it != run.entries.end(); ++it) {
+	file->append(run.keys.data() + it->offset, it->length);
+      }
+      spilled.end = file->finish();
+      runs.push_back(std::move(spilled));
+      // Release the memory of the run rather than keep it for the next
+      run = Run();
+    }
+  }
+  if (!run.entries.empty()) {
+    sort_run(run);
+    runs.push_back(std::move(run));
+  }
+}
+
+// Reads the keys of a run in order
+class RunCursor {
+ public:
+  explicit RunCursor(const Run& run);
+  bool next();
+  const char *key() const;
+  size_t length() const;
+ private:
+  void fill(size_t needed);
+
+  const Run& _run;
+  // For a run in memory, the position of the next entry
+  size_t _entry;
+  // For a spilled run, the buffered bytes [_start, _end) and the offset in
+  // the file of the byte after them
+  vector<char> _buffer;
+  size_t _start;
+  size_t _end;
+  uint64_t _offset;
+  const char *_key;
+  size_t _length;
+};
+
+RunCursor::RunCursor(const Run& run)
+  : _run(run), _entry(0), _start(0), _end(0), _offset(run.begin), _key(nullptr), _length(0) {
+  if (run.file) {
+    _buffer.resize(std::min<uint64_t>(IO_BUFFER_SIZE, run.end - run.begin));
+  }
+}
+
+// Moves to the next key and returns true, or returns false at the end of
+// the run
+bool RunCursor::next() {
+  if (!_run.file) {
+    if (_entry == _run.entries.size()) {
+      return false;
+    }
+    const KeyEntry& entry = _run.entries[_entry++];
+    _key = _run.keys.data() + entry.offset;
+    _length = entry.length;
+    return true;
+  }
+  uint32_t length;
+  fill(sizeof(length));
+  if (_end - _start < sizeof(length)) {
+    return false;
+  }
+  std::memcpy(&length, &_buffer[_start], sizeof(length));
+  _start += sizeof(length);
+  fill(length);
+  if (_end - _start < length) {
+    throw StorageError("A sort run is truncated");
+  }
+  _key = &_buffer[_start];
+  _length = length;
+  _start += length;
+  return true;
+}
+
+// Returns the current key
+const char *RunCursor::key() const {
+  return _key;
+}
+
+size_t RunCursor::length() const {
+  return _length;
+}
+
+// Reads more of the file until needed bytes are buffered, or the file ends
+void RunCursor::fill(size_t needed) {
+  if (_end - _start >= needed) {
+    return;
+  }
+  std::memmove(&_buffer[0], &_buffer[_start], _end - _start);
+  _end -= _start;
+  _start = 0;
+  if (_buffer.size() < needed) {
+    _buffer.resize(needed);
+  }
+  while (_end < needed && _offset < _run.end) {
+    size_t wanted = std::min<uint64_t>(_buffer.size() - _end, _run.end - _offset);
+    size_t count = _run.file->read(_offset, &_buffer[_end], wanted);
+    if (count == 0) {
+      return;
+    }
+    _end += count;
+    _offset += count;
+  }
+}
+
+/*------------------------------------------------
+  Merging
+  ----------------------------------------------*/
+
+// A tournament tree over the current keys of k cursors. Each inner node
+// holds the loser of the match played there, and node 0 the overall
+// winner, the cursor with the least key. Replacing the winner's key only
+// replays the matches on its path to the root, log2(k) comparisons, each
+// against a loser already known.
+class LoserTree {
+ public:
+  explicit LoserTree(vector<RunCursor>& cursors);
+  bool empty() const;
+  RunCursor& top();
+  void pop();
+ private:
+  bool less(size_t a, size_t b) const;
+
+  vector<RunCursor>& _cursors;
+  vector<bool> _live;
+  vector<size_t> _losers;
+};
+
+// Starts a tournament between the first keys of the cursors
+LoserTree::LoserTree(vector<RunCursor>& cursors)
+  : _cursors(cursors), _live(cursors.size()), _losers(cursors.size()) {
+  const size_t k = cursors.size();
+  for (size_t i = 0; i < k; ++i) {
+    _live[i] = cursors[i].next();
+  }
+  // Leaves are nodes k to 2k - 1, one per cursor
+  vector<size_t> winners(2 * k);
+  for (size_t i = 0; i < k; ++i) {
+    winners[k + i] = i;
+  }
+  for (size_t node = k - 1; node > 0; --node) {
+    size_t a = winners[2 * node];
+    size_t b = winners[2 * node + 1];
+    winners[node] = less(a, b) ? a : b;
+    _losers[node] = less(a, b) ? b : a;
+  }
+  _losers[0] = k == 1 ? 0 : winners[1];
+}
+
+// Returns true once every cursor is exhausted
+bool LoserTree::empty() const {
+  return !_live[_losers[0]];
+}
+
+// Returns the cursor with the least key
+RunCursor& LoserTree::top() {
+  return _cursors[_losers[0]];
+}
+
+// Moves the winner to its next key and replays its matches
+void LoserTree::pop() {
+  const size_t k = _cursors.size();
+  size_t winner = _losers[0];
+  _live[winner] = _cursors[winner].next();
+  for (size_t node = (winner + k) / 2; node > 0; node /= 2) {
+    if (less(_losers[node], winner)) {
+      std::swap(_losers[node], winner);
+    }
+  }
+  _losers[0] = winner;
+}
+
+// Returns true if cursor a's key is less than b's. Exhausted cursors come
+// after every key.
+bool LoserTree::less(size_t a, size_t b) const {
+  if (!_live[a] || !_live[b]) {
+    return _live[a] && !_live[b];
+  }
+  return compare_keys(_cursors[a].key(), _cursors[a].length(), _cursors[b].key(),
+		      _cursors[b].length()) < 0;
+}
+
+// Merges the runs in [begin, end) through a loser tree, calling emit with
+// every key in order
+void merge_runs(vector<Run>::const_iterator begin, vector<Run>::const_iterator end,
+		const std::function<void(const char*, size_t)>& emit) {
+  vector<RunCursor> cursors;
+  for (auto it = begin; it != end; ++it) {
+    cursors.push_back(RunCursor(*it));
+  }
+  if (cursors.empty()) {
+    return;
+  }
+  for (LoserTree tree(cursors); !tree.empty(); tree.pop()) {
+    emit(tree.top().key(), tree.top().length());
+  }
+}
+
+// Sorts rows by their sort keys: each share of the rows into runs of its
+// own, on the threads of pool, then the runs merged, in passes of at most
+// MAX_FAN_IN runs until that many are left
+void merge_sort(const Table& table, vector<size_t>& rows, const vector<SortKey>& keys,
+		ThreadPool *pool) {
+  size_t shares = 1;
+  if (pool) {
+    shares = std::max<size_t>(1, std::min(pool->size(), rows.size() / MIN_SHARE));
+  }
+  const size_t memory = std::max<size_t>(1, sort_memory_limit() / shares);
+  vector<vector<Run>> share_runs(shares);
+  run_tasks(pool, shares, [&](size_t share) {
+      const size_t begin = rows.size() * share / shares;
+      const size_t end = rows.size() * (share + 1) / shares;
+      build_runs(table, keys, rows.data() + begin, rows.data() + end, memory, share_runs[share]);
+    });
+  vector<Run> runs;
+  for (auto it = share_runs.begin(); it != share_runs.end(); ++it) {
+    for (auto run = it->begin(); run != it->end(); ++run) {
+      runs.push_back(std::move(*run));
+    }
+  }
+  rows.clear();
+  if (runs.size() == 1 && !runs.front().file) {
+    const Run& run = runs.front();
+    for (auto it = run.entries.begin(); it != run.entries.end(); ++it) {
+      rows.push_back(key_row(run.keys.data() + it->offset, it->length));
+    }
+    return;
+  }
+  // Each pass merges its runs into runs of a file of its own
+  while (runs.size() > MAX_FAN_IN) {
+    auto file = std::make_shared<RunFile>();
+    vector<Run> merged;
+    for (size_t first = 0; first < runs.size(); first += MAX_FAN_IN) {
+      size_t last = std::min(first + MAX_FAN_IN, runs.size());
+      Run run;
+      run.file = file;
+      run.begin = file->finish();
+      merge_runs(runs.begin() + first, runs.begin() + last, [&](const char *key, size_t length) {
+	  file->append(key, length);
+	});
+      run.end = file->finish();
+      merged.push_back(std::move(run));
+    }
+    runs.swap(merged);
+  }
+  merge_runs(runs.begin(), runs.end(), [&](const char *key, size_t length) {
+      rows.push_back(key_row(key, length));
+    });
+}
+
+}  // namespace
+
+// Returns the memory, in bytes, a full sort holds keys in before it spills
+// them to temporary files
+size_t sort_memory_limit() {
+  return memory_limit.load(std::memory_order_relaxed);
+}
+
+// Sets the memory a full sort holds keys in; at least one key is always
+// held
+void set_sort_memory_limit(size_t bytes) {
+  memory_limit.store(bytes, std::memory_order_relaxed);
+}
+
+// Sorts rows, which must be rows of table that are not deleted, by the
+// values of the key columns, and keeps only the first limit of them. The
+// rows are split between the threads of pool, or kept on the calling thread
+// only if pool is null. When limit is fewer than all of them, each driver
+// (see morsel.h) finds the first limit rows of the morsels it takes with a
+// bounded heap, and the rows the heaps hold are sorted last. Otherwise
+// every row is sorted with an external merge sort. Throws a StorageError if
+// a run cannot be spilled or read back.
+void sort_rows(const Table& table, vector<size_t>& rows, const vector<SortKey>& keys,
+	       size_t limit, ThreadPool *pool) {
+  if (limit >= rows.size()) {
+    merge_sort(table, rows, keys, pool);
+    return;
+  }
+  const RowOrder order(table, keys);
+  if (limit == 0) {
+    rows.clear();
+    return;
+  }
+  // Every driver keeps a heap of the least rows of its morsels
+  const size_t drivers = morsel_drivers(pool, rows.size());
+  vector<vector<size_t>> heaps(drivers);
+  run_morsels(pool, rows.size(), MORSEL_ROWS, drivers, [&](size_t begin, size_t end,
+							  size_t driver) {
+      add_to_heap(order, rows.data() + begin, rows.data() + end, limit, heaps[driver]);
+    });
+  rows.clear();
+  for (auto it = heaps.begin(); it != heaps.end(); ++it) {
+    rows.insert(rows.end(), it->begin(), it->end());
+  }
+  size_t kept = std::min(limit, rows.size());
+  std::partial_sort(rows.begin(), rows.begin() + kept, rows.end(), order);
+  rows.resize(kept);
+}
@@ -0,0 +1,43 @@
+// SimpleSQL: Sorting
+//
+// Orders rows of a table by the values of some of its columns, for ORDER
+// BY. Values compare as index keys do (see index_key.h): NULLs first,
+// numbers by value and strings bytewise. A key sorted in descending order
+// reverses that, NULLs included. Rows with equal keys keep their row
+// order, so results do not depend on how the work was split.
+//
+// When only the first rows in that order are wanted, as with ORDER BY and
+// LIMIT, they are found without sorting the rest: each driver of the
+// morsels of rows (see morsel.h) keeps the best rows it has seen in a
+// bounded heap whose top is the worst of them, so most rows of a large
+// input cost one comparison with the top, and the heaps are merged at the
+// end.
+//
+// Sorting every row is an external merge sort. Each row's sort key is
+// encoded into bytes whose memcmp order is the sort order (see
+// append_sort_key() in sort.cpp), and keys are sorted in runs that fit the
+// memory limit. A run that fills it is spilled to a temporary file that
+// holds every spilled run of its thread, and the runs are merged through a
+// loser tree, reading spilled runs back a buffer at a time. Only the keys
+// count against the limit: the rows themselves stay in their table.
+
+#ifndef __SORT_H__
+#define __SORT_H__
+
+#include <cstddef>
+#include <vector>
+#include "../storage/table.h"
+#include "../util/thread_pool.h"
+
+// A column rows are sorted by, and its direction
+struct SortKey {
+  std::size_t column;
+  bool descending;
+};
+
+std::size_t sort_memory_limit();
+void set_sort_memory_limit(std::size_t bytes);
+void sort_rows(const Table& table, std::vector<std::size_t>& rows,
+	       const std::vector<SortKey>& keys, std::size_t limit, ThreadPool *pool);
+
+#endif  // __SORT_H__
@@ -0,0 +1,596 @@
+// SimpleSQL: WHERE evaluation
+
+#include "where.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "../AST/visitor.h"
+#include "../storage/index_key.h"
+#include "morsel.h"
+
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+namespace {
+
+// The most rows of an ordered index checked against a condition at once
+const size_t MAX_BLOCK_ROWS = 1 << 16;
+
+// Returns true for the operators that compare their operands
+bool is_comparison(BinaryOp op) {
+  return op != BinaryOp::AND && op != BinaryOp::OR;
+}
+
+// Returns the operator that gives the same result with its operands
+// swapped
+BinaryOp mirror(BinaryOp op) {
+  switch (op) {
+  case BinaryOp::GTHAN:
+    return BinaryOp::LTHAN;
+  case BinaryOp::LTHAN:
+    return BinaryOp::GTHAN;
+  case BinaryOp::GEQ:
+    return BinaryOp::LEQ;
+  case BinaryOp::LEQ:
+    return BinaryOp::GEQ;
+  default:
+    return op;
+  }
+}
+
+// A conjunct of a condition comparing a column with a constant, written
+// with the column on the left
+struct Restriction {
+  size_t column;
+  BinaryOp op;
+  Value value;
+};
+
+// Finds the restrictions among the conjuncts of a condition
+class RestrictionFinder : public Visitor {
+ public:
+  RestrictionFinder(const Table& table, const vector<Value>& parameters,
+		    const ExpressionColumns *bindings);
+  vector<Restriction> find(const Expression *condition);
+  void visitLiteral(const Literal& node);
+  void visitPlaceholder(const Placeholder& node);
+  void visitColumnRef(const ColumnRef& node);
+  void visitBinaryExpr(const BinaryExpr& node);
+  void visitBetweenExpr(const BetweenExpr& node);
+ private:
+  // The kinds of operand a comparison can have
+  enum class Operand {
+    COLUMN,
+    CONSTANT,
+    OTHER
+  };
+  Operand operand(const Expression *expression);
+  void restrict(const Expression *left, BinaryOp op, const Expression *right);
+
+  const Table& _table;
+  const vector<Value>& _parameters;
+  const ExpressionColumns *const _bindings;
+  vector<Restriction> _restrictions;
+  // True while an operand is being read, and the kind of the operand read
+  bool _reading;
+  Operand _operand;
+  size_t _column;
+  Value _value;
+};
+
+RestrictionFinder::RestrictionFinder(const Table& table, const vector<Value>& parameters,
+				     const ExpressionColumns *bindings)
+  : _table(table), _parameters(parameters), _bindings(bindings), _reading(false), _operand(Operand::OTHER),
+    _column(0) {}
+
+// Returns the restrictions among the conjuncts of condition
+vector<Restriction> RestrictionFinder::find(const Expression *condition) {
+  _restrictions.clear();
+  condition->accept(*this);
+  return _restrictions;
+}
+
+void RestrictionFinder::visitLiteral(const Literal& node) {
+  _operand = Operand::CONSTANT;
+  _value = node.value();
+}
+
+void RestrictionFinder::visitPlaceholder(const Placeholder& node) {
+  if (node.index() < _parameters.size()) {
+    _operand = Operand::CONSTANT;
+    _value = _parameters[node.index()];
+  }
+}
+
+void RestrictionFinder::visitColumnRef(const ColumnRef& node) {
+  if (_bindings && _bindings->count(&node)) {
+    _operand = Operand::COLUMN;
+    _column = _bindings->at(&node);
+    return;
+  }
+  int column = _table.schema().index_of(node.name().str());
+  if (column >= 0) {
+    _operand = Operand::COLUMN;
+    _column = column;
+  }
+}
+
+// Descends into ANDs, and records comparisons of a column with a constant
+void RestrictionFinder::visitBinaryExpr(const BinaryExpr& node) {
+  if (_reading) {
+    return;
+  }
+  if (node.op() == BinaryOp::AND) {
+    node.left()->accept(*this);
+    node.right()->accept(*this);
+    return;
+  }
+  if (!is_comparison(node.op())) {
+    return;
+  }
+  restrict(node.left(), node.op(), node.right());
+}
+
+// Records x BETWEEN a AND b as x >= a and x <= b
+void RestrictionFinder::visitBetweenExpr(const BetweenExpr& node) {
+  if (_reading || node.negated()) {
+    return;
+  }
+  restrict(node.value(), BinaryOp::GEQ, node.low());
+  restrict(node.value(), BinaryOp::LEQ, node.high());
+}
+
+// Records the comparison of left with right if it restricts a column
+void RestrictionFinder::restrict(const Expression *left, BinaryOp op, const Expression *right) {
+  Operand left_kind = operand(left);
+  size_t column = _column;
+  Value value = _value;
+  Operand right_kind = operand(right);
+  if (left_kind == Operand::COLUMN && right_kind == Operand::CONSTANT) {
+    _restrictions.push_back(Restriction{column, op, _value});
+  } else if (left_kind == Operand::CONSTANT && right_kind == Operand::COLUMN) {
+    _restrictions.push_back(Restriction{_column, mirror(op), value});
+  }
+}
+
+// Returns the kind of an operand of a comparison. Sets _column to the
+// position of a column, and _value to the value of a constant.
+RestrictionFinder::Operand RestrictionFinder::operand(const Expression *expression) {
+  _operand = Operand::OTHER;
+  _reading = true;
+  expression->accept(*this);
+  _reading = false;
+  return _operand;
+}
+
+// A way to find the candidate rows of a condition with an index
+struct IndexScan {
+  // Higher scores are expected to yield fewer candidates
+  int score;
+  // The index used, or null for the primary key
+  const SecondaryIndex *index;
+  // For a hash index, the key looked up. Otherwise the range [from, to)
+  // scanned, unbounded above if to is empty.
+  string from;
+  string to;
+};
+
+// Appends the index key of the value the restrictions require column to
+// equal to key, and returns true, or returns false if there is no such
+// restriction whose value fits the column
+bool equal_key(const Table& table, const vector<Restriction>& restrictions, size_t column,
+	       string& key) {
+  for (auto it = restrictions.begin(); it != restrictions.end(); ++it) {
+    if (it->column != column || it->op != BinaryOp::EQUAL || it->value.is_null()) {
+      continue;
+    }
+    try {
+      append_key(key, table.schema().coerce(column, it->value));
+      return true;
+    } catch (const StorageError&) {
+      // The value has no index key, but evaluating the condition still
+      // compares it correctly
+    }
+  }
+  return false;
+}
+
+// Sets bound to the index key of the value of the first restriction of
+// column with one of the given operators, and returns its operator, or
+// returns EQUAL if there is none
+BinaryOp range_bound(const Table& table, const vector<Restriction>& restrictions, size_t column,
+		     BinaryOp inclusive, BinaryOp exclusive, string& bound) {
+  for (auto it = restrictions.begin(); it != restrictions.end(); ++it) {
+    if (it->column != column || (it->op != inclusive && it->op != exclusive) ||
+	it->value.is_null()) {
+      continue;
+    }
+    try {
+      bound.clear();
+      append_key(bound, table.schema().coerce(column, it->value));
+      return it->op;
+    } catch (const StorageError&) {
+    }
+  }
+  return BinaryOp::EQUAL;
+}
+
+// Plans a scan of an index on columns. Returns a score of 0 if the index
+// cannot narrow down the rows.
+IndexScan plan_scan(const Table& table, const vector<Restriction>& restrictions,
+		    const vector<size_t>& columns, const SecondaryIndex *index) {
+  IndexScan scan{0, index, string(), string()};
+  size_t equal = 0;
+  while (equal < columns.size() && equal_key(table, restrictions, columns[equal], scan.from)) {
+    ++equal;
+  }
+  if (index && index->kind() == IndexKind::HASH) {
+    if (equal == columns.size()) {
+      // Lookups are cheaper than scans of the same rows
+      scan.score = 4 * equal + 1;
+    }
+    return scan;
+  }
+  if (equal == columns.size() && !index) {
+    // At most one row matches all columns of the primary key
+    scan.score = 4 * equal + 3;
+    scan.to = prefix_successor(scan.from);
+    return scan;
+  }
+  scan.score = 4 * equal;
+  const string prefix = scan.from;
+  scan.to = prefix_successor(prefix);
+  if (equal < columns.size()) {
+    string lower;
+    string upper;
+    BinaryOp low = range_bound(table, restrictions, columns[equal], BinaryOp::GEQ,
+			       BinaryOp::GTHAN, lower);
+    BinaryOp high = range_bound(table, restrictions, columns[equal], BinaryOp::LEQ,
+				BinaryOp::LTHAN, upper);
+    if (low != BinaryOp::EQUAL || high != BinaryOp::EQUAL) {
+      scan.score += 2;
+      // Nulls sort first, and are in no range
+      scan.from = prefix + '\x01';
+      if (low == BinaryOp::GEQ) {
+	scan.from = prefix + lower;
+      } else if (low == BinaryOp::GTHAN) {
+	scan.from = prefix_successor(prefix + lower);
+      }
+      if (high == BinaryOp::LEQ) {
+	scan.to = prefix_successor(prefix + upper);
+      } else if (high == BinaryOp::LTHAN) {
+	scan.to = prefix + upper;
+      }
+    }
+  }
+  return scan;
+}
+
+// Returns the best plan for finding the candidate rows of the restrictions
+// with an index, which has a score of 0 if no index narrows them down
+IndexScan best_scan(const Table& table, const vector<Restriction>& restrictions) {
+  IndexScan best{0, nullptr, string(), string()};
+  if (table.primary_index()) {
+    best = plan_scan(table, restrictions, table.schema().primary_key(), nullptr);
+  }
+  for (auto it = table.indexes().begin(); it != table.indexes().end(); ++it) {
+    IndexScan scan = plan_scan(table, restrictions, (*it)->columns(), it->get());
+    if (scan.score > best.score) {
+      best = scan;
+    }
+  }
+  return best;
+}
+
+// Sets candidates to the rows an index finds for the restrictions, and
+// returns true, or returns false if no index narrows them down
+bool index_candidates(const Table& table, const vector<Restriction>& restrictions,
+		      vector<size_t>& candidates) {
+  IndexScan best = best_scan(table, restrictions);
+  if (best.score == 0) {
+    return false;
+  }
+  auto visit = [&](uint64_t row) {
+    candidates.push_back(static_cast<size_t>(row));
+    return true;
+  };
+  const string *to = best.to.empty() ? nullptr : &best.to;
+  if (!best.index) {
+    table.primary_index()->scan(best.from, to, visit);
+  } else if (best.index->kind() == IndexKind::HASH) {
+    vector<uint64_t> rows;
+    best.index->find(best.from, rows);
+    std::for_each(rows.begin(), rows.end(), visit);
+  } else {
+    best.index->scan(best.from, to, visit);
+  }
+  std::sort(candidates.begin(), candidates.end());
+  return true;
+}
+
+// Returns true, and sets index to the ordered index, or null for the
+// primary key, whose leading columns are the key columns, if table has one
+// and the keys all sort in the same direction
+bool ordered_index(const Table& table, const vector<SortKey>& keys,
+		   const SecondaryIndex *&index) {
+  for (auto it = keys.begin(); it != keys.end(); ++it) {
+    if (it->descending != keys.front().descending) {
+      return false;
+    }
+  }
+  auto leads = [&](const vector<size_t>& columns) {
+    if (keys.empty() || columns.size() < keys.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (columns[i] != keys[i].column) {
+	return false;
+      }
+    }
+    return true;
+  };
+  if (table.primary_index() && leads(table.schema().primary_key())) {
+    index = nullptr;
+    return true;
+  }
+  for (auto it = table.indexes().begin(); it != table.indexes().end(); ++it) {
+    if ((*it)->kind() == IndexKind::ORDERED && leads((*it)->columns())) {
+      index = it->get();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Appends to rows the rows of table, numbered from first_row, that the
+// count rows of batch in sel, if filter is null, or those of them filter
+// selects
+void select_batch(const Filter *filter, const Batch& batch, size_t first_row, BatchRow *sel,
+		  size_t count, vector<size_t>& rows) {
+  if (filter) {
+    count = filter->select(batch, sel, count, true, sel);
+  }
+  size_t base = first_row + batch.offset;
+  for (size_t i = 0; i < count; ++i) {
+    rows.push_back(base + sel[i]);
+  }
+}
+
+// Appends to rows the candidates in [begin, end), rows of table in row
+// order, that are not deleted, if filter is null, or those of them filter
+// selects. The candidates are grouped by the batch they fall in.
+void select_candidates(const Table& table, const Filter *filter,
+		       vector<size_t>::const_iterator begin, vector<size_t>::const_iterator end,
+		       vector<size_t>& rows) {
+  BatchRow sel[BATCH_SIZE];
+  const size_t chunk_rows = table.chunk_rows();
+  auto it = begin;
+  while (it != end) {
+    size_t chunk = *it / chunk_rows;
+    size_t offset = *it % chunk_rows / BATCH_SIZE * BATCH_SIZE;
+    ChunkHandle pinned = table.pin(chunk);
+    Batch batch{pinned.get(), offset, 0};
+    batch.size = std::min(BATCH_SIZE, batch.chunk->size() - offset);
+    size_t first_row = chunk * chunk_rows;
+    size_t batch_end = first_row + offset + batch.size;
+    size_t count = 0;
+    for (; it != end && *it < batch_end; ++it) {
+      if (!batch.chunk->is_deleted(*it - first_row)) {
+	sel[count++] = static_cast<BatchRow>(*it - first_row - offset);
+      }
+    }
+    select_batch(filter, batch, first_row, sel, count, rows);
+  }
+}
+
+// Appends to rows the rows of chunks [begin, end) of table that are not
+// deleted, if filter is null, or those of them filter selects. Batches
+// the filter rules out from their zones are not read. Each chunk is only
+// pinned while it is scanned, so the chunks of a table kept in a store
+// can be paged out behind the scan.
+void scan_chunks(const Table& table, const Filter *filter, size_t begin, size_t end,
+		 vector<size_t>& rows) {
+  BatchRow sel[BATCH_SIZE];
+  const size_t chunk_rows = table.chunk_rows();
+  for (size_t chunk = begin; chunk < end; ++chunk) {
+    ChunkHandle pinned = table.pin(chunk);
+    const Chunk *rows_chunk = pinned.get();
+    for (size_t offset = 0; offset < rows_chunk->size(); offset += BATCH_SIZE) {
+      Batch batch{rows_chunk, offset, std::min(BATCH_SIZE, rows_chunk->size() - offset)};
+      if (filter && !filter->may_select(batch)) {
+	continue;
+      }
+      size_t count = select_all(batch, sel);
+      select_batch(filter, batch, chunk * chunk_rows, sel, count, rows);
+    }
+  }
+}
+
+}  // namespace
+
+// Sets rows to the rows of table for which condition is true, in row
+// order. Every row that is not deleted is selected if condition is null.
+// The values of placeholders are taken from parameters. Throws a
+// StorageError if the condition cannot be evaluated, such as when it names
+// a column the table does not have. Expressions in bindings stand for the
+// columns they are bound to.
+//
+// The condition is compiled into filters once, then applied a batch at a
+// time, either to every row of every chunk or to the candidates an index
+// yields, grouped by the batch they fall in. Chunks are scanned in morsels
+// of whole chunks on the drivers of morsel.h, with the threads of pool if
+// it is not null, and the rows of every morsel are appended in order.
+void select_rows(const Table& table, const Expression *condition,
+		 const vector<Value>& parameters, vector<size_t>& rows,
+		 const ExpressionColumns *bindings, ThreadPool *pool) {
+  rows.clear();
+  std::unique_ptr<Filter> filter;
+  vector<size_t> candidates;
+  bool indexed = false;
+  if (condition) {
+    filter = compile_filter(table, condition, parameters, bindings);
+    RestrictionFinder finder(table, parameters, bindings);
+    indexed = index_candidates(table, finder.find(condition), candidates);
+  }
+  if (indexed) {
+    select_candidates(table, filter.get(), candidates.begin(), candidates.end(), rows);
+    return;
+  }
+  const size_t chunks = table.chunk_count();
+  const size_t morsel = std::max<size_t>(1, MORSEL_ROWS / table.chunk_rows());
+  const size_t drivers = morsel_drivers(pool, chunks, morsel);
+  if (drivers == 1) {
+    scan_chunks(table, filter.get(), 0, chunks, rows);
+    return;
+  }
+  vector<vector<size_t>> selected((chunks + morsel - 1) / morsel);
+  run_morsels(pool, chunks, morsel, drivers, [&](size_t begin, size_t end, size_t) {
+      scan_chunks(table, filter.get(), begin, end, selected[begin / morsel]);
+    });
+  size_t total = 0;
+  for (auto it = selected.begin(); it != selected.end(); ++it) {
+    total += it->size();
+  }
+  rows.reserve(total);
+  for (auto it = selected.begin(); it != selected.end(); ++it) {
+    rows.insert(rows.end(), it->begin(), it->end());
+  }
+}
+
+// Passes the rows of table for which condition is true to consume, in row
+// order, a morsel at a time, and stops early if consume returns false.
+// Rows are found as by select_rows(), and only the rows of the morsels
+// being scanned are kept at once: as many morsels as there are drivers
+// are scanned together, then passed on in order on the calling thread.
+// Only the rows the table has when the scan starts are passed, so
+// consume may append rows to it.
+void scan_rows(const Table& table, const Expression *condition,
+	       const vector<Value>& parameters, const RowConsumer& consume,
+	       const ExpressionColumns *bindings, ThreadPool *pool) {
+  std::unique_ptr<Filter> filter;
+  vector<size_t> candidates;
+  bool indexed = false;
+  if (condition) {
+    filter = compile_filter(table, condition, parameters, bindings);
+    RestrictionFinder finder(table, parameters, bindings);
+    indexed = index_candidates(table, finder.find(condition), candidates);
+  }
+  if (indexed) {
+    vector<size_t> rows;
+    for (size_t begin = 0; begin < candidates.size(); begin += MORSEL_ROWS) {
+      auto first = candidates.begin() + begin;
+      rows.clear();
+      select_candidates(table, filter.get(), first,
+			first + std::min(MORSEL_ROWS, candidates.size() - begin), rows);
+      if (!consume(rows)) {
+	return;
+      }
+    }
+    return;
+  }
+  const size_t end_row = table.rows();
+  const size_t chunks = (end_row + table.chunk_rows() - 1) / table.chunk_rows();
+  const size_t morsel = std::max<size_t>(1, MORSEL_ROWS / table.chunk_rows());
+  const size_t drivers = morsel_drivers(pool, chunks, morsel);
+  vector<vector<size_t>> selected(drivers);
+  for (size_t begin = 0; begin < chunks; begin += drivers * morsel) {
+    const size_t end = std::min(chunks, begin + drivers * morsel);
+    for (auto it = selected.begin(); it != selected.end(); ++it) {
+      it->clear();
+    }
+    if (drivers == 1) {
+      scan_chunks(table, filter.get(), begin, end, selected.front());
+    } else {
+      run_morsels(pool, end - begin, morsel, drivers, [&](size_t first, size_t last, size_t) {
+	  scan_chunks(table, filter.get(), begin + first, begin + last, selected[first / morsel]);
+	});
+    }
+    for (auto it = selected.begin(); it != selected.end(); ++it) {
+      // Rows appended to the last chunk since the scan started
+      while (!it->empty() && it->back() >= end_row) {
+	it->pop_back();
+      }
+      if (!consume(*it)) {
+	return;
+      }
+    }
+  }
+}
+
+// Sets rows to the first limit rows of table for which condition is true,
+// in the order of the sort keys, by scanning an ordered index on the key
+// columns in that order and stopping once limit rows are selected.
+// Returns true if it did, or false, leaving rows unchanged, if there is no
+// such index or the condition lets select_rows() use an index, which then
+// narrows the rows down more cheaply. Rows with equal keys come in index
+// order. Expressions in bindings stand for the columns they are bound to.
+//
+// The rows the index yields are checked against the condition in blocks,
+// sorted into row order for the filters; each block is twice the size of
+// the last, starting from limit rows, so few are checked beyond those
+// needed when most rows are selected.
+bool select_ordered_rows(const Table& table, const Expression *condition,
+			 const vector<Value>& parameters, const vector<SortKey>& keys,
+			 size_t limit, vector<size_t>& rows, const ExpressionColumns *bindings) {
+  const SecondaryIndex *index;
+  if (!ordered_index(table, keys, index)) {
+    return false;
+  }
+  std::unique_ptr<Filter> filter;
+  if (condition) {
+    RestrictionFinder finder(table, parameters, bindings);
+    if (best_scan(table, finder.find(condition)).score > 0) {
+      return false;
+    }
+    filter = compile_filter(table, condition, parameters, bindings);
+  }
+  rows.clear();
+  if (limit == 0) {
+    return true;
+  }
+  vector<size_t> block;
+  size_t block_size = std::min(limit, MAX_BLOCK_ROWS);
+  vector<size_t> candidates;
+  vector<size_t> selected;
+  // Appends the rows of the block that are selected to rows, in index
+  // order, until there are limit of them
+  auto flush = [&]() {
+    candidates = block;
+    std::sort(candidates.begin(), candidates.end());
+    selected.clear();
+    select_candidates(table, filter.get(), candidates.begin(), candidates.end(), selected);
+    for (auto it = block.begin(); it != block.end() && rows.size() < limit; ++it) {
+      if (std::binary_search(selected.begin(), selected.end(), *it)) {
+	rows.push_back(*it);
+      }
+    }
+    block.clear();
+    block_size = std::min(2 * block_size, MAX_BLOCK_ROWS);
+  };
+  auto visit = [&](uint64_t row) {
+    block.push_back(static_cast<size_t>(row));
+    if (block.size() == block_size) {
+      flush();
+    }
+    return rows.size() < limit;
+  };
+  const bool descending = keys.front().descending;
+  if (!index) {
+    if (descending) {
+      table.primary_index()->scan_reverse(string(), nullptr, visit);
+    } else {
+      table.primary_index()->scan(string(), nullptr, visit);
+    }
+  } else if (descending) {
+    index->scan_reverse(string(), nullptr, visit);
+  } else {
+    index->scan(string(), nullptr, visit);
+  }
+  if (!block.empty()) {
+    flush();
+  }
+  return true;
+}
@@ -0,0 +1,54 @@
+// SimpleSQL: WHERE evaluation
+//
+// Finds the rows of a table that satisfy the condition of a WHERE clause.
+// Conditions follow SQL's three-valued logic: comparing with NULL gives
+// unknown, and only the rows whose condition is true are selected. The
+// condition is evaluated a batch of rows at a time by filters (see
+// filter.h).
+//
+// Indexes are used automatically. The conjuncts of the condition, the
+// operands of its top-level ANDs, that compare a column with a literal or
+// a parameter restrict that column. If the columns of a hash index are all
+// restricted to be equal to values, or the leading columns of the primary
+// key or an ordered index are, possibly followed by a range on the next
+// column, the index yields the candidate rows, and only they are checked
+// against the whole condition. Otherwise every row of the table is, in
+// parallel on the threads of a pool if one is given, except for the
+// batches of rows whose zones (see column.h) show the condition cannot
+// hold for them. A range on a column that grows as rows are appended, such
+// as the time of a reading, thus only reads the batches of rows in range.
+//
+// When only the first rows in some order are wanted, an ordered index on
+// the columns of that order can instead yield rows in order, so that the
+// scan stops as soon as enough of them are selected.
+//
+// Rows can also be passed on as they are found, a morsel at a time, so
+// that a consumer such as INSERT ... SELECT never holds them all.
+
+#ifndef __WHERE_H__
+#define __WHERE_H__
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "../AST/expression.h"
+#include "../storage/table.h"
+#include "../util/thread_pool.h"
+#include "filter.h"
+#include "sort.h"
+
+void select_rows(const Table& table, const Expression *condition,
+		 const std::vector<Value>& parameters, std::vector<std::size_t>& rows,
+		 const ExpressionColumns *bindings = nullptr, ThreadPool *pool = nullptr);
+// Receives a batch of selected rows, and returns false to stop the scan
+typedef std::function<bool(const std::vector<std::size_t>& rows)> RowConsumer;
+
+void scan_rows(const Table& table, const Expression *condition,
+	       const std::vector<Value>& parameters, const RowConsumer& consume,
+	       const ExpressionColumns *bindings = nullptr, ThreadPool *pool = nullptr);
+bool select_ordered_rows(const Table& table, const Expression *condition,
+			 const std::vector<Value>& parameters, const std::vector<SortKey>& keys,
+			 std::size_t limit, std::vector<std::size_t>& rows,
+			 const ExpressionColumns *bindings = nullptr);
+
+#endif  // __WHERE_H__
@@ -0,0 +1,254 @@
+// SimpleSQL: Character scanning
+//
+// Each vector scanner builds a mask of the bytes that belong to the run
+// being scanned, inverts it, and uses the lowest set bit to locate the end
+// of the run. Bytes past the last full vector are handled by the scalar
+// scanners.
+
+#include "char_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMPLESQL_X86_SCAN
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/*------------------------------------------------
+  Scalar scanners
+  ----------------------------------------------*/
+
+const char *skip_whitespace_scalar(const char *begin, const char *end) {
+  while (begin < end && is_space_char(*begin)) {
+    ++begin;
+  }
+  return begin;
+}
+
+const char *skip_identifier_scalar(const char *begin, const char *end) {
+  while (begin < end && is_identifier_char(*begin)) {
+    ++begin;
+  }
+  return begin;
+}
+
+const char *find_char_scalar(const char *begin, const char *end, char c) {
+  while (begin < end && *begin != c) {
+    ++begin;
+  }
+  return begin;
+}
+
+const Scanners scalar_scanners = {
+  skip_whitespace_scalar,
+  skip_identifier_scalar,
+  find_char_scalar
+};
+
+#ifdef SIMPLESQL_X86_SCAN
+
+/*------------------------------------------------
+  SSE2 scanners
+  ----------------------------------------------*/
+
+// Returns a mask with a byte set to 0xff if lo <= byte <= hi, unsigned
+inline __m128i in_range_sse2(__m128i bytes, char lo, char hi) {
+  __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8(lo));
+  __m128i bound = _mm_set1_epi8(static_cast<char>(hi - lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(shifted, bound), shifted);
+}
+
+inline __m128i space_mask_sse2(__m128i bytes) {
+  return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+		      in_range_sse2(bytes, '\t', '\r'));
+}
+
+inline __m128i identifier_mask_sse2(__m128i bytes) {
+  __m128i folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+  return _mm_or_si128(_mm_or_si128(in_range_sse2(folded, 'a', 'z'),
+				   in_range_sse2(bytes, '0', '9')),
+		      _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+}
+
+const char *skip_whitespace_sse2(const char *begin, const char *end) {
+  for (; begin + 16 <= end; begin += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    unsigned others = ~_mm_movemask_epi8(space_mask_sse2(bytes)) & 0xffff;
+    if (others) {
+      return begin + __builtin_ctz(others);
+    }
+  }
+  return skip_whitespace_scalar(begin, end);
+}
+
+const char *skip_identifier_sse2(const char *begin, const char *end) {
+  for (; begin + 16 <= end; begin += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    unsigned others = ~_mm_movemask_epi8(identifier_mask_sse2(bytes)) & 0xffff;
+    if (others) {
+      return begin + __builtin_ctz(others);
+    }
+  }
+  return skip_identifier_scalar(begin, end);
+}
+
+const char *find_char_sse2(const char *begin, const char *end, char c) {
+  __m128i target = _mm_set1_epi8(c);
+  for (; begin + 16 <= end; begin += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    unsigned matches = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, target));
+    if (matches) {
+      return begin + __builtin_ctz(matches);
+    }
+  }
+  return find_char_scalar(begin, end, c);
+}
+
+const Scanners sse2_scanners = {
+  skip_whitespace_sse2,
+  skip_identifier_sse2,
+  find_char_sse2
+};
+
+/*------------------------------------------------
+  AVX2 scanners
+  ----------------------------------------------*/
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET inline __m256i in_range_avx2(__m256i bytes, char lo, char hi) {
+  __m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8(lo));
+  __m256i bound = _mm256_set1_epi8(static_cast<char>(hi - lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, bound), shifted);
+}
+
+AVX2_TARGET inline __m256i space_mask_avx2(__m256i bytes) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+			 in_range_avx2(bytes, '\t', '\r'));
+}
+
+AVX2_TARGET inline __m256i identifier_mask_avx2(__m256i bytes) {
+  __m256i folded = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+  return _mm256_or_si256(_mm256_or_si256(in_range_avx2(folded, 'a', 'z'),
+					 in_range_avx2(bytes, '0', '9')),
+			 _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+}
+
+AVX2_TARGET const char *skip_whitespace_avx2(const char *begin, const char *end) {
+  for (; begin + 32 <= end; begin += 32) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    unsigned others = ~static_cast<unsigned>(_mm256_movemask_epi8(space_mask_avx2(bytes)));
+    if (others) {
+      return begin + __builtin_ctz(others);
+    }
+  }
+  return skip_whitespace_sse2(begin, end);
+}
+
+AVX2_TARGET const char *skip_identifier_avx2(const char *begin, const char *end) {
+  for (; begin + 32 <= end; begin += 32) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    unsigned others = ~static_cast<unsigned>(_mm256_movemask_epi8(identifier_mask_avx2(bytes)));
+    if (others) {
+      return begin + __builtin_ctz(others);
+    }
+  }
+  return skip_identifier_sse2(begin, end);
+}
+
+AVX2_TARGET const char *find_char_avx2(const char *begin, const char *end, char c) {
+  __m256i target = _mm256_set1_epi8(c);
+  for (; begin + 32 <= end; begin += 32) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    unsigned matches = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, target));
+    if (matches) {
+      return begin + __builtin_ctz(matches);
+    }
+  }
+  return find_char_sse2(begin, end, c);
+}
+
+const Scanners avx2_scanners = {
+  skip_whitespace_avx2,
+  skip_identifier_avx2,
+  find_char_avx2
+};
+
+#endif  // SIMPLESQL_X86_SCAN
+
+// Returns true if the CPU supports the given implementation
+bool supported(ScanLevel level) {
+  switch (level) {
+  case ScanLevel::SCALAR:
+    return true;
+#ifdef SIMPLESQL_X86_SCAN
+  case ScanLevel::SSE2:
+    return __builtin_cpu_supports("sse2");
+  case ScanLevel::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+// Returns the scanners of the given implementation
+const Scanners& scanners_for(ScanLevel level) {
+  switch (level) {
+#ifdef SIMPLESQL_X86_SCAN
+  case ScanLevel::SSE2:
+    return sse2_scanners;
+  case ScanLevel::AVX2:
+    return avx2_scanners;
+#endif
+  default:
+    return scalar_scanners;
+  }
+}
+
+// Returns the widest implementation the CPU supports
+ScanLevel best_level() {
+  if (supported(ScanLevel::AVX2)) {
+    return ScanLevel::AVX2;
+  }
+  if (supported(ScanLevel::SSE2)) {
+    return ScanLevel::SSE2;
+  }
+  return ScanLevel::SCALAR;
+}
+
+// The implementation in use. Selected on first use rather than during
+// static initialization, so that lexing from other static initializers is
+// safe.
+struct Selection {
+  ScanLevel level;
+  const Scanners *scanners;
+  Selection() : level(best_level()), scanners(&scanners_for(level)) {}
+};
+
+Selection& selection() {
+  static Selection selected;
+  return selected;
+}
+
+}  // namespace
+
+// Returns the scanners currently in use
+const Scanners& scanners() {
+  return *selection().scanners;
+}
+
+// Returns the implementation currently in use
+ScanLevel scan_level() {
+  return selection().level;
+}
+
+// Switches to the given implementation if the CPU supports it
+bool set_scan_level(ScanLevel level) {
+  if (!supported(level)) {
+    return false;
+  }
+  selection().level = level;
+  selection().scanners = &scanners_for(level);
+  return true;
+}
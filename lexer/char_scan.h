@@ -0,0 +1,80 @@
+// SimpleSQL: Character scanning
+//
+// Locale-free character classification for the lexer, along with scanners
+// that skip over whole runs of a character class at once. On x86 the
+// scanners classify 16 (SSE2) or 32 (AVX2) bytes per step; the widest
+// implementation the CPU supports is selected the first time one is used.
+
+#ifndef __CHAR_SCAN_H__
+#define __CHAR_SCAN_H__
+
+// The implementations of the scanners that can be selected
+enum class ScanLevel {
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+// Returns true if c is whitespace in the C locale
+inline bool is_space_char(char c) {
+  return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+// Returns true if c is an ASCII letter
+inline bool is_alpha_char(char c) {
+  return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a';
+}
+
+// Returns true if c is an ASCII digit
+inline bool is_digit_char(char c) {
+  return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+// Returns true if the given character is legal in an SQL identifier
+inline bool is_identifier_char(char c) {
+  return is_alpha_char(c) || is_digit_char(c) || c == '_';
+}
+
+// The scanners of one implementation. Each returns a pointer to the first
+// character in [begin, end) that ends the run it scans over, or end.
+struct Scanners {
+  // Skips whitespace
+  const char *(*skip_whitespace)(const char *begin, const char *end);
+  // Skips characters legal in an identifier
+  const char *(*skip_identifier)(const char *begin, const char *end);
+  // Finds the next occurrence of c
+  const char *(*find_char)(const char *begin, const char *end, char c);
+};
+
+// Returns the scanners currently in use
+const Scanners& scanners();
+
+// Returns the implementation currently in use
+ScanLevel scan_level();
+
+// Switches to the given implementation. Returns false, leaving the current
+// implementation in place, if the CPU does not support it.
+bool set_scan_level(ScanLevel level);
+
+// Returns a pointer to the first non-whitespace character in [begin, end),
+// or end
+inline const char *skip_whitespace(const char *begin, const char *end) {
+  // Single spaces between tokens are by far the most common case
+  if (begin < end && !is_space_char(*begin)) {
+    return begin;
+  }
+  return scanners().skip_whitespace(begin, end);
+}
+
+// Returns a pointer to the first character in [begin, end) that is not
+// legal in an identifier, or end
+inline const char *skip_identifier(const char *begin, const char *end) {
+  return scanners().skip_identifier(begin, end);
+}
+
+// Returns a pointer to the first occurrence of c in [begin, end), or end
+inline const char *find_char(const char *begin, const char *end, char c) {
+  return scanners().find_char(begin, end, c);
+}
+
+#endif  // __CHAR_SCAN_H__
@@ -1,23 +1,24 @@
 
 #include "lexer.h"
-#include <locale>
-#include <boost/algorithm/string.hpp>
+#include "char_scan.h"
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <utility>
 #include "lexer_static_data.h"
 using std::vector;
 using std::string;
-using std::map;
-using std::pair;
-using std::make_pair;
 using std::istream;
 using std::ostream;
 using std::unique_ptr;
 
 bool is_keyword(const string& word);
-bool is_legal_in_identifier(char c);
-const Token* const get_token_from_word(const string& word);
-const Token* const get_next_token(char c);
-string to_string(const Tokens type);
+Tokens get_token_type(const TextSpan& word);
+Tokens get_symbol_type(char c);
+const char *lex_number(const char *begin, const char *end, FlatToken& toke);
+const char *lex_string(const char *begin, const char *end, FlatToken& toke);
+const string error_message(const FlatToken& toke);
 
 /*------------------------------------------------
   Token Methods
@@ -40,15 +41,17 @@ ostream& operator<< (ostream& output, const Token& toke) {
 // Returns a string representation of the token
 const string Token::toString() const{
   // keywords : simply look up the string in the keywords list
-  if (type_ <= Tokens::PERCENT) {
-    return boost::algorithm::to_upper_copy(kws[type_].first);
+  if (type_ <= LAST_KEYWORD) {
+    string keyword(kws[type_].name, kws[type_].length);
+    for (auto it = keyword.begin(); it != keyword.end(); ++it) {
+      *it = *it & ~0x20;
+    }
+    return keyword;
   }
   // Symbols: return a string representation of the token
   switch (type_) {
   case STAR:
     return "STAR";
-  case QUOTE:
-    return "QUOTE";
   case SEMICOLON:
     return "SEMICOLON";
   case EQUAL:
@@ -75,6 +78,8 @@ const string Token::toString() const{
     return "PERCENT_SIGN";
   case PLUS:
     return "PLUS";
+  case PLACEHOLDER:
+    return "PLACEHOLDER";
   default:
     return "Error: unrecognized type";
   }
@@ -91,7 +96,7 @@ const string& Identifier::name() const{
 
 // constructs a new identifier using the given name. Assumes that name does not
 // refer to a keyword
-Identifier::Identifier(const string& name) : name_(name), Token(Tokens::IDENTIFIER) {
+Identifier::Identifier(const string& name) : Token(Tokens::IDENTIFIER), name_(name) {
   assert(!is_keyword(name));  
 }
 
@@ -107,7 +112,7 @@ const string Identifier::toString() const {
   ---------------------------------------------*/
 
 // Constructs a new error token with the given message
-Error::Error(const string& error) : error_(error) , Token(Tokens::ERROR) {}
+Error::Error(const string& error) : Token(Tokens::ERROR), error_(error) {}
 
 // returns the error message associated with the token
 const string& Error::error() const{
@@ -122,123 +127,344 @@ const string Error::toString() const {
 
 
 
+/*-----------------------------------------------
+  Literal methods
+  ---------------------------------------------*/
+
+// Constructs a new string literal token holding the given value
+StringLit::StringLit(const string& literal) : Token(Tokens::STRINGLIT), _literal(literal) {}
+
+// Returns the value of the string literal
+const string StringLit::literal() const {
+  return _literal;
+}
+
+// Returns a string representation of the literal of the form
+// "StringLit(<literal>)"
+const string StringLit::toString() const {
+  return "StringLit(" + _literal + ")";
+}
+
+// Constructs a new integer literal token holding the given value
+IntLit::IntLit(long long literal) : Token(Tokens::INTLIT), _literal(literal) {}
+
+// Returns the value of the integer literal
+long long IntLit::literal() const {
+  return _literal;
+}
+
+// Returns a string representation of the literal of the form
+// "IntLit(<literal>)"
+const string IntLit::toString() const {
+  return "IntLit(" + std::to_string(_literal) + ")";
+}
+
+// Constructs a new unsigned integer literal token holding the given value
+UIntLit::UIntLit(unsigned long long literal) : Token(Tokens::UINTLIT), _literal(literal) {}
+
+// Returns the value of the unsigned integer literal
+unsigned long long UIntLit::literal() const {
+  return _literal;
+}
+
+// Returns a string representation of the literal of the form
+// "UIntLit(<literal>)"
+const string UIntLit::toString() const {
+  return "UIntLit(" + std::to_string(_literal) + ")";
+}
+
+// Constructs a new double literal token holding the given value
+DoubleLit::DoubleLit(double literal) : Token(Tokens::DOUBLELIT), _literal(literal) {}
+
+// Returns the value of the double literal
+double DoubleLit::literal() const {
+  return _literal;
+}
+
+// Returns a string representation of the literal of the form
+// "DoubleLit(<literal>)"
+const string DoubleLit::toString() const {
+  return "DoubleLit(" + std::to_string(_literal) + ")";
+}
+
+
+/*-----------------------------------------------
+  Flat token methods
+  ---------------------------------------------*/
+
+// Returns a copy of the characters referred to by the span
+const string TextSpan::str() const {
+  return string(data, length);
+}
+
+// Returns the value of a STRINGLIT flat token. The span excludes the
+// surrounding quotes; a doubled quote inside it stands for a single one.
+const string string_literal(const FlatToken& token) {
+  assert(token.type == Tokens::STRINGLIT);
+  if (!token.literal.escaped) {
+    return token.text.str();
+  }
+  string value;
+  value.reserve(token.text.length);
+  const char *end = token.text.data + token.text.length;
+  for (const char *p = token.text.data; p < end; ++p) {
+    value.push_back(*p);
+    if ((*p == '\'' || *p == '"') && p + 1 < end && *(p + 1) == *p) {
+      ++p;
+    }
+  }
+  return value;
+}
+
+// Converts a flat token into the equivalent dynamically allocated Token.
+// Caller is responsible for deleting the token.
+const Token* const make_token(const FlatToken& token) {
+  switch (token.type) {
+  case Tokens::IDENTIFIER:
+    return new Identifier(token.text.str());
+  case Tokens::STRINGLIT:
+    return new StringLit(string_literal(token));
+  case Tokens::INTLIT:
+    return new IntLit(token.literal.int_value);
+  case Tokens::UINTLIT:
+    return new UIntLit(token.literal.uint_value);
+  case Tokens::DOUBLELIT:
+    return new DoubleLit(token.literal.double_value);
+  case Tokens::ERROR:
+    return new Error(error_message(token));
+  default:
+    return new Token(token.type);
+  }
+}
+
+
 /*-------------------------------------------------------------
   Utility functions
   -----------------------------------------------------------*/
 
-  // Tokenizes the command into a vector of the above tokens.
+// Tokenizes the command into a vector of the above tokens. The tokens are
+// produced by the flat tokenizer and then converted one by one.
 void tokenize_command(const string& command,
-		      vector<unique_ptr<const Token>>& result) {  
-    for ( auto it = command.cbegin(); it < command.cend(); ++it) {
-      // Skip over whitespace
-      if (!std::isspace(static_cast<unsigned char> (*it))) {
-	const Token* new_token;
-	if (std::isalpha(*it)) {
-	  // Parse the next keyword
-	  auto curr = it;
-	  while (is_legal_in_identifier(*curr)) {
-	    ++curr;
-	  }
-	  string word (it, curr);
-	  new_token = get_token_from_word(word);
-	  it = curr - 1;
-	} else {
-	  switch (*it) {
-	  case '<':
-	    // Three special cases: either this is a not equal sign, a less than
-	    // or equal sign, or a less than sign.
-	    if (it + 1 != command.cend()) {
-	      switch (*(it + 1)) {
-	      case '>':
-	      new_token = new Token(Tokens::NEQUAL);
-	      ++it;
-	      break;
-	      case '=':
-		new_token = new Token(Tokens::LEQ);
-	      ++it;
-	      break;
-	      default:
-		new_token = new Token(Tokens::LTHAN);
-		break;
-	    }
-	    } else {
-	      new_token = new Token(Tokens::LTHAN);
-	    }
-	    break;
-	  case '>':
-	    if (it+1 != command.cend() && (*(it + 1)) == '=') {
-	      new_token = new Token(Tokens::GEQ);
-	      ++it;
-	    } else {
-	      new_token = new Token(Tokens::GTHAN);
-	    }
-	    break;
-	  default:
-	    new_token = get_next_token(*it);
-	  }
-	}
-	result.push_back(std::move(unique_ptr<const Token>(new_token)));
-      }
+		      vector<unique_ptr<const Token>>& result) {
+  vector<FlatToken> flat;
+  tokenize_command(command, flat);
+  result.reserve(result.size() + flat.size());
+  for (auto it = flat.cbegin(); it != flat.cend(); ++it) {
+    result.push_back(unique_ptr<const Token>(make_token(*it)));
+  }
+}
+
+// Tokenizes the command into a vector of flat tokens. Spans in the result
+// point into command, which must outlive them.
+void tokenize_command(const string& command, vector<FlatToken>& result) {
+  const char *const end = command.data() + command.size();
+  // Whitespace is skipped a whole run at a time
+  for (const char *it = skip_whitespace(command.data(), end); it < end;
+       it = skip_whitespace(it, end)) {
+    FlatToken toke;
+    it = lex_token(it, end, toke);
+    result.push_back(toke);
+  }
+}
+
+// Lexes the single token starting at the non-whitespace character it into
+// toke, and returns a pointer one past the token's last character. Never
+// looks more than TOKEN_LOOKAHEAD characters past the end of the token.
+const char *lex_token(const char *it, const char *end, FlatToken& toke) {
+  toke.text.data = it;
+  toke.text.length = 1;
+  toke.literal.int_value = 0;
+  if (is_alpha_char(*it)) {
+    // Parse the next keyword or identifier. A qualified name, such as
+    // table.column, is a single identifier.
+    const char *curr = skip_identifier(it, end);
+    while (end - curr > 1 && *curr == '.' && is_alpha_char(curr[1])) {
+      curr = skip_identifier(curr + 1, end);
+    }
+    toke.text.length = curr - it;
+    toke.type = get_token_type(toke.text);
+    return curr;
+  }
+  if (is_digit_char(*it)) {
+    return lex_number(it, end, toke);
+  }
+  if (*it == '\'' || *it == '"') {
+    return lex_string(it, end, toke);
+  }
+  if (*it == '$') {
+    // A numbered placeholder; the number is lexed as an integer
+    const char *curr = it + 1;
+    if (curr == end || !is_digit_char(*curr)) {
+      toke.type = Tokens::ERROR;
+      return curr;
+    }
+    curr = lex_number(curr, end, toke);
+    toke.text.data = it;
+    toke.text.length = curr - it;
+    // Placeholders are numbered from 1
+    bool valid = toke.type == Tokens::INTLIT && toke.literal.int_value > 0;
+    toke.type = valid ? Tokens::PLACEHOLDER : Tokens::ERROR;
+    return curr;
+  }
+  switch (*it) {
+  case '<':
+    // Three special cases: either this is a not equal sign, a less than
+    // or equal sign, or a less than sign.
+    if (it + 1 != end && *(it + 1) == '>') {
+      toke.type = Tokens::NEQUAL;
+      ++toke.text.length;
+    } else if (it + 1 != end && *(it + 1) == '=') {
+      toke.type = Tokens::LEQ;
+      ++toke.text.length;
+    } else {
+      toke.type = Tokens::LTHAN;
+    }
+    break;
+  case '>':
+    if (it + 1 != end && *(it + 1) == '=') {
+      toke.type = Tokens::GEQ;
+      ++toke.text.length;
+    } else {
+      toke.type = Tokens::GTHAN;
+    }
+    break;
+  default:
+    toke.type = get_symbol_type(*it);
+  }
+  return it + toke.text.length;
+}
+
+// Lexes the numeric literal starting at begin into toke, and returns a
+// pointer one past its last character. Integers that fit in a long long are
+// INTLITs, larger ones UINTLITs, and anything with a fraction or exponent
+// (or too large for either) a DOUBLELIT.
+const char *lex_number(const char *begin, const char *end, FlatToken& toke) {
+  const char *curr = begin;
+  unsigned long long value = 0;
+  bool overflow = false;
+  while (curr < end && is_digit_char(*curr)) {
+    unsigned digit = *curr - '0';
+    if (value > (ULLONG_MAX - digit) / 10) {
+      overflow = true;
+    }
+    value = value * 10 + digit;
+    ++curr;
+  }
+  bool is_double = overflow;
+  if (curr + 1 < end && *curr == '.' && is_digit_char(*(curr + 1))) {
+    is_double = true;
+    for (++curr; curr < end && is_digit_char(*curr); ++curr) {}
+  }
+  if (curr < end && (*curr == 'e' || *curr == 'E')) {
+    const char *exp = curr + 1;
+    if (exp < end && (*exp == '+' || *exp == '-')) {
+      ++exp;
     }
+    if (exp < end && is_digit_char(*exp)) {
+      is_double = true;
+      for (curr = exp; curr < end && is_digit_char(*curr); ++curr) {}
+    }
+  }
+  toke.text.length = curr - begin;
+  if (is_double) {
+    // strtod needs a terminated buffer, and the span is not terminated
+    char digits[64];
+    if (toke.text.length >= sizeof(digits)) {
+      toke.type = Tokens::ERROR;
+      return curr;
+    }
+    std::memcpy(digits, begin, toke.text.length);
+    digits[toke.text.length] = '\0';
+    toke.type = Tokens::DOUBLELIT;
+    toke.literal.double_value = std::strtod(digits, nullptr);
+  } else if (value <= static_cast<unsigned long long>(LLONG_MAX)) {
+    toke.type = Tokens::INTLIT;
+    toke.literal.int_value = static_cast<long long>(value);
+  } else {
+    toke.type = Tokens::UINTLIT;
+    toke.literal.uint_value = value;
+  }
+  return curr;
+}
+
+// Lexes the string literal whose opening quote is at begin into toke, and
+// returns a pointer one past its closing quote. Either quote character may
+// delimit a string, and a doubled quote stands for a literal one. An
+// unterminated string becomes an error token covering the rest of the input.
+const char *lex_string(const char *begin, const char *end, FlatToken& toke) {
+  const char quote = *begin;
+  bool escaped = false;
+  for (const char *curr = find_char(begin + 1, end, quote); curr < end;
+       curr = find_char(curr + 1, end, quote)) {
+    if (curr + 1 < end && *(curr + 1) == quote) {
+      escaped = true;
+      ++curr;
+      continue;
+    }
+    toke.type = Tokens::STRINGLIT;
+    toke.text.data = begin + 1;
+    toke.text.length = curr - begin - 1;
+    toke.literal.escaped = escaped;
+    return curr + 1;
   }
-  
+  toke.type = Tokens::ERROR;
+  toke.text.length = end - begin;
+  return end;
+}
 
-  // Returns the next symbolic token given by the character
-  // in the stream. Caller is responsible for deleting the token.
-  // Does not handle the case of symbols beginning with < or >.
-  // Returns an error token in the case of an unrecognizable symbol.
-const Token* const get_next_token(char c) {
+// Returns the type of the single-character symbolic token c. Does not
+// handle the case of symbols beginning with < or >. Returns ERROR in the
+// case of an unrecognizable symbol.
+Tokens get_symbol_type(char c) {
   switch (c) {
   case '*':
-    return new Token(Tokens::STAR);
-  case '\"':
-    return new Token(Tokens::QUOTE);
+    return Tokens::STAR;
   case ';':
-    return new Token(Tokens::SEMICOLON);
+    return Tokens::SEMICOLON;
+  case '?':
+    return Tokens::PLACEHOLDER;
   case '=':
-    return new Token(Tokens::EQUAL);
+    return Tokens::EQUAL;
   case '(':
-    return new Token(Tokens::LPAREN);
+    return Tokens::LPAREN;
   case ')':
-    return new Token(Tokens::RPAREN);
+    return Tokens::RPAREN;
   case '%':
-    return new Token(Tokens::PERCENT_SIGN);
+    return Tokens::PERCENT_SIGN;
   case ',':
-    return new Token(Tokens::COMMA);
+    return Tokens::COMMA;
   case '+':
-    return new Token(Tokens::PLUS);
+    return Tokens::PLUS;
   case '_':
-    return new Token(Tokens::UNDERSCORE);
+    return Tokens::UNDERSCORE;
   default:
-    string error_message("Unrecognized Symbol: ");
-    return new Error(error_message + c);
+    return Tokens::ERROR;
   }
 }
 
+// Returns the message carried by the Error token equivalent to the given
+// flat error token
+const string error_message(const FlatToken& toke) {
+  if (toke.text.data[0] == '\'' || toke.text.data[0] == '"') {
+    return "Unterminated string literal";
+  }
+  if (is_digit_char(toke.text.data[0])) {
+    return "Malformed numeric literal: " + toke.text.str();
+  }
+  if (toke.text.data[0] == '$') {
+    return "Malformed placeholder: " + toke.text.str();
+  }
+  string error_message("Unrecognized Symbol: ");
+  return error_message + toke.text.data[0];
+}
 
 // Returns true if the word given is a registered SQL keyword
 bool is_keyword(const string& word) {
-  string lowercase_word = boost::algorithm::to_lower_copy(word);
-  return keywords.find(lowercase_word) != keywords.end();
-}
-
-
-// Returns true if the given character is legal in an SQL identifier
-bool is_legal_in_identifier(char c) {
-  return isalpha(c) || isdigit(c) || c == '_';
+  return keyword_type(word.data(), word.size()) != Tokens::IDENTIFIER;
 }
 
-// Returns a dynamically allocated Token associated with the given
-// string. Client is responsible for deleting token after use.
-const Token* const get_token_from_word(const string& word) {
-  string lowercase_word = boost::algorithm::to_lower_copy(word);
-  auto it = keywords.find(lowercase_word);
-  if (it == keywords.end()) {
-    return new Identifier(word);
-  }
-  return new Token(it->second);      
+// Returns the keyword type of the given word, or IDENTIFIER if the word
+// is not a keyword
+Tokens get_token_type(const TextSpan& word) {
+  return keyword_type(word.data, word.length);
 }
-
-
-
-
@@ -6,6 +6,7 @@
 
 #ifndef __LEXER_H__
 #define __LEXER_H__
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <memory>
@@ -68,6 +69,8 @@ enum Tokens {
   RIGHT,
   FULL,
   OUTER,
+  ON,
+  USING,
   UNION,
   COALESCE,
   
@@ -79,6 +82,12 @@ enum Tokens {
   LIMIT,
   PERCENT,
 
+  // Constraint keywords
+  PRIMARY,
+  KEY,
+  FOREIGN,
+  REFERENCES,
+
   // Datatype keywords
   INT,
   DOUBLE,
@@ -87,7 +96,6 @@ enum Tokens {
   VARCHAR,
   STRING,
   BINARY,
-  ENUM,
   
   // Semantic Symbols
   STAR,
@@ -111,6 +119,10 @@ enum Tokens {
   UINTLIT,
   DOUBLELIT,
   CHARLIT,
+
+  // Parameter of a prepared statement: ? or $<n>. The literal payload
+  // holds n, or 0 for ?
+  PLACEHOLDER,
     
   // Identifier and Error types
   IDENTIFIER,
@@ -160,14 +172,25 @@ class StringLit : public Token {
 
 class IntLit : public Token {
  public:
-  int literal() const;
-  IntLit(int literal);
+  long long literal() const;
+  IntLit(long long literal);
   virtual const std::string toString() const;
  private:
-  int _literal;
+  long long _literal;
   IntLit();
 };
 
+// An integer literal too large for a long long
+class UIntLit : public Token {
+ public:
+  unsigned long long literal() const;
+  UIntLit(unsigned long long literal);
+  virtual const std::string toString() const;
+ private:
+  unsigned long long _literal;
+  UIntLit();
+};
+
 class DoubleLit : public Token {
  public:
   double literal() const;
@@ -180,9 +203,48 @@ class DoubleLit : public Token {
 
 
 
+// A non-owning reference to a run of characters in the command being
+// tokenized, in the style of std::string_view. Only valid for as long as
+// the command it refers to.
+struct TextSpan {
+  const char *data;
+  std::size_t length;
+  const std::string str() const;
+};
+
+// A value-type token produced by the flat tokenizer. Keywords and symbols
+// only carry their type. Identifiers, string literals and errors refer back
+// into the command through text, and numeric literals are decoded into the
+// inline literal payload, so lexing a command never touches the heap beyond
+// the result vector itself.
+struct FlatToken {
+  Tokens type;
+  TextSpan text;
+  union {
+    long long int_value;
+    unsigned long long uint_value;
+    double double_value;
+    // For STRINGLIT: true if text still contains doubled quote characters
+    // that must be collapsed to read the literal's value
+    bool escaped;
+  } literal;
+};
+
+// Returns the value of a STRINGLIT flat token with its escapes collapsed
+const std::string string_literal(const FlatToken& token);
+
+// Converts a flat token into the equivalent dynamically allocated Token.
+// Caller is responsible for deleting the token.
+const Token* const make_token(const FlatToken& token);
+
 std::ostream& operator<< (std::ostream& output, const Error& error);
 std::ostream& operator<< (std::ostream& output, const Identifier& identifier);
 std::ostream& operator<< (std::ostream& output, const Token& token);
 
+// The furthest past the end of a token that lex_token may look
+const std::size_t TOKEN_LOOKAHEAD = 3;
+
+const char *lex_token(const char *it, const char *end, FlatToken& toke);
+void tokenize_command(const std::string& command, std::vector<FlatToken>& result);
 void tokenize_command(const std::string& command, std::vector<std::unique_ptr<const Token>>& result);
 #endif  // __LEXER_H__
@@ -1,75 +1,218 @@
 #ifndef __LEXER_STATIC_DATA__
 #define __LEXER_STATIC_DATA__
 
+#include <cstddef>
+#include <cstdint>
+#include "lexer.h"
 
+// A registered SQL keyword: its lowercase spelling, the length of that
+// spelling, and the token it lexes to
+struct Keyword {
+  const char *name;
+  std::size_t length;
+  Tokens token;
+};
+
+// Returns the keyword entry for the given spelling and token
+template <std::size_t N>
+constexpr Keyword kw(const char (&name)[N], Tokens token) {
+  return Keyword{name, N - 1, token};
+}
 
-const pair<const string, const Tokens> kws[] = {
-  make_pair("select", Tokens::SELECT),
-  make_pair("update", Tokens::UPDATE),
-  make_pair("delete", Tokens::DELETE),
-  make_pair("insert", Tokens::INSERT),
-  make_pair("into", Tokens::INTO),
-  make_pair("create", Tokens::CREATE),
-  make_pair("database", Tokens::DATABASE),
-  make_pair("alter", Tokens::ALTER),
-  make_pair("table", Tokens::TABLE),
-  make_pair("drop", Tokens::DROP),
-  make_pair("index", Tokens::INDEX),
-  make_pair( "group",Tokens::GROUP),
-  make_pair("by", Tokens::BY),
-  make_pair("procedure", Tokens::PROCEDURE),
-  make_pair("exec", Tokens::EXEC),
-  make_pair("values", Tokens::VALUES),
-  make_pair("from", Tokens::FROM),
-  make_pair("distinct", Tokens::DISTINCT),
-  make_pair("count", Tokens::COUNT),
-  make_pair("where", Tokens::WHERE),
-  make_pair("having", Tokens::HAVING),
-  make_pair("between", Tokens::BETWEEN),
-  make_pair("exists", Tokens::EXISTS),
-  make_pair("any", Tokens::ANY),
-  make_pair("all", Tokens::ALL),
-  make_pair("as", Tokens::AS),
-  make_pair("like", Tokens::LIKE),
-  make_pair("in", Tokens::IN),
-  make_pair("and", Tokens::AND),
-  make_pair("or", Tokens::OR),
-  make_pair("not", Tokens::NOT),
-  make_pair("order", Tokens:: ORDER),
-  make_pair("by", Tokens::BY),
-  make_pair("asc", Tokens::ASC),
-  make_pair("desc", Tokens::DESC),
-  make_pair("is", Tokens::IS),
-  make_pair("null",  Tokens::NUL),
-  make_pair("min", Tokens::MIN),
-  make_pair("max", Tokens::MAX),
-  make_pair("avg", Tokens::AVG),
-  make_pair("sum", Tokens::SUM),
-  make_pair("inner", Tokens::INNER),
-  make_pair("join", Tokens::JOIN),
-  make_pair("left", Tokens::LEFT),
-  make_pair("right", Tokens::RIGHT),
-  make_pair("full", Tokens::FULL),
-  make_pair("outer", Tokens::OUTER),
-  make_pair("union", Tokens::UNION),
-  make_pair("coalesce", Tokens::COALESCE),
-  make_pair("set", Tokens::SET),
-  make_pair("top", Tokens::TOP),
-  make_pair("limit", Tokens::LIMIT),
-  make_pair("percent", Tokens::PERCENT),
+// All keywords, in the same order as the Tokens enum so that the spelling
+// of keyword token t is kws[t]
+constexpr Keyword kws[] = {
+  kw("select", Tokens::SELECT),
+  kw("update", Tokens::UPDATE),
+  kw("delete", Tokens::DELETE),
+  kw("insert", Tokens::INSERT),
+  kw("into", Tokens::INTO),
+  kw("create", Tokens::CREATE),
+  kw("alter", Tokens::ALTER),
+  kw("drop", Tokens::DROP),
+  kw("index", Tokens::INDEX),
+  kw("database", Tokens::DATABASE),
+  kw("table", Tokens::TABLE),
+  kw("group", Tokens::GROUP),
+  kw("by", Tokens::BY),
+  kw("procedure", Tokens::PROCEDURE),
+  kw("exec", Tokens::EXEC),
+  kw("values", Tokens::VALUES),
+  kw("from", Tokens::FROM),
+  kw("distinct", Tokens::DISTINCT),
+  kw("count", Tokens::COUNT),
+  kw("where", Tokens::WHERE),
+  kw("having", Tokens::HAVING),
+  kw("between", Tokens::BETWEEN),
+  kw("exists", Tokens::EXISTS),
+  kw("any", Tokens::ANY),
+  kw("all", Tokens::ALL),
+  kw("as", Tokens::AS),
+  kw("like", Tokens::LIKE),
+  kw("in", Tokens::IN),
+  kw("and", Tokens::AND),
+  kw("or", Tokens::OR),
+  kw("not", Tokens::NOT),
+  kw("order", Tokens::ORDER),
+  kw("asc", Tokens::ASC),
+  kw("desc", Tokens::DESC),
+  kw("is", Tokens::IS),
+  kw("null", Tokens::NUL),
+  kw("min", Tokens::MIN),
+  kw("max", Tokens::MAX),
+  kw("avg", Tokens::AVG),
+  kw("sum", Tokens::SUM),
+  kw("inner", Tokens::INNER),
+  kw("join", Tokens::JOIN),
+  kw("left", Tokens::LEFT),
+  kw("right", Tokens::RIGHT),
+  kw("full", Tokens::FULL),
+  kw("outer", Tokens::OUTER),
+  kw("on", Tokens::ON),
+  kw("using", Tokens::USING),
+  kw("union", Tokens::UNION),
+  kw("coalesce", Tokens::COALESCE),
+  kw("set", Tokens::SET),
+  kw("enum", Tokens::ENUM),
+  kw("top", Tokens::TOP),
+  kw("limit", Tokens::LIMIT),
+  kw("percent", Tokens::PERCENT),
+  // Constraint keywords
+  kw("primary", Tokens::PRIMARY),
+  kw("key", Tokens::KEY),
+  kw("foreign", Tokens::FOREIGN),
+  kw("references", Tokens::REFERENCES),
   // Type keywords
-  make_pair("int", Tokens::INT),
-  make_pair("double", Tokens::DOUBLE),
-  make_pair("unsigned", Tokens::UNSIGNED),
-  make_pair("char", Tokens::CHAR),
-  make_pair("varchar", Tokens::VARCHAR),
-  make_pair("string", Tokens::STRING),
-  make_pair("binary", Tokens::BINARY),
-  make_pair("enum", Tokens::ENUM),
-  make_pair("set", Tokens::SET)
+  kw("int", Tokens::INT),
+  kw("double", Tokens::DOUBLE),
+  kw("unsigned", Tokens::UNSIGNED),
+  kw("char", Tokens::CHAR),
+  kw("varchar", Tokens::VARCHAR),
+  kw("string", Tokens::STRING),
+  kw("binary", Tokens::BINARY)
+};
+
+constexpr std::size_t NUM_KEYWORDS = sizeof(kws) / sizeof(kws[0]);
+
+// The last token type that is a keyword
+constexpr Tokens LAST_KEYWORD = Tokens::BINARY;
+
+static_assert(NUM_KEYWORDS == LAST_KEYWORD + 1,
+	      "every keyword token needs exactly one entry in kws");
+
+
+/*-------------------------------------------------------------
+  Perfect hash over the keywords
+
+  Words are looked up case-insensitively without copying them: every
+  character is folded with | 0x20, which lowercases letters and leaves
+  digits alone. An underscore folds to a character no keyword contains, so
+  folding never makes an identifier compare equal to a keyword. Before
+  hashing, words are rejected on length and on their first character. The
+  hash seed is searched for at compile time until no two keywords collide.
+  -----------------------------------------------------------*/
+
+// Number of slots in the hash table. Must be a power of two.
+constexpr std::size_t KEYWORD_SLOTS = 256;
+
+// Marks an empty slot in the hash table
+constexpr std::uint8_t NO_KEYWORD = 0xff;
+
+// Folds an identifier character for case-insensitive comparison
+constexpr char fold(char c) {
+  return c | 0x20;
+}
+
+// Hashes a word with the given seed. Case-insensitive.
+constexpr std::uint32_t keyword_hash(const char *word, std::size_t length, std::uint32_t seed) {
+  std::uint32_t hash = seed ^ static_cast<std::uint32_t>(length);
+  for (std::size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(fold(word[i]))) * 16777619u;
+  }
+  return hash ^ (hash >> 15);
+}
+
+// The hash table over kws, along with the bounds used for prefiltering
+struct KeywordTable {
+  std::uint32_t seed;
+  std::size_t min_length;
+  std::size_t max_length;
+  // Bit i is set if some keyword starts with the i-th letter
+  std::uint32_t first_letters;
+  std::uint8_t slots[KEYWORD_SLOTS];
 };
 
-const map<const string, const Tokens> keywords (kws, kws + sizeof(kws) / sizeof(kws[0]));
+// Fills the slots of table using its seed. Returns false if two keywords
+// collide.
+constexpr bool fill_keyword_slots(KeywordTable& table) {
+  for (std::size_t i = 0; i < KEYWORD_SLOTS; ++i) {
+    table.slots[i] = NO_KEYWORD;
+  }
+  for (std::size_t i = 0; i < NUM_KEYWORDS; ++i) {
+    std::size_t slot = keyword_hash(kws[i].name, kws[i].length, table.seed) & (KEYWORD_SLOTS - 1);
+    if (table.slots[slot] != NO_KEYWORD) {
+      return false;
+    }
+    table.slots[slot] = static_cast<std::uint8_t>(i);
+  }
+  return true;
+}
+
+// Builds the keyword table, searching for the first seed that hashes every
+// keyword to a distinct slot
+constexpr KeywordTable build_keyword_table() {
+  KeywordTable table{2166136261u, kws[0].length, kws[0].length, 0, {}};
+  for (std::size_t i = 0; i < NUM_KEYWORDS; ++i) {
+    if (kws[i].length < table.min_length) {
+      table.min_length = kws[i].length;
+    }
+    if (kws[i].length > table.max_length) {
+      table.max_length = kws[i].length;
+    }
+    table.first_letters |= 1u << (kws[i].name[0] - 'a');
+  }
+  while (!fill_keyword_slots(table)) {
+    ++table.seed;
+  }
+  return table;
+}
+
+constexpr KeywordTable keyword_table = build_keyword_table();
+
+// Returns the keyword token spelled by the given word, ignoring case, or
+// IDENTIFIER if the word is not a keyword. The word must consist of
+// characters legal in an identifier.
+inline Tokens keyword_type(const char *word, std::size_t length) {
+  if (length < keyword_table.min_length || length > keyword_table.max_length) {
+    return Tokens::IDENTIFIER;
+  }
+  unsigned first = static_cast<unsigned char>(fold(word[0])) - 'a';
+  if (first >= 26 || !(keyword_table.first_letters & (1u << first))) {
+    return Tokens::IDENTIFIER;
+  }
+  std::size_t slot = keyword_hash(word, length, keyword_table.seed) & (KEYWORD_SLOTS - 1);
+  std::uint8_t index = keyword_table.slots[slot];
+  if (index == NO_KEYWORD || kws[index].length != length) {
+    return Tokens::IDENTIFIER;
+  }
+  for (std::size_t i = 0; i < length; ++i) {
+    if (fold(word[i]) != kws[index].name[i]) {
+      return Tokens::IDENTIFIER;
+    }
+  }
+  return kws[index].token;
+}
+
+// Checks at compile time that the table order matches the Tokens enum
+constexpr bool keywords_in_token_order() {
+  for (std::size_t i = 0; i < NUM_KEYWORDS; ++i) {
+    if (kws[i].token != static_cast<Tokens>(i)) {
+      return false;
+    }
+  }
+  return true;
+}
 
+static_assert(keywords_in_token_order(), "kws must be in Tokens order");
 
 #endif  // __LEXER_STATIC_DATA__
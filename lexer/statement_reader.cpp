@@ -0,0 +1,165 @@
+// SimpleSQL: Statement reader
+//
+// The buffer holds the unfinished statement followed by input that has not
+// been lexed yet. When the lexer reaches the end of the buffer, the
+// unfinished statement is moved to the front, the spans of its tokens are
+// rebased, and the rest of the buffer is filled from the stream. A token is
+// only accepted once the characters the lexer may look at past its end are
+// in the buffer too, so tokens straddling a chunk boundary are lexed again
+// after the refill.
+
+#include "statement_reader.h"
+#include <cstring>
+#include "char_scan.h"
+
+using std::vector;
+using std::size_t;
+
+// Constructs a reader over the given stream with a buffer of the given
+// size, which joins statements of up to max_statement bytes
+StatementReader::StatementReader(std::istream& input, size_t buffer_size, size_t max_statement)
+  : _input(input), _buffer(buffer_size), _max_statement(max_statement), _begin(0), _scan(0),
+    _filled(0),
+    _eof(false), _failed(false), _partial(false), _statements(0) {}
+
+// Returns true if the tokens handed out by the last call to next() are not
+// the end of their statement, because the statement does not fit in the
+// buffer
+bool StatementReader::partial() const {
+  return _partial;
+}
+
+// Returns the number of complete statements handed out so far
+size_t StatementReader::statements_read() const {
+  return _statements;
+}
+
+// Replaces the contents of tokens with the tokens of the next statement,
+// including its SEMICOLON. Returns false once the input is exhausted.
+bool StatementReader::next(vector<FlatToken>& tokens) {
+  tokens.clear();
+  _partial = false;
+  if (_failed) {
+    return false;
+  }
+  while (true) {
+    const char *const data = _buffer.data();
+    const char *const end = data + _filled;
+    const char *it = skip_whitespace(data + _scan, end);
+    _scan = it - data;
+    if (tokens.empty()) {
+      // Whitespace between statements need not be kept in the buffer
+      _begin = _scan;
+    }
+    if (it < end) {
+      FlatToken toke;
+      const char *next = lex_token(it, end, toke);
+      if (_eof || static_cast<size_t>(end - next) >= TOKEN_LOOKAHEAD) {
+	tokens.push_back(toke);
+	_scan = next - data;
+	if (toke.type == Tokens::SEMICOLON) {
+	  _begin = _scan;
+	  ++_statements;
+	  return true;
+	}
+	continue;
+      }
+    } else if (_eof) {
+      // The input ended without a final semicolon
+      _begin = _scan;
+      if (tokens.empty()) {
+	return false;
+      }
+      ++_statements;
+      return true;
+    }
+    if (refill(tokens)) {
+      continue;
+    }
+    if (!tokens.empty()) {
+      // The statement is longer than the buffer; hand out what we have and
+      // continue from the token that did not fit
+      _partial = true;
+      _begin = _scan;
+      return true;
+    }
+    // A single token is longer than the buffer
+    FlatToken error;
+    error.type = Tokens::ERROR;
+    error.text.data = _buffer.data() + _scan;
+    error.text.length = _filled - _scan;
+    error.literal.int_value = 0;
+    tokens.push_back(error);
+    _failed = true;
+    return true;
+  }
+}
+
+// Appends the rest of the statement to tokens, if the last call to next()
+// handed out only part of it. The spans of the earlier pieces are copied
+// out of the buffer before it is refilled, so the whole statement is held
+// in memory once this returns. Returns false, clearing tokens and skipping
+// the rest of the statement, if its tokens hold more than max_statement
+// bytes of text.
+bool StatementReader::complete(vector<FlatToken>& tokens) {
+  _spill.clear();
+  // Offsets into _spill of the spans of the tokens copied so far. The
+  // spill may move as it grows, so spans are only pointed into it once
+  // the statement is complete.
+  vector<size_t> offsets;
+  vector<FlatToken> piece;
+  while (_partial) {
+    for (size_t i = offsets.size(); i < tokens.size(); ++i) {
+      offsets.push_back(_spill.size());
+      _spill.append(tokens[i].text.data, tokens[i].text.length);
+    }
+    if (_spill.size() > _max_statement) {
+      while (_partial && next(piece)) {}
+      tokens.clear();
+      _spill.clear();
+      _spill.shrink_to_fit();
+      return false;
+    }
+    if (!next(piece)) {
+      break;
+    }
+    tokens.insert(tokens.end(), piece.begin(), piece.end());
+  }
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    tokens[i].text.data = _spill.data() + offsets[i];
+  }
+  return true;
+}
+
+// Makes the next call to next() hand out the rest of a partial statement
+// starting at token, one of the tokens of the last piece, rather than after
+// the piece. For callers that consume the start of a piece and leave the
+// rest, such as a row it cuts off, to be read again with what follows.
+void StatementReader::resume_at(const FlatToken& token) {
+  if (_partial) {
+    _begin = _scan = token.text.data - _buffer.data();
+  }
+}
+
+// Moves the unfinished statement to the front of the buffer and reads more
+// input after it. Returns false if the buffer is already full.
+bool StatementReader::refill(vector<FlatToken>& tokens) {
+  if (_begin > 0) {
+    std::memmove(_buffer.data(), _buffer.data() + _begin, _filled - _begin);
+    for (auto it = tokens.begin(); it != tokens.end(); ++it) {
+      it->text.data -= _begin;
+    }
+    _filled -= _begin;
+    _scan -= _begin;
+    _begin = 0;
+  }
+  if (_filled == _buffer.size()) {
+    return false;
+  }
+  _input.read(_buffer.data() + _filled, _buffer.size() - _filled);
+  _filled += _input.gcount();
+  if (!_input) {
+    _eof = true;
+  }
+  return true;
+}
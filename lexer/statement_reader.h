@@ -0,0 +1,65 @@
+// SimpleSQL: Statement reader
+//
+// Lexes SQL scripts of any size from a stream, handing out one statement's
+// tokens at a time. The script is read through a single fixed-size buffer,
+// so memory use is bounded by the buffer size rather than the script size.
+
+#ifndef __STATEMENT_READER_H__
+#define __STATEMENT_READER_H__
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+
+// Reads statements from an input stream. Each statement is handed out as
+// soon as its terminating SEMICOLON has been lexed; a final statement with
+// no semicolon is handed out at the end of the input.
+//
+// Tokens refer into the reader's buffer and are only valid until the next
+// call to next() or complete(). A statement too long for the buffer is
+// handed out in pieces, each flagged by partial(). A caller that consumes
+// the pieces as they come, as ValuesLoader does, may resume from a token
+// of its choosing with resume_at(), and needs no more memory than the
+// buffer. Otherwise complete() joins the pieces back together, copying
+// them into memory of its own, up to max_statement bytes of token text;
+// longer statements are skipped. A single token too long for the buffer
+// is reported as an ERROR token, after which the reader stops.
+class StatementReader {
+ public:
+  StatementReader(std::istream& input, std::size_t buffer_size = DEFAULT_BUFFER_SIZE,
+		  std::size_t max_statement = DEFAULT_MAX_STATEMENT);
+  bool next(std::vector<FlatToken>& tokens);
+  bool complete(std::vector<FlatToken>& tokens);
+  void resume_at(const FlatToken& token);
+  bool partial() const;
+  std::size_t statements_read() const;
+
+  static const std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+  static const std::size_t DEFAULT_MAX_STATEMENT = 64 << 20;
+ private:
+  StatementReader() = delete;
+  StatementReader(const StatementReader&) = delete;
+  StatementReader& operator=(const StatementReader&) = delete;
+  bool refill(std::vector<FlatToken>& tokens);
+
+  std::istream& _input;
+  std::vector<char> _buffer;
+  // The most bytes of token text complete() joins
+  const std::size_t _max_statement;
+  // Offset of the start of the statement being lexed
+  std::size_t _begin;
+  // Offset of the next character to lex
+  std::size_t _scan;
+  // Number of characters of input in the buffer
+  std::size_t _filled;
+  bool _eof;
+  bool _failed;
+  bool _partial;
+  std::size_t _statements;
+  // Copies of the spans of statement pieces joined by complete()
+  std::string _spill;
+};
+
+#endif  // __STATEMENT_READER_H__
@@ -1,16 +1,1063 @@
+// SimpleSQL: Parser
+//
+// A recursive descent parser over flat tokens. Each grammar rule is a
+// method of Parser named after the rule, and the grammar of each statement
+// is documented on the AST class it produces.
 
-#include "../lexer/lexer.h"
-#include "../AST/ast_public.h"
+#include "parser.h"
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <memory>
 
 using std::unique_ptr;
 using std::vector;
 using std::string;
+using std::size_t;
 
-const CreateBuilder createBuilder();
+/*------------------------------------------------
+  ParseError methods
+  ----------------------------------------------*/
 
-const vector<const ASTNode* const> parse(const vector<const unique_ptr<const Token>> tokes) {
-  
-  
+// Creates an error with the given message about the token at index token,
+// in the statement at index statement
+ParseError::ParseError(const string& message, size_t token, size_t statement)
+  : std::runtime_error(message), _token(token), _statement(statement) {}
+
+// Returns the index of the token the error was found at
+size_t ParseError::token() const {
+  return _token;
+}
+
+// Returns the index of the statement the error was found in
+size_t ParseError::statement() const {
+  return _statement;
+}
+
+namespace {
+
+// Parses a single statement. Nodes are allocated in the arena; lists are
+// collected in vectors and copied into the arena once complete.
+class Parser {
+ public:
+  Parser(const FlatToken *begin, const FlatToken *end, Arena& arena);
+  const ASTNode *statement();
+  bool values_header(ValuesHeader& header);
+  const FlatToken *rows(RowBatch& batch, bool last, bool& done);
+  size_t parameters() const;
+ private:
+  const FlatToken& peek() const;
+  bool accept(Tokens type);
+  const FlatToken& expect(Tokens type, const char *what);
+  [[noreturn]] void error(const string& message) const;
+
+  const ASTNode *create();
+  const ASTNode *create_index();
+  IndexKind index_kind();
+  const CreateElement *create_element();
+  Datatype datatype(int& length);
+  vector<ArenaString> member_list();
+  const ASTNode *drop();
+  const ASTNode *insert();
+  const InsertOption *values_option(const ArenaString& table,
+				    const ArenaList<ArenaString>& columns);
+  void row(RowBatch& batch);
+  const Select *select();
+  const SelectExpression *select_expression();
+  const GroupByExpr *group_by();
+  const OrderByExpr *order_by();
+  bool join(vector<JoinClause>& joins);
+  const LimitExpr *limit();
+  const ASTNode *delete_statement();
+  const ASTNode *update();
+  const Expression *condition();
+  const Expression *and_condition();
+  const Expression *not_condition();
+  const Expression *predicate();
+  const Expression *expression();
+  const Expression *aggregate();
+  const Expression *literal();
+  bool literal_value(Value& value);
+  bool row_value(Value& value);
+  const Expression *placeholder();
+
+  ArenaString identifier();
+  ArenaString string_value(const FlatToken& toke);
+  ArenaList<SetClause> set_clauses();
+  ArenaList<ArenaString> identifier_list();
+  int int_value();
+
+  const FlatToken *const _begin;
+  const FlatToken *const _end;
+  const FlatToken *_curr;
+  Arena& _arena;
+  CreateBuilder _create;
+  ColumnDeclBuilder _column;
+  // Number of parameters seen so far, and whether they are numbered
+  // explicitly with $n rather than by position with ?
+  size_t _parameters;
+  bool _numbered;
+};
+
+Parser::Parser(const FlatToken *begin, const FlatToken *end, Arena& arena)
+  : _begin(begin), _end(end), _curr(begin), _arena(arena), _create(arena),
+    _column(arena), _parameters(0), _numbered(false) {}
+
+// Returns the number of parameters of the statement parsed, which is the
+// highest placeholder index used
+size_t Parser::parameters() const {
+  return _parameters;
+}
+
+// statement ::= <create_statement> | <drop_statement> | <insert_stmt>
+//             | <select_stmt> | <delete_stmt> | <update_stmt>
+const ASTNode *Parser::statement() {
+  const ASTNode *node;
+  switch (peek().type) {
+  case Tokens::CREATE:
+    node = create();
+    break;
+  case Tokens::DROP:
+    node = drop();
+    break;
+  case Tokens::INSERT:
+    node = insert();
+    break;
+  case Tokens::SELECT:
+    node = select();
+    break;
+  case Tokens::DELETE:
+    node = delete_statement();
+    break;
+  case Tokens::UPDATE:
+    node = update();
+    break;
+  default:
+    error("Expected the start of a statement");
+  }
+  accept(Tokens::SEMICOLON);
+  if (_curr != _end) {
+    error("Expected the end of the statement");
+  }
+  return node;
+}
+
+/*------------------------------------------------
+  Token handling
+  ----------------------------------------------*/
+
+// Returns the current token. Past the end of the statement, this is a
+// SEMICOLON, which ends every statement.
+const FlatToken& Parser::peek() const {
+  static const FlatToken end_of_statement = {Tokens::SEMICOLON, {";", 1}, {0}};
+  if (_curr == _end) {
+    return end_of_statement;
+  }
+  if (_curr->type == Tokens::ERROR) {
+    unique_ptr<const Token> toke(make_token(*_curr));
+    error(static_cast<const Error&>(*toke).error());
+  }
+  return *_curr;
+}
+
+// Consumes the current token if it has the given type, and returns true
+// if it did
+bool Parser::accept(Tokens type) {
+  if (peek().type == type && _curr != _end) {
+    ++_curr;
+    return true;
+  }
+  return false;
+}
+
+// Consumes and returns the current token, which must have the given type.
+// Otherwise reports that what was expected.
+const FlatToken& Parser::expect(Tokens type, const char *what) {
+  const FlatToken& toke = peek();
+  if (toke.type != type || _curr == _end) {
+    error(string("Expected ") + what);
+  }
+  ++_curr;
+  return toke;
+}
+
+// Throws a ParseError with the given message at the current token
+void Parser::error(const string& message) const {
+  throw ParseError(message, _curr - _begin);
+}
+
+/*------------------------------------------------
+  Create statements
+  ----------------------------------------------*/
+
+// create_statement ::= CREATE DATABASE <identifier>
+//                    | CREATE TABLE <identifier> (<element> {, <element>}*)
+//                    | <create_index>
+const ASTNode *Parser::create() {
+  expect(Tokens::CREATE, "CREATE");
+  if (accept(Tokens::DATABASE)) {
+    return _create.type(ASTType::DATABASE).name(identifier()).build();
+  }
+  if (peek().type == Tokens::INDEX) {
+    return create_index();
+  }
+  expect(Tokens::TABLE, "TABLE, DATABASE or INDEX");
+  ArenaString name = identifier();
+  vector<const CreateElement*> elements;
+  expect(Tokens::LPAREN, "(");
+  do {
+    elements.push_back(create_element());
+  } while (accept(Tokens::COMMA));
+  expect(Tokens::RPAREN, ")");
+  return _create.type(ASTType::TABLE).name(name).elements(elements).build();
+}
+
+// create_index ::= INDEX <identifier> ON <table_name>
+//                    (<column_name> {, <column_name>}*) [USING <index_kind>]
+const ASTNode *Parser::create_index() {
+  expect(Tokens::INDEX, "INDEX");
+  ArenaString name = identifier();
+  expect(Tokens::ON, "ON");
+  ArenaString table = identifier();
+  ArenaList<ArenaString> columns = identifier_list();
+  IndexKind kind = IndexKind::ORDERED;
+  if (accept(Tokens::USING)) {
+    kind = index_kind();
+  }
+  return _arena.make<CreateIndex>(name, table, columns, kind);
+}
+
+// index_kind ::= HASH | BTREE
+// Neither is a keyword, so that both remain usable as names.
+IndexKind Parser::index_kind() {
+  const FlatToken& toke = expect(Tokens::IDENTIFIER, "HASH or BTREE");
+  string kind(toke.text.data, toke.text.length);
+  for (auto it = kind.begin(); it != kind.end(); ++it) {
+    *it = static_cast<char>(std::tolower(static_cast<unsigned char>(*it)));
+  }
+  if (kind == "hash") {
+    return IndexKind::HASH;
+  }
+  if (kind == "btree") {
+    return IndexKind::ORDERED;
+  }
+  --_curr;
+  error("Expected HASH or BTREE");
+}
+
+// create_element ::= <column_decl> | <primary_key_decl> | <foreign_key_decl>
+const CreateElement *Parser::create_element() {
+  if (accept(Tokens::PRIMARY)) {
+    expect(Tokens::KEY, "KEY");
+    return _arena.make<PrimaryKeyDecl>(identifier_list());
+  }
+  if (accept(Tokens::FOREIGN)) {
+    expect(Tokens::KEY, "KEY");
+    ArenaList<ArenaString> keys = identifier_list();
+    expect(Tokens::REFERENCES, "REFERENCES");
+    return _arena.make<ForeignKeyDecl>(identifier(), keys);
+  }
+  _column.name(identifier());
+  int length = 0;
+  Datatype type = datatype(length);
+  _column.type(type);
+  if (type == Datatype::ENUM_T || type == Datatype::SET_T) {
+    _column.members(member_list());
+  } else if (accept(Tokens::LPAREN)) {
+    length = int_value();
+    expect(Tokens::RPAREN, ")");
+  }
+  _column.length(length);
+  if (accept(Tokens::NOT)) {
+    expect(Tokens::NUL, "NULL");
+    _column.nullable(false);
+  } else {
+    accept(Tokens::NUL);
+  }
+  return _column.build();
+}
+
+// datatype ::= INT | DOUBLE | UNSIGNED [INT | DOUBLE] | CHAR | VARCHAR
+//            | STRING | BINARY | ENUM | SET
+// Sets length to the default length of the type.
+Datatype Parser::datatype(int& length) {
+  switch (peek().type) {
+  case Tokens::INT:
+    ++_curr;
+    return Datatype::INT_T;
+  case Tokens::DOUBLE:
+    ++_curr;
+    return Datatype::DOUBLE_T;
+  case Tokens::UNSIGNED:
+    ++_curr;
+    if (accept(Tokens::DOUBLE)) {
+      return Datatype::UDOUBLE_T;
+    }
+    accept(Tokens::INT);
+    return Datatype::UINT_T;
+  case Tokens::CHAR:
+    ++_curr;
+    length = 1;
+    return Datatype::CHAR_T;
+  case Tokens::VARCHAR:
+    ++_curr;
+    return Datatype::VARCHAR_T;
+  case Tokens::STRING:
+    ++_curr;
+    return Datatype::STRING_T;
+  case Tokens::BINARY:
+    ++_curr;
+    return Datatype::BINARY_T;
+  case Tokens::ENUM:
+    ++_curr;
+    return Datatype::ENUM_T;
+  case Tokens::SET:
+    ++_curr;
+    return Datatype::SET_T;
+  default:
+    error("Expected a column type");
+  }
+}
+
+// member_list ::= (<string> {, <string>}*)
+vector<ArenaString> Parser::member_list() {
+  vector<ArenaString> members;
+  expect(Tokens::LPAREN, "(");
+  do {
+    members.push_back(string_value(expect(Tokens::STRINGLIT, "a string")));
+  } while (accept(Tokens::COMMA));
+  expect(Tokens::RPAREN, ")");
+  return members;
+}
+
+/*------------------------------------------------
+  Drop statements
+  ----------------------------------------------*/
+
+// drop_statement ::= DROP [TABLE | DATABASE | INDEX] <name>
+const ASTNode *Parser::drop() {
+  expect(Tokens::DROP, "DROP");
+  if (accept(Tokens::DATABASE)) {
+    return _arena.make<DropDatabase>(identifier());
+  }
+  if (accept(Tokens::INDEX)) {
+    return _arena.make<DropIndex>(identifier());
+  }
+  accept(Tokens::TABLE);
+  return _arena.make<DropTable>(identifier());
+}
+
+/*------------------------------------------------
+  Insert statements
+  ----------------------------------------------*/
+
+// insert_stmt ::= INSERT [INTO] <table_name>
+//                   { [(<column_name> {, <column_name>}*)] <values_option>
+//                   | [(<column_name> {, <column_name>}*)] <select_stmt>
+//                   | SET <column_name>=<expr> {, <column_name>=<expr>}* }
+const ASTNode *Parser::insert() {
+  expect(Tokens::INSERT, "INSERT");
+  accept(Tokens::INTO);
+  ArenaString table = identifier();
+  const InsertOption *option;
+  if (accept(Tokens::SET)) {
+    option = _arena.make<SetOption>(set_clauses(), table);
+  } else {
+    ArenaList<ArenaString> columns;
+    if (peek().type == Tokens::LPAREN) {
+      columns = identifier_list();
+    }
+    if (peek().type == Tokens::SELECT) {
+      option = _arena.make<SelectOption>(table, columns, select());
+      return _arena.make<Insert>(option);
+    }
+    option = values_option(table, columns);
+  }
+  return _arena.make<Insert>(option);
+}
+
+// values_option ::= VALUES <row> {, <row>}*
+// row ::= (<expr> {, <expr>}*)
+// Every row must have as many values as the first. Literals are converted
+// to values as they are read, and the rows of a bulk load are collected in
+// one list, so no node is made for them.
+const InsertOption *Parser::values_option(const ArenaString& table,
+					  const ArenaList<ArenaString>& columns) {
+  expect(Tokens::VALUES, "VALUES, SELECT or SET");
+  vector<Value> values;
+  vector<RowExpression> expressions;
+  size_t width = 0;
+  do {
+    const FlatToken *first = &expect(Tokens::LPAREN, "(");
+    const size_t start = values.size();
+    do {
+      Value value;
+      if (!literal_value(value)) {
+	expressions.push_back(RowExpression{values.size(), expression()});
+      }
+      values.push_back(value);
+    } while (accept(Tokens::COMMA));
+    if (start == 0) {
+      width = values.size();
+      // Later rows are assumed to take as many tokens as the first
+      const size_t row_tokens = _curr - first + 2;
+      values.reserve(width * (1 + (_end - _curr) / row_tokens));
+    } else if (values.size() - start != width) {
+      error("Expected " + std::to_string(width) + " values in every row");
+    }
+    expect(Tokens::RPAREN, ")");
+  } while (accept(Tokens::COMMA));
+  return _arena.make<ValuesOption>(table, columns, width, ArenaList<Value>(_arena, values),
+				   ArenaList<RowExpression>(_arena, expressions));
+}
+
+// values_header ::= INSERT [INTO] <table_name> [(<column_name> {, <column_name>}*)] VALUES
+// Returns false, leaving header incomplete, if the statement is not an
+// INSERT ... VALUES.
+bool Parser::values_header(ValuesHeader& header) {
+  if (!accept(Tokens::INSERT)) {
+    return false;
+  }
+  accept(Tokens::INTO);
+  header.table = identifier();
+  header.columns = ArenaList<ArenaString>();
+  if (peek().type == Tokens::LPAREN) {
+    header.columns = identifier_list();
+  }
+  if (!accept(Tokens::VALUES)) {
+    return false;
+  }
+  header.rows = _curr;
+  return true;
+}
+
+// rows ::= <row> {, <row>}*
+// Parses rows into batch until it is full or the rows end, and returns the
+// first token not parsed. done is set once the last row of the statement
+// has been parsed. Unless last is set, more tokens of the statement follow
+// _end, so a row they cut off, or whose successor cannot be seen yet, is
+// left for the caller to parse again with the tokens that follow.
+const FlatToken *Parser::rows(RowBatch& batch, bool last, bool& done) {
+  done = false;
+  while (batch.count < batch.capacity) {
+    const FlatToken *const start = _curr;
+    const size_t expressions = batch.expressions.size();
+    bool cut_off = false;
+    try {
+      row(batch);
+      cut_off = _curr == _end && !last;
+    } catch (const ParseError&) {
+      // A row that runs into the end of the tokens is only an error if
+      // nothing follows
+      if (last || _curr != _end) {
+	throw;
+      }
+      cut_off = true;
+    }
+    if (cut_off) {
+      batch.expressions.resize(expressions);
+      return start;
+    }
+    ++batch.count;
+    if (!accept(Tokens::COMMA)) {
+      accept(Tokens::SEMICOLON);
+      if (_curr != _end) {
+	error("Expected the end of the statement");
+      }
+      done = true;
+      return _curr;
+    }
+  }
+  return _curr;
+}
+
+// row ::= (<expr> {, <expr>}*)
+// Parses a row into the next row of batch
+void Parser::row(RowBatch& batch) {
+  expect(Tokens::LPAREN, "(");
+  if (batch.values.size() < (batch.count + 1) * batch.stride) {
+    batch.values.resize((batch.count + 1) * batch.stride);
+  }
+  Value *const out = &batch.values[batch.count * batch.stride];
+  const size_t width = batch.targets.size();
+  size_t i = 0;
+  do {
+    if (i == width) {
+      error("Expected " + std::to_string(width) + " values in every row");
+    }
+    Value& value = out[batch.targets[i++]];
+    if (!row_value(value)) {
+      value = Value();
+      batch.expressions.push_back(RowExpression{static_cast<size_t>(&value - batch.values.data()),
+					       expression()});
+    }
+  } while (accept(Tokens::COMMA));
+  if (i != width) {
+    error("Expected " + std::to_string(width) + " values in every row");
+  }
+  expect(Tokens::RPAREN, ")");
+}
+
+/*------------------------------------------------
+  Select statements
+  ----------------------------------------------*/
+
+// select_stmt ::= SELECT {* | <expr> {, <expr>}*} [<select_expr>]
+const Select *Parser::select() {
+  expect(Tokens::SELECT, "SELECT");
+  vector<const Expression*> columns;
+  if (!accept(Tokens::STAR)) {
+    do {
+      columns.push_back(expression());
+    } while (accept(Tokens::COMMA));
+  }
+  const SelectExpression *exp = nullptr;
+  if (peek().type == Tokens::FROM) {
+    exp = select_expression();
+  }
+  return _arena.make<Select>(ArenaList<const Expression*>(_arena, columns), exp);
+}
+
+// select_expr ::= FROM <table_name> {, <table_name>}* {<join>}*
+//                   [WHERE <condition>]
+//                   [<group_by>] [HAVING <condition>] [<order_by>]
+//                   [LIMIT [<offset>, ] <row_count>]
+const SelectExpression *Parser::select_expression() {
+  expect(Tokens::FROM, "FROM");
+  vector<ArenaString> tables;
+  do {
+    tables.push_back(identifier());
+  } while (accept(Tokens::COMMA));
+  vector<JoinClause> joins;
+  while (join(joins)) {
+  }
+  const WhereExpr *where = nullptr;
+  if (accept(Tokens::WHERE)) {
+    where = _arena.make<WhereExpr>(condition());
+  }
+  const GroupByExpr *group = nullptr;
+  if (peek().type == Tokens::GROUP) {
+    group = group_by();
+  }
+  const HavingExpr *having = nullptr;
+  if (accept(Tokens::HAVING)) {
+    having = _arena.make<HavingExpr>(condition());
+  }
+  const OrderByExpr *order = nullptr;
+  if (peek().type == Tokens::ORDER) {
+    order = order_by();
+  }
+  const LimitExpr *limit_expr = nullptr;
+  if (peek().type == Tokens::LIMIT) {
+    limit_expr = limit();
+  }
+  return _arena.make<SelectExpression>(ArenaList<ArenaString>(_arena, tables),
+				       ArenaList<JoinClause>(_arena, joins), where, group, having,
+				       order, limit_expr);
+}
+
+// join ::= [INNER | {LEFT | RIGHT | FULL} [OUTER]] JOIN <table_name>
+//          ON <condition>
+// Appends the join to joins and returns true, or returns false if the
+// next token does not start a join.
+bool Parser::join(vector<JoinClause>& joins) {
+  JoinKind kind = JoinKind::INNER;
+  if (accept(Tokens::LEFT)) {
+    kind = JoinKind::LEFT;
+  } else if (accept(Tokens::RIGHT)) {
+    kind = JoinKind::RIGHT;
+  } else if (accept(Tokens::FULL)) {
+    kind = JoinKind::FULL;
+  } else if (!accept(Tokens::INNER) && peek().type != Tokens::JOIN) {
+    return false;
+  }
+  if (kind != JoinKind::INNER) {
+    accept(Tokens::OUTER);
+  }
+  expect(Tokens::JOIN, "JOIN");
+  ArenaString table = identifier();
+  expect(Tokens::ON, "ON");
+  joins.push_back(JoinClause(kind, table, condition()));
+  return true;
 }
 
+// group_by ::= GROUP BY <expr> {, <expr>}*
+const GroupByExpr *Parser::group_by() {
+  expect(Tokens::GROUP, "GROUP");
+  expect(Tokens::BY, "BY");
+  vector<const Expression*> columns;
+  do {
+    columns.push_back(expression());
+  } while (accept(Tokens::COMMA));
+  return _arena.make<GroupByExpr>(ArenaList<const Expression*>(_arena, columns));
+}
+
+// order_by ::= ORDER BY <expr> [ASC | DESC] {, <expr> [ASC | DESC]}*
+const OrderByExpr *Parser::order_by() {
+  expect(Tokens::ORDER, "ORDER");
+  expect(Tokens::BY, "BY");
+  vector<OrderByItem> items;
+  do {
+    const Expression *value = expression();
+    bool descending = accept(Tokens::DESC);
+    if (!descending) {
+      accept(Tokens::ASC);
+    }
+    items.push_back(OrderByItem(value, descending));
+  } while (accept(Tokens::COMMA));
+  return _arena.make<OrderByExpr>(ArenaList<OrderByItem>(_arena, items));
+}
+
+// limit ::= LIMIT [<offset>, ] <row_count>
+const LimitExpr *Parser::limit() {
+  expect(Tokens::LIMIT, "LIMIT");
+  int offset = 0;
+  int rows = int_value();
+  if (accept(Tokens::COMMA)) {
+    offset = rows;
+    rows = int_value();
+  }
+  return _arena.make<LimitExpr>(offset, rows);
+}
+
+/*------------------------------------------------
+  Delete statements
+  ----------------------------------------------*/
+
+// delete_stmt ::= DELETE FROM <table_name> [WHERE <condition>]
+const ASTNode *Parser::delete_statement() {
+  expect(Tokens::DELETE, "DELETE");
+  expect(Tokens::FROM, "FROM");
+  ArenaString table = identifier();
+  const Expression *where = nullptr;
+  if (accept(Tokens::WHERE)) {
+    where = condition();
+  }
+  return _arena.make<Delete>(table, where);
+}
+
+/*------------------------------------------------
+  Update statements
+  ----------------------------------------------*/
+
+// update_stmt ::= UPDATE <table_name> SET <set_clause> {, <set_clause>}*
+//                   [WHERE <condition>]
+const ASTNode *Parser::update() {
+  expect(Tokens::UPDATE, "UPDATE");
+  ArenaString table = identifier();
+  expect(Tokens::SET, "SET");
+  ArenaList<SetClause> set = set_clauses();
+  const Expression *where = nullptr;
+  if (accept(Tokens::WHERE)) {
+    where = condition();
+  }
+  return _arena.make<Update>(table, set, where);
+}
+
+/*------------------------------------------------
+  Expressions
+  ----------------------------------------------*/
+
+// condition ::= <and_condition> {OR <and_condition>}*
+const Expression *Parser::condition() {
+  const Expression *left = and_condition();
+  while (accept(Tokens::OR)) {
+    left = _arena.make<BinaryExpr>(BinaryOp::OR, left, and_condition());
+  }
+  return left;
+}
+
+// and_condition ::= <not_condition> {AND <not_condition>}*
+const Expression *Parser::and_condition() {
+  const Expression *left = not_condition();
+  while (accept(Tokens::AND)) {
+    left = _arena.make<BinaryExpr>(BinaryOp::AND, left, not_condition());
+  }
+  return left;
+}
+
+// not_condition ::= NOT <not_condition> | <predicate>
+const Expression *Parser::not_condition() {
+  if (accept(Tokens::NOT)) {
+    return _arena.make<NotExpr>(not_condition());
+  }
+  return predicate();
+}
+
+// predicate ::= (<condition>)
+//             | <expr> [<comparison> <expr>
+//                      | [NOT] BETWEEN <expr> AND <expr>
+//                      | [NOT] IN (<expr> {, <expr>}*)
+//                      | IS [NOT] NULL]
+// comparison ::= = | != | > | < | >= | <=
+const Expression *Parser::predicate() {
+  if (accept(Tokens::LPAREN)) {
+    const Expression *inner = condition();
+    expect(Tokens::RPAREN, ")");
+    return inner;
+  }
+  const Expression *left = expression();
+  if (accept(Tokens::IS)) {
+    bool negated = accept(Tokens::NOT);
+    expect(Tokens::NUL, "NULL");
+    return _arena.make<IsNullExpr>(left, negated);
+  }
+  bool negated = accept(Tokens::NOT);
+  if (accept(Tokens::BETWEEN)) {
+    const Expression *low = expression();
+    expect(Tokens::AND, "AND");
+    return _arena.make<BetweenExpr>(left, low, expression(), negated);
+  }
+  if (accept(Tokens::IN)) {
+    vector<const Expression*> list;
+    expect(Tokens::LPAREN, "(");
+    do {
+      list.push_back(expression());
+    } while (accept(Tokens::COMMA));
+    expect(Tokens::RPAREN, ")");
+    return _arena.make<InExpr>(left, ArenaList<const Expression*>(_arena, list), negated);
+  }
+  if (negated) {
+    --_curr;
+    error("Expected BETWEEN or IN");
+  }
+  BinaryOp op;
+  switch (peek().type) {
+  case Tokens::EQUAL:
+    op = BinaryOp::EQUAL;
+    break;
+  case Tokens::NEQUAL:
+    op = BinaryOp::NEQUAL;
+    break;
+  case Tokens::GTHAN:
+    op = BinaryOp::GTHAN;
+    break;
+  case Tokens::LTHAN:
+    op = BinaryOp::LTHAN;
+    break;
+  case Tokens::GEQ:
+    op = BinaryOp::GEQ;
+    break;
+  case Tokens::LEQ:
+    op = BinaryOp::LEQ;
+    break;
+  default:
+    return left;
+  }
+  ++_curr;
+  return _arena.make<BinaryExpr>(op, left, expression());
+}
+
+// expr ::= <literal> | <placeholder> | <column_ref> | <aggregate>
+const Expression *Parser::expression() {
+  switch (peek().type) {
+  case Tokens::PLACEHOLDER:
+    return placeholder();
+  case Tokens::COUNT:
+  case Tokens::SUM:
+  case Tokens::MIN:
+  case Tokens::MAX:
+  case Tokens::AVG:
+    return aggregate();
+  case Tokens::IDENTIFIER:
+    return _arena.make<ColumnRef>(identifier());
+  default:
+    return literal();
+  }
+}
+
+// aggregate ::= COUNT(*) | <function>([DISTINCT] <expr>)
+// function ::= COUNT | SUM | MIN | MAX | AVG
+const Expression *Parser::aggregate() {
+  AggregateFunction function;
+  switch (peek().type) {
+  case Tokens::COUNT:
+    function = AggregateFunction::COUNT;
+    break;
+  case Tokens::SUM:
+    function = AggregateFunction::SUM;
+    break;
+  case Tokens::MIN:
+    function = AggregateFunction::MIN;
+    break;
+  case Tokens::MAX:
+    function = AggregateFunction::MAX;
+    break;
+  default:
+    function = AggregateFunction::AVG;
+    break;
+  }
+  ++_curr;
+  expect(Tokens::LPAREN, "(");
+  if (function == AggregateFunction::COUNT && accept(Tokens::STAR)) {
+    expect(Tokens::RPAREN, ")");
+    return _arena.make<AggregateExpr>(function, nullptr, false);
+  }
+  bool distinct = accept(Tokens::DISTINCT);
+  const Expression *argument = expression();
+  expect(Tokens::RPAREN, ")");
+  return _arena.make<AggregateExpr>(function, argument, distinct);
+}
+
+// literal ::= NULL | <int> | <double> | <string>
+const Expression *Parser::literal() {
+  Value value;
+  if (!literal_value(value)) {
+    error("Expected a value");
+  }
+  return _arena.make<Literal>(value);
+}
+
+// Consumes a literal, if the next token is one, and sets value to its
+// value. Returns false, consuming nothing, if it is not.
+bool Parser::literal_value(Value& value) {
+  const FlatToken& toke = peek();
+  switch (toke.type) {
+  case Tokens::NUL:
+    value = Value();
+    break;
+  case Tokens::INTLIT:
+    value = Value(toke.literal.int_value);
+    break;
+  case Tokens::UINTLIT:
+    value = Value(toke.literal.uint_value);
+    break;
+  case Tokens::DOUBLELIT:
+    value = Value(toke.literal.double_value);
+    break;
+  case Tokens::STRINGLIT: {
+    ArenaString string = string_value(toke);
+    value = Value(string.data(), string.length());
+    break;
+  }
+  default:
+    return false;
+  }
+  ++_curr;
+  return true;
+}
 
+// Like literal_value(), but a string literal with no escapes refers to the
+// token's text rather than a copy, so the value is only valid as long as
+// the token is. Used for rows that are stored before the tokens go.
+bool Parser::row_value(Value& value) {
+  const FlatToken& toke = peek();
+  if (toke.type != Tokens::STRINGLIT || toke.literal.escaped) {
+    return literal_value(value);
+  }
+  value = Value(toke.text.data, toke.text.length);
+  ++_curr;
+  return true;
+}
+
+// placeholder ::= ? | $<n>
+// Placeholders written ? are numbered in order of appearance. A statement
+// may use either form, but not both.
+const Expression *Parser::placeholder() {
+  const FlatToken& toke = expect(Tokens::PLACEHOLDER, "a placeholder");
+  bool numbered = toke.literal.int_value != 0;
+  if (_parameters > 0 && numbered != _numbered) {
+    --_curr;
+    error("Cannot mix ? and $n placeholders");
+  }
+  _numbered = numbered;
+  size_t index = numbered ? static_cast<size_t>(toke.literal.int_value) : _parameters + 1;
+  if (index > _parameters) {
+    _parameters = index;
+  }
+  return _arena.make<Placeholder>(index - 1);
+}
+
+/*------------------------------------------------
+  Shared rules
+  ----------------------------------------------*/
+
+// Consumes an identifier and returns its name, copied into the arena
+ArenaString Parser::identifier() {
+  const FlatToken& toke = expect(Tokens::IDENTIFIER, "an identifier");
+  return ArenaString(_arena, toke.text.data, toke.text.length);
+}
+
+// Returns the value of a string literal token, copied into the arena
+ArenaString Parser::string_value(const FlatToken& toke) {
+  if (!toke.literal.escaped) {
+    return ArenaString(_arena, toke.text.data, toke.text.length);
+  }
+  return ArenaString(_arena, string_literal(toke));
+}
+
+// set_clauses ::= <column_name>=<expr> {, <column_name>=<expr>}*
+ArenaList<SetClause> Parser::set_clauses() {
+  vector<SetClause> set;
+  do {
+    ArenaString column = identifier();
+    expect(Tokens::EQUAL, "=");
+    set.push_back(SetClause(column, expression()));
+  } while (accept(Tokens::COMMA));
+  return ArenaList<SetClause>(_arena, set);
+}
+
+// identifier_list ::= (<identifier> {, <identifier>}*)
+ArenaList<ArenaString> Parser::identifier_list() {
+  vector<ArenaString> names;
+  expect(Tokens::LPAREN, "(");
+  do {
+    names.push_back(identifier());
+  } while (accept(Tokens::COMMA));
+  expect(Tokens::RPAREN, ")");
+  return ArenaList<ArenaString>(_arena, names);
+}
+
+// Consumes an integer literal that fits in an int and returns its value
+int Parser::int_value() {
+  const FlatToken& toke = expect(Tokens::INTLIT, "an integer");
+  if (toke.literal.int_value > INT32_MAX) {
+    error("Integer too large");
+  }
+  return static_cast<int>(toke.literal.int_value);
+}
+
+}  // namespace
+
+// Parses a single statement from the tokens in [begin, end), allocating its
+// AST in arena. The statement may end in a SEMICOLON. Throws a ParseError,
+// with a token index relative to begin, if the tokens are not a statement.
+// If parameters is not null, it is set to the number of parameters the
+// statement takes.
+const ASTNode *parse_statement(const FlatToken *begin, const FlatToken *end, Arena& arena,
+			       size_t *parameters) {
+  Parser parser(begin, end, arena);
+  const ASTNode *node = parser.statement();
+  if (parameters) {
+    *parameters = parser.parameters();
+  }
+  return node;
+}
+
+// Parses the start of the INSERT ... VALUES statement in [begin, end), up
+// to its first row, into header, allocating its strings in arena. Returns
+// false if the tokens do not start an INSERT ... VALUES statement.
+bool parse_values_header(const FlatToken *begin, const FlatToken *end, Arena& arena,
+			 ValuesHeader& header) {
+  Parser parser(begin, end, arena);
+  try {
+    return parser.values_header(header);
+  } catch (const ParseError&) {
+    // Left for the statement's parse to report
+    return false;
+  }
+}
+
+// Parses the rows of a VALUES list from the tokens in [begin, end) into
+// batch, and returns the first token not parsed. Parsing stops once batch
+// is full or the statement ends, when done is set. Unless last is set, the
+// statement goes on past end, and rows that may not be complete are left
+// to be parsed again along with the tokens that follow. Throws a
+// ParseError, with a token index relative to begin, at an invalid row.
+const FlatToken *parse_rows(const FlatToken *begin, const FlatToken *end, bool last,
+			    Arena& arena, RowBatch& batch, bool& done) {
+  Parser parser(begin, end, arena);
+  return parser.rows(batch, last, done);
+}
+
+// Splits tokes into statements at each SEMICOLON, and returns the half open
+// token range of every non-empty statement in order. The lexer never
+// produces a SEMICOLON inside a literal, and no statement nests another,
+// so every SEMICOLON ends a statement.
+vector<std::pair<const FlatToken*, const FlatToken*>> split_statements(const vector<FlatToken>& tokes) {
+  vector<std::pair<const FlatToken*, const FlatToken*>> statements;
+  const FlatToken *const last = tokes.data() + tokes.size();
+  const FlatToken *begin = tokes.data();
+  while (begin != last) {
+    const FlatToken *end = begin;
+    while (end != last && end->type != Tokens::SEMICOLON) {
+      ++end;
+    }
+    if (end != begin) {
+      statements.push_back(std::make_pair(begin, end));
+    }
+    begin = end == last ? last : end + 1;
+  }
+  return statements;
+}
+
+// Parses every statement in tokes, allocating their ASTs in arena, and
+// returns their roots in order. Empty statements are skipped. Throws a
+// ParseError, with a token index relative to the start of tokes, at the
+// first invalid statement.
+const vector<const ASTNode*> parse(const vector<FlatToken>& tokes, Arena& arena) {
+  vector<const ASTNode*> statements;
+  auto ranges = split_statements(tokes);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    try {
+      statements.push_back(parse_statement(ranges[i].first, ranges[i].second, arena));
+    } catch (const ParseError& e) {
+      throw ParseError(e.what(), e.token() + (ranges[i].first - tokes.data()), i);
+    }
+  }
+  return statements;
+}
+
+// Parses every statement in tokes on the workers of pool, and returns their
+// roots in order. The statements are divided into contiguous batches of
+// similar token counts, a few per worker so that uneven statements still
+// balance. Each batch is parsed into an arena of its own, since arenas are
+// not thread safe; the arenas are appended to arenas and must outlive the
+// ASTs. Throws the ParseError of the first invalid statement.
+const vector<const ASTNode*> parse(const vector<FlatToken>& tokes,
+				   vector<unique_ptr<Arena>>& arenas, ThreadPool& pool) {
+  auto ranges = split_statements(tokes);
+  const size_t batches_per_worker = 4;
+  size_t batches = pool.size() * batches_per_worker;
+  if (batches > ranges.size()) {
+    batches = ranges.size();
+  }
+  if (batches <= 1) {
+    arenas.push_back(unique_ptr<Arena>(new Arena()));
+    return parse(tokes, *arenas.back());
+  }
+
+  vector<const ASTNode*> statements(ranges.size());
+  // The statement index of the first error found so far. Batches stop at
+  // statements past it, since their results would be thrown away.
+  std::atomic<size_t> first_error(ranges.size());
+  vector<unique_ptr<ParseError>> errors(batches);
+  size_t tokens_per_batch = tokes.size() / batches + 1;
+  size_t begin = 0;
+  for (size_t batch = 0; batch < batches && begin < ranges.size(); ++batch) {
+    // Extend the batch until it holds its share of the tokens
+    size_t end = begin;
+    const FlatToken *const batch_start = ranges[begin].first;
+    while (end < ranges.size() &&
+	   (end == begin || static_cast<size_t>(ranges[end].second - batch_start) <= tokens_per_batch)) {
+      ++end;
+    }
+    if (batch == batches - 1) {
+      end = ranges.size();
+    }
+    arenas.push_back(unique_ptr<Arena>(new Arena()));
+    Arena *arena = arenas.back().get();
+    pool.submit([&, begin, end, batch, arena] {
+	for (size_t i = begin; i < end && i < first_error.load(); ++i) {
+	  try {
+	    statements[i] = parse_statement(ranges[i].first, ranges[i].second, *arena);
+	  } catch (const ParseError& e) {
+	    errors[batch].reset(new ParseError(e.what(), e.token() + (ranges[i].first - tokes.data()), i));
+	    size_t seen = first_error.load();
+	    while (i < seen && !first_error.compare_exchange_weak(seen, i)) {}
+	    return;
+	  }
+	}
+      });
+    begin = end;
+  }
+  pool.wait();
+  // Batches are in statement order, so the first error found in batch
+  // order is the first error in the script
+  for (auto it = errors.begin(); it != errors.end(); ++it) {
+    if (*it) {
+      throw **it;
+    }
+  }
+  return statements;
+}
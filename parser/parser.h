@@ -0,0 +1,70 @@
+// SimpleSQL: Parser
+//
+// This module turns the flat tokens produced by the lexer into
+// ASTs. Every node of a statement's AST is allocated in the arena
+// passed to the parser, so the whole tree is freed with the arena.
+
+#ifndef __PARSER_H__
+#define __PARSER_H__
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <memory>
+#include "../lexer/lexer.h"
+#include "../AST/ast_public.h"
+#include "../util/thread_pool.h"
+
+// Thrown when the tokens do not form a valid statement. Records the index
+// of the offending token in the token vector that was parsed, and the
+// index of the statement it belongs to among the statements parsed.
+class ParseError : public std::runtime_error {
+ public:
+  ParseError(const std::string& message, std::size_t token, std::size_t statement = 0);
+  std::size_t token() const;
+  std::size_t statement() const;
+ private:
+  std::size_t _token;
+  std::size_t _statement;
+};
+
+const ASTNode *parse_statement(const FlatToken *begin, const FlatToken *end, Arena& arena,
+			       std::size_t *parameters = nullptr);
+
+// The part of an INSERT ... VALUES statement before its rows
+struct ValuesHeader {
+  ArenaString table;
+  ArenaList<ArenaString> columns;
+  // The first token of the first row
+  const FlatToken *rows;
+};
+
+// Rows of a VALUES list parsed straight into a buffer of table rows. Value
+// i of a row goes to column targets[i] of the row, and the other columns
+// are left as they are, or null if values grows to hold the row. Values
+// that are not literals are set to null and listed in expressions, with
+// their index in values, to be evaluated by the caller.
+struct RowBatch {
+  std::vector<std::size_t> targets;
+  // The number of values in a row of values
+  std::size_t stride;
+  // The number of rows parsed before the batch is full
+  std::size_t capacity;
+  std::vector<Value> values;
+  // The number of rows parsed into values
+  std::size_t count;
+  std::vector<RowExpression> expressions;
+};
+
+bool parse_values_header(const FlatToken *begin, const FlatToken *end, Arena& arena,
+			 ValuesHeader& header);
+const FlatToken *parse_rows(const FlatToken *begin, const FlatToken *end, bool last,
+			    Arena& arena, RowBatch& batch, bool& done);
+
+const std::vector<const ASTNode*> parse(const std::vector<FlatToken>& tokes, Arena& arena);
+const std::vector<const ASTNode*> parse(const std::vector<FlatToken>& tokes,
+					std::vector<std::unique_ptr<Arena>>& arenas,
+					ThreadPool& pool);
+
+#endif  // __PARSER_H__
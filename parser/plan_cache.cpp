@@ -0,0 +1,314 @@
+// SimpleSQL: Prepared statements and the plan cache
+//
+// Cache keys are built from the token stream rather than the text of a
+// statement, so statements that differ only in whitespace or in the case
+// of their keywords share an entry. Each token contributes its type, and
+// identifiers, literals and placeholders contribute their text as well.
+
+#include "plan_cache.h"
+#include <stdexcept>
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::size_t;
+
+/*------------------------------------------------
+  PreparedStatement methods
+  ----------------------------------------------*/
+
+// Parses the single statement in [begin, end) into an arena owned by the
+// prepared statement. Throws a ParseError if it is not a statement.
+PreparedStatement::PreparedStatement(const FlatToken *begin, const FlatToken *end)
+  : _statement(nullptr), _parameters(0) {
+  _statement = parse_statement(begin, end, _arena, &_parameters);
+}
+
+// Returns the root of the statement's AST
+const ASTNode *PreparedStatement::statement() const {
+  return _statement;
+}
+
+// Returns the number of parameters the statement takes
+size_t PreparedStatement::parameters() const {
+  return _parameters;
+}
+
+// Binds the statement to the given parameter values. Throws an
+// invalid_argument if there is not exactly one value per parameter.
+BoundStatement PreparedStatement::bind(const vector<Value>& parameters) const {
+  if (parameters.size() != _parameters) {
+    throw std::invalid_argument("Statement takes " + std::to_string(_parameters) +
+				" parameter(s) but " + std::to_string(parameters.size()) +
+				" were given");
+  }
+  return BoundStatement{_statement, parameters};
+}
+
+namespace {
+
+// Returns true if tokens of the given type are constants that an ad-hoc
+// statement can take as parameters
+bool is_literal(Tokens type) {
+  switch (type) {
+  case Tokens::INTLIT:
+  case Tokens::UINTLIT:
+  case Tokens::DOUBLELIT:
+  case Tokens::STRINGLIT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns true if the statement in tokes is one whose plan is cached
+bool is_cacheable(const vector<FlatToken>& tokes) {
+  if (tokes.empty()) {
+    return false;
+  }
+  switch (tokes.front().type) {
+  case Tokens::SELECT:
+  case Tokens::INSERT:
+  case Tokens::UPDATE:
+  case Tokens::DELETE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Appends the key of a single token to key
+void append_key(string& key, const FlatToken& toke) {
+  key.push_back(static_cast<char>(toke.type));
+  if (toke.type == Tokens::IDENTIFIER || toke.type == Tokens::PLACEHOLDER ||
+      toke.type == Tokens::CHARLIT || is_literal(toke.type)) {
+    // The length keeps adjacent texts from running together
+    key.append(std::to_string(toke.text.length));
+    key.push_back(':');
+    key.append(toke.text.data, toke.text.length);
+  }
+}
+
+// Returns the key of a whole statement, literals included
+string exact_key(const vector<FlatToken>& tokes) {
+  string key;
+  for (auto it = tokes.begin(); it != tokes.end(); ++it) {
+    append_key(key, *it);
+  }
+  return key;
+}
+
+// Returns the value of a literal token. Strings are copied into arena.
+Value literal_value(const FlatToken& toke, Arena& arena) {
+  switch (toke.type) {
+  case Tokens::INTLIT:
+    return Value(toke.literal.int_value);
+  case Tokens::UINTLIT:
+    return Value(toke.literal.uint_value);
+  case Tokens::DOUBLELIT:
+    return Value(toke.literal.double_value);
+  default: {
+    ArenaString value = toke.literal.escaped ? ArenaString(arena, string_literal(toke))
+      : ArenaString(arena, toke.text.data, toke.text.length);
+    return Value(value.data(), value.length());
+  }
+  }
+}
+
+// Lexes the single statement in sql, dropping any trailing semicolons so
+// that they do not change its key
+vector<FlatToken> statement_tokens(const string& sql) {
+  vector<FlatToken> tokes;
+  tokenize_command(sql, tokes);
+  while (!tokes.empty() && tokes.back().type == Tokens::SEMICOLON) {
+    tokes.pop_back();
+  }
+  return tokes;
+}
+
+}  // namespace
+
+/*------------------------------------------------
+  PlanCache methods
+  ----------------------------------------------*/
+
+// Creates an empty cache holding at most capacity statements
+PlanCache::PlanCache(size_t capacity)
+  : _capacity(capacity), _hits(0), _misses(0) {}
+
+// Returns the prepared statement for sql, which may contain placeholders,
+// parsing it only if it is not already cached. Throws a ParseError if sql
+// is not a single statement.
+shared_ptr<const PreparedStatement> PlanCache::prepare(const string& sql) {
+  vector<FlatToken> tokes = statement_tokens(sql);
+  if (!is_cacheable(tokes)) {
+    return std::make_shared<const PreparedStatement>(tokes.data(), tokes.data() + tokes.size());
+  }
+  return prepare(exact_key(tokes), tokes);
+}
+
+// Returns the prepared statement for the ad-hoc statement sql, and sets
+// parameters to the values it binds. Literals are replaced by parameters
+// before the cache is searched, with string values copied into arena, so
+// statements that differ only in their constants hit the same entry.
+// Statements whose literals cannot all be parameters, such as the row
+// count of a LIMIT, are cached as written instead, with no parameters.
+// Throws a ParseError if sql is not a single statement, or if it already
+// contains placeholders.
+shared_ptr<const PreparedStatement> PlanCache::lookup(const string& sql,
+						      vector<Value>& parameters,
+						      Arena& arena) {
+  vector<FlatToken> tokes = statement_tokens(sql);
+  return lookup(tokes.data(), tokes.data() + tokes.size(), parameters, arena);
+}
+
+// As above, for the ad-hoc statement whose tokens are in [begin, end), such
+// as one of the statements of a script. Trailing semicolons are ignored.
+// The tokens need not outlive the call.
+shared_ptr<const PreparedStatement> PlanCache::lookup(const FlatToken *begin,
+						      const FlatToken *end,
+						      vector<Value>& parameters,
+						      Arena& arena) {
+  parameters.clear();
+  while (end != begin && (end - 1)->type == Tokens::SEMICOLON) {
+    --end;
+  }
+  const vector<FlatToken> tokes(begin, end);
+  if (!is_cacheable(tokes)) {
+    return std::make_shared<const PreparedStatement>(tokes.data(), tokes.data() + tokes.size());
+  }
+  vector<FlatToken> normalized(tokes);
+  vector<Value> values;
+  string key;
+  for (size_t i = 0; i < normalized.size(); ++i) {
+    FlatToken& toke = normalized[i];
+    if (toke.type == Tokens::PLACEHOLDER) {
+      throw ParseError("Statements with placeholders must be prepared", i);
+    }
+    if (is_literal(toke.type)) {
+      values.push_back(literal_value(toke, arena));
+      toke.type = Tokens::PLACEHOLDER;
+      toke.literal.int_value = values.size();
+      key.push_back(static_cast<char>(Tokens::PLACEHOLDER));
+    } else {
+      append_key(key, toke);
+    }
+  }
+
+  shared_ptr<const PreparedStatement> plan;
+  if (find(key, plan)) {
+    if (!plan) {
+      return prepare(exact_key(tokes), tokes);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_hits;
+    parameters.swap(values);
+    return plan;
+  }
+  try {
+    plan = std::make_shared<const PreparedStatement>(normalized.data(),
+						     normalized.data() + normalized.size());
+  } catch (const ParseError&) {
+    // Parse as written first, so that invalid statements leave no entry
+    plan = prepare(exact_key(tokes), tokes);
+    insert(key, nullptr);
+    return plan;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_misses;
+  }
+  parameters.swap(values);
+  return insert(key, plan);
+}
+
+// Returns the number of statements found in the cache
+size_t PlanCache::hits() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _hits;
+}
+
+// Returns the number of statements that had to be parsed
+size_t PlanCache::misses() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _misses;
+}
+
+// Returns the number of entries in the cache
+size_t PlanCache::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _entries.size();
+}
+
+// Returns the most entries the cache holds
+size_t PlanCache::capacity() const {
+  return _capacity;
+}
+
+// Removes every entry and resets the counters. Statements already handed
+// out stay valid.
+void PlanCache::clear() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.clear();
+  _index.clear();
+  _hits = 0;
+  _misses = 0;
+}
+
+// Looks up key, and if it is present sets plan to its statement, marks it
+// most recently used and returns true
+bool PlanCache::find(const string& key, shared_ptr<const PreparedStatement>& plan) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _index.find(key);
+  if (it == _index.end()) {
+    return false;
+  }
+  _entries.splice(_entries.begin(), _entries, it->second);
+  plan = it->second->second;
+  return true;
+}
+
+// Adds plan under key, evicting the least recently used entry if the cache
+// is full, and returns the statement cached under key. If another thread
+// cached key in the meantime, its statement is kept and returned.
+shared_ptr<const PreparedStatement> PlanCache::insert(const string& key,
+						      shared_ptr<const PreparedStatement> plan) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_capacity == 0) {
+    return plan;
+  }
+  auto it = _index.find(key);
+  if (it != _index.end()) {
+    if (it->second->second) {
+      return it->second->second;
+    }
+    _entries.erase(it->second);
+    _index.erase(it);
+  }
+  if (_entries.size() >= _capacity) {
+    _index.erase(_entries.back().first);
+    _entries.pop_back();
+  }
+  _entries.push_front(Entry(key, plan));
+  _index[key] = _entries.begin();
+  return plan;
+}
+
+// Returns the statement cached under key, parsing it from tokes if it is
+// not cached. Parsing happens outside the lock so that other statements
+// can be looked up meanwhile.
+shared_ptr<const PreparedStatement> PlanCache::prepare(const string& key,
+						       const vector<FlatToken>& tokes) {
+  shared_ptr<const PreparedStatement> plan;
+  if (find(key, plan) && plan) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_hits;
+    return plan;
+  }
+  plan = std::make_shared<const PreparedStatement>(tokes.data(), tokes.data() + tokes.size());
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_misses;
+  }
+  return insert(key, plan);
+}
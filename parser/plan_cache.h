@@ -0,0 +1,89 @@
+// SimpleSQL: Prepared statements and the plan cache
+//
+// A prepared statement is parsed once and executed many times with
+// different parameters, given by ? or $n placeholders. The plan cache
+// keeps recently prepared statements keyed on their token stream, and can
+// also parameterize ad-hoc statements itself by treating their literals as
+// parameters, so statements that differ only in their constants share one
+// parsed AST.
+
+#ifndef __PLAN_CACHE_H__
+#define __PLAN_CACHE_H__
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "parser.h"
+
+class PreparedStatement;
+
+// A prepared statement together with the values of its parameters, ready
+// to be executed. The i-th value is the value of Placeholder i.
+struct BoundStatement {
+  const ASTNode *statement;
+  std::vector<Value> parameters;
+};
+
+// A parsed statement that owns its AST. Placeholders in the AST stand for
+// parameters numbered from 0.
+class PreparedStatement {
+ public:
+  PreparedStatement(const FlatToken *begin, const FlatToken *end);
+  const ASTNode *statement() const;
+  std::size_t parameters() const;
+  BoundStatement bind(const std::vector<Value>& parameters) const;
+ private:
+  PreparedStatement(const PreparedStatement&) = delete;
+  PreparedStatement& operator=(const PreparedStatement&) = delete;
+  Arena _arena;
+  const ASTNode *_statement;
+  std::size_t _parameters;
+};
+
+// A thread safe LRU cache of prepared statements. Only SELECT, INSERT,
+// UPDATE and DELETE statements are cached; others are prepared afresh
+// every time.
+class PlanCache {
+ public:
+  explicit PlanCache(std::size_t capacity = DEFAULT_CAPACITY);
+  std::shared_ptr<const PreparedStatement> prepare(const std::string& sql);
+  std::shared_ptr<const PreparedStatement> lookup(const std::string& sql,
+						  std::vector<Value>& parameters,
+						  Arena& arena);
+  std::shared_ptr<const PreparedStatement> lookup(const FlatToken *begin, const FlatToken *end,
+						  std::vector<Value>& parameters,
+						  Arena& arena);
+  std::size_t hits() const;
+  std::size_t misses() const;
+  std::size_t size() const;
+  std::size_t capacity() const;
+  void clear();
+
+  static const std::size_t DEFAULT_CAPACITY = 1024;
+ private:
+  PlanCache(const PlanCache&) = delete;
+  PlanCache& operator=(const PlanCache&) = delete;
+
+  // Most recently used entries are at the front. A null plan marks a
+  // normalized key whose statement cannot take its literals as parameters.
+  typedef std::pair<std::string, std::shared_ptr<const PreparedStatement>> Entry;
+  bool find(const std::string& key, std::shared_ptr<const PreparedStatement>& plan);
+  std::shared_ptr<const PreparedStatement> insert(const std::string& key,
+						  std::shared_ptr<const PreparedStatement> plan);
+  std::shared_ptr<const PreparedStatement> prepare(const std::string& key,
+						   const std::vector<FlatToken>& tokes);
+
+  const std::size_t _capacity;
+  std::list<Entry> _entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+  mutable std::mutex _mutex;
+  std::size_t _hits;
+  std::size_t _misses;
+};
+
+#endif  // __PLAN_CACHE_H__
@@ -1,23 +1,458 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include "lexer/lexer.h"
+#include "lexer/statement_reader.h"
+#include "parser/parser.h"
+#include "parser/plan_cache.h"
+#include "exec/sort.h"
+#include "storage/catalog.h"
+#include "storage/page_file.h"
+#include "storage/wal.h"
+#include "util/thread_pool.h"
 
 using std::string;
 using std::vector;
 using std::unique_ptr;
 using std::cout;
 using std::cin;
+using std::cerr;
 using std::endl;
 
-int main(int argc, char **argv) {
-  string command;
-  std::getline(cin, command);
-  vector<unique_ptr<const Token>> tokes;
+namespace {
+
+// Log records are replayed in batches of at most this many records, or
+// this many encoded bytes, whose statements are parsed in parallel
+const std::size_t RECOVERY_BATCH_RECORDS = 4096;
+const std::size_t RECOVERY_BATCH_BYTES = 16 << 20;
+
+// Complete statements read by the shell are parsed together, on the
+// workers of a pool, in batches of at most this many statements or about
+// this many tokens
+const std::size_t SHELL_BATCH_STATEMENTS = 1024;
+const std::size_t SHELL_BATCH_TOKENS = 1 << 16;
+// Statements of a batch are looked up in the plan cache this many to a task
+const std::size_t SHELL_LOOKUP_STATEMENTS = 64;
+
+// A log record waiting to be replayed
+struct PendingRecord {
+  Lsn lsn;
+  LogRecord record;
+};
+
+// Appends a SEMICOLON to tokes, to end a statement that has none
+void append_semicolon(vector<FlatToken>& tokes) {
+  FlatToken semicolon;
+  semicolon.type = Tokens::SEMICOLON;
+  semicolon.text.data = ";";
+  semicolon.text.length = 1;
+  semicolon.literal.int_value = 0;
+  tokes.push_back(semicolon);
+}
+
+// Parses and applies a single log record, reporting it if it fails.
+// Returns true if it was applied.
+bool apply_record(const PendingRecord& pending, Catalog& catalog) {
+  vector<FlatToken> tokes;
+  Arena arena;
+  pending.record.tokens(tokes);
+  try {
+    vector<const ASTNode*> statements = parse(tokes, arena);
+    for (auto it = statements.begin(); it != statements.end(); ++it) {
+      (*it)->accept(catalog);
+    }
+    return true;
+  } catch (const ParseError& e) {
+    cerr << "Log record " << pending.lsn << ": " << e.what() << endl;
+  } catch (const StorageError& e) {
+    cerr << "Log record " << pending.lsn << ": " << e.what() << endl;
+  }
+  return false;
+}
+
+// Parses the statements of a batch of log records on the workers of pool,
+// then applies them to catalog in log order. Parsing does not depend on the
+// database, so only applying has to wait for the records before. Returns
+// the number of records applied.
+std::size_t apply_batch(const vector<PendingRecord>& batch, Catalog& catalog, ThreadPool& pool) {
+  // Each record holds one statement. A SEMICOLON is added to any record
+  // without one, so that the batch splits into one statement per record.
+  vector<FlatToken> tokes;
+  vector<FlatToken> record_tokes;
+  for (auto it = batch.begin(); it != batch.end(); ++it) {
+    it->record.tokens(record_tokes);
+    tokes.insert(tokes.end(), record_tokes.begin(), record_tokes.end());
+    if (record_tokes.back().type != Tokens::SEMICOLON) {
+      append_semicolon(tokes);
+    }
+  }
+  vector<unique_ptr<Arena>> arenas;
+  vector<const ASTNode*> statements;
+  bool parsed = true;
+  try {
+    statements = parse(tokes, arenas, pool);
+  } catch (const ParseError&) {
+    parsed = false;
+  }
+  if (!parsed || statements.size() != batch.size()) {
+    // Replay record by record, so that the records around the invalid one
+    // are still applied
+    std::size_t applied = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+      applied += apply_record(*it, catalog);
+    }
+    return applied;
+  }
+  std::size_t applied = 0;
+  for (std::size_t i = 0; i < statements.size(); ++i) {
+    try {
+      statements[i]->accept(catalog);
+      ++applied;
+    } catch (const StorageError& e) {
+      cerr << "Log record " << batch[i].lsn << ": " << e.what() << endl;
+    }
+  }
+  return applied;
+}
+
+// Applies the statements in the write-ahead log after the given LSN to
+// catalog, and returns the number applied
+std::size_t recover(const WriteAheadLog& log, Lsn after, Catalog& catalog) {
+  ThreadPool pool;
+  std::size_t applied = 0;
+  vector<PendingRecord> batch;
+  std::size_t batch_bytes = 0;
+  log.replay([&](Lsn lsn, const LogRecord& record) {
+      if (lsn <= after || record.encoded().empty()) {
+	return;
+      }
+      batch.push_back(PendingRecord{lsn, record});
+      batch_bytes += record.encoded().size();
+      if (batch.size() == RECOVERY_BATCH_RECORDS || batch_bytes >= RECOVERY_BATCH_BYTES) {
+	applied += apply_batch(batch, catalog, pool);
+	batch.clear();
+	batch_bytes = 0;
+      }
+    });
+  applied += apply_batch(batch, catalog, pool);
+  return applied;
+}
+
+// Prints the headings and rows of a query result
+void print_result(const QueryResult& result) {
+  for (std::size_t i = 0; i < result.headings.size(); ++i) {
+    cout << (i ? " | " : "") << result.headings[i];
+  }
+  cout << endl;
+  const Table& rows = *result.rows;
+  std::size_t count = 0;
+  for (std::size_t row = 0; row < rows.rows(); ++row) {
+    if (rows.is_deleted(row)) {
+      continue;
+    }
+    for (std::size_t i = 0; i < rows.schema().size(); ++i) {
+      cout << (i ? " | " : "") << rows.value(row, i).toString();
+    }
+    cout << endl;
+    ++count;
+  }
+  cout << "(" << count << " row(s))" << endl;
+}
+
+// Prints the lexical analysis of a statement, or of a piece of one
+void print_tokens(const vector<FlatToken>& tokes) {
   cout << "Lexical analysis:" << endl;
-  tokenize_command(command, tokes);
   for (auto it = tokes.begin(); it != tokes.end(); ++it) {
-    cout << **it << " ";
+    unique_ptr<const Token> toke(make_token(*it));
+    cout << *toke << " ";
   }
   cout << endl;
+}
+
+// Loads the rows of the INSERT ... VALUES statement loader was started on,
+// whose first piece is in tokes, reading the rest from reader a piece at a
+// time, and logs it if there is a log. A row a piece cuts off is read again
+// at the start of the next.
+void load_values(StatementReader& reader, vector<FlatToken>& tokes, ValuesLoader& loader,
+		 WriteAheadLog *log) {
+  LogRecord record;
+  while (true) {
+    const FlatToken *begin = tokes.data();
+    const FlatToken *end = begin + tokes.size();
+    const FlatToken *rest = loader.load(begin, end, !reader.partial());
+    if (log) {
+      record.append(begin, rest);
+    }
+    if (!reader.partial()) {
+      break;
+    }
+    if (rest != end) {
+      reader.resume_at(*rest);
+    }
+    reader.next(tokes);
+    print_tokens(tokes);
+  }
+  if (log) {
+    log->commit(record);
+  }
+  cout << "Parsed 1 statement(s), loaded " << loader.rows() << " row(s)" << endl;
+}
+
+// Returns true if tokes is an INSERT ... VALUES statement of more than one
+// row, which ValuesLoader loads without building an AST for its rows
+bool many_rows(const vector<FlatToken>& tokes) {
+  if (tokes.empty() || tokes[0].type != Tokens::INSERT) {
+    return false;
+  }
+  auto it = tokes.begin();
+  while (it != tokes.end() && it->type != Tokens::VALUES) {
+    ++it;
+  }
+  std::size_t depth = 0;
+  for (; it != tokes.end(); ++it) {
+    if (it->type == Tokens::LPAREN) {
+      ++depth;
+    } else if (it->type == Tokens::RPAREN) {
+      --depth;
+    } else if (it->type == Tokens::COMMA && depth == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Complete statements read by the shell, waiting to be parsed together.
+// The reader's tokens refer into its buffer, which reading on overwrites,
+// so the text of every token is copied into text. The tokens are pointed
+// at their copies once the batch is run, as text may move as it grows.
+struct StatementBatch {
+  vector<FlatToken> tokes;
+  // The offset into text of the text of each token
+  vector<std::size_t> offsets;
+  string text;
+  // The index in tokes of the first token of each statement, and the
+  // number of the statement in the script
+  vector<std::size_t> starts;
+  vector<std::size_t> numbers;
+};
+
+// Adds the statement in tokes, the given one of the script, to batch,
+// ending it with a SEMICOLON if it has none. Empty statements are dropped,
+// as the parser skips them.
+void add_statement(StatementBatch& batch, const vector<FlatToken>& tokes, std::size_t number) {
+  if (tokes.empty() || tokes[0].type == Tokens::SEMICOLON) {
+    return;
+  }
+  batch.starts.push_back(batch.tokes.size());
+  batch.numbers.push_back(number);
+  batch.tokes.insert(batch.tokes.end(), tokes.begin(), tokes.end());
+  if (tokes.back().type != Tokens::SEMICOLON) {
+    append_semicolon(batch.tokes);
+  }
+  for (std::size_t i = batch.offsets.size(); i < batch.tokes.size(); ++i) {
+    batch.offsets.push_back(batch.text.size());
+    batch.text.append(batch.tokes[i].text.data, batch.tokes[i].text.length);
+  }
+}
+
+// Returns true if batch holds as many statements or tokens as the shell
+// parses together
+bool batch_full(const StatementBatch& batch) {
+  return batch.starts.size() >= SHELL_BATCH_STATEMENTS || batch.tokes.size() >= SHELL_BATCH_TOKENS;
+}
+
+// Looks the statements of batch up in cache on the workers of pool, so
+// that those seen before, up to their literals, are not parsed again, and
+// the rest are parsed in parallel. Then applies them to catalog in order
+// with the parameters the lookups bind, printing their results, and logs
+// those that change the database if there is a log. An invalid statement
+// is reported with its number, and the statements around it are still
+// applied. Empties the batch.
+void run_batch(StatementBatch& batch, PlanCache& cache, Catalog& catalog, ThreadPool& pool,
+	       WriteAheadLog *log) {
+  if (batch.starts.empty()) {
+    return;
+  }
+  for (std::size_t i = 0; i < batch.tokes.size(); ++i) {
+    batch.tokes[i].text.data = batch.text.data() + batch.offsets[i];
+  }
   cout << "Parsing analysis:" << endl;
-  
+  const std::size_t count = batch.starts.size();
+  batch.starts.push_back(batch.tokes.size());
+  const std::size_t hits = cache.hits();
+  vector<std::shared_ptr<const PreparedStatement>> plans(count);
+  vector<vector<Value>> parameters(count);
+  vector<unique_ptr<ParseError>> errors(count);
+  // String parameters are copied into an arena per task, as arenas are not
+  // thread safe
+  vector<unique_ptr<Arena>> arenas;
+  for (std::size_t first = 0; first < count; first += SHELL_LOOKUP_STATEMENTS) {
+    const std::size_t last = std::min(first + SHELL_LOOKUP_STATEMENTS, count);
+    arenas.push_back(unique_ptr<Arena>(new Arena()));
+    Arena *arena = arenas.back().get();
+    pool.submit([&, first, last, arena] {
+	for (std::size_t i = first; i < last; ++i) {
+	  const FlatToken *begin = batch.tokes.data() + batch.starts[i];
+	  const FlatToken *end = batch.tokes.data() + batch.starts[i + 1];
+	  try {
+	    plans[i] = cache.lookup(begin, end, parameters[i], *arena);
+	  } catch (const ParseError& e) {
+	    errors[i].reset(new ParseError(e.what(), e.token(), i));
+	  }
+	}
+      });
+  }
+  pool.wait();
+  const std::size_t parsed = count - std::count_if(errors.begin(), errors.end(),
+						   [](const unique_ptr<ParseError>& error) {
+						     return error != nullptr;
+						   });
+  cout << "Parsed " << parsed << " statement(s), " << cache.hits() - hits
+       << " found in the plan cache" << endl;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (errors[i]) {
+      cout << "Error at token " << errors[i]->token() << " of statement " << batch.numbers[i]
+	   << ": " << errors[i]->what() << endl;
+      continue;
+    }
+    try {
+      catalog.execute(*plans[i]->statement(), parameters[i]);
+      unique_ptr<QueryResult> result = catalog.take_result();
+      if (result) {
+	print_result(*result);
+      }
+      if (log && is_logged(*plans[i]->statement())) {
+	log->commit(LogRecord(batch.tokes.data() + batch.starts[i],
+			      batch.tokes.data() + batch.starts[i + 1]));
+      }
+    } catch (const StorageError& e) {
+      cout << "Error: " << e.what() << endl;
+    }
+  }
+  batch = StatementBatch();
+}
+
+}  // namespace
+
+// Reads statements from the script named on the command line, or from
+// standard input if there is none, and prints the analysis of each. The
+// rows of INSERT ... VALUES statements are loaded as they are read; other
+// statements are looked up in the plan cache, or parsed, in batches, in
+// parallel, and applied in order. The plan cache's hits and misses are
+// printed at the end.
+// With --data, the tables are kept in the given page file, starting with
+// those saved in it, and the database is saved to it once the script ends;
+// with --memory, their chunks are paged out of memory once they use more
+// than the given number of bytes. With --wal,
+// the statements in the given log are applied next, skipping those the
+// saved tables already reflect, and every statement that changes the
+// database is logged before it is acknowledged.
+// With --sort-memory, sorts spill to temporary files once their keys use
+// the given number of bytes.
+int main(int argc, char **argv) {
+  const char *data_path = nullptr;
+  std::size_t memory = Catalog::DEFAULT_MEMORY_BUDGET;
+  const char *log_path = nullptr;
+  const char *script_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+      data_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+      memory = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--wal") == 0 && i + 1 < argc) {
+      log_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--sort-memory") == 0 && i + 1 < argc) {
+      set_sort_memory_limit(std::strtoull(argv[++i], nullptr, 10));
+    } else {
+      script_path = argv[i];
+    }
+  }
+  std::ifstream script;
+  if (script_path) {
+    script.open(script_path);
+    if (!script) {
+      cerr << "Could not open " << script_path << endl;
+      return 1;
+    }
+  }
+  // Outlives the catalog, whose tables are kept in it
+  unique_ptr<PageFile> data;
+  Catalog catalog;
+  // The LSN of the last logged statement the saved tables reflect
+  Lsn checkpoint = 0;
+  if (data_path) {
+    try {
+      data.reset(new PageFile(data_path));
+      checkpoint = catalog.open(*data, memory);
+      cout << "Opened " << catalog.table_names().size() << " table(s) in " << data_path << endl;
+    } catch (const StorageError& e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+  }
+  unique_ptr<WriteAheadLog> log;
+  if (log_path) {
+    try {
+      log.reset(new WriteAheadLog(log_path));
+      std::size_t applied = recover(*log, checkpoint, catalog);
+      cout << "Recovered " << applied << " statement(s) from " << log_path << endl;
+    } catch (const StorageError& e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+  }
+  StatementReader reader(script_path ? script : cin);
+  vector<FlatToken> tokes;
+  ValuesLoader loader(catalog);
+  ThreadPool pool;
+  PlanCache cache;
+  StatementBatch batch;
+  while (reader.next(tokes)) {
+    print_tokens(tokes);
+    if (!reader.partial() && !many_rows(tokes)) {
+      add_statement(batch, tokes, reader.statements_read());
+      if (batch_full(batch)) {
+	run_batch(batch, cache, catalog, pool, log.get());
+      }
+      continue;
+    }
+    // The statements read before this one are applied first
+    run_batch(batch, cache, catalog, pool, log.get());
+    const std::size_t number = reader.statements_read() + reader.partial();
+    try {
+      if (loader.start(tokes.data(), tokes.data() + tokes.size())) {
+	cout << "Parsing analysis:" << endl;
+	load_values(reader, tokes, loader, log.get());
+	continue;
+      }
+      if (!reader.complete(tokes)) {
+	cout << "Error: Statement longer than " << StatementReader::DEFAULT_MAX_STATEMENT
+	     << " bytes" << endl;
+	continue;
+      }
+      add_statement(batch, tokes, reader.statements_read());
+      run_batch(batch, cache, catalog, pool, log.get());
+    } catch (const ParseError& e) {
+      cout << "Error at token " << e.token() << " of statement " << number << ": " << e.what()
+	   << endl;
+    } catch (const StorageError& e) {
+      cout << "Error: " << e.what() << endl;
+    }
+    // Skip what is left of a statement that failed part way
+    while (reader.partial() && reader.next(tokes)) {}
+  }
+  run_batch(batch, cache, catalog, pool, log.get());
+  cout << "Plan cache: " << cache.hits() << " hit(s), " << cache.misses() << " miss(es)" << endl;
+  if (data_path) {
+    try {
+      catalog.save(log ? log->durable_lsn() : checkpoint);
+    } catch (const StorageError& e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+  }
+  return 0;
 }
@@ -0,0 +1,728 @@
+// SimpleSQL: B+-tree
+//
+// A version word is even when unlocked. Locking adds one and unlocking
+// adds one more, so every modification of a node leaves it with a new
+// version, and a reader that saw the old one restarts. Node fields are
+// atomics read and written with relaxed ordering; the version's acquire
+// and release ordering is what makes a validated read consistent.
+//
+// Inner nodes hold count separators and count + 1 children: child i holds
+// the keys from separator i - 1, inclusive, up to separator i. Nodes are
+// never merged, so a node's key range only ever shrinks, by the node
+// splitting, which changes its version.
+
+#include "btree.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include "column.h"
+
+using std::size_t;
+using std::string;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_relaxed;
+
+namespace {
+
+// Every node is this many bytes
+const size_t NODE_SIZE = 8 * CACHE_LINE_SIZE;
+// The most keys a node holds, chosen so that both kinds of node fit
+const size_t CAPACITY = 20;
+// Set in the version word of a locked node
+const uint64_t LOCKED = 1;
+// Prefixes are recorded in 16 bits
+const size_t MAX_PREFIX = 0xFFFF;
+
+// Returns the 8 bytes of the given key that follow its first prefix bytes,
+// as a big-endian integer padded with zeroes, so that heads compare as
+// the bytes do
+uint64_t head(const char *key, size_t length, size_t prefix) {
+  uint64_t bits = 0;
+  if (prefix + sizeof(bits) <= length) {
+    std::memcpy(&bits, key + prefix, sizeof(bits));
+    return __builtin_bswap64(bits);
+  }
+  for (size_t i = prefix; i < prefix + sizeof(bits); ++i) {
+    bits = bits << 8 | (i < length ? static_cast<unsigned char>(key[i]) : 0);
+  }
+  return bits;
+}
+
+// Compares two keys, which agree on their first start bytes, bytewise
+int compare_from(const char *a, size_t a_length, const char *b, size_t b_length, size_t start) {
+  size_t common = std::min(a_length, b_length);
+  start = std::min(start, common);
+  int c = std::memcmp(a + start, b + start, common - start);
+  if (c != 0) {
+    return c;
+  }
+  return a_length < b_length ? -1 : a_length > b_length;
+}
+
+}  // namespace
+
+// A key, stored as its length followed by its bytes
+struct BTree::Key {
+  uint32_t length;
+
+  const char *data() const {
+    return reinterpret_cast<const char*>(this + 1);
+  }
+
+  // Returns a copy of key
+  static const Key *make(const string& key) {
+    Key *made = static_cast<Key*>(std::malloc(sizeof(Key) + key.size()));
+    if (!made) {
+      throw std::bad_alloc();
+    }
+    made->length = static_cast<uint32_t>(key.size());
+    std::memcpy(made + 1, key.data(), key.size());
+    return made;
+  }
+
+  // Returns the length of the prefix that a and b, either of which may be
+  // null, share
+  static size_t common_prefix(const Key *a, const Key *b) {
+    if (!a || !b) {
+      return 0;
+    }
+    size_t length = std::min<size_t>(std::min(a->length, b->length), MAX_PREFIX);
+    size_t i = 0;
+    while (i < length && a->data()[i] == b->data()[i]) {
+      ++i;
+    }
+    return i;
+  }
+};
+
+// The part of a node common to leaves and inner nodes: the version, and
+// the keys with their heads
+struct alignas(CACHE_LINE_SIZE) BTree::Node {
+  std::atomic<uint64_t> version;
+  std::atomic<uint16_t> count;
+  std::atomic<uint16_t> prefix;
+  bool leaf;
+  std::atomic<uint64_t> heads[CAPACITY];
+  std::atomic<const Key*> keys[CAPACITY];
+
+  // Sets version to the node's version and returns true, or returns false
+  // if the node is locked
+  bool read_lock(uint64_t& seen) const {
+    seen = version.load(memory_order_acquire);
+    return (seen & LOCKED) == 0;
+  }
+
+  // Returns true if the node has not changed since its version was seen
+  bool validate(uint64_t seen) const {
+    std::atomic_thread_fence(memory_order_acquire);
+    return version.load(memory_order_relaxed) == seen;
+  }
+
+  // Locks the node if it has not changed since its version was seen, and
+  // returns true if it did
+  bool upgrade(uint64_t seen) {
+    return version.compare_exchange_strong(seen, seen + LOCKED, memory_order_acquire);
+  }
+
+  void unlock() {
+    version.fetch_add(LOCKED, memory_order_release);
+  }
+
+  // Returns the number of keys, which is never more than CAPACITY however
+  // inconsistent the node is
+  size_t size() const {
+    return std::min<size_t>(count.load(memory_order_relaxed), CAPACITY);
+  }
+
+  const Key *key(size_t i) const {
+    return keys[i].load(memory_order_relaxed);
+  }
+
+  // Compares key, whose head in this node is key_head, with key i
+  int compare(size_t i, const char *key, size_t length, uint64_t key_head, size_t skip) const {
+    uint64_t stored_head = heads[i].load(memory_order_relaxed);
+    if (key_head != stored_head) {
+      return key_head < stored_head ? -1 : 1;
+    }
+    const Key *stored = this->key(i);
+    if (!stored) {
+      // Only seen mid-modification, which validation will catch
+      return 0;
+    }
+    return compare_from(key, length, stored->data(), stored->length, skip + sizeof(uint64_t));
+  }
+
+  // Returns the number of keys less than key or, if after is set, not
+  // greater than key
+  size_t bound(const char *key, size_t length, bool after) const {
+    size_t skip = prefix.load(memory_order_relaxed);
+    uint64_t key_head = head(key, length, skip);
+    size_t low = 0;
+    size_t high = size();
+    while (low < high) {
+      size_t middle = (low + high) / 2;
+      int c = compare(middle, key, length, key_head, skip);
+      if (c > 0 || (after && c == 0)) {
+	low = middle + 1;
+      } else {
+	high = middle;
+      }
+    }
+    return low;
+  }
+
+  size_t lower_bound(const string& key) const {
+    return bound(key.data(), key.size(), false);
+  }
+
+  size_t upper_bound(const string& key) const {
+    return bound(key.data(), key.size(), true);
+  }
+
+  // Returns true if key i is key
+  bool holds(size_t i, const string& key) const {
+    const Key *stored = this->key(i);
+    return stored && compare_from(key.data(), key.size(), stored->data(), stored->length, 0) == 0;
+  }
+
+  // Sets key i and its head. The node must be locked.
+  void set_key(size_t i, const Key *key) {
+    keys[i].store(key, memory_order_relaxed);
+    heads[i].store(head(key->data(), key->length, prefix.load(memory_order_relaxed)),
+		   memory_order_relaxed);
+  }
+
+  // Moves key from to key to. The node must be locked.
+  void move_key(size_t to, size_t from) {
+    keys[to].store(keys[from].load(memory_order_relaxed), memory_order_relaxed);
+    heads[to].store(heads[from].load(memory_order_relaxed), memory_order_relaxed);
+  }
+
+  // Records that the keys share their first skip bytes, and recomputes
+  // their heads. The node must be locked.
+  void set_prefix(size_t skip) {
+    prefix.store(static_cast<uint16_t>(skip), memory_order_relaxed);
+    for (size_t i = 0; i < size(); ++i) {
+      set_key(i, key(i));
+    }
+  }
+};
+
+struct BTree::Inner : BTree::Node {
+  std::atomic<Node*> children[CAPACITY + 1];
+
+  Node *child(size_t i) const {
+    return children[i].load(memory_order_relaxed);
+  }
+};
+
+struct BTree::Leaf : BTree::Node {
+  std::atomic<uint64_t> values[CAPACITY];
+  std::atomic<Leaf*> next;
+};
+
+namespace {
+
+// Returns a new, zeroed, unlocked node aligned to a cache line
+template <typename N>
+N *make_node(bool leaf) {
+  static_assert(sizeof(N) <= NODE_SIZE, "Nodes must fit in NODE_SIZE bytes");
+  void *memory;
+  if (posix_memalign(&memory, CACHE_LINE_SIZE, NODE_SIZE) != 0) {
+    throw std::bad_alloc();
+  }
+  // Every field of a node is zero when empty, so zeroing is constructing
+  std::memset(memory, 0, NODE_SIZE);
+  N *node = static_cast<N*>(memory);
+  node->leaf = leaf;
+  return node;
+}
+
+}  // namespace
+
+// Creates an empty tree
+BTree::BTree() : _root(make_node<Leaf>(true)), _size(0) {}
+
+BTree::~BTree() {
+  destroy(_root.load());
+  for (auto it = _retired.begin(); it != _retired.end(); ++it) {
+    std::free(const_cast<Key*>(*it));
+  }
+}
+
+// Maps key to value and returns true, or returns false, leaving the tree
+// unchanged, if key is already mapped
+bool BTree::insert(const string& key, uint64_t value) {
+  const Key *stored = Key::make(key);
+  while (true) {
+    switch (try_insert(key, value, stored)) {
+    case Outcome::DONE:
+      _size.fetch_add(1, memory_order_relaxed);
+      return true;
+    case Outcome::EXISTS:
+      std::free(const_cast<Key*>(stored));
+      return false;
+    case Outcome::MISSING:
+      // A node was split; try again at once
+      break;
+    case Outcome::RESTART:
+      std::this_thread::yield();
+      break;
+    }
+  }
+}
+
+// Sets value to the value key maps to and returns true, or returns false
+// if key is not mapped
+bool BTree::find(const string& key, uint64_t& value) const {
+  while (true) {
+    switch (try_find(key, value)) {
+    case Outcome::DONE:
+      return true;
+    case Outcome::RESTART:
+      std::this_thread::yield();
+      break;
+    default:
+      return false;
+    }
+  }
+}
+
+// Removes key and returns true, or returns false if key is not mapped
+bool BTree::erase(const string& key) {
+  while (true) {
+    switch (try_erase(key)) {
+    case Outcome::DONE:
+      _size.fetch_sub(1, memory_order_relaxed);
+      return true;
+    case Outcome::RESTART:
+      std::this_thread::yield();
+      break;
+    default:
+      return false;
+    }
+  }
+}
+
+// Calls visit with the value of every key in [from, to), in key order,
+// until visit returns false. A null to leaves the range unbounded above.
+// Keys inserted or erased during the scan may or may not be visited, but
+// no key is visited twice.
+void BTree::scan(const string& from, const string *to,
+		 const std::function<bool(uint64_t)>& visit) const {
+  // Restarts resume after the last key visited
+  string resume = from;
+  while (try_scan(resume, to, visit) == Outcome::RESTART) {
+    std::this_thread::yield();
+  }
+}
+
+// Calls visit with the value of every key in [from, to), in descending key
+// order, until visit returns false. A null to leaves the range unbounded
+// above. Leaves only link to the next leaf, so each leaf is reached by
+// descending from the root to the keys before the low fence of the leaf
+// visited last. Keys inserted or erased during the scan may or may not be
+// visited, but no key is visited twice.
+void BTree::scan_reverse(const string& from, const string *to,
+			 const std::function<bool(uint64_t)>& visit) const {
+  // Restarts resume before the last leaf visited
+  string before = to ? *to : string();
+  bool bounded = to != nullptr;
+  while (try_scan_reverse(from, before, bounded, visit) == Outcome::RESTART) {
+    std::this_thread::yield();
+  }
+}
+
+// Returns the number of keys in the tree
+size_t BTree::size() const {
+  return _size.load(memory_order_relaxed);
+}
+
+// Returns the number of levels in the tree, counting the leaves
+size_t BTree::height() const {
+  size_t levels = 1;
+  for (const Node *node = _root.load(memory_order_acquire); !node->leaf; ++levels) {
+    node = static_cast<const Inner*>(node)->child(0);
+  }
+  return levels;
+}
+
+// Descends to the leaf for key, splitting full nodes on the way, and adds
+// key there. stored is the copy of key the tree keeps.
+BTree::Outcome BTree::try_insert(const string& key, uint64_t value, const Key *&stored) {
+  Node *node = _root.load(memory_order_acquire);
+  uint64_t version;
+  if (!node->read_lock(version) || node != _root.load(memory_order_acquire)) {
+    return Outcome::RESTART;
+  }
+  Inner *parent = nullptr;
+  uint64_t parent_version = 0;
+  // The fences of node; null for the ends of the key space
+  const Key *low = nullptr;
+  const Key *high = nullptr;
+  while (true) {
+    if (node->size() == CAPACITY) {
+      // Lock the parent first, since the split adds a separator to it
+      if (parent && !parent->upgrade(parent_version)) {
+	return Outcome::RESTART;
+      }
+      if (!node->upgrade(version)) {
+	if (parent) {
+	  parent->unlock();
+	}
+	return Outcome::RESTART;
+      }
+      if (!parent && node != _root.load(memory_order_acquire)) {
+	node->unlock();
+	return Outcome::RESTART;
+      }
+      if (node->leaf) {
+	split_leaf(static_cast<Leaf*>(node), parent, low, high);
+      } else {
+	split_inner(static_cast<Inner*>(node), parent, low, high);
+      }
+      node->unlock();
+      if (parent) {
+	parent->unlock();
+      }
+      return Outcome::MISSING;
+    }
+    if (node->leaf) {
+      break;
+    }
+    if (parent && !parent->validate(parent_version)) {
+      return Outcome::RESTART;
+    }
+    Inner *inner = static_cast<Inner*>(node);
+    size_t count = inner->size();
+    size_t i = inner->upper_bound(key);
+    Node *child = inner->child(i);
+    const Key *child_low = i > 0 ? inner->key(i - 1) : low;
+    const Key *child_high = i < count ? inner->key(i) : high;
+    if (!inner->validate(version)) {
+      return Outcome::RESTART;
+    }
+    parent = inner;
+    parent_version = version;
+    node = child;
+    low = child_low;
+    high = child_high;
+    if (!node->read_lock(version)) {
+      return Outcome::RESTART;
+    }
+  }
+
+  Leaf *leaf = static_cast<Leaf*>(node);
+  if (!leaf->upgrade(version)) {
+    return Outcome::RESTART;
+  }
+  if (parent && !parent->validate(parent_version)) {
+    leaf->unlock();
+    return Outcome::RESTART;
+  }
+  size_t count = leaf->size();
+  size_t i = leaf->lower_bound(key);
+  if (i < count && leaf->holds(i, key)) {
+    leaf->unlock();
+    return Outcome::EXISTS;
+  }
+  for (size_t j = count; j > i; --j) {
+    leaf->move_key(j, j - 1);
+    leaf->values[j].store(leaf->values[j - 1].load(memory_order_relaxed), memory_order_relaxed);
+  }
+  leaf->set_key(i, stored);
+  leaf->values[i].store(value, memory_order_relaxed);
+  leaf->count.store(static_cast<uint16_t>(count + 1), memory_order_relaxed);
+  leaf->unlock();
+  return Outcome::DONE;
+}
+
+// Descends to the leaf for key and reads its value
+BTree::Outcome BTree::try_find(const string& key, uint64_t& value) const {
+  Node *node = _root.load(memory_order_acquire);
+  uint64_t version;
+  if (!node->read_lock(version) || node != _root.load(memory_order_acquire)) {
+    return Outcome::RESTART;
+  }
+  while (!node->leaf) {
+    const Inner *inner = static_cast<const Inner*>(node);
+    Node *child = inner->child(inner->upper_bound(key));
+    // Lock the child before validating its parent, so that a split of the
+    // child after it was chosen is seen as a change of the child
+    uint64_t child_version;
+    if (!child->read_lock(child_version) || !inner->validate(version)) {
+      return Outcome::RESTART;
+    }
+    node = child;
+    version = child_version;
+  }
+  const Leaf *leaf = static_cast<const Leaf*>(node);
+  size_t i = leaf->lower_bound(key);
+  bool found = i < leaf->size() && leaf->holds(i, key);
+  uint64_t found_value = found ? leaf->values[i].load(memory_order_relaxed) : 0;
+  if (!leaf->validate(version)) {
+    return Outcome::RESTART;
+  }
+  if (!found) {
+    return Outcome::MISSING;
+  }
+  value = found_value;
+  return Outcome::DONE;
+}
+
+// Descends to the leaf for key and removes key from it. The key's copy is
+// retired rather than freed, since separators and readers may still refer
+// to it.
+BTree::Outcome BTree::try_erase(const string& key) {
+  Node *node = _root.load(memory_order_acquire);
+  uint64_t version;
+  if (!node->read_lock(version) || node != _root.load(memory_order_acquire)) {
+    return Outcome::RESTART;
+  }
+  while (!node->leaf) {
+    Inner *inner = static_cast<Inner*>(node);
+    Node *child = inner->child(inner->upper_bound(key));
+    // As in try_find(), lock the child before validating its parent
+    uint64_t child_version;
+    if (!child->read_lock(child_version) || !inner->validate(version)) {
+      return Outcome::RESTART;
+    }
+    node = child;
+    version = child_version;
+  }
+  Leaf *leaf = static_cast<Leaf*>(node);
+  if (!leaf->upgrade(version)) {
+    return Outcome::RESTART;
+  }
+  size_t count = leaf->size();
+  size_t i = leaf->lower_bound(key);
+  if (i == count || !leaf->holds(i, key)) {
+    leaf->unlock();
+    return Outcome::MISSING;
+  }
+  const Key *erased = leaf->key(i);
+  for (size_t j = i; j + 1 < count; ++j) {
+    leaf->move_key(j, j + 1);
+    leaf->values[j].store(leaf->values[j + 1].load(memory_order_relaxed), memory_order_relaxed);
+  }
+  leaf->count.store(static_cast<uint16_t>(count - 1), memory_order_relaxed);
+  leaf->unlock();
+  std::lock_guard<std::mutex> lock(_retired_mutex);
+  _retired.push_back(erased);
+  return Outcome::DONE;
+}
+
+// Visits the keys from from onwards, one leaf at a time. Each leaf is read
+// and validated before any of its values are visited, and from is then
+// moved past the last key visited, so a restart carries on from there.
+BTree::Outcome BTree::try_scan(string& from, const string *to,
+			       const std::function<bool(uint64_t)>& visit) const {
+  Node *node = _root.load(memory_order_acquire);
+  uint64_t version;
+  if (!node->read_lock(version) || node != _root.load(memory_order_acquire)) {
+    return Outcome::RESTART;
+  }
+  while (!node->leaf) {
+    const Inner *inner = static_cast<const Inner*>(node);
+    Node *child = inner->child(inner->upper_bound(from));
+    // As in try_find(), lock the child before validating its parent
+    uint64_t child_version;
+    if (!child->read_lock(child_version) || !inner->validate(version)) {
+      return Outcome::RESTART;
+    }
+    node = child;
+    version = child_version;
+  }
+  const Leaf *leaf = static_cast<const Leaf*>(node);
+  size_t i = leaf->lower_bound(from);
+  uint64_t values[CAPACITY];
+  while (true) {
+    size_t count = leaf->size();
+    size_t found = 0;
+    const Key *last = nullptr;
+    bool finished = false;
+    for (; i < count; ++i) {
+      const Key *key = leaf->key(i);
+      if (!key) {
+	break;
+      }
+      if (to && compare_from(key->data(), key->length, to->data(), to->size(), 0) >= 0) {
+	finished = true;
+	break;
+      }
+      values[found++] = leaf->values[i].load(memory_order_relaxed);
+      last = key;
+    }
+    Leaf *next = leaf->next.load(memory_order_relaxed);
+    if (!leaf->validate(version)) {
+      return Outcome::RESTART;
+    }
+    for (size_t j = 0; j < found; ++j) {
+      if (!visit(values[j])) {
+	return Outcome::DONE;
+      }
+    }
+    if (last) {
+      // The smallest key greater than the last one visited
+      from.assign(last->data(), last->length);
+      from += '\0';
+    }
+    if (finished || !next) {
+      return Outcome::DONE;
+    }
+    leaf = next;
+    i = 0;
+    if (!leaf->read_lock(version)) {
+      return Outcome::RESTART;
+    }
+  }
+}
+
+// Visits the keys of the leaves before before, or of every leaf if bounded
+// is false, from the last, until a key is less than from. The child is
+// read locked before its parent is validated, so a leaf that splits after
+// it is chosen does not lose the keys it moves to its right.
+BTree::Outcome BTree::try_scan_reverse(const string& from, string& before, bool& bounded,
+				       const std::function<bool(uint64_t)>& visit) const {
+  uint64_t values[CAPACITY];
+  while (true) {
+    Node *node = _root.load(memory_order_acquire);
+    uint64_t version;
+    if (!node->read_lock(version) || node != _root.load(memory_order_acquire)) {
+      return Outcome::RESTART;
+    }
+    // The low fence of node; null for the start of the key space
+    const Key *low = nullptr;
+    while (!node->leaf) {
+      const Inner *inner = static_cast<const Inner*>(node);
+      size_t i = bounded ? inner->lower_bound(before) : inner->size();
+      Node *child = inner->child(i);
+      if (i > 0) {
+	low = inner->key(i - 1);
+      }
+      uint64_t child_version;
+      if (!child->read_lock(child_version) || !inner->validate(version)) {
+	return Outcome::RESTART;
+      }
+      node = child;
+      version = child_version;
+    }
+    const Leaf *leaf = static_cast<const Leaf*>(node);
+    size_t i = bounded ? leaf->lower_bound(before) : leaf->size();
+    size_t found = 0;
+    bool finished = false;
+    while (i > 0) {
+      const Key *key = leaf->key(--i);
+      if (!key) {
+	break;
+      }
+      if (compare_from(key->data(), key->length, from.data(), from.size(), 0) < 0) {
+	finished = true;
+	break;
+      }
+      values[found++] = leaf->values[i].load(memory_order_relaxed);
+    }
+    if (!leaf->validate(version)) {
+      return Outcome::RESTART;
+    }
+    for (size_t j = 0; j < found; ++j) {
+      if (!visit(values[j])) {
+	return Outcome::DONE;
+      }
+    }
+    if (finished || !low) {
+      return Outcome::DONE;
+    }
+    before.assign(low->data(), low->length);
+    bounded = true;
+  }
+}
+
+// Splits inner, which is full, moving its upper half to a new node. Its
+// middle separator moves up to parent, or to a new root if inner is the
+// root. inner and parent must be locked, and low and high are inner's
+// fences.
+void BTree::split_inner(Inner *inner, Inner *parent, const Key *low, const Key *high) {
+  Inner *right = make_node<Inner>(false);
+  size_t count = inner->size();
+  size_t middle = count / 2;
+  const Key *separator = inner->key(middle);
+  for (size_t i = middle + 1; i < count; ++i) {
+    right->keys[i - middle - 1].store(inner->key(i), memory_order_relaxed);
+    right->children[i - middle - 1].store(inner->child(i), memory_order_relaxed);
+  }
+  right->children[count - middle - 1].store(inner->child(count), memory_order_relaxed);
+  right->count.store(static_cast<uint16_t>(count - middle - 1), memory_order_relaxed);
+  right->set_prefix(Key::common_prefix(separator, high));
+  inner->count.store(static_cast<uint16_t>(middle), memory_order_relaxed);
+  inner->set_prefix(Key::common_prefix(low, separator));
+  add_separator(parent, inner, separator, right);
+}
+
+// Splits leaf, which is full, moving its upper half to a new leaf whose
+// first key becomes a separator in parent, or in a new root if leaf is the
+// root. leaf and parent must be locked, and low and high are leaf's
+// fences.
+void BTree::split_leaf(Leaf *leaf, Inner *parent, const Key *low, const Key *high) {
+  Leaf *right = make_node<Leaf>(true);
+  size_t count = leaf->size();
+  size_t middle = count / 2;
+  const Key *separator = leaf->key(middle);
+  for (size_t i = middle; i < count; ++i) {
+    right->keys[i - middle].store(leaf->key(i), memory_order_relaxed);
+    right->values[i - middle].store(leaf->values[i].load(memory_order_relaxed), memory_order_relaxed);
+  }
+  right->count.store(static_cast<uint16_t>(count - middle), memory_order_relaxed);
+  right->set_prefix(Key::common_prefix(separator, high));
+  right->next.store(leaf->next.load(memory_order_relaxed), memory_order_relaxed);
+  leaf->count.store(static_cast<uint16_t>(middle), memory_order_relaxed);
+  leaf->set_prefix(Key::common_prefix(low, separator));
+  leaf->next.store(right, memory_order_relaxed);
+  add_separator(parent, leaf, separator, right);
+}
+
+// Adds separator to parent, with right as the child after it. A null
+// parent means left was the root, and a new root is made over left and
+// right. parent, if any, must be locked and have room.
+void BTree::add_separator(Inner *parent, Node *left, const Key *separator, Node *right) {
+  if (!parent) {
+    Inner *root = make_node<Inner>(false);
+    root->set_key(0, separator);
+    root->children[0].store(left, memory_order_relaxed);
+    root->children[1].store(right, memory_order_relaxed);
+    root->count.store(1, memory_order_relaxed);
+    _root.store(root, memory_order_release);
+    return;
+  }
+  size_t count = parent->size();
+  size_t i = parent->bound(separator->data(), separator->length, true);
+  for (size_t j = count; j > i; --j) {
+    parent->move_key(j, j - 1);
+    parent->children[j + 1].store(parent->child(j), memory_order_relaxed);
+  }
+  parent->set_key(i, separator);
+  parent->children[i + 1].store(right, memory_order_relaxed);
+  parent->count.store(static_cast<uint16_t>(count + 1), memory_order_relaxed);
+}
+
+// Frees node, its descendants and the keys in its leaves. Separators are
+// copies of keys kept by leaves, or retired, so they are not freed here.
+void BTree::destroy(Node *node) {
+  if (node->leaf) {
+    for (size_t i = 0; i < node->size(); ++i) {
+      std::free(const_cast<Key*>(node->key(i)));
+    }
+  } else {
+    const Inner *inner = static_cast<const Inner*>(node);
+    for (size_t i = 0; i <= inner->size(); ++i) {
+      destroy(inner->child(i));
+    }
+  }
+  std::free(node);
+}
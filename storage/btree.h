@@ -0,0 +1,81 @@
+// SimpleSQL: B+-tree
+//
+// An ordered map from index keys (see index_key.h) to row numbers, safe for
+// any number of concurrent readers and writers.
+//
+// Nodes are a fixed number of cache lines, aligned to cache lines. Every
+// key in a node lies between the node's fence keys, the separators its
+// parent routes by, so all of them share the fences' common prefix. A node
+// records the length of that prefix and, packed together at its front, the
+// next 8 bytes of each key as an integer "head". Searching a node compares
+// heads, and only reads a key's remaining bytes when heads are equal.
+// Keys themselves are stored once, outside the nodes, and shared between a
+// leaf and any separators copied from it.
+//
+// Concurrency uses optimistic lock coupling. Every node has a version
+// word holding a lock bit. Readers take no locks: they note a node's
+// version, read it, and check that the version is unchanged before
+// trusting what they read, restarting from the root if it changed.
+// Writers descend the same way and only lock the nodes they modify. Full
+// nodes are split on the way down, so a split never has to climb back up.
+// Nodes and keys are not freed until the tree is destroyed, so a reader
+// never follows a pointer into freed memory, however stale.
+
+#ifndef __BTREE_H__
+#define __BTREE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class BTree {
+ public:
+  BTree();
+  ~BTree();
+  bool insert(const std::string& key, std::uint64_t value);
+  bool find(const std::string& key, std::uint64_t& value) const;
+  bool erase(const std::string& key);
+  void scan(const std::string& from, const std::string *to,
+	    const std::function<bool(std::uint64_t)>& visit) const;
+  void scan_reverse(const std::string& from, const std::string *to,
+		    const std::function<bool(std::uint64_t)>& visit) const;
+  std::size_t size() const;
+  std::size_t height() const;
+ private:
+  BTree(const BTree&) = delete;
+  BTree& operator=(const BTree&) = delete;
+
+  struct Key;
+  struct Node;
+  struct Inner;
+  struct Leaf;
+  enum class Outcome {
+    DONE,
+    EXISTS,
+    MISSING,
+    RESTART
+  };
+  Outcome try_insert(const std::string& key, std::uint64_t value, const Key *&stored);
+  Outcome try_find(const std::string& key, std::uint64_t& value) const;
+  Outcome try_erase(const std::string& key);
+  Outcome try_scan(std::string& from, const std::string *to,
+		   const std::function<bool(std::uint64_t)>& visit) const;
+  Outcome try_scan_reverse(const std::string& from, std::string& before, bool& bounded,
+			   const std::function<bool(std::uint64_t)>& visit) const;
+  void split_inner(Inner *inner, Inner *parent, const Key *low, const Key *high);
+  void split_leaf(Leaf *leaf, Inner *parent, const Key *low, const Key *high);
+  void add_separator(Inner *parent, Node *left, const Key *separator, Node *right);
+  void destroy(Node *node);
+
+  std::atomic<Node*> _root;
+  std::atomic<std::size_t> _size;
+  // Keys erased from the tree, which separators or readers may still use
+  std::vector<const Key*> _retired;
+  std::mutex _retired_mutex;
+};
+
+#endif  // __BTREE_H__
@@ -0,0 +1,335 @@
+// SimpleSQL: Buffer pool
+//
+// A single lock guards the page table and the frames, and is held while a
+// missing page is read, so the pool suits one scan at a time better than
+// many concurrent ones.
+
+#include "buffer_pool.h"
+#include <cstring>
+
+using std::size_t;
+using std::uint64_t;
+using std::lock_guard;
+using std::mutex;
+
+/*------------------------------------------------
+  PageHandle methods
+  ----------------------------------------------*/
+
+// Creates a handle to no page
+PageHandle::PageHandle() : _pool(nullptr), _frame(0), _id(NO_PAGE), _data(nullptr) {}
+
+PageHandle::PageHandle(BufferPool *pool, size_t frame, PageId id, char *data)
+  : _pool(pool), _frame(frame), _id(id), _data(data) {}
+
+PageHandle::PageHandle(PageHandle&& other)
+  : _pool(other._pool), _frame(other._frame), _id(other._id), _data(other._data) {
+  other._pool = nullptr;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other) {
+  release();
+  _pool = other._pool;
+  _frame = other._frame;
+  _id = other._id;
+  _data = other._data;
+  other._pool = nullptr;
+  return *this;
+}
+
+PageHandle::~PageHandle() {
+  release();
+}
+
+// Returns the id of the page
+PageId PageHandle::id() const {
+  return _id;
+}
+
+// Returns the contents of the page, which stay in memory until the handle
+// is released
+char *PageHandle::data() const {
+  return _data;
+}
+
+// Records that the page was modified, so it is written back before its
+// frame is reused
+void PageHandle::mark_dirty() {
+  if (_pool) {
+    _pool->mark_dirty(_frame);
+  }
+}
+
+// Unpins the page. The handle refers to no page afterwards.
+void PageHandle::release() {
+  if (_pool) {
+    _pool->unpin(_frame);
+    _pool = nullptr;
+    _data = nullptr;
+  }
+}
+
+// Returns true if the handle refers to a page
+PageHandle::operator bool() const {
+  return _pool != nullptr;
+}
+
+/*------------------------------------------------
+  BufferPool methods
+  ----------------------------------------------*/
+
+// Creates a pool over file with as many frames as fit in memory_budget
+// bytes. k is the number of uses LRU-K remembers per page. Throws a
+// StorageError if the budget is smaller than a page.
+BufferPool::BufferPool(PageFile& file, size_t memory_budget, EvictionPolicy policy, size_t k)
+  : _file(file), _page_size(file.page_size()), _policy(policy), _k(k ? k : 1), _hand(0),
+    _clock(0), _hits(0), _misses(0), _evictions(0), _writes(0) {
+  size_t frames = memory_budget / _page_size;
+  if (frames == 0) {
+    throw StorageError("Buffer pool budget is smaller than a page");
+  }
+  _memory.reserve(frames * _page_size);
+  _frames.resize(frames, Frame{NO_PAGE, 0, false, false, {}});
+  for (size_t i = frames; i > 0; --i) {
+    _free.push_back(i - 1);
+  }
+}
+
+// Writes back every dirty page
+BufferPool::~BufferPool() {
+  try {
+    flush_all();
+  } catch (const StorageError&) {
+    // Nothing can be reported from a destructor; flush_all() reports failures
+  }
+}
+
+// Returns the file the pool caches
+PageFile& BufferPool::file() const {
+  return _file;
+}
+
+size_t BufferPool::page_size() const {
+  return _page_size;
+}
+
+// Returns the number of pages the pool holds at once
+size_t BufferPool::frames() const {
+  return _frames.size();
+}
+
+// Returns the page with the given id, pinned, reading it from the file if
+// it is not in the pool. Throws a StorageError if every frame is pinned.
+PageHandle BufferPool::fetch(PageId id) {
+  lock_guard<mutex> lock(_mutex);
+  auto it = _page_table.find(id);
+  if (it != _page_table.end()) {
+    ++_hits;
+    return pin(it->second);
+  }
+  ++_misses;
+  size_t index = victim();
+  Frame& frame = _frames[index];
+  try {
+    _file.read(id, frame_data(index));
+  } catch (const StorageError&) {
+    _free.push_back(index);
+    throw;
+  }
+  frame.id = id;
+  _page_table[id] = index;
+  return pin(index);
+}
+
+// Adds the given number of consecutive zeroed pages to the file, and
+// returns the first, pinned and dirty. The others are fetched as usual,
+// and read as zeroes until written.
+PageHandle BufferPool::allocate(size_t pages) {
+  PageId first = _file.allocate(pages);
+  lock_guard<mutex> lock(_mutex);
+  size_t index = victim();
+  Frame& frame = _frames[index];
+  std::memset(frame_data(index), 0, _page_size);
+  frame.id = first;
+  frame.dirty = true;
+  _page_table[first] = index;
+  return pin(index);
+}
+
+// Hints that the given pages will be fetched soon, in order
+void BufferPool::prefetch(PageId first, size_t pages) {
+  _file.prefetch(first, pages);
+}
+
+// Writes the page with the given id back to the file if it is in the pool
+// and dirty
+void BufferPool::flush(PageId id) {
+  lock_guard<mutex> lock(_mutex);
+  auto it = _page_table.find(id);
+  if (it != _page_table.end()) {
+    write_back(_frames[it->second], it->second);
+  }
+}
+
+// Writes every dirty page back to the file
+void BufferPool::flush_all() {
+  lock_guard<mutex> lock(_mutex);
+  for (size_t i = 0; i < _frames.size(); ++i) {
+    write_back(_frames[i], i);
+  }
+}
+
+// Returns the number of fetches that found their page in the pool
+size_t BufferPool::hits() const {
+  lock_guard<mutex> lock(_mutex);
+  return _hits;
+}
+
+// Returns the number of fetches that had to read their page
+size_t BufferPool::misses() const {
+  lock_guard<mutex> lock(_mutex);
+  return _misses;
+}
+
+// Returns the number of pages evicted to make room for others
+size_t BufferPool::evictions() const {
+  lock_guard<mutex> lock(_mutex);
+  return _evictions;
+}
+
+// Returns the number of pages written back to the file
+size_t BufferPool::writes() const {
+  lock_guard<mutex> lock(_mutex);
+  return _writes;
+}
+
+// Returns the fraction of fetches that found their page in the pool, or 0
+// if there have been none
+double BufferPool::hit_ratio() const {
+  lock_guard<mutex> lock(_mutex);
+  size_t fetches = _hits + _misses;
+  return fetches ? static_cast<double>(_hits) / fetches : 0.0;
+}
+
+// Zeroes the hit, miss, eviction and write counts
+void BufferPool::reset_stats() {
+  lock_guard<mutex> lock(_mutex);
+  _hits = _misses = _evictions = _writes = 0;
+}
+
+// Pins the page in the given frame and returns a handle to it. Must be
+// called with the lock held.
+PageHandle BufferPool::pin(size_t index) {
+  Frame& frame = _frames[index];
+  ++frame.pins;
+  touch(frame);
+  return PageHandle(this, index, frame.id, frame_data(index));
+}
+
+// Gives up a pin on the page in the given frame
+void BufferPool::unpin(size_t index) {
+  lock_guard<mutex> lock(_mutex);
+  --_frames[index].pins;
+}
+
+// Marks the page in the given frame dirty
+void BufferPool::mark_dirty(size_t index) {
+  lock_guard<mutex> lock(_mutex);
+  _frames[index].dirty = true;
+}
+
+// Records a use of the page in frame
+void BufferPool::touch(Frame& frame) {
+  if (_policy == EvictionPolicy::CLOCK) {
+    frame.referenced = true;
+    return;
+  }
+  frame.history.insert(frame.history.begin(), ++_clock);
+  if (frame.history.size() > _k) {
+    frame.history.pop_back();
+  }
+}
+
+// Returns an empty frame, evicting a page if none is free. The frame is
+// removed from the page table and its history is cleared. Must be called
+// with the lock held.
+size_t BufferPool::victim() {
+  size_t index;
+  if (!_free.empty()) {
+    index = _free.back();
+    _free.pop_back();
+  } else {
+    index = _policy == EvictionPolicy::CLOCK ? clock_victim() : lru_k_victim();
+    Frame& frame = _frames[index];
+    write_back(frame, index);
+    _page_table.erase(frame.id);
+    ++_evictions;
+  }
+  Frame& frame = _frames[index];
+  frame.id = NO_PAGE;
+  frame.pins = 0;
+  frame.dirty = false;
+  frame.referenced = false;
+  frame.history.clear();
+  return index;
+}
+
+// Sweeps the clock hand over the frames, clearing reference bits, until
+// it reaches an unpinned frame whose bit is already clear. Two sweeps
+// clear every bit, so a frame is found in two unless all are pinned.
+size_t BufferPool::clock_victim() {
+  for (size_t step = 0; step < 2 * _frames.size(); ++step) {
+    size_t index = _hand;
+    _hand = (_hand + 1) % _frames.size();
+    Frame& frame = _frames[index];
+    if (frame.pins > 0) {
+      continue;
+    }
+    if (!frame.referenced) {
+      return index;
+    }
+    frame.referenced = false;
+  }
+  throw StorageError("Every buffer pool frame is pinned");
+}
+
+// Returns the unpinned frame whose K-th most recent use is oldest. Pages
+// used fewer than K times count as infinitely old, and ties are broken by
+// the most recent use.
+size_t BufferPool::lru_k_victim() {
+  size_t best = _frames.size();
+  uint64_t best_kth = 0;
+  uint64_t best_last = 0;
+  for (size_t i = 0; i < _frames.size(); ++i) {
+    const Frame& frame = _frames[i];
+    if (frame.pins > 0) {
+      continue;
+    }
+    uint64_t kth = frame.history.size() < _k ? 0 : frame.history.back();
+    uint64_t last = frame.history.empty() ? 0 : frame.history.front();
+    if (best == _frames.size() || kth < best_kth || (kth == best_kth && last < best_last)) {
+      best = i;
+      best_kth = kth;
+      best_last = last;
+    }
+  }
+  if (best == _frames.size()) {
+    throw StorageError("Every buffer pool frame is pinned");
+  }
+  return best;
+}
+
+// Writes the page in frame back to the file if it is dirty. Must be called
+// with the lock held.
+void BufferPool::write_back(Frame& frame, size_t index) {
+  if (frame.dirty && frame.id != NO_PAGE) {
+    _file.write(frame.id, frame_data(index));
+    frame.dirty = false;
+    ++_writes;
+  }
+}
+
+// Returns the memory of the given frame
+char *BufferPool::frame_data(size_t frame) const {
+  return const_cast<char*>(_memory.data()) + frame * _page_size;
+}
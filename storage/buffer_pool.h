@@ -0,0 +1,116 @@
+// SimpleSQL: Buffer pool
+//
+// Caches pages of a page file in a fixed number of frames, set by a memory
+// budget. A page is pinned while a PageHandle to it exists, and pinned
+// pages are never evicted. Modified pages are marked dirty and written
+// back when they are evicted or flushed. The frame to evict is chosen by
+// CLOCK, which approximates LRU with one reference bit per frame, or by
+// LRU-K, which evicts the page whose K-th most recent use is oldest so
+// that pages touched once by a scan leave before pages in steady use.
+
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "column.h"
+#include "page_file.h"
+
+class BufferPool;
+
+enum class EvictionPolicy {
+  CLOCK,
+  LRU_K
+};
+
+// A pinned page. Unpins the page when destroyed or released.
+class PageHandle {
+ public:
+  PageHandle();
+  PageHandle(PageHandle&& other);
+  PageHandle& operator=(PageHandle&& other);
+  ~PageHandle();
+  PageId id() const;
+  char *data() const;
+  void mark_dirty();
+  void release();
+  explicit operator bool() const;
+ private:
+  friend class BufferPool;
+  PageHandle(BufferPool *pool, std::size_t frame, PageId id, char *data);
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+  BufferPool *_pool;
+  std::size_t _frame;
+  PageId _id;
+  char *_data;
+};
+
+class BufferPool {
+ public:
+  BufferPool(PageFile& file, std::size_t memory_budget,
+	     EvictionPolicy policy = EvictionPolicy::CLOCK, std::size_t k = 2);
+  ~BufferPool();
+  PageFile& file() const;
+  std::size_t page_size() const;
+  std::size_t frames() const;
+  PageHandle fetch(PageId id);
+  PageHandle allocate(std::size_t pages = 1);
+  void prefetch(PageId first, std::size_t pages);
+  void flush(PageId id);
+  void flush_all();
+
+  std::size_t hits() const;
+  std::size_t misses() const;
+  std::size_t evictions() const;
+  std::size_t writes() const;
+  double hit_ratio() const;
+  void reset_stats();
+ private:
+  friend class PageHandle;
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  struct Frame {
+    PageId id;
+    std::size_t pins;
+    bool dirty;
+    // CLOCK: set when the page is used, cleared as the hand passes
+    bool referenced;
+    // LRU-K: the times of the last K uses, most recent first
+    std::vector<std::uint64_t> history;
+  };
+  PageHandle pin(std::size_t frame);
+  void unpin(std::size_t frame);
+  void mark_dirty(std::size_t frame);
+  void touch(Frame& frame);
+  std::size_t victim();
+  std::size_t clock_victim();
+  std::size_t lru_k_victim();
+  void write_back(Frame& frame, std::size_t index);
+  char *frame_data(std::size_t frame) const;
+
+  PageFile& _file;
+  const std::size_t _page_size;
+  const EvictionPolicy _policy;
+  const std::size_t _k;
+  AlignedBuffer _memory;
+  std::vector<Frame> _frames;
+  std::unordered_map<PageId, std::size_t> _page_table;
+  // Frames that have never held a page
+  std::vector<std::size_t> _free;
+  std::size_t _hand;
+  std::uint64_t _clock;
+  std::size_t _hits;
+  std::size_t _misses;
+  std::size_t _evictions;
+  std::size_t _writes;
+  mutable std::mutex _mutex;
+};
+
+#endif  // __BUFFER_POOL_H__
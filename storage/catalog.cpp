@@ -0,0 +1,646 @@
+// SimpleSQL: Catalog
+
+#include "catalog.h"
+#include <algorithm>
+#include <utility>
+#include "../exec/where.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+using std::unique_ptr;
+
+namespace {
+
+// Returns the position in table of each of the columns named, or of every
+// column in order if none are. Throws a StorageError if a column does not
+// exist or is named twice.
+vector<size_t> insert_columns(const Table& table, const ArenaList<ArenaString>& names) {
+  const Schema& schema = table.schema();
+  vector<size_t> columns;
+  columns.reserve(names.empty() ? schema.size() : names.size());
+  if (names.empty()) {
+    for (size_t i = 0; i < schema.size(); ++i) {
+      columns.push_back(i);
+    }
+    return columns;
+  }
+  vector<bool> named(schema.size(), false);
+  for (auto it = names.begin(); it != names.end(); ++it) {
+    string name = it->str();
+    int index = schema.index_of(name);
+    if (index < 0) {
+      throw StorageError("Table " + table.name() + " has no column " + name);
+    }
+    if (named[index]) {
+      throw StorageError("Column " + name + " is listed twice");
+    }
+    named[index] = true;
+    columns.push_back(index);
+  }
+  return columns;
+}
+
+// Appends the rows a query selects to a table as they arrive, a batch at a
+// time. The selected values go to the given columns of the table, and its
+// other columns are null.
+class InsertSink : public RowSink {
+ public:
+  InsertSink(Table& table, const vector<size_t>& columns);
+  void start(const Schema& columns);
+  void append(const Value *rows, size_t count);
+ private:
+  Table& _table;
+  const vector<size_t>& _columns;
+  // The batch being appended, laid out as the table's rows
+  vector<Value> _rows;
+  // The characters of the batch's strings
+  string _strings;
+};
+
+InsertSink::InsertSink(Table& table, const vector<size_t>& columns)
+  : _table(table), _columns(columns) {}
+
+// Checks that as many columns are selected as are inserted into, before
+// any row is appended
+void InsertSink::start(const Schema& columns) {
+  if (columns.size() != _columns.size()) {
+    throw StorageError("INSERT has " + std::to_string(_columns.size()) + " columns but " +
+		       std::to_string(columns.size()) + " are selected");
+  }
+}
+
+// Appends a batch of selected rows. Their strings are copied first, since
+// they may point into the table itself, where appending can move them.
+void InsertSink::append(const Value *rows, size_t count) {
+  const size_t width = _table.schema().size();
+  const size_t selected = _columns.size();
+  size_t length = 0;
+  for (size_t i = 0; i < count * selected; ++i) {
+    length += rows[i].type() == ValueType::STRING ? rows[i].string_length() : 0;
+  }
+  _strings.resize(length);
+  _rows.assign(count * width, Value());
+  char *next = &_strings[0];
+  for (size_t row = 0; row < count; ++row) {
+    for (size_t i = 0; i < selected; ++i) {
+      Value value = rows[row * selected + i];
+      if (value.type() == ValueType::STRING) {
+	std::copy(value.string_data(), value.string_data() + value.string_length(), next);
+	value = Value(next, value.string_length());
+	next += value.string_length();
+      }
+      _rows[row * width + _columns[i]] = value;
+    }
+  }
+  _table.append_in_place(_rows.data(), count);
+}
+
+// Deletes the rows of table from first on, and their index entries. Undoes
+// the batches a statement appended before one of them failed.
+void erase_appended(Table& table, size_t first) {
+  vector<size_t> rows;
+  rows.reserve(table.rows() - first);
+  for (size_t row = first; row < table.rows(); ++row) {
+    rows.push_back(row);
+  }
+  table.erase(rows);
+}
+
+}  // namespace
+
+/*------------------------------------------------
+  TableBuilder methods
+  ----------------------------------------------*/
+
+// Creates a builder whose tables have chunks of chunk_rows rows
+TableBuilder::TableBuilder(size_t chunk_rows)
+  : _chunk_rows(chunk_rows), _has_primary_key(false) {}
+
+// Returns the table described by node. Throws a StorageError if the
+// declarations are inconsistent, such as a column declared twice.
+unique_ptr<Table> TableBuilder::build(const CreateTable& node) {
+  node.accept(*this);
+  return std::move(_table);
+}
+
+void TableBuilder::visitCreateTable(const CreateTable& node) {
+  _schema = Schema();
+  _primary_key.clear();
+  _has_primary_key = false;
+  for (auto it = node.elements().begin(); it != node.elements().end(); ++it) {
+    (*it)->accept(*this);
+  }
+  // The key may be declared before the columns it names
+  if (_has_primary_key) {
+    _schema.set_primary_key(_primary_key);
+  }
+  _table.reset(new Table(node.name().str(), _schema, _chunk_rows));
+}
+
+void TableBuilder::visitColumnDecl(const ColumnDecl& node) {
+  ColumnSchema column{node.name().str(), node.type(), node.length(), node.nullable()};
+  if (!node.members().empty()) {
+    vector<string> members;
+    for (auto it = node.members().begin(); it != node.members().end(); ++it) {
+      members.push_back(it->str());
+    }
+    column.dictionary.reset(new Dictionary(members));
+  }
+  _schema.add_column(column);
+}
+
+void TableBuilder::visitPrimaryKeyDecl(const PrimaryKeyDecl& node) {
+  if (_has_primary_key) {
+    throw StorageError("Only one primary key may be declared");
+  }
+  _has_primary_key = true;
+  for (auto it = node.keys().begin(); it != node.keys().end(); ++it) {
+    _primary_key.push_back(it->str());
+  }
+}
+
+/*------------------------------------------------
+  Catalog methods
+  ----------------------------------------------*/
+
+const size_t Catalog::DEFAULT_MEMORY_BUDGET;
+
+Catalog::Catalog() : _parameters(nullptr) {}
+
+// Returns the table with the given name, or null if there is none
+Table *Catalog::table(const string& name) const {
+  auto it = _tables.find(name);
+  return it == _tables.end() ? nullptr : it->second.get();
+}
+
+// Creates the table described by node and returns it. Throws a
+// StorageError if a table of that name exists.
+Table& Catalog::create_table(const CreateTable& node) {
+  string name = node.name().str();
+  if (table(name)) {
+    throw StorageError("Table " + name + " already exists");
+  }
+  TableBuilder builder;
+  unique_ptr<Table> table = builder.build(node);
+  if (_store) {
+    _store->keep(*table);
+  }
+  Table& created = *table;
+  _tables[name] = std::move(table);
+  return created;
+}
+
+// Drops the table with the given name, and its indexes. Throws a
+// StorageError if there is none.
+void Catalog::drop_table(const string& name) {
+  if (_tables.erase(name) == 0) {
+    throw StorageError("Table " + name + " does not exist");
+  }
+  for (auto it = _index_tables.begin(); it != _index_tables.end();) {
+    it = it->second == name ? _index_tables.erase(it) : std::next(it);
+  }
+}
+
+// Returns the names of every table, sorted
+vector<string> Catalog::table_names() const {
+  vector<string> names;
+  for (auto it = _tables.begin(); it != _tables.end(); ++it) {
+    names.push_back(it->first);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+// Creates the index described by node, filled with the rows of its table,
+// and returns it. Throws a StorageError if an index of that name exists,
+// or the table or columns do not.
+const SecondaryIndex& Catalog::create_index(const CreateIndex& node) {
+  string name = node.name().str();
+  if (_index_tables.count(name)) {
+    throw StorageError("Index " + name + " already exists");
+  }
+  Table& table = existing_table(node.table_name().str());
+  vector<string> columns;
+  for (auto it = node.columns().begin(); it != node.columns().end(); ++it) {
+    columns.push_back(it->str());
+  }
+  const SecondaryIndex& index = table.create_index(name, node.kind(), columns);
+  _index_tables[name] = table.name();
+  return index;
+}
+
+// Drops the index with the given name. Throws a StorageError if there is
+// none.
+void Catalog::drop_index(const string& name) {
+  auto it = _index_tables.find(name);
+  if (it == _index_tables.end()) {
+    throw StorageError("Index " + name + " does not exist");
+  }
+  existing_table(it->second).drop_index(name);
+  _index_tables.erase(it);
+}
+
+// Keeps the tables in file from now on, in up to memory_budget bytes of
+// memory. Adds the tables saved in it, with their indexes, and returns the
+// LSN they were saved with; a file nothing was saved to adds nothing and
+// returns 0. Tables the catalog already has are kept in the file too, and
+// written to it once they are saved or paged out. The file must outlive
+// the catalog. Throws a StorageError if the catalog already keeps its
+// tables in a file, the file is corrupt, or a table or index of the same
+// name already exists.
+std::uint64_t Catalog::open(PageFile& file, size_t memory_budget) {
+  if (_store) {
+    throw StorageError("The tables are already kept in a file");
+  }
+  unique_ptr<TableStore> store(new TableStore(file, memory_budget));
+  std::uint64_t lsn;
+  vector<unique_ptr<Table>> tables = store->open(lsn);
+  for (auto it = tables.begin(); it != tables.end(); ++it) {
+    const string& name = (*it)->name();
+    if (table(name)) {
+      throw StorageError("Table " + name + " already exists");
+    }
+    for (auto index = (*it)->indexes().begin(); index != (*it)->indexes().end(); ++index) {
+      if (_index_tables.count((*index)->name())) {
+	throw StorageError("Index " + (*index)->name() + " already exists");
+      }
+    }
+  }
+  for (auto it = _tables.begin(); it != _tables.end(); ++it) {
+    store->keep(*it->second);
+  }
+  for (auto it = tables.begin(); it != tables.end(); ++it) {
+    for (auto index = (*it)->indexes().begin(); index != (*it)->indexes().end(); ++index) {
+      _index_tables[(*index)->name()] = (*it)->name();
+    }
+    string name = (*it)->name();
+    _tables[name] = std::move(*it);
+  }
+  _store = std::move(store);
+  return lsn;
+}
+
+// Writes the chunks changed since they were last written and the indexes
+// of every table to the file the tables are kept in, with the LSN of the
+// last logged statement they reflect, and makes them the file's root once
+// they reach the disk. Throws a StorageError if the tables are not kept in
+// a file, or it cannot be written.
+void Catalog::save(std::uint64_t lsn) {
+  if (!_store) {
+    throw StorageError("The tables are not kept in a file");
+  }
+  vector<const Table*> tables;
+  vector<string> names = table_names();
+  for (auto it = names.begin(); it != names.end(); ++it) {
+    tables.push_back(table(*it));
+  }
+  _store->save(tables, lsn);
+}
+
+// Returns the store the tables are kept in, or null if they are not kept
+// in a file
+const TableStore *Catalog::store() const {
+  return _store.get();
+}
+
+// Applies statement, taking the values of its placeholders from
+// parameters
+void Catalog::execute(const ASTNode& statement, const vector<Value>& parameters) {
+  _parameters = &parameters;
+  try {
+    statement.accept(*this);
+  } catch (...) {
+    _parameters = nullptr;
+    throw;
+  }
+  _parameters = nullptr;
+}
+
+// Returns the result of the SELECT statement last visited, or null if it
+// has been taken or none has been visited
+unique_ptr<QueryResult> Catalog::take_result() {
+  return std::move(_result);
+}
+
+void Catalog::visitCreateTable(const CreateTable& node) {
+  begin_statement();
+  create_table(node);
+}
+
+void Catalog::visitDropTable(const DropTable& node) {
+  begin_statement();
+  drop_table(node.name().str());
+}
+
+void Catalog::visitCreateIndex(const CreateIndex& node) {
+  begin_statement();
+  create_index(node);
+}
+
+void Catalog::visitDropIndex(const DropIndex& node) {
+  begin_statement();
+  drop_index(node.name().str());
+}
+
+void Catalog::visitInsert(const Insert& node) {
+  begin_statement();
+  node.option()->accept(*this);
+}
+
+// Appends the rows of values, in the order of the columns listed or, if
+// there are none, of the table's columns. Columns not listed are null. The
+// rows are appended a batch at a time, and if one does not fit the batches
+// before it are deleted again, so either all of them are or none is.
+void Catalog::visitValuesOption(const ValuesOption& node) {
+  Table& table = existing_table(node.table_name().str());
+  const size_t width = table.schema().size();
+  // The column of the table each value of a row goes to
+  const vector<size_t> targets = insert_columns(table, node.columns());
+  const size_t columns = targets.size();
+  if (node.width() != columns) {
+    throw StorageError("INSERT has " + std::to_string(columns) + " columns but " +
+		       std::to_string(node.width()) + " values");
+  }
+  const size_t rows = node.rows();
+  const Value *values = node.values().begin();
+  const RowExpression *expression = node.expressions().begin();
+  vector<Value> batch(std::min(rows, ValuesLoader::DEFAULT_BATCH_ROWS) * width);
+  const size_t first = table.rows();
+  try {
+    for (size_t start = 0; start < rows; start += ValuesLoader::DEFAULT_BATCH_ROWS) {
+      const size_t count = std::min(rows - start, ValuesLoader::DEFAULT_BATCH_ROWS);
+      for (size_t row = 0; row < count; ++row) {
+	const Value *in = values + (start + row) * columns;
+	Value *out = &batch[row * width];
+	for (size_t i = 0; i < columns; ++i) {
+	  out[targets[i]] = in[i];
+	}
+      }
+      // Expressions are listed in the order of their positions
+      const size_t end = (start + count) * columns;
+      for (; expression != node.expressions().end() && expression->position < end; ++expression) {
+	size_t row = expression->position / columns - start;
+	batch[row * width + targets[expression->position % columns]] = evaluate(expression->expression);
+      }
+      table.append_in_place(batch.data(), count);
+    }
+  } catch (...) {
+    erase_appended(table, first);
+    throw;
+  }
+}
+
+// Appends the row given by the assignments. Columns not assigned are null.
+void Catalog::visitSetOption(const SetOption& node) {
+  Table& table = existing_table(node.table_name().str());
+  const Schema& schema = table.schema();
+  vector<Value> row(schema.size());
+  vector<bool> assigned(schema.size(), false);
+  for (auto it = node.set().begin(); it != node.set().end(); ++it) {
+    string name = it->column().str();
+    int index = schema.index_of(name);
+    if (index < 0) {
+      throw StorageError("Table " + table.name() + " has no column " + name);
+    }
+    if (assigned[index]) {
+      throw StorageError("Column " + name + " is assigned twice");
+    }
+    assigned[index] = true;
+    row[index] = evaluate(it->value());
+  }
+  table.append(row);
+}
+
+// Appends the rows the query selects, in the order of the columns listed
+// or, if there are none, of the table's columns. Columns not listed are
+// null. Rows are appended a batch at a time as the query finds them, so
+// they are never all held at once. If a row does not fit, the batches
+// before it are deleted again, so the statement either inserts every row
+// or none.
+void Catalog::visitSelectOption(const SelectOption& node) {
+  Table& table = existing_table(node.table_name().str());
+  const vector<size_t> columns = insert_columns(table, node.column_list());
+  InsertSink sink(table, columns);
+  const size_t first = table.rows();
+  try {
+    run_select(*this, *node.select(), parameters(), &pool(), sink);
+  } catch (...) {
+    erase_appended(table, first);
+    throw;
+  }
+}
+
+// Deletes the rows that meet the condition, or every row if there is none
+void Catalog::visitDelete(const Delete& node) {
+  begin_statement();
+  Table& table = existing_table(node.table_name().str());
+  vector<size_t> rows;
+  select_rows(table, node.exp(), parameters(), rows, nullptr, &pool());
+  table.erase(rows);
+}
+
+// Assigns the values to the columns of the rows that meet the condition,
+// or of every row if there is none
+void Catalog::visitUpdate(const Update& node) {
+  begin_statement();
+  Table& table = existing_table(node.table_name().str());
+  const Schema& schema = table.schema();
+  vector<std::pair<size_t, Value>> assignments;
+  vector<bool> assigned(schema.size(), false);
+  for (auto it = node.set().begin(); it != node.set().end(); ++it) {
+    string name = it->column().str();
+    int index = schema.index_of(name);
+    if (index < 0) {
+      throw StorageError("Table " + table.name() + " has no column " + name);
+    }
+    if (assigned[index]) {
+      throw StorageError("Column " + name + " is assigned twice");
+    }
+    assigned[index] = true;
+    assignments.push_back(std::make_pair(static_cast<size_t>(index), evaluate(it->value())));
+  }
+  vector<size_t> rows;
+  select_rows(table, node.exp(), parameters(), rows, nullptr, &pool());
+  table.update(rows, assignments);
+}
+
+// Runs the query and keeps its result
+void Catalog::visitSelect(const Select& node) {
+  begin_statement();
+  _result.reset(new QueryResult(run_select(*this, node, parameters(), &pool())));
+}
+
+void Catalog::visitLiteral(const Literal& node) {
+  _value = node.value();
+}
+
+void Catalog::visitPlaceholder(const Placeholder& node) {
+  if (!_parameters || node.index() >= _parameters->size()) {
+    throw StorageError("No value for parameter " + std::to_string(node.index() + 1));
+  }
+  _value = (*_parameters)[node.index()];
+}
+
+void Catalog::visitColumnRef(const ColumnRef& node) {
+  throw StorageError("Column " + node.name().str() + " cannot be used as a value");
+}
+
+void Catalog::visitBinaryExpr(const BinaryExpr& node) {
+  throw StorageError("Conditions cannot be used as values");
+}
+
+void Catalog::visitAggregateExpr(const AggregateExpr& node) {
+  throw StorageError("Aggregates cannot be used as values");
+}
+
+// Returns the table with the given name. Throws a StorageError if there is
+// none.
+Table& Catalog::existing_table(const string& name) const {
+  Table *found = table(name);
+  if (!found) {
+    throw StorageError("Table " + name + " does not exist");
+  }
+  return *found;
+}
+
+// Returns the value of an expression inserted or assigned
+Value Catalog::evaluate(const Expression *expression) {
+  expression->accept(*this);
+  return _value;
+}
+
+// Returns the parameters of the statement being applied, which are empty
+// unless it is applied with execute()
+const vector<Value>& Catalog::parameters() const {
+  static const vector<Value> none;
+  return _parameters ? *_parameters : none;
+}
+
+// Returns the threads queries run on, starting them if they are not
+ThreadPool& Catalog::pool() {
+  if (!_pool) {
+    _pool.reset(new ThreadPool());
+  }
+  return *_pool;
+}
+
+// Starts applying a statement. The chunks of tables kept in a file that
+// the statement before it read may then be paged out, since no value read
+// from them is used any more.
+void Catalog::begin_statement() {
+  if (_store) {
+    _store->begin_statement();
+  }
+}
+
+/*------------------------------------------------
+  ValuesLoader methods
+  ----------------------------------------------*/
+
+const size_t ValuesLoader::DEFAULT_BATCH_ROWS;
+
+// Creates a loader that appends rows to the tables of catalog batch_rows
+// at a time
+ValuesLoader::ValuesLoader(Catalog& catalog, size_t batch_rows)
+  : _catalog(catalog), _table(nullptr), _first_row(0), _resume(nullptr), _offset(0),
+    _done(false) {
+  _batch.stride = 0;
+  _batch.capacity = batch_rows ? batch_rows : 1;
+  _batch.count = 0;
+}
+
+// Starts loading the statement whose first piece is the tokens in [begin,
+// end). Returns false, loading nothing, if it is not an INSERT ... VALUES
+// statement. Throws a StorageError if the table or a column listed does
+// not exist.
+bool ValuesLoader::start(const FlatToken *begin, const FlatToken *end) {
+  _catalog.begin_statement();
+  _arena.reset();
+  _table = nullptr;
+  ValuesHeader header;
+  if (!parse_values_header(begin, end, _arena, header)) {
+    return false;
+  }
+  Table& table = _catalog.existing_table(header.table.str());
+  _batch.targets = insert_columns(table, header.columns);
+  _batch.stride = table.schema().size();
+  // Rows are added as they are parsed, so are null to begin with. Columns
+  // not listed stay null, as converting a null leaves it null, but a batch
+  // kept from an earlier statement must be cleared if there are any.
+  if (_batch.targets.size() < _batch.stride) {
+    _batch.values.clear();
+  }
+  _batch.count = 0;
+  _batch.expressions.clear();
+  _table = &table;
+  _first_row = table.rows();
+  _resume = header.rows;
+  _offset = 0;
+  _done = false;
+  return true;
+}
+
+// Appends the rows of the piece of the statement in [begin, end), the
+// first being the one passed to start(). Unless last is set, the statement
+// goes on in later pieces, and the rows the piece may not hold whole are
+// left for the next one. Returns the first token not loaded, where the next
+// piece must start. Throws a ParseError, with a token index relative to the
+// start of the statement, or a StorageError if a row is invalid, after
+// deleting the rows the statement appended.
+const FlatToken *ValuesLoader::load(const FlatToken *begin, const FlatToken *end, bool last) {
+  const FlatToken *it = _resume ? _resume : begin;
+  _resume = nullptr;
+  try {
+    while (true) {
+      try {
+	it = parse_rows(it, end, last, _arena, _batch, _done);
+      } catch (const ParseError& e) {
+	throw ParseError(e.what(), _offset + (it - begin) + e.token());
+      }
+      if (_batch.count < _batch.capacity) {
+	break;
+      }
+      flush();
+    }
+    // The values of the batch refer to the piece's tokens, which do not
+    // outlive it
+    flush();
+    if (!_done && it == begin) {
+      throw ParseError("Row too long to read", _offset + (it - begin));
+    }
+  } catch (...) {
+    _batch.count = 0;
+    _batch.expressions.clear();
+    _arena.reset();
+    erase_appended(*_table, _first_row);
+    throw;
+  }
+  _offset += it - begin;
+  return it;
+}
+
+// Returns true once the last row of the statement has been loaded
+bool ValuesLoader::done() const {
+  return _done;
+}
+
+// Returns the number of rows the statement has appended so far
+size_t ValuesLoader::rows() const {
+  return _table ? _table->rows() - _first_row : 0;
+}
+
+// Evaluates the values of the batch that are not literals, and appends
+// the batch to the table
+void ValuesLoader::flush() {
+  for (auto it = _batch.expressions.begin(); it != _batch.expressions.end(); ++it) {
+    _batch.values[it->position] = _catalog.evaluate(it->expression);
+  }
+  const size_t count = _batch.count;
+  _batch.count = 0;
+  _batch.expressions.clear();
+  if (count > 0) {
+    _table->append_in_place(_batch.values.data(), count);
+  }
+  _arena.reset();
+}
@@ -0,0 +1,139 @@
+// SimpleSQL: Catalog
+//
+// Turns CREATE TABLE statements into physical tables, keeps the tables of
+// the database and their indexes by name, and applies INSERT, UPDATE and
+// DELETE statements to them.
+
+#ifndef __CATALOG_H__
+#define __CATALOG_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../AST/visitor.h"
+#include "../exec/query.h"
+#include "../parser/parser.h"
+#include "../util/thread_pool.h"
+#include "table.h"
+#include "table_file.h"
+
+// Builds the empty table described by a CreateTable AST. Every ColumnDecl
+// becomes a column, and the PrimaryKeyDecl, if any, the primary key.
+// Foreign keys are accepted but not enforced.
+class TableBuilder : public Visitor {
+ public:
+  TableBuilder(std::size_t chunk_rows = Table::DEFAULT_CHUNK_ROWS);
+  std::unique_ptr<Table> build(const CreateTable& node);
+  void visitCreateTable(const CreateTable& node);
+  void visitColumnDecl(const ColumnDecl& node);
+  void visitPrimaryKeyDecl(const PrimaryKeyDecl& node);
+ private:
+  const std::size_t _chunk_rows;
+  Schema _schema;
+  std::vector<std::string> _primary_key;
+  bool _has_primary_key;
+  std::unique_ptr<Table> _table;
+};
+
+// The tables of a database. Visiting a CREATE TABLE, DROP TABLE, CREATE
+// INDEX, DROP INDEX, INSERT, UPDATE or DELETE statement applies it, and
+// visiting a SELECT statement runs it and keeps its result for
+// take_result(). The values inserted or assigned must be literals, or
+// placeholders when the statement is applied with execute(), and INSERT
+// ... SELECT appends the rows of its query as the query finds them. Index
+// names are unique across the database. The tables can be kept in a page
+// file, which pages their chunks in and out of memory (see table_file.h),
+// and saved to it.
+class Catalog : public Visitor {
+ public:
+  Catalog();
+  Table *table(const std::string& name) const;
+  Table& create_table(const CreateTable& node);
+  void drop_table(const std::string& name);
+  std::vector<std::string> table_names() const;
+  const SecondaryIndex& create_index(const CreateIndex& node);
+  void drop_index(const std::string& name);
+  std::uint64_t open(PageFile& file, std::size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+  void save(std::uint64_t lsn);
+  const TableStore *store() const;
+  void execute(const ASTNode& statement, const std::vector<Value>& parameters);
+  std::unique_ptr<QueryResult> take_result();
+  void visitCreateTable(const CreateTable& node);
+  void visitDropTable(const DropTable& node);
+  void visitCreateIndex(const CreateIndex& node);
+  void visitDropIndex(const DropIndex& node);
+  void visitInsert(const Insert& node);
+  void visitValuesOption(const ValuesOption& node);
+  void visitSetOption(const SetOption& node);
+  void visitSelectOption(const SelectOption& node);
+  void visitDelete(const Delete& node);
+  void visitUpdate(const Update& node);
+  void visitSelect(const Select& node);
+  void visitLiteral(const Literal& node);
+  void visitPlaceholder(const Placeholder& node);
+  void visitColumnRef(const ColumnRef& node);
+  void visitBinaryExpr(const BinaryExpr& node);
+  void visitAggregateExpr(const AggregateExpr& node);
+
+  // The memory a database kept in a page file uses by default
+  static const std::size_t DEFAULT_MEMORY_BUDGET = 64 << 20;
+ private:
+  friend class ValuesLoader;
+  Table& existing_table(const std::string& name) const;
+  Value evaluate(const Expression *expression);
+  const std::vector<Value>& parameters() const;
+  ThreadPool& pool();
+  void begin_statement();
+
+  // Null unless the tables are kept in a page file. Outlives the tables.
+  std::unique_ptr<TableStore> _store;
+  std::unordered_map<std::string, std::unique_ptr<Table>> _tables;
+  // The name of the table of every index
+  std::unordered_map<std::string, std::string> _index_tables;
+  // The parameters of the statement being applied
+  const std::vector<Value> *_parameters;
+  // The value of the expression last evaluated
+  Value _value;
+  // The result of the SELECT statement last run, until it is taken
+  std::unique_ptr<QueryResult> _result;
+  // The threads queries run on, started by the first SELECT
+  std::unique_ptr<ThreadPool> _pool;
+};
+
+// Applies INSERT ... VALUES statements to a catalog as their tokens arrive,
+// which may be in several pieces when a statement is longer than the
+// buffer it is read through. Rows are parsed straight into a batch laid
+// out as the table's rows, converted in place and appended a batch at a
+// time, so no AST is built for them. If a row fails, the rows the
+// statement appended before it are deleted again.
+class ValuesLoader {
+ public:
+  explicit ValuesLoader(Catalog& catalog, std::size_t batch_rows = DEFAULT_BATCH_ROWS);
+  bool start(const FlatToken *begin, const FlatToken *end);
+  const FlatToken *load(const FlatToken *begin, const FlatToken *end, bool last);
+  bool done() const;
+  std::size_t rows() const;
+
+  static const std::size_t DEFAULT_BATCH_ROWS = 1024;
+ private:
+  ValuesLoader(const ValuesLoader&) = delete;
+  ValuesLoader& operator=(const ValuesLoader&) = delete;
+  void flush();
+
+  Catalog& _catalog;
+  // Holds the strings and expressions of the rows in the batch
+  Arena _arena;
+  Table *_table;
+  RowBatch _batch;
+  // The number of rows in the table before the statement
+  std::size_t _first_row;
+  // Where the first piece's rows start, until it is loaded
+  const FlatToken *_resume;
+  // The index in the statement of the first token of the current piece
+  std::size_t _offset;
+  bool _done;
+};
+
+#endif  // __CATALOG_H__
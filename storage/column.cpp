@@ -0,0 +1,418 @@
+// SimpleSQL: Column storage
+
+#include "column.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+using std::size_t;
+using std::uint64_t;
+
+namespace {
+
+// The number a coerced value of a numeric column holds, as the C++ type of
+// the column's physical type
+template <typename T>
+T number(const Value& value);
+
+template <>
+std::int64_t number(const Value& value) {
+  return value.int_value();
+}
+
+template <>
+uint64_t number(const Value& value) {
+  return value.uint_value();
+}
+
+template <>
+double number(const Value& value) {
+  return value.double_value();
+}
+
+Value number_value(std::int64_t number) {
+  return Value(static_cast<long long>(number));
+}
+
+Value number_value(uint64_t number) {
+  return Value(static_cast<unsigned long long>(number));
+}
+
+Value number_value(double number) {
+  return Value(number);
+}
+
+}  // namespace
+
+/*------------------------------------------------
+  AlignedBuffer methods
+  ----------------------------------------------*/
+
+AlignedBuffer::AlignedBuffer() : _data(nullptr), _capacity(0) {}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other)
+  : _data(other._data), _capacity(other._capacity) {
+  other._data = nullptr;
+  other._capacity = 0;
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) {
+  std::swap(_data, other._data);
+  std::swap(_capacity, other._capacity);
+  return *this;
+}
+
+AlignedBuffer::~AlignedBuffer() {
+  std::free(_data);
+}
+
+// Grows the buffer to hold at least bytes bytes, keeping its contents.
+// New bytes are zeroed.
+void AlignedBuffer::reserve(size_t bytes) {
+  if (bytes <= _capacity) {
+    return;
+  }
+  // Round up to whole cache lines so vector loads never run off the end
+  bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  void *grown;
+  if (posix_memalign(&grown, CACHE_LINE_SIZE, bytes) != 0) {
+    throw std::bad_alloc();
+  }
+  if (_capacity > 0) {
+    std::memcpy(grown, _data, _capacity);
+  }
+  std::memset(static_cast<char*>(grown) + _capacity, 0, bytes - _capacity);
+  std::free(_data);
+  _data = static_cast<char*>(grown);
+  _capacity = bytes;
+}
+
+// Returns the size of the buffer in bytes
+size_t AlignedBuffer::capacity() const {
+  return _capacity;
+}
+
+char *AlignedBuffer::data() {
+  return _data;
+}
+
+const char *AlignedBuffer::data() const {
+  return _data;
+}
+
+/*------------------------------------------------
+  ColumnChunk methods
+  ----------------------------------------------*/
+
+// Creates an empty chunk of the given column
+ColumnChunk::ColumnChunk(const ColumnSchema& column)
+  : _column(column), _type(physical_type(column.type)), _size(0), _capacity(0),
+    _heap_size(0) {}
+
+// Returns the schema of the column
+const ColumnSchema& ColumnChunk::column() const {
+  return _column;
+}
+
+// Returns how the column's values are stored
+PhysicalType ColumnChunk::type() const {
+  return _type;
+}
+
+// Returns the number of rows in the chunk
+size_t ColumnChunk::size() const {
+  return _size;
+}
+
+// Returns the number of rows the chunk has room for
+size_t ColumnChunk::capacity() const {
+  return _capacity;
+}
+
+// Returns the bytes of memory the column's values, validity, heap and
+// zones take up
+size_t ColumnChunk::bytes() const {
+  return _values.capacity() + (_encoded ? _encoded->bytes() : 0) + _validity.capacity() +
+    _heap.capacity() + _zones.capacity() * sizeof(Zone);
+}
+
+// Makes room for rows rows in all, so that appending up to that many
+// moves nothing
+void ColumnChunk::reserve(size_t rows) {
+  if (rows <= _capacity) {
+    return;
+  }
+  _values.reserve(rows * physical_width(_type));
+  if (_column.nullable) {
+    _validity.reserve((rows + 63) / 64 * sizeof(uint64_t));
+  }
+  _capacity = rows;
+}
+
+// Appends value, which must already be coerced to the column's type with
+// Schema::coerce()
+void ColumnChunk::append(const Value& value) {
+  if (_size == _capacity) {
+    reserve(_capacity ? _capacity * 2 : 1024);
+  }
+  if (_size % ZONE_ROWS == 0) {
+    _zones.push_back(Zone{Value(), Value(), 0, 0});
+  }
+  widen(_zones.back(), value);
+  if (_column.nullable && !value.is_null()) {
+    _validity.as<uint64_t>()[_size / 64] |= uint64_t(1) << (_size % 64);
+  }
+  switch (_type) {
+  case PhysicalType::INT64:
+    _values.as<std::int64_t>()[_size] = value.is_null() ? 0 : value.int_value();
+    break;
+  case PhysicalType::UINT64:
+    _values.as<uint64_t>()[_size] = value.is_null() ? 0 : value.uint_value();
+    break;
+  case PhysicalType::DOUBLE:
+    _values.as<double>()[_size] = value.is_null() ? 0.0 : value.double_value();
+    break;
+  case PhysicalType::STRING:
+    if (!value.is_null()) {
+      size_t needed = _heap_size + value.string_length();
+      if (needed > _heap.capacity()) {
+	_heap.reserve(needed > 2 * _heap.capacity() ? needed : 2 * _heap.capacity());
+      }
+      std::memcpy(_heap.data() + _heap_size, value.string_data(), value.string_length());
+      _heap_size = needed;
+    }
+    _values.as<uint64_t>()[_size] = _heap_size;
+    break;
+  case PhysicalType::ENUM:
+    _values.as<std::uint8_t>()[_size] = value.is_null() ? 0
+      : _column.dictionary->index_of(value.string_data(), value.string_length()) + 1;
+    break;
+  case PhysicalType::SET: {
+    uint64_t mask = 0;
+    if (!value.is_null()) {
+      _column.dictionary->set_mask(value.string_data(), value.string_length(), mask);
+    }
+    _values.as<uint64_t>()[_size] = mask;
+    break;
+  }
+  }
+  ++_size;
+}
+
+// Appends count values, each stride values after the one before, which
+// must already be coerced, as append() would one at a time. Numeric columns
+// are filled by a loop for their type.
+void ColumnChunk::append(const Value *values, size_t count, size_t stride) {
+  switch (_type) {
+  case PhysicalType::INT64:
+    append_numbers<std::int64_t>(values, count, stride);
+    break;
+  case PhysicalType::UINT64:
+    append_numbers<uint64_t>(values, count, stride);
+    break;
+  case PhysicalType::DOUBLE:
+    append_numbers<double>(values, count, stride);
+    break;
+  default:
+    for (size_t i = 0; i < count; ++i) {
+      append(values[i * stride]);
+    }
+  }
+}
+
+// Appends count values of a numeric column whose values are T, a zone at a
+// time, keeping the zone's bounds as numbers until it is done
+template <typename T>
+void ColumnChunk::append_numbers(const Value *values, size_t count, size_t stride) {
+  if (_size + count > _capacity) {
+    reserve(std::max(_size + count, 2 * _capacity));
+  }
+  T *const out = _values.as<T>();
+  uint64_t *const validity = _column.nullable ? _validity.as<uint64_t>() : nullptr;
+  while (count > 0) {
+    if (_size % ZONE_ROWS == 0) {
+      _zones.push_back(Zone{Value(), Value(), 0, 0});
+    }
+    Zone& zone = _zones.back();
+    const size_t batch = std::min(count, ZONE_ROWS - _size % ZONE_ROWS);
+    bool bounded = !zone.low.is_null();
+    T low = bounded ? number<T>(zone.low) : T();
+    T high = bounded ? number<T>(zone.high) : T();
+    for (size_t row = _size; row < _size + batch; ++row, values += stride) {
+      if (values->is_null()) {
+	out[row] = T();
+	++zone.nulls;
+	continue;
+      }
+      const T value = number<T>(*values);
+      out[row] = value;
+      if (validity) {
+	validity[row / 64] |= uint64_t(1) << (row % 64);
+      }
+      // A NaN widens no zone, as in widen()
+      if (value != value) {
+	continue;
+      }
+      if (!bounded) {
+	low = high = value;
+	bounded = true;
+      } else if (value < low) {
+	low = value;
+      } else if (value > high) {
+	high = value;
+      }
+    }
+    zone.rows += batch;
+    if (bounded) {
+      zone.low = number_value(low);
+      zone.high = number_value(high);
+    }
+    _size += batch;
+    count -= batch;
+  }
+}
+
+// Encodes the values of a numeric column, if that saves enough space, and
+// frees the plain ones. Called once the chunk is full; nothing can be
+// appended after.
+void ColumnChunk::seal() {
+  if (_encoded || _size == 0) {
+    return;
+  }
+  switch (_type) {
+  case PhysicalType::INT64:
+    _encoded = EncodedColumn::encode(_values.as<std::int64_t>(), validity(), _size);
+    break;
+  case PhysicalType::UINT64:
+    _encoded = EncodedColumn::encode(_values.as<uint64_t>(), validity(), _size);
+    break;
+  case PhysicalType::DOUBLE:
+    _encoded = EncodedColumn::encode(_values.as<double>(), validity(), _size);
+    break;
+  default:
+    return;
+  }
+  if (_encoded) {
+    _values = AlignedBuffer();
+  }
+}
+
+// Returns the number of zones of the column
+size_t ColumnChunk::zones() const {
+  return _zones.size();
+}
+
+// Returns the zone of the rows from index * ZONE_ROWS up to the next zone
+const Zone& ColumnChunk::zone(size_t index) const {
+  return _zones[index];
+}
+
+// Summarizes the rows of a zone again, leaving out those deleted. deleted
+// has a bit per row, set for deleted rows; rows past its end are not
+// deleted.
+void ColumnChunk::summarize(size_t index, const std::vector<uint64_t>& deleted) {
+  Zone zone{Value(), Value(), 0, 0};
+  const size_t end = std::min(_size, (index + 1) * ZONE_ROWS);
+  for (size_t row = index * ZONE_ROWS; row < end; ++row) {
+    if (row / 64 >= deleted.size() || !bit_is_set(deleted.data(), row)) {
+      widen(zone, value(row));
+    }
+  }
+  _zones[index] = zone;
+}
+
+// Takes value, coerced to the column's type, into zone
+void ColumnChunk::widen(Zone& zone, const Value& value) const {
+  ++zone.rows;
+  if (value.is_null()) {
+    ++zone.nulls;
+    return;
+  }
+  bool lower;
+  bool higher;
+  switch (_type) {
+  case PhysicalType::INT64:
+    lower = zone.low.is_null() || value.int_value() < zone.low.int_value();
+    higher = zone.high.is_null() || value.int_value() > zone.high.int_value();
+    break;
+  case PhysicalType::UINT64:
+    lower = zone.low.is_null() || value.uint_value() < zone.low.uint_value();
+    higher = zone.high.is_null() || value.uint_value() > zone.high.uint_value();
+    break;
+  case PhysicalType::DOUBLE:
+    if (std::isnan(value.double_value())) {
+      return;
+    }
+    lower = zone.low.is_null() || value.double_value() < zone.low.double_value();
+    higher = zone.high.is_null() || value.double_value() > zone.high.double_value();
+    break;
+  default:
+    return;
+  }
+  if (lower) {
+    zone.low = value;
+  }
+  if (higher) {
+    zone.high = value;
+  }
+}
+
+// Returns the encoded values of the column, or null if it is plain
+const EncodedColumn *ColumnChunk::encoded() const {
+  return _encoded.get();
+}
+
+// Returns the validity bitmap of the chunk, or null if the column is not
+// nullable
+const uint64_t *ColumnChunk::validity() const {
+  return _column.nullable ? _validity.as<uint64_t>() : nullptr;
+}
+
+// Returns true if the value at row is null
+bool ColumnChunk::is_null(size_t row) const {
+  return _column.nullable && !bit_is_set(_validity.as<uint64_t>(), row);
+}
+
+// Returns the characters of the string at row. Valid until the next append.
+const char *ColumnChunk::string_data(size_t row) const {
+  assert(_type == PhysicalType::STRING);
+  if (!_heap.data()) {
+    return "";
+  }
+  return _heap.data() + (row == 0 ? 0 : _values.as<uint64_t>()[row - 1]);
+}
+
+// Returns the length of the string at row
+size_t ColumnChunk::string_length(size_t row) const {
+  assert(_type == PhysicalType::STRING);
+  const uint64_t *ends = _values.as<uint64_t>();
+  return ends[row] - (row == 0 ? 0 : ends[row - 1]);
+}
+
+// Returns the value at row. Strings refer to the chunk's heap, and are
+// valid until the next append, except for ENUM and SET values, which refer
+// to the column's dictionary.
+Value ColumnChunk::value(size_t row) const {
+  if (is_null(row)) {
+    return Value();
+  }
+  switch (_type) {
+  case PhysicalType::INT64:
+    return Value(static_cast<long long>(at<std::int64_t>(row)));
+  case PhysicalType::UINT64:
+    return Value(static_cast<unsigned long long>(at<uint64_t>(row)));
+  case PhysicalType::DOUBLE:
+    return Value(at<double>(row));
+  case PhysicalType::ENUM: {
+    const std::string& member = _column.dictionary->member(_values.as<std::uint8_t>()[row] - 1);
+    return Value(member.data(), member.size());
+  }
+  case PhysicalType::SET:
+    return _column.dictionary->set_value(_values.as<uint64_t>()[row]);
+  default:
+    return Value(string_data(row), string_length(row));
+  }
+}
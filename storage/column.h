@@ -0,0 +1,159 @@
+// SimpleSQL: Column storage
+//
+// A table's rows are split into chunks, and each chunk stores every column
+// separately. Fixed-width values are kept in a contiguous typed array
+// aligned to a cache line, so scans can run over them directly. Strings
+// are kept as an array of offsets into a heap of characters, and ENUM and
+// SET values as their codes and masks. Nullable columns also keep a
+// validity bitmap with one bit per row, set for rows that are not null;
+// null rows hold a zero value.
+//
+// Once its chunk is full, a numeric column is sealed, and may then be
+// encoded (see encoding.h) instead of plain. Encoded values are read with
+// at() and decode(), or compared with a constant by the encoding itself;
+// values() is only for plain columns. Null rows of an encoded column hold
+// the value of a row before them rather than zero.
+//
+// Every ZONE_ROWS rows of a column are summarized by a zone, which is
+// widened as rows are appended, so that a scan can skip the rows a
+// condition cannot hold for without reading them. Deleting rows leaves
+// their values in the zones until the chunk summarizes them again (see
+// table.h), so a zone always covers at least the rows left.
+
+#ifndef __COLUMN_H__
+#define __COLUMN_H__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "encoding.h"
+#include "schema.h"
+
+// The alignment of column buffers
+const std::size_t CACHE_LINE_SIZE = 64;
+
+// The rows each zone of a column summarizes
+const std::size_t ZONE_ROWS = 1024;
+
+// A synopsis of up to ZONE_ROWS consecutive rows of a column: how many
+// there are and how many are null, and for numeric columns the smallest
+// and largest of the others. low and high are null for other columns, and
+// when every value is null or NaN, which no range comparison holds for.
+struct Zone {
+  Value low;
+  Value high;
+  std::uint32_t rows;
+  std::uint32_t nulls;
+};
+
+// A growable buffer aligned to a cache line. Growing moves the contents,
+// so pointers into the buffer are invalidated by reserve().
+class AlignedBuffer {
+ public:
+  AlignedBuffer();
+  AlignedBuffer(AlignedBuffer&& other);
+  AlignedBuffer& operator=(AlignedBuffer&& other);
+  ~AlignedBuffer();
+  void reserve(std::size_t bytes);
+  std::size_t capacity() const;
+  char *data();
+  const char *data() const;
+  template <typename T>
+  T *as() { return reinterpret_cast<T*>(_data); }
+  template <typename T>
+  const T *as() const { return reinterpret_cast<const T*>(_data); }
+ private:
+  AlignedBuffer(const AlignedBuffer&) = delete;
+  AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+  char *_data;
+  std::size_t _capacity;
+};
+
+// The values of one column in one chunk. Capacity grows as rows are
+// appended, up to the chunk size.
+class ColumnChunk {
+ public:
+  ColumnChunk(const ColumnSchema& column);
+  const ColumnSchema& column() const;
+  PhysicalType type() const;
+  std::size_t size() const;
+  std::size_t capacity() const;
+  std::size_t bytes() const;
+  void reserve(std::size_t rows);
+  void append(const Value& value);
+  void append(const Value *values, std::size_t count, std::size_t stride);
+  void seal();
+  std::size_t zones() const;
+  const Zone& zone(std::size_t index) const;
+  void summarize(std::size_t index, const std::vector<std::uint64_t>& deleted);
+
+  const EncodedColumn *encoded() const;
+  template <typename T>
+  const T *values() const;
+  template <typename T>
+  T at(std::size_t row) const;
+  template <typename T>
+  void decode(std::size_t first, std::size_t count, T *out) const;
+  const std::uint64_t *validity() const;
+  bool is_null(std::size_t row) const;
+  const char *string_data(std::size_t row) const;
+  std::size_t string_length(std::size_t row) const;
+  Value value(std::size_t row) const;
+ private:
+  void widen(Zone& zone, const Value& value) const;
+  template <typename T>
+  void append_numbers(const Value *values, std::size_t count, std::size_t stride);
+
+  ColumnSchema _column;
+  PhysicalType _type;
+  std::size_t _size;
+  std::size_t _capacity;
+  // Fixed-width values, or for strings the offset of every row's end in
+  // the heap. Freed when the column is encoded.
+  AlignedBuffer _values;
+  // Null unless the column is sealed and encoded
+  std::unique_ptr<EncodedColumn> _encoded;
+  // Empty unless the column is nullable
+  AlignedBuffer _validity;
+  AlignedBuffer _heap;
+  std::size_t _heap_size;
+  // A zone for every ZONE_ROWS rows, the last of which may be partial
+  std::vector<Zone> _zones;
+};
+
+// Returns the values of a fixed-width column that is not encoded as an
+// array of T, which must be the C++ type of the column's physical type
+template <typename T>
+const T *ColumnChunk::values() const {
+  assert(_type != PhysicalType::STRING && sizeof(T) == physical_width(_type) && !_encoded);
+  return _values.as<T>();
+}
+
+// Returns the value at row of a numeric column, encoded or not, as T, the
+// C++ type of the column's physical type
+template <typename T>
+T ColumnChunk::at(std::size_t row) const {
+  return _encoded ? _encoded->at<T>(row) : values<T>()[row];
+}
+
+// Writes count values of a numeric column, encoded or not, starting with
+// the one at first, to out
+template <typename T>
+void ColumnChunk::decode(std::size_t first, std::size_t count, T *out) const {
+  if (_encoded) {
+    _encoded->decode(first, count, out);
+  } else {
+    const T *values = this->values<T>() + first;
+    std::copy(values, values + count, out);
+  }
+}
+
+// Returns true if the bit for row is set in a validity bitmap
+inline bool bit_is_set(const std::uint64_t *bitmap, std::size_t row) {
+  return (bitmap[row / 64] >> (row % 64)) & 1;
+}
+
+#endif  // __COLUMN_H__
@@ -0,0 +1,538 @@
+// SimpleSQL: Column encodings
+
+#include "encoding.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include "../exec/kernels.h"
+
+using std::size_t;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// The rows sampled to estimate the size of a dictionary, and the most
+// distinct values the sample may have for one to be tried
+const size_t DICTIONARY_SAMPLE = 4096;
+const size_t MAX_SAMPLE_DISTINCT = 2048;
+
+// The most values a dictionary may have
+const size_t MAX_DICTIONARY = 65536;
+
+template <typename T>
+uint64_t to_bits(T value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+template <typename T>
+T from_bits(uint64_t bits) {
+  T value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+template <typename T>
+bool is_nan(T) {
+  return false;
+}
+
+bool is_nan(double value) {
+  return std::isnan(value);
+}
+
+// Returns the bits of the codes of a column whose largest code is largest:
+// none if it is zero, or else enough whole bytes for a kernel's type
+unsigned code_width(uint64_t largest) {
+  if (largest == 0) {
+    return 0;
+  }
+  return largest <= UINT8_MAX ? 8 : largest <= UINT16_MAX ? 16
+    : largest <= UINT32_MAX ? 32 : 64;
+}
+
+// Returns true if the bit for row is set in a validity bitmap
+bool is_valid(const uint64_t *validity, size_t row) {
+  return (validity[row / 64] >> (row % 64)) & 1;
+}
+
+// Returns true if a op b, for a comparison operator op
+template <typename T>
+bool holds(BinaryOp op, T a, T b) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return a == b;
+  case BinaryOp::NEQUAL:
+    return a != b;
+  case BinaryOp::GTHAN:
+    return a > b;
+  case BinaryOp::LTHAN:
+    return a < b;
+  case BinaryOp::GEQ:
+    return a >= b;
+  default:
+    return a <= b;
+  }
+}
+
+// How many of a run of values a comparison holds for
+enum class Outcome {
+  NONE,
+  SOME,
+  ALL
+};
+
+// Returns how many of a run of values, of which low is the smallest and
+// high the largest, satisfy op with constant. Not for NaNs.
+template <typename T>
+Outcome range_outcome(BinaryOp op, T low, T high, T constant) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    if (constant < low || high < constant) {
+      return Outcome::NONE;
+    }
+    return low == high ? Outcome::ALL : Outcome::SOME;
+  case BinaryOp::NEQUAL:
+    if (constant < low || high < constant) {
+      return Outcome::ALL;
+    }
+    return low == high ? Outcome::NONE : Outcome::SOME;
+  case BinaryOp::LTHAN:
+    return high < constant ? Outcome::ALL : low < constant ? Outcome::SOME : Outcome::NONE;
+  case BinaryOp::LEQ:
+    return high <= constant ? Outcome::ALL : low <= constant ? Outcome::SOME : Outcome::NONE;
+  case BinaryOp::GTHAN:
+    return low > constant ? Outcome::ALL : high > constant ? Outcome::SOME : Outcome::NONE;
+  default:
+    return low >= constant ? Outcome::ALL : high >= constant ? Outcome::SOME : Outcome::NONE;
+  }
+}
+
+// Sets the bits from from up to to of a bitmap
+void set_bits(uint64_t *bits, size_t from, size_t to) {
+  for (; from < to && from % 64 != 0; ++from) {
+    bits[from / 64] |= uint64_t(1) << (from % 64);
+  }
+  for (; from + 64 <= to; from += 64) {
+    bits[from / 64] = ~uint64_t(0);
+  }
+  for (; from < to; ++from) {
+    bits[from / 64] |= uint64_t(1) << (from % 64);
+  }
+}
+
+// Orders the bits of values of type T by value, and equal values, such as
+// the two zeros of a double, by their bits
+template <typename T>
+struct ValueOrder {
+  bool operator()(uint64_t a, uint64_t b) const {
+    T x = from_bits<T>(a);
+    T y = from_bits<T>(b);
+    return x < y || (!(y < x) && a < b);
+  }
+};
+
+// An encoding a column could have, and the bits it would take
+struct Candidate {
+  Encoding encoding;
+  uint64_t cost;
+  // The bits of each packed code
+  unsigned width;
+};
+
+}  // namespace
+
+EncodedColumn::EncodedColumn(Encoding encoding, size_t rows, unsigned width)
+  : _encoding(encoding), _rows(rows), _width(width), _base(0), _code_limit(0) {
+  if (encoding != Encoding::RUN_LENGTH) {
+    _codes.assign((rows * width + 63) / 64, 0);
+  }
+}
+
+// Encodes rows values of a column in the encoding that takes the least
+// space, or returns null if the column should stay plain. validity is the
+// column's validity bitmap, or null if it is not nullable.
+template <typename T>
+unique_ptr<EncodedColumn> EncodedColumn::encode(const T *values, const uint64_t *validity,
+						size_t rows) {
+  if (rows == 0) {
+    return nullptr;
+  }
+  // Null rows take the value before them, and those at the start the first
+  // value that is not null
+  vector<uint64_t> filled(rows);
+  size_t first_valid = 0;
+  while (validity && first_valid < rows && !is_valid(validity, first_valid)) {
+    ++first_valid;
+  }
+  uint64_t last = to_bits(first_valid < rows ? values[first_valid] : T());
+  for (size_t i = 0; i < rows; ++i) {
+    if (!validity || is_valid(validity, i)) {
+      last = to_bits(values[i]);
+    }
+    filled[i] = last;
+  }
+
+  T low = from_bits<T>(filled[0]);
+  T high = low;
+  bool has_nan = false;
+  bool ascending = true;
+  uint64_t runs = 1;
+  uint64_t step = ~uint64_t(0);
+  for (size_t i = 0; i < rows; ++i) {
+    T value = from_bits<T>(filled[i]);
+    has_nan = has_nan || is_nan(value);
+    if (value < low) {
+      low = value;
+    }
+    if (high < value) {
+      high = value;
+    }
+    if (i > 0) {
+      runs += filled[i] != filled[i - 1];
+      if (value < from_bits<T>(filled[i - 1])) {
+	ascending = false;
+      } else {
+	step = std::min(step, filled[i] - filled[i - 1]);
+      }
+    }
+  }
+  if (rows == 1) {
+    step = 0;
+  }
+
+  const uint64_t n = rows;
+  const uint64_t plain = 64 * n;
+  vector<Candidate> candidates;
+  if (std::is_integral<T>::value) {
+    unsigned width = code_width(to_bits(high) - to_bits(low));
+    candidates.push_back({Encoding::FRAME, n * width + 64, width});
+    if (ascending) {
+      uint64_t largest = 0;
+      for (size_t i = 0; i < rows; ++i) {
+	size_t group = i / DELTA_GROUP * DELTA_GROUP;
+	largest = std::max(largest, filled[i] - filled[group] - (i - group) * step);
+      }
+      width = code_width(largest);
+      uint64_t groups = (n + DELTA_GROUP - 1) / DELTA_GROUP;
+      candidates.push_back({Encoding::DELTA, n * width + 64 * groups + 64, width});
+    }
+  }
+  if (rows <= UINT32_MAX) {
+    candidates.push_back({Encoding::RUN_LENGTH, runs * 96, 0});
+  }
+  if (!has_nan) {
+    vector<uint64_t> sample;
+    size_t stride = std::max<size_t>(1, rows / DICTIONARY_SAMPLE);
+    for (size_t i = 0; i < rows; i += stride) {
+      sample.push_back(filled[i]);
+    }
+    std::sort(sample.begin(), sample.end());
+    uint64_t distinct = std::unique(sample.begin(), sample.end()) - sample.begin();
+    if (distinct <= MAX_SAMPLE_DISTINCT) {
+      unsigned width = code_width(distinct - 1);
+      candidates.push_back({Encoding::DICTIONARY, n * width + 64 * distinct, width});
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+		   [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+
+  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+    if (it->cost * 4 > plain * 3) {
+      break;
+    }
+    vector<uint64_t> dictionary;
+    unsigned width = it->width;
+    if (it->encoding == Encoding::DICTIONARY) {
+      // The sample may have missed values, so the estimate is checked
+      vector<uint64_t> sorted(filled);
+      std::sort(sorted.begin(), sorted.end());
+      dictionary.assign(sorted.begin(), std::unique(sorted.begin(), sorted.end()));
+      width = code_width(dictionary.size() - 1);
+      if (dictionary.size() > MAX_DICTIONARY
+	  || (n * width + 64 * dictionary.size()) * 4 > plain * 3) {
+	continue;
+      }
+      std::sort(dictionary.begin(), dictionary.end(), ValueOrder<T>());
+    }
+
+    unique_ptr<EncodedColumn> column(new EncodedColumn(it->encoding, rows, width));
+    switch (it->encoding) {
+    case Encoding::FRAME:
+      column->_base = to_bits(low);
+      column->_code_limit = to_bits(high) - to_bits(low) + 1;
+      for (size_t i = 0; i < rows; ++i) {
+	column->pack(i, filled[i] - column->_base);
+      }
+      break;
+    case Encoding::DELTA:
+      column->_base = step;
+      for (size_t i = 0; i < rows; ++i) {
+	size_t group = i / DELTA_GROUP * DELTA_GROUP;
+	if (i == group) {
+	  column->_values.push_back(filled[i]);
+	}
+	column->pack(i, filled[i] - filled[group] - (i - group) * step);
+      }
+      break;
+    case Encoding::RUN_LENGTH:
+      for (size_t i = 0; i < rows; ++i) {
+	if (i == 0 || filled[i] != filled[i - 1]) {
+	  if (i > 0) {
+	    column->_run_ends.push_back(static_cast<uint32_t>(i));
+	  }
+	  column->_values.push_back(filled[i]);
+	}
+      }
+      column->_run_ends.push_back(static_cast<uint32_t>(rows));
+      break;
+    case Encoding::DICTIONARY:
+      column->_code_limit = dictionary.size();
+      for (size_t i = 0; i < rows; ++i) {
+	column->pack(i, std::lower_bound(dictionary.begin(), dictionary.end(), filled[i],
+					 ValueOrder<T>()) - dictionary.begin());
+      }
+      column->_values = std::move(dictionary);
+      break;
+    }
+    return column;
+  }
+  return nullptr;
+}
+
+// Returns how the column is encoded
+Encoding EncodedColumn::encoding() const {
+  return _encoding;
+}
+
+// Returns the memory the encoded column takes, in bytes
+size_t EncodedColumn::bytes() const {
+  return sizeof(*this) + _codes.capacity() * sizeof(uint64_t)
+    + _values.capacity() * sizeof(uint64_t) + _run_ends.capacity() * sizeof(uint32_t);
+}
+
+// Writes count values, starting with the one at first, to out
+template <typename T>
+void EncodedColumn::decode(size_t first, size_t count, T *out) const {
+  const size_t end = first + count;
+  switch (_encoding) {
+  case Encoding::RUN_LENGTH:
+    for (size_t row = first, r = run(first); row < end; ++row) {
+      if (row == _run_ends[r]) {
+	++r;
+      }
+      out[row - first] = from_bits<T>(_values[r]);
+    }
+    break;
+  case Encoding::FRAME:
+    for (size_t row = first; row < end; ++row) {
+      out[row - first] = from_bits<T>(_base + code(row));
+    }
+    break;
+  case Encoding::DELTA:
+    for (size_t row = first; row < end; ++row) {
+      out[row - first] = from_bits<T>(_values[row / DELTA_GROUP] + row % DELTA_GROUP * _base
+				      + code(row));
+    }
+    break;
+  default:
+    for (size_t row = first; row < end; ++row) {
+      out[row - first] = from_bits<T>(_values[code(row)]);
+    }
+    break;
+  }
+}
+
+// Compares rows values, starting with the one at first, with constant using
+// op, which must be a comparison operator, and writes one bit per row to
+// bits like the comparison kernels do. Only the groups of deltas where the
+// column crosses the constant are decoded.
+template <typename T>
+void EncodedColumn::compare(BinaryOp op, T constant, size_t first, size_t rows,
+			    uint64_t *bits) const {
+  std::fill(bits, bits + (rows + 63) / 64, 0);
+  const size_t end = first + rows;
+  switch (_encoding) {
+  case Encoding::FRAME:
+  case Encoding::DICTIONARY: {
+    if (is_nan(constant)) {
+      match_codes(0, 0, op == BinaryOp::NEQUAL, first, rows, bits);
+      break;
+    }
+    // The codes of the values less than the constant end at lower, and
+    // those of the values no greater at upper
+    uint64_t lower;
+    uint64_t upper;
+    if (_encoding == Encoding::FRAME) {
+      const T low = from_bits<T>(_base);
+      const T high = from_bits<T>(_base + _code_limit - 1);
+      lower = constant <= low ? 0 : constant > high ? _code_limit : to_bits(constant) - _base;
+      upper = constant < low ? 0 : constant >= high ? _code_limit
+	: to_bits(constant) - _base + 1;
+    } else {
+      lower = std::lower_bound(_values.begin(), _values.end(), constant,
+			       [](uint64_t v, T c) { return from_bits<T>(v) < c; })
+	- _values.begin();
+      upper = std::upper_bound(_values.begin(), _values.end(), constant,
+			       [](T c, uint64_t v) { return c < from_bits<T>(v); })
+	- _values.begin();
+    }
+    switch (op) {
+    case BinaryOp::EQUAL:
+      match_codes(lower, upper, false, first, rows, bits);
+      break;
+    case BinaryOp::NEQUAL:
+      match_codes(lower, upper, true, first, rows, bits);
+      break;
+    case BinaryOp::LTHAN:
+      match_codes(0, lower, false, first, rows, bits);
+      break;
+    case BinaryOp::LEQ:
+      match_codes(0, upper, false, first, rows, bits);
+      break;
+    case BinaryOp::GTHAN:
+      match_codes(0, upper, true, first, rows, bits);
+      break;
+    default:
+      match_codes(0, lower, true, first, rows, bits);
+      break;
+    }
+    break;
+  }
+  case Encoding::DELTA:
+    for (size_t start = first; start < end;) {
+      size_t stop = std::min(end, (start / DELTA_GROUP + 1) * DELTA_GROUP);
+      Outcome outcome = range_outcome(op, at<T>(start), at<T>(stop - 1), constant);
+      if (outcome == Outcome::ALL) {
+	set_bits(bits, start - first, stop - first);
+      } else if (outcome == Outcome::SOME) {
+	const uint64_t base = _values[start / DELTA_GROUP];
+	for (size_t row = start; row < stop; ++row) {
+	  T value = from_bits<T>(base + row % DELTA_GROUP * _base + code(row));
+	  bits[(row - first) / 64] |= uint64_t(holds(op, value, constant)) << ((row - first) % 64);
+	}
+      }
+      start = stop;
+    }
+    break;
+  case Encoding::RUN_LENGTH:
+    for (size_t start = first, r = run(first); start < end; ++r) {
+      size_t stop = std::min<size_t>(end, _run_ends[r]);
+      if (holds(op, from_bits<T>(_values[r]), constant)) {
+	set_bits(bits, start - first, stop - first);
+      }
+      start = stop;
+    }
+    break;
+  }
+}
+
+// Writes the code of row
+void EncodedColumn::pack(size_t row, uint64_t code) {
+  char *codes = reinterpret_cast<char*>(_codes.data());
+  switch (_width) {
+  case 0:
+    break;
+  case 8:
+    reinterpret_cast<uint8_t*>(codes)[row] = static_cast<uint8_t>(code);
+    break;
+  case 16:
+    reinterpret_cast<uint16_t*>(codes)[row] = static_cast<uint16_t>(code);
+    break;
+  case 32:
+    reinterpret_cast<uint32_t*>(codes)[row] = static_cast<uint32_t>(code);
+    break;
+  default:
+    _codes[row] = code;
+    break;
+  }
+}
+
+// Returns the position of the run that row is in
+size_t EncodedColumn::run(size_t row) const {
+  return std::upper_bound(_run_ends.begin(), _run_ends.end(), row) - _run_ends.begin();
+}
+
+// Sets the bits of the rows, of rows starting with the one at first, whose
+// codes are at least low and less than high, or with negated, of those
+// whose codes are not
+void EncodedColumn::match_codes(uint64_t low, uint64_t high, bool negated, size_t first,
+				size_t rows, uint64_t *bits) const {
+  const size_t words = (rows + 63) / 64;
+  if (low == high || _width == 0) {
+    // Either no code matches, or every code is zero
+    bool match = low < high && low == 0;
+    std::fill(bits, bits + words, match ? ~uint64_t(0) : 0);
+  } else if (low == 0 && high >= _code_limit) {
+    std::fill(bits, bits + words, ~uint64_t(0));
+  } else {
+    switch (_width) {
+    case 8:
+      match_codes_of<uint8_t>(low, high, first, rows, bits);
+      break;
+    case 16:
+      match_codes_of<uint16_t>(low, high, first, rows, bits);
+      break;
+    default:
+      match_codes_of<uint32_t>(low, high, first, rows, bits);
+      break;
+    }
+  }
+  if (negated) {
+    for (size_t w = 0; w < words; ++w) {
+      bits[w] = ~bits[w];
+    }
+  }
+  if (rows % 64 != 0) {
+    bits[words - 1] &= (uint64_t(1) << (rows % 64)) - 1;
+  }
+}
+
+// Sets the bits of the rows, of rows starting with the one at first, whose
+// codes, of type C, are at least low and less than high, by running one
+// kernel for each bound that some code reaches. high must be greater than
+// low.
+template <typename C>
+void EncodedColumn::match_codes_of(uint64_t low, uint64_t high, size_t first, size_t rows,
+				   uint64_t *bits) const {
+  const C *values = codes<C>() + first;
+  if (low == 0) {
+    constant_kernel<C>(BinaryOp::LTHAN)(values, static_cast<C>(high), rows, bits);
+  } else if (high >= _code_limit) {
+    constant_kernel<C>(BinaryOp::GEQ)(values, static_cast<C>(low), rows, bits);
+  } else if (high - low == 1) {
+    constant_kernel<C>(BinaryOp::EQUAL)(values, static_cast<C>(low), rows, bits);
+  } else {
+    constant_kernel<C>(BinaryOp::GEQ)(values, static_cast<C>(low), rows, bits);
+    const ConstantKernel<C> below_high = constant_kernel<C>(BinaryOp::LTHAN);
+    const size_t PIECE = 1024;
+    uint64_t below[PIECE / 64];
+    for (size_t start = 0; start < rows; start += PIECE) {
+      const size_t count = std::min(PIECE, rows - start);
+      below_high(values + start, static_cast<C>(high), count, below);
+      for (size_t w = 0; w < (count + 63) / 64; ++w) {
+	bits[start / 64 + w] &= below[w];
+      }
+    }
+  }
+}
+
+template unique_ptr<EncodedColumn> EncodedColumn::encode(const std::int64_t*, const uint64_t*,
+							 size_t);
+template unique_ptr<EncodedColumn> EncodedColumn::encode(const uint64_t*, const uint64_t*,
+							 size_t);
+template unique_ptr<EncodedColumn> EncodedColumn::encode(const double*, const uint64_t*,
+							 size_t);
+template void EncodedColumn::decode(size_t, size_t, std::int64_t*) const;
+template void EncodedColumn::decode(size_t, size_t, uint64_t*) const;
+template void EncodedColumn::decode(size_t, size_t, double*) const;
+template void EncodedColumn::compare(BinaryOp, std::int64_t, size_t, size_t, uint64_t*) const;
+template void EncodedColumn::compare(BinaryOp, uint64_t, size_t, size_t, uint64_t*) const;
+template void EncodedColumn::compare(BinaryOp, double, size_t, size_t, uint64_t*) const;
@@ -0,0 +1,151 @@
+// SimpleSQL: Column encodings
+//
+// When a chunk fills up, each of its numeric columns is sealed: its values
+// are encoded in whichever of the encodings below takes the least space,
+// and the plain array is freed. Full chunks never change, so an encoding
+// is built once and only read after that. Every encoding can read back one
+// value or a run of them, and can compare a run of values with a constant
+// without decoding them first.
+//
+// Frames, deltas and dictionaries keep a code for each row, packed into
+// the fewest whole bytes that hold the largest code, or into none when
+// every code is zero, as for times taken at a fixed interval. Each value
+// is then read back with one load, and a comparison with a constant
+// becomes a test of the codes against the range of codes it holds for,
+// which the kernels (see kernels.h) run on 8, 16 or 32 codes per vector
+// rather than on four plain values. Each run of equal values is compared
+// once, and a group of 64 deltas is decided from its first and last
+// values unless the constant falls between them.
+//
+// The space every encoding would take is worked out from one pass over the
+// values, except for the dictionary, whose size is estimated from the
+// distinct values of a sample of rows and checked when it is built. A
+// column stays plain unless an encoding saves at least a quarter of its
+// space.
+//
+// Null rows take the value of the row before them, so that they neither
+// widen frames nor break runs, and read back as that value.
+
+#ifndef __ENCODING_H__
+#define __ENCODING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "../AST/expression.h"
+
+enum class Encoding {
+  // Offsets from the smallest value. Integers only.
+  FRAME,
+  // The first value of each group of 64 rows, and the offsets of the
+  // others from the line rising from it by the smallest step between rows.
+  // Integers that never decrease only.
+  DELTA,
+  // Runs of equal values, and the row after each
+  RUN_LENGTH,
+  // The distinct values in order, and the position of each row's value
+  // among them. Not used for doubles that include NaN.
+  DICTIONARY
+};
+
+// The encoded values of one column of a full chunk. T, the C++ type of the
+// column, is one of std::int64_t, std::uint64_t and double; reading values
+// as std::uint64_t gives their bits whatever their type.
+class EncodedColumn {
+ public:
+  template <typename T>
+  static std::unique_ptr<EncodedColumn> encode(const T *values, const std::uint64_t *validity,
+					       std::size_t rows);
+  Encoding encoding() const;
+  std::size_t bytes() const;
+  template <typename T>
+  T at(std::size_t row) const;
+  template <typename T>
+  void decode(std::size_t first, std::size_t count, T *out) const;
+  template <typename T>
+  void compare(BinaryOp op, T constant, std::size_t first, std::size_t rows,
+	       std::uint64_t *bits) const;
+ private:
+  // The rows in each group of deltas
+  static const std::size_t DELTA_GROUP = 64;
+
+  EncodedColumn(Encoding encoding, std::size_t rows, unsigned width);
+  EncodedColumn(const EncodedColumn&) = delete;
+  EncodedColumn& operator=(const EncodedColumn&) = delete;
+  void pack(std::size_t row, std::uint64_t code);
+  std::uint64_t code(std::size_t row) const;
+  template <typename C>
+  const C *codes() const;
+  std::size_t run(std::size_t row) const;
+  std::uint64_t bits_at(std::size_t row) const;
+  void match_codes(std::uint64_t low, std::uint64_t high, bool negated, std::size_t first,
+		   std::size_t rows, std::uint64_t *bits) const;
+  template <typename C>
+  void match_codes_of(std::uint64_t low, std::uint64_t high, std::size_t first,
+		      std::size_t rows, std::uint64_t *bits) const;
+
+  const Encoding _encoding;
+  const std::size_t _rows;
+  // The bits of each code, 0, 8, 16 or 32, and the codes, row after row
+  const unsigned _width;
+  std::vector<std::uint64_t> _codes;
+  // For a frame, the bits of the smallest value, and for deltas the
+  // smallest step
+  std::uint64_t _base;
+  // One more than the largest code of a frame or dictionary
+  std::uint64_t _code_limit;
+  // The bits of the dictionary's values, of each run's value, or of the
+  // first value of each group of deltas
+  std::vector<std::uint64_t> _values;
+  // The row after each run
+  std::vector<std::uint32_t> _run_ends;
+};
+
+// Returns the value at row
+template <typename T>
+T EncodedColumn::at(std::size_t row) const {
+  std::uint64_t bits = bits_at(row);
+  T value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Returns the code of row
+inline std::uint64_t EncodedColumn::code(std::size_t row) const {
+  switch (_width) {
+  case 0:
+    return 0;
+  case 8:
+    return codes<std::uint8_t>()[row];
+  case 16:
+    return codes<std::uint16_t>()[row];
+  case 32:
+    return codes<std::uint32_t>()[row];
+  default:
+    return _codes[row];
+  }
+}
+
+// Returns the codes as an array of C, the unsigned type of their width
+template <typename C>
+const C *EncodedColumn::codes() const {
+  return reinterpret_cast<const C*>(_codes.data());
+}
+
+// Returns the bits of the value at row
+inline std::uint64_t EncodedColumn::bits_at(std::size_t row) const {
+  switch (_encoding) {
+  case Encoding::FRAME:
+    return _base + code(row);
+  case Encoding::DELTA:
+    return _values[row / DELTA_GROUP] + row % DELTA_GROUP * _base + code(row);
+  case Encoding::RUN_LENGTH:
+    return _values[run(row)];
+  default:
+    return _values[code(row)];
+  }
+}
+
+#endif  // __ENCODING_H__
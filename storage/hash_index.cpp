@@ -0,0 +1,117 @@
+// SimpleSQL: Hash index
+
+#include "hash_index.h"
+#include <cstring>
+#include "index_key.h"
+
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+namespace {
+
+// Marks a slot that holds no entry
+const uint64_t EMPTY = ~uint64_t(0);
+const size_t MIN_SLOTS = 16;
+// The pool is not compacted until it holds at least this many bytes
+const size_t MIN_POOL_BYTES = 4096;
+
+}  // namespace
+
+HashIndex::HashIndex()
+  : _slots(MIN_SLOTS, Slot{0, EMPTY, 0, 0}), _size(0), _compacted(0) {}
+
+// Adds an entry mapping key to row. The entry must not already exist.
+void HashIndex::insert(const string& key, uint64_t row) {
+  if ((_size + 1) * 4 > _slots.size() * 3) {
+    rebuild(_slots.size() * 2);
+  } else if (_pool.size() > 2 * _compacted + MIN_POOL_BYTES) {
+    rebuild(_slots.size());
+  }
+  place(hash_key(key.data(), key.size()), key.data(), key.size(), row);
+  ++_size;
+}
+
+// Removes the entry mapping key to row, and returns true if there was one
+bool HashIndex::erase(const string& key, uint64_t row) {
+  const size_t mask = _slots.size() - 1;
+  const uint64_t hash = hash_key(key.data(), key.size());
+  size_t hole = hash & mask;
+  while (!(_slots[hole].row == row && matches(_slots[hole], hash, key.data(), key.size()))) {
+    if (_slots[hole].row == EMPTY) {
+      return false;
+    }
+    hole = (hole + 1) & mask;
+  }
+  // Later entries of the run move into the hole if that does not put them
+  // before the slot they hash to
+  for (size_t i = (hole + 1) & mask; _slots[i].row != EMPTY; i = (i + 1) & mask) {
+    size_t home = _slots[i].hash & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      _slots[hole] = _slots[i];
+      hole = i;
+    }
+  }
+  _slots[hole].row = EMPTY;
+  --_size;
+  return true;
+}
+
+// Appends the rows key maps to, in no particular order, to rows
+void HashIndex::find(const string& key, vector<uint64_t>& rows) const {
+  const size_t mask = _slots.size() - 1;
+  const uint64_t hash = hash_key(key.data(), key.size());
+  for (size_t i = hash & mask; _slots[i].row != EMPTY; i = (i + 1) & mask) {
+    if (matches(_slots[i], hash, key.data(), key.size())) {
+      rows.push_back(_slots[i].row);
+    }
+  }
+}
+
+// Returns the number of entries
+size_t HashIndex::size() const {
+  return _size;
+}
+
+// Returns true if the entry in slot has the given key, whose hash is hash
+bool HashIndex::matches(const Slot& slot, uint64_t hash, const char *key, size_t length) const {
+  return slot.hash == hash && slot.length == length &&
+    std::memcmp(_pool.data() + slot.offset, key, length) == 0;
+}
+
+// Stores an entry in the first free slot of its probe run. Its key shares
+// the bytes of an equal key met on the way, if any, and is otherwise
+// copied to the pool.
+void HashIndex::place(uint64_t hash, const char *key, size_t length, uint64_t row) {
+  const size_t mask = _slots.size() - 1;
+  size_t i = hash & mask;
+  bool shared = false;
+  uint64_t offset = 0;
+  for (; _slots[i].row != EMPTY; i = (i + 1) & mask) {
+    if (!shared && matches(_slots[i], hash, key, length)) {
+      shared = true;
+      offset = _slots[i].offset;
+    }
+  }
+  if (!shared) {
+    offset = _pool.size();
+    _pool.append(key, length);
+  }
+  _slots[i] = Slot{hash, row, offset, length};
+}
+
+// Moves every entry into a new array of capacity slots, copying only the
+// key bytes still in use to a new pool
+void HashIndex::rebuild(size_t capacity) {
+  vector<Slot> slots(capacity, Slot{0, EMPTY, 0, 0});
+  string pool;
+  slots.swap(_slots);
+  pool.swap(_pool);
+  for (auto it = slots.begin(); it != slots.end(); ++it) {
+    if (it->row != EMPTY) {
+      place(it->hash, pool.data() + it->offset, it->length, it->row);
+    }
+  }
+  _compacted = _pool.size();
+}
@@ -0,0 +1,52 @@
+// SimpleSQL: Hash index
+//
+// An open-addressing hash table from index keys (see index_key.h) to row
+// numbers. A key may map to any number of rows, and every (key, row) pair
+// is an entry of its own.
+//
+// Entries live in a single array of slots and are found by linear probing
+// from the slot picked by their key's hash. A slot holds the full 64-bit
+// hash, so probes compare hashes and only read key bytes when hashes are
+// equal. Key bytes are kept in one pool, and entries with equal keys share
+// the bytes. Erasing an entry moves later entries of its probe run back
+// instead of leaving a tombstone, so probe runs do not grow with deletes.
+// The array doubles when it is three quarters full. It is rebuilt, with
+// the pool compacted, whenever it grows or the pool has doubled since it
+// was last compacted, so the bytes of erased keys are reclaimed.
+
+#ifndef __HASH_INDEX_H__
+#define __HASH_INDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class HashIndex {
+ public:
+  HashIndex();
+  void insert(const std::string& key, std::uint64_t row);
+  bool erase(const std::string& key, std::uint64_t row);
+  void find(const std::string& key, std::vector<std::uint64_t>& rows) const;
+  std::size_t size() const;
+ private:
+  struct Slot {
+    std::uint64_t hash;
+    std::uint64_t row;
+    // The key's bytes in the pool
+    std::uint64_t offset;
+    std::uint64_t length;
+  };
+  bool matches(const Slot& slot, std::uint64_t hash, const char *key,
+	       std::size_t length) const;
+  void place(std::uint64_t hash, const char *key, std::size_t length, std::uint64_t row);
+  void rebuild(std::size_t capacity);
+
+  std::vector<Slot> _slots;
+  std::string _pool;
+  std::size_t _size;
+  // The size of the pool when it was last compacted
+  std::size_t _compacted;
+};
+
+#endif  // __HASH_INDEX_H__
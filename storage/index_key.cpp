@@ -0,0 +1,118 @@
+// SimpleSQL: Index keys
+
+#include "index_key.h"
+#include <cstdint>
+#include <cstring>
+
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+namespace {
+
+const char NULL_TAG = 0;
+const char VALUE_TAG = 1;
+const uint64_t SIGN_BIT = uint64_t(1) << 63;
+
+void append_big_endian(string& key, uint64_t bits) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    key += static_cast<char>(bits >> shift);
+  }
+}
+
+// Mixes the bits of x so that every bit of the result depends on all of
+// them
+inline uint64_t mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  return x ^ (x >> 33);
+}
+
+}  // namespace
+
+// Appends the encoding of value to key
+void append_key(string& key, const Value& value) {
+  if (value.is_null()) {
+    key += NULL_TAG;
+    return;
+  }
+  key += VALUE_TAG;
+  switch (value.type()) {
+  case ValueType::INT:
+    append_big_endian(key, static_cast<uint64_t>(value.int_value()) ^ SIGN_BIT);
+    break;
+  case ValueType::UINT:
+    append_big_endian(key, value.uint_value());
+    break;
+  case ValueType::DOUBLE: {
+    // -0.0 and 0.0 are equal, so they must encode alike
+    double d = value.double_value() == 0.0 ? 0.0 : value.double_value();
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    append_big_endian(key, bits & SIGN_BIT ? ~bits : bits ^ SIGN_BIT);
+    break;
+  }
+  case ValueType::STRING: {
+    const char *data = value.string_data();
+    for (size_t i = 0; i < value.string_length(); ++i) {
+      key += data[i];
+      if (data[i] == '\0') {
+	key += '\xFF';
+      }
+    }
+    key += '\0';
+    key += '\0';
+    break;
+  }
+  case ValueType::NUL:
+    break;
+  }
+}
+
+// Returns the key of the given values, in order
+string encode_key(const vector<Value>& values) {
+  string key;
+  for (auto it = values.begin(); it != values.end(); ++it) {
+    append_key(key, *it);
+  }
+  return key;
+}
+
+// Returns the smallest key greater than every key starting with prefix, or
+// an empty string if there is none. Keys starting with prefix are then
+// exactly those in [prefix, prefix_successor(prefix)).
+string prefix_successor(const string& prefix) {
+  string successor = prefix;
+  while (!successor.empty()) {
+    if (successor.back() != '\xFF') {
+      ++successor.back();
+      return successor;
+    }
+    successor.pop_back();
+  }
+  return successor;
+}
+
+// Hashes length bytes of a key, eight at a time
+uint64_t hash_key(const char *data, size_t length) {
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+  while (length >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    hash = mix(hash ^ word);
+    data += 8;
+    length -= 8;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data, length);
+  return mix(hash ^ tail);
+}
+
+// Hashes a 64-bit word. The mix is a bijection, so words with equal hashes
+// are equal.
+uint64_t hash_word(uint64_t word) {
+  return mix(word);
+}
@@ -0,0 +1,38 @@
+// SimpleSQL: Index keys
+//
+// Index keys are the values of one or more columns encoded into a byte
+// string whose bytewise (memcmp) order is the order of the values, compared
+// column by column. Indexes then compare keys of any type and any number
+// of columns alike, and a key on the first columns of a composite key is a
+// prefix of every full key that starts with those values.
+//
+// Each value is a tag byte, 0 for NULL and 1 otherwise, so nulls sort
+// first, followed by:
+//   INT     8 bytes, big endian, with the sign bit flipped
+//   UINT    8 bytes, big endian
+//   DOUBLE  8 bytes, big endian, with the sign bit flipped for positive
+//           numbers and every bit flipped for negative ones
+//   STRING  the bytes, with every 0 byte written as 0 0xFF, then 0 0
+// No encoded value is a prefix of another, so the columns of a composite
+// key cannot run into each other.
+//
+// Keys are also hashed, by hash indexes and by grouping, with hash_key().
+// Keys that are a single 64-bit word can be hashed with hash_word(), whose
+// hashes are equal only for equal words.
+
+#ifndef __INDEX_KEY_H__
+#define __INDEX_KEY_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../AST/value.h"
+
+void append_key(std::string& key, const Value& value);
+std::string encode_key(const std::vector<Value>& values);
+std::string prefix_successor(const std::string& prefix);
+std::uint64_t hash_key(const char *data, std::size_t length);
+std::uint64_t hash_word(std::uint64_t word);
+
+#endif  // __INDEX_KEY_H__
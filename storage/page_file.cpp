@@ -0,0 +1,161 @@
+// SimpleSQL: Page files
+
+#include "page_file.h"
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::size_t;
+using std::string;
+
+namespace {
+
+const char MAGIC[8] = {'S', 'S', 'Q', 'L', 'P', 'A', 'G', 'E'};
+const std::uint32_t VERSION = 1;
+
+// The layout of page 0. Integers are stored in native byte order.
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t page_size;
+  std::uint64_t page_count;
+  std::uint64_t root;
+};
+
+// Throws a StorageError describing the failed system call
+[[noreturn]] void io_error(const string& what, const string& path) {
+  throw StorageError(what + " " + path + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+// Opens the page file at path, creating it with the given page size if it
+// does not exist. The page size of an existing file is read from its
+// header. Throws a StorageError if the file cannot be opened or is not a
+// page file.
+PageFile::PageFile(const string& path, size_t page_size)
+  : _path(path), _fd(-1), _page_size(page_size), _page_count(1), _root(NO_PAGE) {
+  if (page_size < sizeof(FileHeader) || page_size > MAX_PAGE_SIZE) {
+    throw StorageError("Invalid page size " + std::to_string(page_size));
+  }
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (_fd < 0) {
+    io_error("Could not open", path);
+  }
+  struct stat info;
+  if (::fstat(_fd, &info) != 0) {
+    ::close(_fd);
+    io_error("Could not stat", path);
+  }
+  if (info.st_size == 0) {
+    write_header();
+    return;
+  }
+  FileHeader header;
+  if (::pread(_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+    ::close(_fd);
+    throw StorageError(path + " is not a page file");
+  }
+  _page_size = header.page_size;
+  _page_count = header.page_count;
+  _root = header.root;
+}
+
+// Records the header and closes the file. Pages written are not synced.
+PageFile::~PageFile() {
+  try {
+    write_header();
+  } catch (const StorageError&) {
+    // Nothing can be reported from a destructor; sync() reports failures
+  }
+  ::close(_fd);
+}
+
+// Returns the size of every page in bytes
+size_t PageFile::page_size() const {
+  return _page_size;
+}
+
+// Returns the number of pages in the file, including the header
+PageId PageFile::page_count() const {
+  return _page_count.load();
+}
+
+// Adds the given number of consecutive zeroed pages to the end of the file
+// and returns the id of the first
+PageId PageFile::allocate(size_t pages) {
+  PageId first = _page_count.fetch_add(pages);
+  if (::ftruncate(_fd, (first + pages) * _page_size) != 0) {
+    io_error("Could not extend", _path);
+  }
+  return first;
+}
+
+// Reads the page with the given id into page, which must hold page_size()
+// bytes
+void PageFile::read(PageId id, char *page) const {
+  ssize_t got = ::pread(_fd, page, _page_size, id * _page_size);
+  if (got < 0) {
+    io_error("Could not read", _path);
+  }
+  // Pages allocated but never written read as zeroes
+  std::memset(page + got, 0, _page_size - got);
+}
+
+// Writes page_size() bytes from page to the page with the given id
+void PageFile::write(PageId id, const char *page) {
+  if (::pwrite(_fd, page, _page_size, id * _page_size) != static_cast<ssize_t>(_page_size)) {
+    io_error("Could not write", _path);
+  }
+}
+
+// Writes the header and waits until every page written reaches the disk
+void PageFile::sync() {
+  write_header();
+  if (::fdatasync(_fd) != 0) {
+    io_error("Could not sync", _path);
+  }
+}
+
+// Returns the page the file's contents are reached from, or NO_PAGE
+PageId PageFile::root() const {
+  return _root;
+}
+
+// Sets the root page. Recorded in the header by sync() and on close.
+void PageFile::set_root(PageId root) {
+  std::lock_guard<std::mutex> lock(_header_mutex);
+  _root = root;
+}
+
+// Tells the kernel the file will be read sequentially, so that it reads
+// further ahead
+void PageFile::advise_sequential() {
+  ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+// Asks the kernel to start reading the given pages into its cache, so that
+// later reads of them do not wait on the disk
+void PageFile::prefetch(PageId first, size_t pages) const {
+  ::posix_fadvise(_fd, first * _page_size, pages * _page_size, POSIX_FADV_WILLNEED);
+}
+
+// Writes page 0
+void PageFile::write_header() {
+  std::lock_guard<std::mutex> lock(_header_mutex);
+  std::vector<char> page(_page_size, 0);
+  FileHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.page_size = static_cast<std::uint32_t>(_page_size);
+  header.page_count = _page_count.load();
+  header.root = _root;
+  std::memcpy(page.data(), &header, sizeof(header));
+  if (::pwrite(_fd, page.data(), _page_size, 0) != static_cast<ssize_t>(_page_size)) {
+    io_error("Could not write", _path);
+  }
+}
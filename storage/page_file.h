@@ -0,0 +1,54 @@
+// SimpleSQL: Page files
+//
+// A page file is a file divided into fixed-size pages, numbered from 0.
+// Page 0 holds the file header, which records the page size and the root
+// page the file's contents are reached from, so page id 0 never refers to
+// data and serves as the null page id.
+
+#ifndef __PAGE_FILE_H__
+#define __PAGE_FILE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "schema.h"
+
+typedef std::uint64_t PageId;
+
+// The null page id
+const PageId NO_PAGE = 0;
+
+class PageFile {
+ public:
+  PageFile(const std::string& path, std::size_t page_size = DEFAULT_PAGE_SIZE);
+  ~PageFile();
+  std::size_t page_size() const;
+  PageId page_count() const;
+  PageId allocate(std::size_t pages = 1);
+  void read(PageId id, char *page) const;
+  void write(PageId id, const char *page);
+  void sync();
+  PageId root() const;
+  void set_root(PageId root);
+  void advise_sequential();
+  void prefetch(PageId first, std::size_t pages) const;
+
+  static const std::size_t DEFAULT_PAGE_SIZE = 8192;
+  // Slotted pages address their bytes with 16 bit offsets
+  static const std::size_t MAX_PAGE_SIZE = 32768;
+ private:
+  PageFile(const PageFile&) = delete;
+  PageFile& operator=(const PageFile&) = delete;
+  void write_header();
+
+  const std::string _path;
+  int _fd;
+  std::size_t _page_size;
+  std::atomic<PageId> _page_count;
+  PageId _root;
+  std::mutex _header_mutex;
+};
+
+#endif  // __PAGE_FILE_H__
@@ -0,0 +1,300 @@
+// SimpleSQL: Table schemas
+
+#include "schema.h"
+#include <algorithm>
+#include <cstdint>
+
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::unique_lock;
+using std::mutex;
+using std::vector;
+
+/*------------------------------------------------
+  StorageError methods
+  ----------------------------------------------*/
+
+StorageError::StorageError(const string& message) : std::runtime_error(message) {}
+
+// Returns how values of the given datatype are stored
+PhysicalType physical_type(Datatype type) {
+  switch (type) {
+  case Datatype::INT_T:
+    return PhysicalType::INT64;
+  case Datatype::UINT_T:
+    return PhysicalType::UINT64;
+  case Datatype::DOUBLE_T:
+  case Datatype::UDOUBLE_T:
+    return PhysicalType::DOUBLE;
+  case Datatype::CHAR_T:
+  case Datatype::VARCHAR_T:
+  case Datatype::STRING_T:
+  case Datatype::BINARY_T:
+    return PhysicalType::STRING;
+  case Datatype::ENUM_T:
+    return PhysicalType::ENUM;
+  default:
+    return PhysicalType::SET;
+  }
+}
+
+// Returns the number of bytes one value of the given type takes in a
+// column. Strings are stored as offsets into a separate heap.
+size_t physical_width(PhysicalType type) {
+  switch (type) {
+  case PhysicalType::INT64:
+    return sizeof(std::int64_t);
+  case PhysicalType::UINT64:
+    return sizeof(std::uint64_t);
+  case PhysicalType::DOUBLE:
+    return sizeof(double);
+  case PhysicalType::ENUM:
+    return sizeof(std::uint8_t);
+  default:
+    return sizeof(std::uint64_t);
+  }
+}
+
+// Returns true if the values of columns of the given type are read as
+// strings, whether or not they are stored as them
+bool reads_as_string(PhysicalType type) {
+  return type == PhysicalType::STRING || type == PhysicalType::ENUM
+    || type == PhysicalType::SET;
+}
+
+/*------------------------------------------------
+  Dictionary methods
+  ----------------------------------------------*/
+
+// Creates the dictionary of the given members. Throws a StorageError if a
+// member is given twice.
+Dictionary::Dictionary(const vector<string>& members) : _members(members) {
+  for (size_t i = 0; i < members.size(); ++i) {
+    if (!_positions.emplace(members[i], i).second) {
+      throw StorageError("Duplicate member '" + members[i] + "'");
+    }
+  }
+}
+
+// Returns the number of members
+size_t Dictionary::size() const {
+  return _members.size();
+}
+
+// Returns the members in declaration order
+const vector<string>& Dictionary::members() const {
+  return _members;
+}
+
+// Returns the member at the given position
+const string& Dictionary::member(size_t index) const {
+  return _members[index];
+}
+
+// Returns the position of the member with the given characters, or -1 if
+// there is none
+int Dictionary::index_of(const char *data, size_t length) const {
+  auto it = _positions.find(string(data, length));
+  return it == _positions.end() ? -1 : static_cast<int>(it->second);
+}
+
+// Sets mask to the set of members listed, separated by commas, in the
+// given characters, and returns true, or returns false if one of them is
+// not a member. The empty string is the empty set.
+bool Dictionary::set_mask(const char *data, size_t length, uint64_t& mask) const {
+  mask = 0;
+  if (length == 0) {
+    return true;
+  }
+  const char *end = data + length;
+  while (true) {
+    const char *comma = std::find(data, end, ',');
+    int index = index_of(data, comma - data);
+    if (index < 0) {
+      return false;
+    }
+    mask |= uint64_t(1) << index;
+    if (comma == end) {
+      return true;
+    }
+    data = comma + 1;
+  }
+}
+
+// Returns the string of the set with the given mask: its members in
+// declaration order, separated by commas. Valid as long as the dictionary.
+Value Dictionary::set_value(uint64_t mask) const {
+  if (mask == 0) {
+    return Value("", 0);
+  }
+  if ((mask & (mask - 1)) == 0) {
+    const string& only = _members[__builtin_ctzll(mask)];
+    return Value(only.data(), only.size());
+  }
+  unique_lock<mutex> lock(_mutex);
+  string& set = _sets[mask];
+  if (set.empty()) {
+    for (uint64_t rest = mask; rest; rest &= rest - 1) {
+      if (rest != mask) {
+	set += ',';
+      }
+      set += _members[__builtin_ctzll(rest)];
+    }
+  }
+  return Value(set.data(), set.size());
+}
+
+/*------------------------------------------------
+  Schema methods
+  ----------------------------------------------*/
+
+// Adds a column after the existing ones. Throws a StorageError if the
+// name is taken, or the members of an ENUM or SET column cannot be stored.
+void Schema::add_column(const ColumnSchema& column) {
+  if (index_of(column.name) >= 0) {
+    throw StorageError("Duplicate column " + column.name);
+  }
+  PhysicalType type = physical_type(column.type);
+  if (type == PhysicalType::ENUM || type == PhysicalType::SET) {
+    const size_t limit = type == PhysicalType::ENUM ? MAX_ENUM_MEMBERS : MAX_SET_MEMBERS;
+    if (!column.dictionary || column.dictionary->size() == 0) {
+      throw StorageError("Column " + column.name + " has no members");
+    }
+    if (column.dictionary->size() > limit) {
+      throw StorageError("Column " + column.name + " has more than " + std::to_string(limit)
+			 + " members");
+    }
+    for (size_t i = 0; type == PhysicalType::SET && i < column.dictionary->size(); ++i) {
+      if (column.dictionary->member(i).find(',') != string::npos) {
+	throw StorageError("SET members cannot contain commas");
+      }
+    }
+  }
+  _columns.push_back(column);
+}
+
+// Makes the named columns the primary key, in the given order. Primary key
+// columns are never null. Throws a StorageError if a column does not exist
+// or is named twice.
+void Schema::set_primary_key(const vector<string>& columns) {
+  vector<size_t> key;
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    int index = index_of(*it);
+    if (index < 0) {
+      throw StorageError("Primary key column " + *it + " does not exist");
+    }
+    for (auto other = key.begin(); other != key.end(); ++other) {
+      if (*other == static_cast<size_t>(index)) {
+	throw StorageError("Column " + *it + " appears twice in the primary key");
+      }
+    }
+    key.push_back(index);
+    _columns[index].nullable = false;
+  }
+  _primary_key = key;
+}
+
+// Returns the number of columns
+size_t Schema::size() const {
+  return _columns.size();
+}
+
+// Returns the column at the given position
+const ColumnSchema& Schema::column(size_t index) const {
+  return _columns[index];
+}
+
+// Returns the position of the column with the given name, or -1 if there
+// is none
+int Schema::index_of(const string& name) const {
+  for (size_t i = 0; i < _columns.size(); ++i) {
+    if (_columns[i].name == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+// Returns the positions of the primary key columns, in key order. Empty if
+// the table has no primary key.
+const vector<size_t>& Schema::primary_key() const {
+  return _primary_key;
+}
+
+// Converts value to the type stored by the column at index. Integers are
+// widened to doubles, and integers of either signedness are accepted where
+// they fit. ENUM and SET values become the dictionary's own string for
+// them, so a SET's members may be listed in any order, or more than once.
+// Throws a StorageError if the value does not fit the column.
+Value Schema::coerce(size_t index, const Value& value) const {
+  const ColumnSchema& column = _columns[index];
+  if (value.is_null()) {
+    if (!column.nullable) {
+      throw StorageError("Column " + column.name + " cannot be NULL");
+    }
+    return value;
+  }
+  switch (physical_type(column.type)) {
+  case PhysicalType::INT64:
+    if (value.type() == ValueType::INT) {
+      return value;
+    }
+    if (value.type() == ValueType::UINT && value.uint_value() <= INT64_MAX) {
+      return Value(static_cast<long long>(value.uint_value()));
+    }
+    break;
+  case PhysicalType::UINT64:
+    if (value.type() == ValueType::UINT) {
+      return value;
+    }
+    if (value.type() == ValueType::INT && value.int_value() >= 0) {
+      return Value(static_cast<unsigned long long>(value.int_value()));
+    }
+    break;
+  case PhysicalType::DOUBLE: {
+    double d;
+    if (value.type() == ValueType::DOUBLE) {
+      d = value.double_value();
+    } else if (value.type() == ValueType::INT) {
+      d = static_cast<double>(value.int_value());
+    } else if (value.type() == ValueType::UINT) {
+      d = static_cast<double>(value.uint_value());
+    } else {
+      break;
+    }
+    if (column.type == Datatype::UDOUBLE_T && d < 0) {
+      break;
+    }
+    return Value(d);
+  }
+  case PhysicalType::STRING:
+    if (value.type() != ValueType::STRING) {
+      break;
+    }
+    if (column.length > 0 && value.string_length() > static_cast<size_t>(column.length)) {
+      throw StorageError("Value too long for column " + column.name);
+    }
+    return value;
+  case PhysicalType::ENUM: {
+    if (value.type() != ValueType::STRING) {
+      break;
+    }
+    int index = column.dictionary->index_of(value.string_data(), value.string_length());
+    if (index < 0) {
+      break;
+    }
+    const string& member = column.dictionary->member(index);
+    return Value(member.data(), member.size());
+  }
+  case PhysicalType::SET: {
+    uint64_t mask;
+    if (value.type() != ValueType::STRING ||
+	!column.dictionary->set_mask(value.string_data(), value.string_length(), mask)) {
+      break;
+    }
+    return column.dictionary->set_value(mask);
+  }
+  }
+  throw StorageError("Value " + value.toString() + " does not fit column " + column.name);
+}
@@ -0,0 +1,101 @@
+// SimpleSQL: Table schemas
+//
+// The logical description of a table: its columns, in declaration order,
+// and its primary key. Schemas are built from CREATE TABLE statements and
+// decide how every column is stored.
+//
+// ENUM and SET columns keep their members in a dictionary shared by every
+// copy of the column's schema. Their values are read and written as
+// strings, an ENUM value being one member and a SET value its members in
+// declaration order separated by commas, but are stored as a member's
+// code or a mask of members. Strings read back point into the dictionary.
+
+#ifndef __SCHEMA_H__
+#define __SCHEMA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../AST/create.h"
+#include "../AST/value.h"
+
+// Thrown when a statement cannot be applied to the stored data, such as a
+// value of the wrong type or a table that does not exist
+class StorageError : public std::runtime_error {
+ public:
+  StorageError(const std::string& message);
+};
+
+// The representation of a column's values in memory. Every Datatype maps
+// to one of these. ENUM values are a byte holding the position of their
+// member plus one, so that null rows can hold zero, and SET values a word
+// with bit i set if member i is in the set.
+enum class PhysicalType {
+  INT64,
+  UINT64,
+  DOUBLE,
+  STRING,
+  ENUM,
+  SET
+};
+
+// The most members an ENUM or SET column can have
+const std::size_t MAX_ENUM_MEMBERS = 255;
+const std::size_t MAX_SET_MEMBERS = 64;
+
+PhysicalType physical_type(Datatype type);
+std::size_t physical_width(PhysicalType type);
+bool reads_as_string(PhysicalType type);
+
+// The members of an ENUM or SET column, in declaration order. Safe to
+// read from several threads at once.
+class Dictionary {
+ public:
+  Dictionary(const std::vector<std::string>& members);
+  std::size_t size() const;
+  const std::vector<std::string>& members() const;
+  const std::string& member(std::size_t index) const;
+  int index_of(const char *data, std::size_t length) const;
+  bool set_mask(const char *data, std::size_t length, std::uint64_t& mask) const;
+  Value set_value(std::uint64_t mask) const;
+ private:
+  Dictionary(const Dictionary&) = delete;
+  Dictionary& operator=(const Dictionary&) = delete;
+  const std::vector<std::string> _members;
+  std::unordered_map<std::string, std::size_t> _positions;
+  // The strings of the sets of more than one member read so far, by mask
+  mutable std::mutex _mutex;
+  mutable std::unordered_map<std::uint64_t, std::string> _sets;
+};
+
+// A column of a table. Length is the declared length of character
+// columns, or 0 if unbounded. Dictionary holds the members of ENUM and
+// SET columns, and is null for other columns.
+struct ColumnSchema {
+  std::string name;
+  Datatype type;
+  int length;
+  bool nullable;
+  std::shared_ptr<const Dictionary> dictionary;
+};
+
+class Schema {
+ public:
+  void add_column(const ColumnSchema& column);
+  void set_primary_key(const std::vector<std::string>& columns);
+  std::size_t size() const;
+  const ColumnSchema& column(std::size_t index) const;
+  int index_of(const std::string& name) const;
+  const std::vector<std::size_t>& primary_key() const;
+  Value coerce(std::size_t index, const Value& value) const;
+ private:
+  std::vector<ColumnSchema> _columns;
+  std::vector<std::size_t> _primary_key;
+};
+
+#endif  // __SCHEMA_H__
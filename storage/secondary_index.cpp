@@ -0,0 +1,108 @@
+// SimpleSQL: Secondary indexes
+
+#include "secondary_index.h"
+#include <cassert>
+#include "index_key.h"
+
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+namespace {
+
+// Returns the key of the entry for row in an ordered index
+string tree_key(const string& key, uint64_t row) {
+  string entry = key;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    entry += static_cast<char>(row >> shift);
+  }
+  return entry;
+}
+
+}  // namespace
+
+// Creates an empty index of the given kind on the columns at the given
+// positions, in key order
+SecondaryIndex::SecondaryIndex(const string& name, IndexKind kind, const vector<size_t>& columns)
+  : _name(name), _kind(kind), _columns(columns),
+    _hash(kind == IndexKind::HASH ? new HashIndex() : nullptr),
+    _tree(kind == IndexKind::ORDERED ? new BTree() : nullptr) {}
+
+const string& SecondaryIndex::name() const {
+  return _name;
+}
+
+IndexKind SecondaryIndex::kind() const {
+  return _kind;
+}
+
+// Returns the positions of the indexed columns, in key order
+const vector<size_t>& SecondaryIndex::columns() const {
+  return _columns;
+}
+
+// Returns the index key of a row, given the values of all of its columns
+// in schema order, converted to their columns' types
+string SecondaryIndex::key(const Value *row) const {
+  string key;
+  for (auto it = _columns.begin(); it != _columns.end(); ++it) {
+    append_key(key, row[*it]);
+  }
+  return key;
+}
+
+// Adds row under the given index key
+void SecondaryIndex::insert(const string& key, uint64_t row) {
+  if (_hash) {
+    _hash->insert(key, row);
+  } else {
+    _tree->insert(tree_key(key, row), row);
+  }
+}
+
+// Removes row from under the given index key
+void SecondaryIndex::erase(const string& key, uint64_t row) {
+  if (_hash) {
+    _hash->erase(key, row);
+  } else {
+    _tree->erase(tree_key(key, row));
+  }
+}
+
+// Appends the rows whose indexed columns have the values encoded by key to
+// rows. An ordered index also accepts the key of some leading columns, and
+// finds the rows in row order.
+void SecondaryIndex::find(const string& key, vector<uint64_t>& rows) const {
+  if (_hash) {
+    _hash->find(key, rows);
+    return;
+  }
+  string end = prefix_successor(key);
+  _tree->scan(key, end.empty() ? nullptr : &end, [&](uint64_t row) {
+      rows.push_back(row);
+      return true;
+    });
+}
+
+// Visits the rows of an ordered index whose keys are in [from, to), in key
+// order, until visit returns false. If to is null the range is unbounded.
+// Keys are compared as index keys, without row numbers.
+void SecondaryIndex::scan(const string& from, const string *to,
+			  const std::function<bool(uint64_t)>& visit) const {
+  assert(_tree);
+  _tree->scan(from, to, visit);
+}
+
+// Visits the rows of an ordered index whose keys are in [from, to) like
+// scan(), but in descending key order
+void SecondaryIndex::scan_reverse(const string& from, const string *to,
+				  const std::function<bool(uint64_t)>& visit) const {
+  assert(_tree);
+  _tree->scan_reverse(from, to, visit);
+}
+
+// Returns the number of rows in the index
+size_t SecondaryIndex::size() const {
+  return _hash ? _hash->size() : _tree->size();
+}
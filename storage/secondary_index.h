@@ -0,0 +1,57 @@
+// SimpleSQL: Secondary indexes
+//
+// An index on one or more columns of a table, created by CREATE INDEX and
+// kept up to date by the table as rows are appended and deleted. Indexed
+// values need not be unique.
+//
+// A HASH index is a HashIndex from the index key of the columns (see
+// index_key.h) to row numbers, and answers lookups of all of its columns.
+// An ORDERED index is a B+-tree whose keys are the index key followed by
+// the row number, 8 bytes big endian, so that rows with equal values still
+// have distinct keys, in row order. Since the index key of its leading
+// columns is a prefix of the full key, it also answers lookups of its
+// leading columns and range scans, like the primary key.
+
+#ifndef __SECONDARY_INDEX_H__
+#define __SECONDARY_INDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "btree.h"
+#include "hash_index.h"
+#include "../AST/create.h"
+#include "../AST/value.h"
+
+class SecondaryIndex {
+ public:
+  SecondaryIndex(const std::string& name, IndexKind kind,
+		 const std::vector<std::size_t>& columns);
+  const std::string& name() const;
+  IndexKind kind() const;
+  const std::vector<std::size_t>& columns() const;
+  std::string key(const Value *row) const;
+  void insert(const std::string& key, std::uint64_t row);
+  void erase(const std::string& key, std::uint64_t row);
+  void find(const std::string& key, std::vector<std::uint64_t>& rows) const;
+  void scan(const std::string& from, const std::string *to,
+	    const std::function<bool(std::uint64_t)>& visit) const;
+  void scan_reverse(const std::string& from, const std::string *to,
+		    const std::function<bool(std::uint64_t)>& visit) const;
+  std::size_t size() const;
+ private:
+  SecondaryIndex(const SecondaryIndex&) = delete;
+  SecondaryIndex& operator=(const SecondaryIndex&) = delete;
+
+  const std::string _name;
+  const IndexKind _kind;
+  const std::vector<std::size_t> _columns;
+  // Exactly one of these is set, according to the kind
+  std::unique_ptr<HashIndex> _hash;
+  std::unique_ptr<BTree> _tree;
+};
+
+#endif  // __SECONDARY_INDEX_H__
@@ -0,0 +1,76 @@
+// SimpleSQL: Slotted pages
+
+#include "slotted_page.h"
+#include <cstring>
+
+using std::size_t;
+
+// Views page, of page_size bytes, as a slotted page. The page must have
+// been initialized with init() before records are read or inserted.
+SlottedPage::SlottedPage(char *page, size_t page_size) : _page(page), _page_size(page_size) {}
+
+// Makes the page an empty slotted page with no next page
+void SlottedPage::init() {
+  Header *h = header();
+  h->next = NO_PAGE;
+  h->records = 0;
+  h->data_start = static_cast<std::uint16_t>(_page_size);
+}
+
+// Returns the number of records in the page
+size_t SlottedPage::records() const {
+  return header()->records;
+}
+
+// Returns the length of the longest record that can still be inserted
+size_t SlottedPage::free_space() const {
+  size_t used = sizeof(Header) + (header()->records + 1) * sizeof(Slot);
+  size_t data_start = header()->data_start;
+  return data_start > used ? data_start - used : 0;
+}
+
+// Adds a record after the existing ones and returns true, or returns false
+// if it does not fit
+bool SlottedPage::insert(const char *record, size_t length) {
+  if (length > free_space()) {
+    return false;
+  }
+  Header *h = header();
+  h->data_start -= static_cast<std::uint16_t>(length);
+  std::memcpy(_page + h->data_start, record, length);
+  slots()[h->records] = Slot{h->data_start, static_cast<std::uint16_t>(length)};
+  ++h->records;
+  return true;
+}
+
+// Returns the bytes of the record in the given slot
+const char *SlottedPage::record(size_t slot) const {
+  return _page + slots()[slot].offset;
+}
+
+// Returns the length of the record in the given slot
+size_t SlottedPage::record_length(size_t slot) const {
+  return slots()[slot].length;
+}
+
+// Returns the page after this one in its list, or NO_PAGE
+PageId SlottedPage::next() const {
+  return header()->next;
+}
+
+void SlottedPage::set_next(PageId next) {
+  header()->next = next;
+}
+
+// Returns the longest record an empty page of the given size can hold
+size_t SlottedPage::capacity(size_t page_size) {
+  return page_size - sizeof(Header) - sizeof(Slot);
+}
+
+SlottedPage::Header *SlottedPage::header() const {
+  return reinterpret_cast<Header*>(_page);
+}
+
+SlottedPage::Slot *SlottedPage::slots() const {
+  return reinterpret_cast<Slot*>(_page + sizeof(Header));
+}
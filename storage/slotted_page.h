@@ -0,0 +1,49 @@
+// SimpleSQL: Slotted pages
+//
+// A slotted page stores variable-length records. A small header at the
+// start of the page is followed by an array of slots, one per record,
+// which grows forward; the records themselves are packed from the end of
+// the page backward. Records are numbered by slot in insertion order.
+// Pages can be chained into lists through the next page id in the header.
+
+#ifndef __SLOTTED_PAGE_H__
+#define __SLOTTED_PAGE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "page_file.h"
+
+// A view of a page buffer as a slotted page. Does not own the buffer.
+class SlottedPage {
+ public:
+  SlottedPage(char *page, std::size_t page_size);
+  void init();
+  std::size_t records() const;
+  std::size_t free_space() const;
+  bool insert(const char *record, std::size_t length);
+  const char *record(std::size_t slot) const;
+  std::size_t record_length(std::size_t slot) const;
+  PageId next() const;
+  void set_next(PageId next);
+
+  static std::size_t capacity(std::size_t page_size);
+ private:
+  // Stored at the start of the page
+  struct Header {
+    std::uint64_t next;
+    std::uint16_t records;
+    // Offset of the first byte of record data
+    std::uint16_t data_start;
+  };
+  struct Slot {
+    std::uint16_t offset;
+    std::uint16_t length;
+  };
+  Header *header() const;
+  Slot *slots() const;
+
+  char *const _page;
+  const std::size_t _page_size;
+};
+
+#endif  // __SLOTTED_PAGE_H__
@@ -0,0 +1,626 @@
+// SimpleSQL: In-memory tables
+
+#include "table.h"
+#include <algorithm>
+#include <unordered_set>
+#include "index_key.h"
+#include "table_file.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+/*------------------------------------------------
+  Chunk methods
+  ----------------------------------------------*/
+
+// Creates an empty chunk with a column for every column of schema
+Chunk::Chunk(const Schema& schema) : _deleted_rows(0) {
+  _columns.reserve(schema.size());
+  for (size_t i = 0; i < schema.size(); ++i) {
+    _columns.push_back(ColumnChunk(schema.column(i)));
+  }
+}
+
+// Returns the number of rows in the chunk
+size_t Chunk::size() const {
+  return _columns.empty() ? 0 : _columns.front().size();
+}
+
+// Returns the number of columns in the chunk
+size_t Chunk::columns() const {
+  return _columns.size();
+}
+
+const ColumnChunk& Chunk::column(size_t index) const {
+  return _columns[index];
+}
+
+ColumnChunk& Chunk::column(size_t index) {
+  return _columns[index];
+}
+
+// Returns true if row has been deleted
+bool Chunk::is_deleted(size_t row) const {
+  return row / 64 < _deleted.size() && bit_is_set(_deleted.data(), row);
+}
+
+// Returns the number of deleted rows in the chunk
+size_t Chunk::deleted_rows() const {
+  return _deleted_rows;
+}
+
+// Returns the bytes of memory the chunk's columns and bitmaps take up
+size_t Chunk::bytes() const {
+  size_t bytes = (_deleted.capacity() + _stale_zones.capacity()) * sizeof(std::uint64_t);
+  for (auto it = _columns.begin(); it != _columns.end(); ++it) {
+    bytes += it->bytes();
+  }
+  return bytes;
+}
+
+// Marks row deleted
+void Chunk::erase(size_t row) {
+  if (is_deleted(row)) {
+    return;
+  }
+  if (row / 64 >= _deleted.size()) {
+    _deleted.resize((size() + 63) / 64, 0);
+  }
+  _deleted[row / 64] |= std::uint64_t(1) << (row % 64);
+  ++_deleted_rows;
+  size_t zone = row / ZONE_ROWS;
+  if (zone / 64 >= _stale_zones.size()) {
+    _stale_zones.resize(zone / 64 + 1, 0);
+  }
+  _stale_zones[zone / 64] |= std::uint64_t(1) << (zone % 64);
+}
+
+// Seals every column, once the chunk is full
+void Chunk::seal() {
+  for (auto it = _columns.begin(); it != _columns.end(); ++it) {
+    it->seal();
+  }
+}
+
+// Summarizes the stale zones of every column again, so that they only
+// cover the rows that are not deleted
+void Chunk::summarize_zones() {
+  for (size_t word = 0; word < _stale_zones.size(); ++word) {
+    for (std::uint64_t stale = _stale_zones[word]; stale != 0; stale &= stale - 1) {
+      size_t zone = word * 64 + __builtin_ctzll(stale);
+      for (auto it = _columns.begin(); it != _columns.end(); ++it) {
+	it->summarize(zone, _deleted);
+      }
+    }
+  }
+  _stale_zones.clear();
+}
+
+/*------------------------------------------------
+  ChunkHandle methods
+  ----------------------------------------------*/
+
+ChunkHandle::ChunkHandle(PagedTable *paged, size_t index, const Chunk *chunk)
+  : _paged(paged), _index(index), _chunk(chunk) {}
+
+ChunkHandle::ChunkHandle(ChunkHandle&& other)
+  : _paged(other._paged), _index(other._index), _chunk(other._chunk) {
+  other._paged = nullptr;
+  other._chunk = nullptr;
+}
+
+ChunkHandle::~ChunkHandle() {
+  if (_paged) {
+    _paged->unpin(_index);
+  }
+}
+
+const Chunk& ChunkHandle::operator*() const {
+  return *_chunk;
+}
+
+const Chunk *ChunkHandle::operator->() const {
+  return _chunk;
+}
+
+const Chunk *ChunkHandle::get() const {
+  return _chunk;
+}
+
+/*------------------------------------------------
+  Table methods
+  ----------------------------------------------*/
+
+// Creates an empty table with the given schema, whose chunks hold up to
+// chunk_rows rows
+Table::Table(const string& name, const Schema& schema, size_t chunk_rows)
+  : _name(name), _schema(schema), _chunk_rows(chunk_rows ? chunk_rows : 1), _rows(0),
+    _deleted_rows(0), _primary_index(schema.primary_key().empty() ? nullptr : new BTree()) {}
+
+// Destroys the table, and takes its chunks out of its store if it is kept
+// in one
+Table::~Table() {}
+
+const string& Table::name() const {
+  return _name;
+}
+
+const Schema& Table::schema() const {
+  return _schema;
+}
+
+// Returns the number of rows ever appended to the table, deleted or not,
+// which is the number of the next row appended
+size_t Table::rows() const {
+  return _rows;
+}
+
+// Returns the most rows a chunk holds
+size_t Table::chunk_rows() const {
+  return _chunk_rows;
+}
+
+// Returns the number of chunks of the table. Every chunk but the last is
+// full.
+size_t Table::chunk_count() const {
+  return _chunks.size();
+}
+
+// Returns the chunk at index, in row order. A chunk of a table kept in a
+// store is read back if it was paged out, and stays in memory until the
+// store's next statement begins, as do the values read from it.
+const Chunk& Table::chunk(size_t index) const {
+  return _paged ? _paged->hold(index) : *_chunks[index];
+}
+
+// Returns the chunk at index, in row order, pinned in memory until the
+// handle is destroyed. A chunk of a table kept in a store is read back if
+// it was paged out, and may be paged out again once it is unpinned, unless
+// the statement has also read it with chunk().
+ChunkHandle Table::pin(size_t index) const {
+  if (_paged) {
+    return ChunkHandle(_paged.get(), index, &_paged->pin(index));
+  }
+  return ChunkHandle(nullptr, index, _chunks[index].get());
+}
+
+// Returns the paging state of the table's chunks, or null if the table is
+// not kept in a store
+PagedTable *Table::paged() const {
+  return _paged.get();
+}
+
+// Appends a row holding a value for every column, in schema order. Throws
+// a StorageError, leaving the table unchanged, if a value does not fit its
+// column.
+void Table::append(const vector<Value>& row) {
+  vector<Value> coerced(_schema.size());
+  coerce(row, coerced.data());
+  vector<string> keys;
+  index_keys(coerced.data(), 1, keys, vector<size_t>());
+  append_coerced(coerced.data(), 1);
+  index_rows(coerced.data(), 1, keys);
+}
+
+// Appends rows in order. Every row is checked before any is appended, so
+// a StorageError leaves the table unchanged.
+void Table::append(const vector<vector<Value>>& rows) {
+  vector<Value> coerced(rows.size() * _schema.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    coerce(rows[i], &coerced[i * _schema.size()]);
+  }
+  vector<string> keys;
+  index_keys(coerced.data(), rows.size(), keys, vector<size_t>());
+  append_coerced(coerced.data(), rows.size());
+  index_rows(coerced.data(), rows.size(), keys);
+}
+
+// Appends count rows stored one after another, each with a value for every
+// column in order. Every row is checked before any is appended, so a
+// StorageError leaves the table unchanged.
+void Table::append(const Value *rows, size_t count) {
+  vector<Value> copy(rows, rows + count * _schema.size());
+  append_in_place(copy.data(), count);
+}
+
+// Like append(), but converts the values of rows to the types of their
+// columns in place instead of in a copy, so rows is overwritten. Meant for
+// callers that fill a buffer of rows only to append it.
+void Table::append_in_place(Value *rows, size_t count) {
+  const size_t width = _schema.size();
+  for (size_t i = 0; i < count; ++i) {
+    Value *row = rows + i * width;
+    for (size_t column = 0; column < width; ++column) {
+      row[column] = _schema.coerce(column, row[column]);
+    }
+  }
+  vector<string> keys;
+  index_keys(rows, count, keys, vector<size_t>());
+  append_coerced(rows, count);
+  index_rows(rows, count, keys);
+}
+
+// Deletes the given rows, removing them from every index. Rows already
+// deleted are skipped. The zones they were in are summarized again once
+// all are deleted.
+void Table::erase(const vector<size_t>& rows) {
+  vector<Value> values(_schema.size());
+  for (auto it = rows.begin(); it != rows.end(); ++it) {
+    if (is_deleted(*it)) {
+      continue;
+    }
+    row_values(*it, values.data());
+    if (_primary_index) {
+      string key;
+      const vector<size_t>& columns = _schema.primary_key();
+      for (auto column = columns.begin(); column != columns.end(); ++column) {
+	append_key(key, values[*column]);
+      }
+      _primary_index->erase(key);
+    }
+    for (auto index = _indexes.begin(); index != _indexes.end(); ++index) {
+      (*index)->erase((*index)->key(values.data()), *it);
+    }
+    change(*it / _chunk_rows).erase(*it % _chunk_rows);
+    changed(*it / _chunk_rows);
+    ++_deleted_rows;
+  }
+  // The chunks rows were deleted from were read with row_values(), so they
+  // are still in memory
+  for (auto it = _chunks.begin(); it != _chunks.end(); ++it) {
+    if (*it) {
+      (*it)->summarize_zones();
+    }
+  }
+}
+
+// Sets the columns of the given rows to the values assigned to them, given
+// as pairs of a column position and a value. The rows are deleted, and
+// their new versions appended in row order, so they get new row numbers.
+// Rows already deleted are skipped. Every new row is checked
+// before any change is made, so a StorageError leaves the table unchanged.
+void Table::update(const vector<size_t>& rows,
+		   const vector<std::pair<size_t, Value>>& assignments) {
+  vector<size_t> targets;
+  for (auto it = rows.begin(); it != rows.end(); ++it) {
+    if (!is_deleted(*it)) {
+      targets.push_back(*it);
+    }
+  }
+  std::sort(targets.begin(), targets.end());
+  targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+  vector<Value> assigned;
+  for (auto it = assignments.begin(); it != assignments.end(); ++it) {
+    assigned.push_back(_schema.coerce(it->first, it->second));
+  }
+  // Unassigned strings refer to chunk heaps, which appending may move, so
+  // the new rows keep copies of them
+  const size_t width = _schema.size();
+  vector<Value> updated(targets.size() * width);
+  vector<string> strings;
+  strings.reserve(updated.size());
+  for (size_t i = 0; i < targets.size(); ++i) {
+    Value *row = &updated[i * width];
+    row_values(targets[i], row);
+    for (size_t column = 0; column < width; ++column) {
+      if (row[column].type() == ValueType::STRING) {
+	strings.push_back(row[column].string_value());
+	row[column] = Value(strings.back().data(), strings.back().size());
+      }
+    }
+    for (size_t j = 0; j < assignments.size(); ++j) {
+      row[assignments[j].first] = assigned[j];
+    }
+  }
+  vector<string> keys;
+  index_keys(updated.data(), targets.size(), keys, targets);
+  erase(targets);
+  append_coerced(updated.data(), targets.size());
+  index_rows(updated.data(), targets.size(), keys);
+}
+
+// Returns true if row has been deleted
+bool Table::is_deleted(size_t row) const {
+  return chunk(row / _chunk_rows).is_deleted(row % _chunk_rows);
+}
+
+// Returns the number of deleted rows
+size_t Table::deleted_rows() const {
+  return _deleted_rows;
+}
+
+// Returns the value of a column of row. Strings refer to the table's
+// storage, and are valid until the next change to the table, or for a
+// table kept in a store until the next statement begins.
+Value Table::value(size_t row, size_t column) const {
+  return chunk(row / _chunk_rows).column(column).value(row % _chunk_rows);
+}
+
+// Returns the primary key index, or null if the table has no primary key
+const BTree *Table::primary_index() const {
+  return _primary_index.get();
+}
+
+// Returns the index key of the given values of the first primary key
+// columns, in key order. A key for fewer columns than the primary key has
+// is a prefix of the keys of every row with those values, so
+// [key, prefix_successor(key)) is the range of those rows. Throws a
+// StorageError if there are more values than key columns, or a value does
+// not fit its column.
+string Table::primary_key(const vector<Value>& values) const {
+  const vector<size_t>& columns = _schema.primary_key();
+  if (values.size() > columns.size()) {
+    throw StorageError("The primary key of table " + _name + " has " +
+		       std::to_string(columns.size()) + " columns but " +
+		       std::to_string(values.size()) + " values were given");
+  }
+  string key;
+  for (size_t i = 0; i < values.size(); ++i) {
+    append_key(key, _schema.coerce(columns[i], values[i]));
+  }
+  return key;
+}
+
+// Sets row to the number of the row whose primary key has the given
+// values and returns true, or returns false if there is no such row.
+// Throws a StorageError if the table has no primary key or the values do
+// not fit it.
+bool Table::find(const vector<Value>& key, size_t& row) const {
+  if (!_primary_index) {
+    throw StorageError("Table " + _name + " has no primary key");
+  }
+  if (key.size() != _schema.primary_key().size()) {
+    throw StorageError("The primary key of table " + _name + " has " +
+		       std::to_string(_schema.primary_key().size()) + " columns but " +
+		       std::to_string(key.size()) + " values were given");
+  }
+  std::uint64_t found;
+  if (!_primary_index->find(primary_key(key), found)) {
+    return false;
+  }
+  row = static_cast<size_t>(found);
+  return true;
+}
+
+// Creates an index of the given kind on the named columns, in key order,
+// and fills it with the table's rows. Throws a StorageError if the table
+// has an index of that name, or the columns are not columns of the table.
+const SecondaryIndex& Table::create_index(const string& name, IndexKind kind,
+					  const vector<string>& columns) {
+  if (index(name)) {
+    throw StorageError("Index " + name + " already exists");
+  }
+  if (columns.empty()) {
+    throw StorageError("Index " + name + " has no columns");
+  }
+  vector<size_t> positions;
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    int position = _schema.index_of(*it);
+    if (position < 0) {
+      throw StorageError("Table " + _name + " has no column " + *it);
+    }
+    if (std::find(positions.begin(), positions.end(), position) != positions.end()) {
+      throw StorageError("Column " + *it + " is indexed twice");
+    }
+    positions.push_back(position);
+  }
+  std::unique_ptr<SecondaryIndex> created(new SecondaryIndex(name, kind, positions));
+  // A chunk at a time, so that the chunks of a table kept in a store can
+  // be paged out once they are indexed
+  vector<Value> values(_schema.size());
+  for (size_t index = 0; index < _chunks.size(); ++index) {
+    ChunkHandle chunk = pin(index);
+    for (size_t row = 0; row < chunk->size(); ++row) {
+      if (!chunk->is_deleted(row)) {
+	for (size_t column = 0; column < values.size(); ++column) {
+	  values[column] = chunk->column(column).value(row);
+	}
+	created->insert(created->key(values.data()), index * _chunk_rows + row);
+      }
+    }
+  }
+  _indexes.push_back(std::move(created));
+  return *_indexes.back();
+}
+
+// Drops the index with the given name. Throws a StorageError if there is
+// none.
+void Table::drop_index(const string& name) {
+  for (auto it = _indexes.begin(); it != _indexes.end(); ++it) {
+    if ((*it)->name() == name) {
+      _indexes.erase(it);
+      return;
+    }
+  }
+  throw StorageError("Index " + name + " does not exist");
+}
+
+// Returns the index with the given name, or null if there is none
+const SecondaryIndex *Table::index(const string& name) const {
+  for (auto it = _indexes.begin(); it != _indexes.end(); ++it) {
+    if ((*it)->name() == name) {
+      return it->get();
+    }
+  }
+  return nullptr;
+}
+
+// Returns the secondary indexes of the table, in order of creation
+const vector<std::unique_ptr<SecondaryIndex>>& Table::indexes() const {
+  return _indexes;
+}
+
+// Writes the values of row, converted to the types of their columns, to
+// out. Throws a StorageError if the row does not fit the schema.
+void Table::coerce(const vector<Value>& row, Value *out) const {
+  if (row.size() != _schema.size()) {
+    throw StorageError("Table " + _name + " has " + std::to_string(_schema.size()) +
+		       " columns but " + std::to_string(row.size()) + " values were given");
+  }
+  for (size_t i = 0; i < row.size(); ++i) {
+    out[i] = _schema.coerce(i, row[i]);
+  }
+}
+
+// Sets keys to the primary keys of count coerced rows stored one after
+// another, or leaves it empty if the table has no primary key. Throws a
+// StorageError if a key is already in the table or repeated among the
+// rows. Keys of the rows in replaced, which must be sorted, are not
+// counted as being in the table.
+void Table::index_keys(const Value *rows, size_t count, vector<string>& keys,
+		       const vector<size_t>& replaced) const {
+  if (!_primary_index) {
+    return;
+  }
+  const vector<size_t>& columns = _schema.primary_key();
+  const size_t width = _schema.size();
+  keys.reserve(count);
+  bool ascending = true;
+  for (size_t i = 0; i < count; ++i) {
+    string key;
+    for (auto it = columns.begin(); it != columns.end(); ++it) {
+      append_key(key, rows[i * width + *it]);
+    }
+    ascending = ascending && (keys.empty() || keys.back() < key);
+    keys.push_back(std::move(key));
+  }
+  // Rows loaded in key order, as dumps are, cannot repeat a key, and
+  // cannot repeat one in the table if they start past its largest key, so
+  // keys are only looked up and hashed once they are out of order. A
+  // single key is as quick to look up as the largest key is to find.
+  if (ascending && count > 1 && last_key() < keys.front()) {
+    return;
+  }
+  for (auto key = keys.begin(); key != keys.end(); ++key) {
+    std::uint64_t existing;
+    if (_primary_index->find(*key, existing) &&
+	!std::binary_search(replaced.begin(), replaced.end(), static_cast<size_t>(existing))) {
+      throw StorageError("Duplicate primary key in table " + _name);
+    }
+  }
+  if (ascending) {
+    return;
+  }
+  std::unordered_set<string> batch(keys.begin(), keys.end());
+  if (batch.size() != keys.size()) {
+    throw StorageError("Duplicate primary key in table " + _name);
+  }
+}
+
+// Returns the largest key in the primary index, or an empty string, which
+// is less than every key, if the index is empty
+string Table::last_key() const {
+  string key;
+  _primary_index->scan_reverse(string(), nullptr, [&](std::uint64_t row) {
+      vector<Value> values(_schema.size());
+      row_values(row, values.data());
+      const vector<size_t>& columns = _schema.primary_key();
+      for (auto it = columns.begin(); it != columns.end(); ++it) {
+	append_key(key, values[*it]);
+      }
+      return false;
+    });
+  return key;
+}
+
+// Adds the last count rows appended, whose coerced values are stored one
+// after another in rows, to every index. Keys are their primary keys, as
+// returned by index_keys().
+void Table::index_rows(const Value *rows, size_t count, const vector<string>& keys) {
+  const size_t first = _rows - count;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    _primary_index->insert(keys[i], first + i);
+  }
+  const size_t width = _schema.size();
+  for (auto index = _indexes.begin(); index != _indexes.end(); ++index) {
+    for (size_t i = 0; i < count; ++i) {
+      (*index)->insert((*index)->key(rows + i * width), first + i);
+    }
+  }
+}
+
+// Writes the values of every column of row, in schema order, to out
+void Table::row_values(size_t row, Value *out) const {
+  const Chunk& chunk = this->chunk(row / _chunk_rows);
+  for (size_t column = 0; column < chunk.columns(); ++column) {
+    out[column] = chunk.column(column).value(row % _chunk_rows);
+  }
+}
+
+// Appends count coerced rows stored one after another. Each chunk is
+// filled a column at a time, so that only one column's buffers are
+// written at once.
+void Table::append_coerced(const Value *rows, size_t count) {
+  const size_t width = _schema.size();
+  while (count > 0) {
+    // The last chunk may be paged out, but every chunk before it is full
+    if (_rows == _chunks.size() * _chunk_rows) {
+      _chunks.push_back(std::unique_ptr<Chunk>(new Chunk(_schema)));
+    }
+    const size_t index = _chunks.size() - 1;
+    Chunk& chunk = change(index);
+    size_t start = chunk.size();
+    size_t batch = std::min(count, _chunk_rows - start);
+    for (size_t column = 0; column < width; ++column) {
+      ColumnChunk& values = chunk.column(column);
+      if (start + batch > values.capacity()) {
+	values.reserve(std::min(_chunk_rows, std::max(start + batch, 2 * values.capacity())));
+      }
+      values.append(rows + column, batch, width);
+    }
+    if (start + batch == _chunk_rows) {
+      chunk.seal();
+    }
+    changed(index);
+    rows += batch * width;
+    count -= batch;
+    _rows += batch;
+  }
+}
+
+// Returns the chunk at index to be changed, read back if it was paged out
+// and kept in memory until changed() is called
+Chunk& Table::change(size_t index) {
+  return _paged ? _paged->change(index) : *_chunks[index];
+}
+
+// Lets a chunk returned by change() be paged out again, and written back
+// first
+void Table::changed(size_t index) {
+  if (_paged) {
+    _paged->changed(index);
+  }
+}
+
+// Adds every row that is not deleted to the primary key index and to every
+// secondary index, a chunk at a time, once the chunks of a table kept in a
+// store have been read from its page file
+void Table::index_saved_rows() {
+  if (!_primary_index && _indexes.empty()) {
+    return;
+  }
+  vector<Value> values(_schema.size());
+  const vector<size_t>& key_columns = _schema.primary_key();
+  for (size_t index = 0; index < _chunks.size(); ++index) {
+    ChunkHandle chunk = pin(index);
+    for (size_t row = 0; row < chunk->size(); ++row) {
+      if (chunk->is_deleted(row)) {
+	continue;
+      }
+      for (size_t column = 0; column < values.size(); ++column) {
+	values[column] = chunk->column(column).value(row);
+      }
+      if (_primary_index) {
+	string key;
+	for (auto it = key_columns.begin(); it != key_columns.end(); ++it) {
+	  append_key(key, values[*it]);
+	}
+	_primary_index->insert(key, index * _chunk_rows + row);
+      }
+      for (auto it = _indexes.begin(); it != _indexes.end(); ++it) {
+	(*it)->insert((*it)->key(values.data()), index * _chunk_rows + row);
+      }
+    }
+  }
+}
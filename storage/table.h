@@ -0,0 +1,148 @@
+// SimpleSQL: In-memory tables
+//
+// A table is a list of chunks of up to chunk_rows() rows each, and every
+// chunk stores its columns separately (see column.h). Rows are appended to
+// the last chunk until it is full, then a new chunk is started, so chunks
+// never move once filled and scans can proceed one chunk at a time. A
+// chunk is sealed as soon as it fills, which encodes its numeric columns.
+//
+// A table with a primary key indexes it in a B+-tree from key to row
+// number, which rejects duplicate keys and answers lookups and key range
+// scans without scanning the table. Secondary indexes on other columns
+// can be added and dropped at any time (see secondary_index.h).
+//
+// Rows keep their row numbers for as long as they exist. Deleting a row
+// marks it deleted in its chunk and removes it from every index, and
+// updating rows deletes them and appends their new versions, so scans
+// must skip deleted rows. Deleting a row also marks the zone it is in
+// (see column.h) stale, and once a deletion or update is done, the stale
+// zones of every chunk are summarized again from the rows left.
+//
+// A table kept in a table store (see table_file.h) has only some of its
+// chunks in memory, so chunks are reached through chunk() or pin(), which
+// read them back when they were paged out.
+
+#ifndef __TABLE_H__
+#define __TABLE_H__
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include "btree.h"
+#include "column.h"
+#include "schema.h"
+#include "secondary_index.h"
+
+class PagedTable;
+
+// A horizontal slice of a table, holding every column for its rows
+class Chunk {
+ public:
+  Chunk(const Schema& schema);
+  std::size_t size() const;
+  std::size_t columns() const;
+  const ColumnChunk& column(std::size_t index) const;
+  ColumnChunk& column(std::size_t index);
+  bool is_deleted(std::size_t row) const;
+  std::size_t deleted_rows() const;
+  std::size_t bytes() const;
+  void erase(std::size_t row);
+  void seal();
+  void summarize_zones();
+ private:
+  std::vector<ColumnChunk> _columns;
+  // A bit per row, set for deleted rows. Empty until a row is deleted, and
+  // rows past its end are not deleted.
+  std::vector<std::uint64_t> _deleted;
+  std::size_t _deleted_rows;
+  // A bit per zone, set for zones rows have been deleted from since they
+  // were last summarized
+  std::vector<std::uint64_t> _stale_zones;
+};
+
+// A chunk pinned in memory. Unpins it when destroyed.
+class ChunkHandle {
+ public:
+  ChunkHandle(ChunkHandle&& other);
+  ~ChunkHandle();
+  const Chunk& operator*() const;
+  const Chunk *operator->() const;
+  const Chunk *get() const;
+ private:
+  friend class Table;
+  ChunkHandle(PagedTable *paged, std::size_t index, const Chunk *chunk);
+  ChunkHandle(const ChunkHandle&) = delete;
+  ChunkHandle& operator=(const ChunkHandle&) = delete;
+
+  // Null unless the table is kept in a store
+  PagedTable *_paged;
+  std::size_t _index;
+  const Chunk *_chunk;
+};
+
+class Table {
+ public:
+  Table(const std::string& name, const Schema& schema,
+	std::size_t chunk_rows = DEFAULT_CHUNK_ROWS);
+  ~Table();
+  const std::string& name() const;
+  const Schema& schema() const;
+  std::size_t rows() const;
+  std::size_t chunk_rows() const;
+  std::size_t chunk_count() const;
+  const Chunk& chunk(std::size_t index) const;
+  ChunkHandle pin(std::size_t index) const;
+  PagedTable *paged() const;
+  void append(const std::vector<Value>& row);
+  void append(const std::vector<std::vector<Value>>& rows);
+  void append(const Value *rows, std::size_t count);
+  void append_in_place(Value *rows, std::size_t count);
+  void erase(const std::vector<std::size_t>& rows);
+  void update(const std::vector<std::size_t>& rows,
+	      const std::vector<std::pair<std::size_t, Value>>& assignments);
+  bool is_deleted(std::size_t row) const;
+  std::size_t deleted_rows() const;
+  Value value(std::size_t row, std::size_t column) const;
+  const BTree *primary_index() const;
+  std::string primary_key(const std::vector<Value>& values) const;
+  bool find(const std::vector<Value>& key, std::size_t& row) const;
+  const SecondaryIndex& create_index(const std::string& name, IndexKind kind,
+				     const std::vector<std::string>& columns);
+  void drop_index(const std::string& name);
+  const SecondaryIndex *index(const std::string& name) const;
+  const std::vector<std::unique_ptr<SecondaryIndex>>& indexes() const;
+
+  static const std::size_t DEFAULT_CHUNK_ROWS = 1 << 16;
+ private:
+  friend class PagedTable;
+  friend class TableStore;
+  Table(const Table&) = delete;
+  Table& operator=(const Table&) = delete;
+  Chunk& change(std::size_t index);
+  void changed(std::size_t index);
+  void index_saved_rows();
+  void coerce(const std::vector<Value>& row, Value *out) const;
+  void append_coerced(const Value *rows, std::size_t count);
+  void index_keys(const Value *rows, std::size_t count, std::vector<std::string>& keys,
+		  const std::vector<std::size_t>& replaced) const;
+  void index_rows(const Value *rows, std::size_t count, const std::vector<std::string>& keys);
+  std::string last_key() const;
+  void row_values(std::size_t row, Value *out) const;
+
+  const std::string _name;
+  const Schema _schema;
+  const std::size_t _chunk_rows;
+  // Null while a chunk is paged out
+  std::vector<std::unique_ptr<Chunk>> _chunks;
+  std::size_t _rows;
+  std::size_t _deleted_rows;
+  // Null if the table has no primary key
+  std::unique_ptr<BTree> _primary_index;
+  std::vector<std::unique_ptr<SecondaryIndex>> _indexes;
+  // Null unless the table is kept in a store
+  std::unique_ptr<PagedTable> _paged;
+};
+
+#endif  // __TABLE_H__
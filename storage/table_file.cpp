@@ -0,0 +1,982 @@
+// SimpleSQL: Tables in page files
+//
+// Integers are written in native byte order, so files are not portable
+// between machines of different endianness.
+
+#include "table_file.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include "slotted_page.h"
+
+using std::size_t;
+using std::string;
+using std::int32_t;
+using std::uint8_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// The kinds of directory record. Each record starts with its kind.
+const char TABLE_RECORD = 'T';
+const char COLUMN_RECORD = 'C';
+const char KEY_RECORD = 'K';
+const char EXTENT_RECORD = 'E';
+const char DELETED_RECORD = 'D';
+const char INDEX_RECORD = 'I';
+
+// The kinds of database directory record
+const char DATABASE_RECORD = 'B';
+const char SAVED_TABLE_RECORD = 'S';
+
+// Records of string columns start with one of these
+const char INLINE_STRING = 0;
+const char OVERFLOW_STRING = 1;
+
+template <typename T>
+void put(string& record, const T& value) {
+  record.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const char *&record) {
+  T value;
+  std::memcpy(&value, record, sizeof(T));
+  record += sizeof(T);
+  return value;
+}
+
+// Appends records to a list of slotted pages, starting a new page whenever
+// the current one is full
+class RecordWriter {
+ public:
+  RecordWriter(BufferPool& pool) : _pool(pool), _first(NO_PAGE), _pages(0) {}
+
+  // Returns the first page of the list
+  PageId first() {
+    if (!_page) {
+      new_page();
+    }
+    return _first;
+  }
+
+  // Returns the number of pages in the list
+  size_t pages() const {
+    return _pages;
+  }
+
+  // Appends record, which must fit in an empty page
+  void write(const string& record) {
+    if (!_page || !SlottedPage(_page.data(), _pool.page_size()).insert(record.data(), record.size())) {
+      new_page();
+      SlottedPage(_page.data(), _pool.page_size()).insert(record.data(), record.size());
+    }
+  }
+ private:
+  void new_page() {
+    PageHandle page = _pool.allocate();
+    SlottedPage(page.data(), _pool.page_size()).init();
+    if (_page) {
+      SlottedPage(_page.data(), _pool.page_size()).set_next(page.id());
+    } else {
+      _first = page.id();
+    }
+    _page = std::move(page);
+    ++_pages;
+  }
+
+  BufferPool& _pool;
+  PageHandle _page;
+  PageId _first;
+  size_t _pages;
+};
+
+// Reads the records of a list of slotted pages in order
+class RecordReader {
+ public:
+  RecordReader(BufferPool& pool, PageId first)
+    : _pool(pool), _next(first), _slot(0) {}
+
+  // Sets record and length to the next record and returns true, or returns
+  // false at the end of the list. The record stays valid until the next
+  // call.
+  bool next(const char *&record, size_t& length) {
+    while (!_page || _slot == SlottedPage(_page.data(), _pool.page_size()).records()) {
+      if (_next == NO_PAGE) {
+	return false;
+      }
+      _page = _pool.fetch(_next);
+      _next = SlottedPage(_page.data(), _pool.page_size()).next();
+      _slot = 0;
+    }
+    SlottedPage page(_page.data(), _pool.page_size());
+    record = page.record(_slot);
+    length = page.record_length(_slot);
+    ++_slot;
+    return true;
+  }
+ private:
+  BufferPool& _pool;
+  PageHandle _page;
+  PageId _next;
+  size_t _slot;
+};
+
+// Writes bytes to a run of newly allocated pages and returns it
+Extent write_extent(BufferPool& pool, const char *data, size_t bytes) {
+  size_t page_size = pool.page_size();
+  Extent extent{NO_PAGE, (bytes + page_size - 1) / page_size};
+  if (extent.pages == 0) {
+    return extent;
+  }
+  PageHandle page = pool.allocate(extent.pages);
+  extent.first = page.id();
+  for (size_t i = 0; i < extent.pages; ++i) {
+    if (i > 0) {
+      page = pool.fetch(extent.first + i);
+      page.mark_dirty();
+    }
+    size_t n = std::min(page_size, bytes - i * page_size);
+    std::memcpy(page.data(), data + i * page_size, n);
+  }
+  return extent;
+}
+
+// Reads bytes bytes from a run of pages written by write_extent()
+void read_extent(BufferPool& pool, const Extent& extent, char *data, size_t bytes) {
+  size_t page_size = pool.page_size();
+  pool.prefetch(extent.first, extent.pages);
+  for (size_t i = 0; i < extent.pages; ++i) {
+    PageHandle page = pool.fetch(extent.first + i);
+    size_t n = std::min(page_size, bytes - i * page_size);
+    std::memcpy(data + i * page_size, page.data(), n);
+  }
+}
+
+// Writes the strings of column to a list of slotted pages, and returns the
+// first. Strings too long for a page are written to an extent of their
+// own, and their record says where.
+PageId write_strings(BufferPool& pool, const ColumnChunk& column) {
+  RecordWriter writer(pool);
+  size_t limit = SlottedPage::capacity(pool.page_size()) - 1;
+  string record;
+  for (size_t row = 0; row < column.size(); ++row) {
+    record.clear();
+    size_t length = column.string_length(row);
+    if (length <= limit) {
+      record += INLINE_STRING;
+      record.append(column.string_data(row), length);
+    } else {
+      Extent extent = write_extent(pool, column.string_data(row), length);
+      record += OVERFLOW_STRING;
+      put(record, extent);
+      put(record, static_cast<uint64_t>(length));
+    }
+    writer.write(record);
+  }
+  return writer.first();
+}
+
+// Reads the strings written by write_strings() into strings, one per row
+void read_strings(BufferPool& pool, PageId first, vector<string>& strings) {
+  RecordReader reader(pool, first);
+  const char *record;
+  size_t length;
+  while (reader.next(record, length)) {
+    if (record[0] == INLINE_STRING) {
+      strings.push_back(string(record + 1, length - 1));
+      continue;
+    }
+    ++record;
+    Extent extent = get<Extent>(record);
+    string s(get<uint64_t>(record), '\0');
+    read_extent(pool, extent, &s[0], s.size());
+    strings.push_back(s);
+  }
+}
+
+// Writes the directory of table, whose chunks were written where saved
+// says, and returns its first page
+PageId write_directory(BufferPool& pool, const Table& table, const vector<SavedChunk>& saved) {
+  const Schema& schema = table.schema();
+  RecordWriter directory(pool);
+  string record(1, TABLE_RECORD);
+  put(record, static_cast<uint64_t>(table.chunk_rows()));
+  record += table.name();
+  directory.write(record);
+  for (size_t i = 0; i < schema.size(); ++i) {
+    const ColumnSchema& column = schema.column(i);
+    record.assign(1, COLUMN_RECORD);
+    put(record, static_cast<uint8_t>(column.type));
+    put(record, static_cast<uint8_t>(column.nullable));
+    put(record, static_cast<int32_t>(column.length));
+    if (column.dictionary) {
+      put(record, static_cast<uint32_t>(column.dictionary->size()));
+      for (size_t m = 0; m < column.dictionary->size(); ++m) {
+	put(record, static_cast<uint32_t>(column.dictionary->member(m).size()));
+	record += column.dictionary->member(m);
+      }
+    }
+    record += column.name;
+    directory.write(record);
+  }
+  if (!schema.primary_key().empty()) {
+    record.assign(1, KEY_RECORD);
+    for (auto it = schema.primary_key().begin(); it != schema.primary_key().end(); ++it) {
+      put(record, static_cast<uint32_t>(*it));
+    }
+    directory.write(record);
+  }
+  for (auto chunk = saved.begin(); chunk != saved.end(); ++chunk) {
+    for (auto it = chunk->columns.begin(); it != chunk->columns.end(); ++it) {
+      record.assign(1, EXTENT_RECORD);
+      put(record, *it);
+      directory.write(record);
+    }
+  }
+  for (size_t c = 0; c < saved.size(); ++c) {
+    if (saved[c].deleted.pages == 0) {
+      continue;
+    }
+    record.assign(1, DELETED_RECORD);
+    put(record, static_cast<uint32_t>(c));
+    put(record, saved[c].deleted);
+    directory.write(record);
+  }
+  for (auto it = table.indexes().begin(); it != table.indexes().end(); ++it) {
+    const SecondaryIndex& index = **it;
+    record.assign(1, INDEX_RECORD);
+    put(record, static_cast<uint8_t>(index.kind()));
+    put(record, static_cast<uint32_t>(index.columns().size()));
+    for (auto column = index.columns().begin(); column != index.columns().end(); ++column) {
+      put(record, static_cast<uint32_t>(*column));
+    }
+    record += index.name();
+    directory.write(record);
+  }
+  return directory.first();
+}
+
+// Reads the count values of a column written where extent says into out,
+// one every stride values. Strings are read into strings, which the values
+// refer to, and ENUM and SET values are their members.
+void read_column(BufferPool& pool, const ColumnSchema& column, const ColumnExtent& extent,
+		 size_t count, vector<string>& strings, Value *out, size_t stride) {
+  PhysicalType type = physical_type(column.type);
+  vector<uint64_t> validity((count + 63) / 64, ~uint64_t(0));
+  if (column.nullable) {
+    read_extent(pool, extent.validity, reinterpret_cast<char*>(validity.data()),
+		validity.size() * sizeof(uint64_t));
+  }
+  strings.clear();
+  if (type == PhysicalType::STRING) {
+    read_strings(pool, extent.values.first, strings);
+  }
+  // ENUM codes are bytes, and other fixed-width values words
+  const size_t bytes = type == PhysicalType::STRING ? 0 : count * physical_width(type);
+  vector<uint64_t> raw((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  read_extent(pool, extent.values, reinterpret_cast<char*>(raw.data()), bytes);
+  for (size_t row = 0; row < count; ++row, out += stride) {
+    if (!bit_is_set(validity.data(), row)) {
+      *out = Value();
+      continue;
+    }
+    switch (type) {
+    case PhysicalType::INT64:
+      *out = Value(static_cast<long long>(raw[row]));
+      break;
+    case PhysicalType::UINT64:
+      *out = Value(static_cast<unsigned long long>(raw[row]));
+      break;
+    case PhysicalType::DOUBLE: {
+      double d;
+      std::memcpy(&d, &raw[row], sizeof(d));
+      *out = Value(d);
+      break;
+    }
+    case PhysicalType::STRING:
+      *out = Value(strings[row].data(), strings[row].size());
+      break;
+    case PhysicalType::ENUM: {
+      const string& member =
+	column.dictionary->member(reinterpret_cast<const uint8_t*>(raw.data())[row] - 1);
+      *out = Value(member.data(), member.size());
+      break;
+    }
+    case PhysicalType::SET:
+      *out = column.dictionary->set_value(raw[row]);
+      break;
+    }
+  }
+}
+
+// Reads the bitmap of deleted rows of a chunk of count rows, which is all
+// zeroes if extent has no pages
+vector<uint64_t> read_deleted(BufferPool& pool, const Extent& extent, size_t count) {
+  vector<uint64_t> deleted((count + 63) / 64, 0);
+  if (extent.pages > 0) {
+    read_extent(pool, extent, reinterpret_cast<char*>(deleted.data()),
+		deleted.size() * sizeof(uint64_t));
+  }
+  return deleted;
+}
+
+}  // namespace
+
+// Writes every column of chunk, the index-th of its table, and the bitmap
+// of its deleted rows to new pages, and returns where. Pages are left
+// dirty in the pool.
+SavedChunk write_chunk(BufferPool& pool, const Chunk& chunk, size_t index) {
+  SavedChunk saved{vector<ColumnExtent>(), Extent{NO_PAGE, 0}};
+  for (size_t i = 0; i < chunk.columns(); ++i) {
+    const ColumnChunk& column = chunk.column(i);
+    ColumnExtent extent{static_cast<uint32_t>(index), static_cast<uint32_t>(i), column.size(),
+			{NO_PAGE, 0}, {NO_PAGE, 0}};
+    if (column.type() == PhysicalType::STRING) {
+      extent.values.first = write_strings(pool, column);
+    } else if (column.encoded()) {
+      // Written plain, and encoded again when the chunk is read
+      vector<uint64_t> values(column.size());
+      column.decode(0, column.size(), values.data());
+      extent.values = write_extent(pool, reinterpret_cast<const char*>(values.data()),
+				   column.size() * sizeof(uint64_t));
+    } else {
+      const char *values = column.type() == PhysicalType::ENUM
+	? reinterpret_cast<const char*>(column.values<uint8_t>())
+	: reinterpret_cast<const char*>(column.values<uint64_t>());
+      extent.values = write_extent(pool, values, column.size() * physical_width(column.type()));
+    }
+    if (column.validity()) {
+      extent.validity = write_extent(pool, reinterpret_cast<const char*>(column.validity()),
+				     (column.size() + 63) / 64 * sizeof(uint64_t));
+    }
+    saved.columns.push_back(extent);
+  }
+  // The deleted rows, written as a bitmap like validity
+  if (chunk.deleted_rows() > 0) {
+    vector<uint64_t> bitmap((chunk.size() + 63) / 64, 0);
+    for (size_t row = 0; row < chunk.size(); ++row) {
+      if (chunk.is_deleted(row)) {
+	bitmap[row / 64] |= uint64_t(1) << (row % 64);
+      }
+    }
+    saved.deleted = write_extent(pool, reinterpret_cast<const char*>(bitmap.data()),
+				 bitmap.size() * sizeof(uint64_t));
+  }
+  return saved;
+}
+
+// Reads back a chunk of a table with the given schema and chunk size,
+// written where saved says, with its deleted rows. A full chunk is sealed
+// again.
+unique_ptr<Chunk> read_chunk(BufferPool& pool, const Schema& schema, size_t chunk_rows,
+			     const SavedChunk& saved) {
+  unique_ptr<Chunk> chunk(new Chunk(schema));
+  const size_t count = saved.columns.empty() ? 0 : saved.columns.front().rows;
+  vector<Value> values(count);
+  vector<string> strings;
+  for (size_t i = 0; i < schema.size(); ++i) {
+    read_column(pool, schema.column(i), saved.columns[i], count, strings, values.data(), 1);
+    ColumnChunk& column = chunk->column(i);
+    column.reserve(count);
+    column.append(values.data(), count, 1);
+  }
+  if (count == chunk_rows) {
+    chunk->seal();
+  }
+  const vector<uint64_t> deleted = read_deleted(pool, saved.deleted, count);
+  for (size_t word = 0; word < deleted.size(); ++word) {
+    for (uint64_t bits = deleted[word]; bits != 0; bits &= bits - 1) {
+      chunk->erase(word * 64 + __builtin_ctzll(bits));
+    }
+  }
+  chunk->summarize_zones();
+  return chunk;
+}
+
+// Writes table to the pool's file and returns the first page of its
+// directory. Pages are left dirty in the pool; flush it to persist them. A
+// table kept in a store whose pool this is only writes the chunks changed
+// since they were last written.
+PageId save_table(BufferPool& pool, const Table& table) {
+  vector<SavedChunk> saved;
+  if (table.paged() && &table.paged()->store().pool() == &pool) {
+    saved = table.paged()->save();
+  } else {
+    for (size_t c = 0; c < table.chunk_count(); ++c) {
+      ChunkHandle chunk = table.pin(c);
+      saved.push_back(write_chunk(pool, *chunk, c));
+    }
+  }
+  return write_directory(pool, table, saved);
+}
+
+// Reads back the table whose directory starts at the given page into
+// memory, with its indexes, leaving out its deleted rows. Throws a
+// StorageError if the page does not start a table directory.
+unique_ptr<Table> load_table(BufferPool& pool, PageId directory) {
+  TableReader reader(pool, directory);
+  unique_ptr<Table> table(new Table(reader.name(), reader.schema(), reader.chunk_rows()));
+  vector<vector<Value>> rows;
+  while (reader.next(rows)) {
+    table->append(rows);
+  }
+  for (auto it = reader.indexes().begin(); it != reader.indexes().end(); ++it) {
+    table->create_index(it->name, it->kind, it->columns);
+  }
+  return table;
+}
+
+// Writes a database directory listing the tables, each saved with
+// save_table(), and the LSN of the last logged statement they reflect.
+// Returns its first page.
+PageId save_database(BufferPool& pool, const vector<const Table*>& tables, uint64_t lsn) {
+  vector<PageId> directories;
+  for (auto it = tables.begin(); it != tables.end(); ++it) {
+    directories.push_back(save_table(pool, **it));
+  }
+  RecordWriter directory(pool);
+  string record(1, DATABASE_RECORD);
+  put(record, lsn);
+  directory.write(record);
+  for (auto it = directories.begin(); it != directories.end(); ++it) {
+    record.assign(1, SAVED_TABLE_RECORD);
+    put(record, *it);
+    directory.write(record);
+  }
+  return directory.first();
+}
+
+// Reads back into memory the tables of the database directory starting at
+// the given page, and sets lsn to the LSN it was saved with. Throws a
+// StorageError if the page does not start a database directory.
+vector<unique_ptr<Table>> load_database(BufferPool& pool, PageId directory, uint64_t& lsn) {
+  vector<PageId> directories = database_tables(pool, directory, lsn);
+  vector<unique_ptr<Table>> tables;
+  for (auto it = directories.begin(); it != directories.end(); ++it) {
+    tables.push_back(load_table(pool, *it));
+  }
+  return tables;
+}
+
+// Returns the first pages of the directories of the tables listed in the
+// database directory starting at the given page, and sets lsn to the LSN
+// it was saved with. Throws a StorageError if the page does not start a
+// database directory.
+vector<PageId> database_tables(BufferPool& pool, PageId directory, uint64_t& lsn) {
+  RecordReader reader(pool, directory);
+  const char *record;
+  size_t length;
+  if (!reader.next(record, length) || record[0] != DATABASE_RECORD) {
+    throw StorageError("Page " + std::to_string(directory) + " does not start a database");
+  }
+  ++record;
+  lsn = get<uint64_t>(record);
+  vector<PageId> directories;
+  while (reader.next(record, length)) {
+    if (*record++ != SAVED_TABLE_RECORD) {
+      throw StorageError("Corrupt database directory");
+    }
+    directories.push_back(get<PageId>(record));
+  }
+  return directories;
+}
+
+/*------------------------------------------------
+  TableReader methods
+  ----------------------------------------------*/
+
+// Reads the directory of the table saved at the given page. Throws a
+// StorageError if the page does not start a table directory.
+TableReader::TableReader(BufferPool& pool, PageId directory)
+  : _pool(pool), _chunk_rows(0), _next_chunk(0) {
+  RecordReader reader(pool, directory);
+  const char *record;
+  size_t length;
+  if (!reader.next(record, length) || record[0] != TABLE_RECORD) {
+    throw StorageError("Page " + std::to_string(directory) + " does not start a table");
+  }
+  const char *end = record + length;
+  ++record;
+  _chunk_rows = get<uint64_t>(record);
+  _name.assign(record, end);
+
+  while (reader.next(record, length)) {
+    end = record + length;
+    switch (*record++) {
+    case COLUMN_RECORD: {
+      Datatype type = static_cast<Datatype>(get<uint8_t>(record));
+      bool nullable = get<uint8_t>(record) != 0;
+      int column_length = get<int32_t>(record);
+      vector<string> members(type == Datatype::ENUM_T || type == Datatype::SET_T
+			     ? get<uint32_t>(record) : 0);
+      for (auto it = members.begin(); it != members.end(); ++it) {
+	size_t member_length = get<uint32_t>(record);
+	it->assign(record, member_length);
+	record += member_length;
+      }
+      ColumnSchema column{string(), type, column_length, nullable};
+      if (!members.empty()) {
+	column.dictionary.reset(new Dictionary(members));
+      }
+      column.name.assign(record, end);
+      _schema.add_column(column);
+      break;
+    }
+    case KEY_RECORD: {
+      vector<string> key;
+      while (record < end) {
+	key.push_back(_schema.column(get<uint32_t>(record)).name);
+      }
+      _schema.set_primary_key(key);
+      break;
+    }
+    case EXTENT_RECORD:
+      _extents.push_back(get<ColumnExtent>(record));
+      break;
+    case DELETED_RECORD: {
+      size_t chunk = get<uint32_t>(record);
+      if (_deleted.size() <= chunk) {
+	_deleted.resize(chunk + 1, Extent{NO_PAGE, 0});
+      }
+      _deleted[chunk] = get<Extent>(record);
+      break;
+    }
+    case INDEX_RECORD: {
+      SavedIndex index;
+      index.kind = static_cast<IndexKind>(get<uint8_t>(record));
+      size_t columns = get<uint32_t>(record);
+      for (size_t i = 0; i < columns; ++i) {
+	index.columns.push_back(_schema.column(get<uint32_t>(record)).name);
+      }
+      index.name.assign(record, end);
+      _indexes.push_back(index);
+      break;
+    }
+    default:
+      throw StorageError("Corrupt directory for table " + _name);
+    }
+  }
+}
+
+// Returns the name of the table
+const string& TableReader::name() const {
+  return _name;
+}
+
+// Returns the schema of the table
+const Schema& TableReader::schema() const {
+  return _schema;
+}
+
+// Returns the number of rows per chunk the table was saved with
+size_t TableReader::chunk_rows() const {
+  return _chunk_rows;
+}
+
+// Returns the indexes the table had when it was saved
+const vector<SavedIndex>& TableReader::indexes() const {
+  return _indexes;
+}
+
+// Returns the number of chunks the table was saved with
+size_t TableReader::chunks() const {
+  return _schema.size() == 0 ? 0 : _extents.size() / _schema.size();
+}
+
+// Returns where the given chunk was written
+SavedChunk TableReader::saved_chunk(size_t chunk) const {
+  // Extents are in chunk order, with every column of a chunk together
+  auto first = _extents.begin() + chunk * _schema.size();
+  return SavedChunk{vector<ColumnExtent>(first, first + _schema.size()),
+		    chunk < _deleted.size() ? _deleted[chunk] : Extent{NO_PAGE, 0}};
+}
+
+// Returns the number of deleted rows in the given chunk, reading only the
+// bitmap of its deleted rows
+size_t TableReader::deleted_rows(size_t chunk) const {
+  if (chunk >= _deleted.size() || _deleted[chunk].pages == 0) {
+    return 0;
+  }
+  const vector<uint64_t> deleted =
+    read_deleted(_pool, _deleted[chunk], _extents[chunk * _schema.size()].rows);
+  size_t count = 0;
+  for (auto it = deleted.begin(); it != deleted.end(); ++it) {
+    count += __builtin_popcountll(*it);
+  }
+  return count;
+}
+
+// Reads back the given chunk whole, deleted rows included
+unique_ptr<Chunk> TableReader::read_chunk(size_t chunk) const {
+  return ::read_chunk(_pool, _schema, _chunk_rows, saved_chunk(chunk));
+}
+
+// Replaces rows with the live rows of the next saved chunk and returns
+// true, or returns false once every chunk has been read. String values
+// refer to memory held by the reader, and are only valid until the next
+// call.
+bool TableReader::next(vector<vector<Value>>& rows) {
+  if (_next_chunk >= chunks()) {
+    return false;
+  }
+  const SavedChunk saved = saved_chunk(_next_chunk++);
+  const size_t count = saved.columns.front().rows;
+  const vector<uint64_t> deleted = read_deleted(_pool, saved.deleted, count);
+  const size_t width = _schema.size();
+  vector<Value> values(count * width);
+  _strings.assign(width, vector<string>());
+  for (size_t i = 0; i < width; ++i) {
+    read_column(_pool, _schema.column(i), saved.columns[i], count, _strings[i], &values[i], width);
+  }
+  rows.clear();
+  for (size_t row = 0; row < count; ++row) {
+    if (!bit_is_set(deleted.data(), row)) {
+      rows.push_back(vector<Value>(values.begin() + row * width,
+				   values.begin() + (row + 1) * width));
+    }
+  }
+  return true;
+}
+
+/*------------------------------------------------
+  TableStore methods
+  ----------------------------------------------*/
+
+namespace {
+
+// The fewest frames a store's buffer pool has, whatever its budget
+const size_t MIN_POOL_FRAMES = 64;
+
+}  // namespace
+
+const size_t TableStore::POOL_SHARE;
+
+// Creates a store for the tables of file, which keeps them in up to
+// memory_budget bytes: a share of it is the buffer pool's, and the rest
+// holds chunks
+TableStore::TableStore(PageFile& file, size_t memory_budget)
+  : _file(file),
+    _pool(file, std::max(memory_budget / POOL_SHARE, MIN_POOL_FRAMES * file.page_size())),
+    _chunk_budget(memory_budget - memory_budget / POOL_SHARE), _hand(0), _resident_bytes(0),
+    _chunks_read(0), _chunks_written(0), _statement(1) {}
+
+// The tables kept in the store must be destroyed first
+TableStore::~TableStore() {}
+
+PageFile& TableStore::file() const {
+  return _file;
+}
+
+BufferPool& TableStore::pool() {
+  return _pool;
+}
+
+// Returns the most bytes of chunks the store keeps in memory once no
+// statement needs more
+size_t TableStore::chunk_budget() const {
+  return _chunk_budget;
+}
+
+// Returns the bytes of the chunks in memory
+size_t TableStore::resident_bytes() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _resident_bytes;
+}
+
+// Returns the number of chunks read back from the file
+size_t TableStore::chunks_read() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _chunks_read;
+}
+
+// Returns the number of changed chunks written to the file
+size_t TableStore::chunks_written() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _chunks_written;
+}
+
+// Returns the tables of the database saved in the file, kept in the store,
+// with their indexes, and sets lsn to the LSN they were saved with. Only
+// the chunks of tables with indexes are read, to fill the indexes, and
+// they are paged out again as the budget requires. A file nothing was
+// saved to has no tables, and an LSN of 0. Throws a StorageError if the
+// file is corrupt.
+vector<unique_ptr<Table>> TableStore::open(uint64_t& lsn) {
+  vector<unique_ptr<Table>> tables;
+  lsn = 0;
+  if (_file.root() == NO_PAGE) {
+    return tables;
+  }
+  vector<PageId> directories = database_tables(_pool, _file.root(), lsn);
+  for (auto it = directories.begin(); it != directories.end(); ++it) {
+    TableReader reader(_pool, *it);
+    unique_ptr<Table> table(new Table(reader.name(), reader.schema(), reader.chunk_rows()));
+    table->_paged.reset(new PagedTable(*this, *table));
+    for (size_t c = 0; c < reader.chunks(); ++c) {
+      SavedChunk saved = reader.saved_chunk(c);
+      table->_chunks.push_back(nullptr);
+      table->_rows += saved.columns.front().rows;
+      table->_deleted_rows += reader.deleted_rows(c);
+      table->_paged->add_saved(saved);
+    }
+    for (auto index = reader.indexes().begin(); index != reader.indexes().end(); ++index) {
+      vector<size_t> columns;
+      for (auto column = index->columns.begin(); column != index->columns.end(); ++column) {
+	columns.push_back(table->_schema.index_of(*column));
+      }
+      table->_indexes.push_back(unique_ptr<SecondaryIndex>(
+	  new SecondaryIndex(index->name, index->kind, columns)));
+    }
+    table->index_saved_rows();
+    tables.push_back(std::move(table));
+  }
+  return tables;
+}
+
+// Keeps table, which holds every chunk in memory, in the store from now
+// on. Its chunks are written to the file once they are paged out or the
+// database is saved.
+void TableStore::keep(Table& table) {
+  table._paged.reset(new PagedTable(*this, table));
+  for (size_t c = 0; c < table._chunks.size(); ++c) {
+    table._paged->change(c);
+    table._paged->changed(c);
+  }
+}
+
+// Writes the chunks of the tables changed since they were last written,
+// and their directories, then makes a database directory listing them, with
+// the LSN of the last logged statement they reflect, the root of the file.
+// The root only changes once every page has reached the disk, so a failed
+// save leaves the database saved before intact. Throws a StorageError if
+// the file cannot be written.
+void TableStore::save(const vector<const Table*>& tables, uint64_t lsn) {
+  PageId root = save_database(_pool, tables, lsn);
+  _pool.flush_all();
+  _file.sync();
+  _file.set_root(root);
+  _file.sync();
+}
+
+// Starts a statement, letting the chunks the last one read be paged out
+void TableStore::begin_statement() {
+  _statement.fetch_add(1, std::memory_order_release);
+  std::lock_guard<std::mutex> lock(_mutex);
+  make_room();
+}
+
+// Adds a chunk read into memory, of the given size, to the chunks the
+// CLOCK hand passes. The mutex must be held.
+void TableStore::add_resident(PagedTable& table, size_t chunk, size_t bytes) {
+  table._slots[chunk].position = _resident.size();
+  _resident.push_back(Resident{&table, chunk});
+  _resident_bytes += bytes;
+}
+
+// Removes a chunk from the chunks in memory. The mutex must be held.
+void TableStore::remove_resident(PagedTable& table, size_t chunk) {
+  PagedTable::Slot& slot = table._slots[chunk];
+  const Resident last = _resident.back();
+  _resident[slot.position] = last;
+  last.table->_slots[last.chunk].position = slot.position;
+  _resident.pop_back();
+  _resident_bytes -= slot.bytes;
+}
+
+// Pages out chunks until the chunks in memory fit the budget, or none is
+// left that may be paged out. The hand skips chunks used since it last
+// passed them, and clears their bits, so two sweeps find a chunk unless
+// none can go. The mutex must be held.
+void TableStore::make_room() {
+  size_t passed = 0;
+  while (_resident_bytes > _chunk_budget && passed < 2 * _resident.size()) {
+    if (_hand >= _resident.size()) {
+      _hand = 0;
+    }
+    const Resident resident = _resident[_hand];
+    PagedTable::Slot& slot = resident.table->_slots[resident.chunk];
+    if (!resident.table->evictable(resident.chunk)) {
+      ++_hand;
+      ++passed;
+    } else if (slot.referenced) {
+      slot.referenced = false;
+      ++_hand;
+      ++passed;
+    } else {
+      // The last chunk in memory takes its place under the hand
+      resident.table->page_out(resident.chunk);
+      passed = 0;
+    }
+  }
+}
+
+/*------------------------------------------------
+  PagedTable methods
+  ----------------------------------------------*/
+
+PagedTable::Slot::Slot()
+  : saved{vector<ColumnExtent>(), Extent{NO_PAGE, 0}}, dirty(false), reading(false),
+    referenced(false), pins(0), bytes(0), position(0), held(0) {}
+
+// Creates the paging state of table, kept in store, with no chunks
+PagedTable::PagedTable(TableStore& store, Table& table) : _store(store), _table(table) {}
+
+// Takes the chunks of the table out of the store's chunks in memory
+PagedTable::~PagedTable() {
+  std::lock_guard<std::mutex> lock(_store._mutex);
+  for (size_t c = 0; c < _slots.size(); ++c) {
+    if (_table._chunks[c]) {
+      _store.remove_resident(*this, c);
+    }
+  }
+}
+
+// Returns the store the table is kept in
+TableStore& PagedTable::store() const {
+  return _store;
+}
+
+// Returns a chunk, read back if it is paged out, and keeps it in memory
+// until the next statement begins. Returns at once for a chunk already
+// held for the current statement.
+const Chunk& PagedTable::hold(size_t chunk) {
+  Slot& slot = _slots[chunk];
+  const uint64_t statement = _store._statement.load(std::memory_order_acquire);
+  if (slot.held.load(std::memory_order_acquire) == statement) {
+    return *_table._chunks[chunk];
+  }
+  std::unique_lock<std::mutex> lock(_store._mutex);
+  const Chunk& held = resident(chunk, lock);
+  slot.held.store(statement, std::memory_order_release);
+  _store.make_room();
+  return held;
+}
+
+// Returns a chunk, read back if it is paged out, and keeps it in memory
+// until it is unpinned as often as it was pinned
+const Chunk& PagedTable::pin(size_t chunk) {
+  std::unique_lock<std::mutex> lock(_store._mutex);
+  const Chunk& pinned = resident(chunk, lock);
+  ++_slots[chunk].pins;
+  _store.make_room();
+  return pinned;
+}
+
+// Gives up a pin on a chunk, which may then be paged out
+void PagedTable::unpin(size_t chunk) {
+  std::lock_guard<std::mutex> lock(_store._mutex);
+  --_slots[chunk].pins;
+  _store.make_room();
+}
+
+// Returns a chunk to be changed, read back if it is paged out, pinned and
+// marked dirty. A chunk just added to the end of the table gets a slot.
+Chunk& PagedTable::change(size_t chunk) {
+  std::unique_lock<std::mutex> lock(_store._mutex);
+  if (chunk == _slots.size()) {
+    _slots.emplace_back();
+    _slots.back().bytes = _table._chunks[chunk]->bytes();
+    _store.add_resident(*this, chunk, _slots.back().bytes);
+  }
+  Chunk& changed = resident(chunk, lock);
+  Slot& slot = _slots[chunk];
+  ++slot.pins;
+  slot.dirty = true;
+  return changed;
+}
+
+// Unpins a chunk returned by change(), once it has been changed, and
+// counts its memory again
+void PagedTable::changed(size_t chunk) {
+  std::lock_guard<std::mutex> lock(_store._mutex);
+  Slot& slot = _slots[chunk];
+  const size_t bytes = _table._chunks[chunk]->bytes();
+  _store._resident_bytes += bytes - slot.bytes;
+  slot.bytes = bytes;
+  --slot.pins;
+  _store.make_room();
+}
+
+// Adds a chunk, paged out, that was saved where saved says
+void PagedTable::add_saved(const SavedChunk& saved) {
+  _slots.emplace_back();
+  _slots.back().saved = saved;
+}
+
+// Writes the chunks changed since they were last written to the store's
+// pool, and returns where every chunk was written
+vector<SavedChunk> PagedTable::save() {
+  std::lock_guard<std::mutex> lock(_store._mutex);
+  vector<SavedChunk> saved;
+  for (size_t c = 0; c < _slots.size(); ++c) {
+    Slot& slot = _slots[c];
+    if (slot.dirty) {
+      slot.saved = write_chunk(_store._pool, *_table._chunks[c], c);
+      slot.dirty = false;
+      ++_store._chunks_written;
+    }
+    saved.push_back(slot.saved);
+  }
+  return saved;
+}
+
+// Returns a chunk, read back through the store's pool if it is paged out,
+// and marks it used. Reads without holding lock, the store's mutex, so
+// that chunks are read in parallel, and waits for a chunk another thread
+// is reading.
+Chunk& PagedTable::resident(size_t chunk, std::unique_lock<std::mutex>& lock) {
+  Slot& slot = _slots[chunk];
+  while (slot.reading) {
+    _store._read.wait(lock);
+  }
+  if (!_table._chunks[chunk]) {
+    slot.reading = true;
+    const SavedChunk saved = slot.saved;
+    lock.unlock();
+    unique_ptr<Chunk> read;
+    try {
+      read = read_chunk(_store._pool, _table._schema, _table._chunk_rows, saved);
+    } catch (...) {
+      lock.lock();
+      slot.reading = false;
+      _store._read.notify_all();
+      throw;
+    }
+    lock.lock();
+    slot.reading = false;
+    slot.bytes = read->bytes();
+    _table._chunks[chunk] = std::move(read);
+    _store.add_resident(*this, chunk, slot.bytes);
+    ++_store._chunks_read;
+    _store._read.notify_all();
+  }
+  slot.referenced = true;
+  return *_table._chunks[chunk];
+}
+
+// Returns true if a chunk in memory may be paged out: it is not pinned,
+// being read, or held for the current statement. The mutex must be held.
+bool PagedTable::evictable(size_t chunk) const {
+  const Slot& slot = _slots[chunk];
+  return slot.pins == 0 && !slot.reading &&
+    slot.held.load(std::memory_order_relaxed) != _store._statement.load(std::memory_order_relaxed);
+}
+
+// Pages out a chunk, writing it to new pages first if it changed since it
+// was last written. The mutex must be held.
+void PagedTable::page_out(size_t chunk) {
+  Slot& slot = _slots[chunk];
+  if (slot.dirty) {
+    slot.saved = write_chunk(_store._pool, *_table._chunks[chunk], chunk);
+    slot.dirty = false;
+    ++_store._chunks_written;
+  }
+  _store.remove_resident(*this, chunk);
+  _table._chunks[chunk].reset();
+}
@@ -0,0 +1,216 @@
+// SimpleSQL: Tables in page files
+//
+// Saves tables to a page file through a buffer pool, and reads them back.
+// Each column of each chunk is written separately: fixed-width values and
+// validity bitmaps as runs of consecutive pages holding the raw arrays,
+// and strings as records in a list of slotted pages, one record per row. A
+// directory, itself a list of slotted pages, records the schema and where
+// every column of every chunk was written, which rows of each chunk are
+// deleted, and the indexes of the table. The first page of the directory
+// identifies the table.
+//
+// A saved table can be read back one chunk at a time, so a scan of it
+// holds a single chunk in memory and reads the rest through the buffer
+// pool.
+//
+// A database directory lists the saved tables of a database, with the LSN
+// of the last logged statement they reflect.
+//
+// A table store keeps the tables of a database in a page file while they
+// are used. Their chunks are read through the store's buffer pool when
+// they are first read, and paged out again, by CLOCK, once the chunks in
+// memory outgrow the store's memory budget. A chunk changed since it was
+// last written is written to new pages before it is paged out, and saving
+// the database only writes those chunks and the directories, then makes
+// the new database directory the file's root. Pages a chunk was written to
+// before are not reused.
+//
+// Values read from a chunk refer to its memory, so every chunk a statement
+// reads with Table::chunk() or Table::value() stays in memory until the
+// next statement begins. Scans pin each chunk only while they filter it,
+// so the chunks they find no rows in can be paged out as the scan goes.
+
+#ifndef __TABLE_FILE_H__
+#define __TABLE_FILE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "buffer_pool.h"
+#include "table.h"
+
+PageId save_table(BufferPool& pool, const Table& table);
+std::unique_ptr<Table> load_table(BufferPool& pool, PageId directory);
+PageId save_database(BufferPool& pool, const std::vector<const Table*>& tables,
+		     std::uint64_t lsn);
+std::vector<std::unique_ptr<Table>> load_database(BufferPool& pool, PageId directory,
+						  std::uint64_t& lsn);
+std::vector<PageId> database_tables(BufferPool& pool, PageId directory, std::uint64_t& lsn);
+
+// A run of consecutive pages
+struct Extent {
+  std::uint64_t first;
+  std::uint64_t pages;
+};
+
+// Where one column of one chunk was written. The values of string columns
+// are a list of slotted pages starting at values.first.
+struct ColumnExtent {
+  std::uint32_t chunk;
+  std::uint32_t column;
+  std::uint64_t rows;
+  Extent values;
+  Extent validity;
+};
+
+// Where every column of one chunk was written, in column order, and the
+// bitmap of its deleted rows, which has no pages if none are
+struct SavedChunk {
+  std::vector<ColumnExtent> columns;
+  Extent deleted;
+};
+
+SavedChunk write_chunk(BufferPool& pool, const Chunk& chunk, std::size_t index);
+std::unique_ptr<Chunk> read_chunk(BufferPool& pool, const Schema& schema,
+				  std::size_t chunk_rows, const SavedChunk& saved);
+
+// An index recorded in a table directory
+struct SavedIndex {
+  std::string name;
+  IndexKind kind;
+  std::vector<std::string> columns;
+};
+
+// Reads a saved table: the live rows of one chunk at a time, or any chunk
+// whole. The pages of each column are prefetched before they are read.
+class TableReader {
+ public:
+  TableReader(BufferPool& pool, PageId directory);
+  const std::string& name() const;
+  const Schema& schema() const;
+  std::size_t chunk_rows() const;
+  const std::vector<SavedIndex>& indexes() const;
+  std::size_t chunks() const;
+  SavedChunk saved_chunk(std::size_t chunk) const;
+  std::size_t deleted_rows(std::size_t chunk) const;
+  std::unique_ptr<Chunk> read_chunk(std::size_t chunk) const;
+  bool next(std::vector<std::vector<Value>>& rows);
+ private:
+  TableReader(const TableReader&) = delete;
+  TableReader& operator=(const TableReader&) = delete;
+
+  BufferPool& _pool;
+  std::string _name;
+  Schema _schema;
+  std::size_t _chunk_rows;
+  std::vector<SavedIndex> _indexes;
+  std::vector<ColumnExtent> _extents;
+  // The bitmap of deleted rows of every chunk, with no pages for chunks
+  // without deleted rows
+  std::vector<Extent> _deleted;
+  std::size_t _next_chunk;
+  // The strings of the chunk last read, which its rows refer to
+  std::vector<std::vector<std::string>> _strings;
+};
+
+// Keeps tables in a page file, with their chunks in memory only while they
+// are used, up to a memory budget (see above)
+class TableStore {
+ public:
+  TableStore(PageFile& file, std::size_t memory_budget);
+  ~TableStore();
+  PageFile& file() const;
+  BufferPool& pool();
+  std::size_t chunk_budget() const;
+  std::size_t resident_bytes() const;
+  std::size_t chunks_read() const;
+  std::size_t chunks_written() const;
+  std::vector<std::unique_ptr<Table>> open(std::uint64_t& lsn);
+  void keep(Table& table);
+  void save(const std::vector<const Table*>& tables, std::uint64_t lsn);
+  void begin_statement();
+
+  // The share of the memory budget the buffer pool caches pages in
+  static const std::size_t POOL_SHARE = 4;
+ private:
+  friend class PagedTable;
+  TableStore(const TableStore&) = delete;
+  TableStore& operator=(const TableStore&) = delete;
+  // A chunk in memory, in the order the CLOCK hand passes them
+  struct Resident {
+    PagedTable *table;
+    std::size_t chunk;
+  };
+  void add_resident(PagedTable& table, std::size_t chunk, std::size_t bytes);
+  void remove_resident(PagedTable& table, std::size_t chunk);
+  void make_room();
+
+  PageFile& _file;
+  BufferPool _pool;
+  // The most bytes of chunks kept in memory
+  const std::size_t _chunk_budget;
+  // Guards the paging state of every table in the store
+  mutable std::mutex _mutex;
+  // Signalled whenever a chunk has been read
+  std::condition_variable _read;
+  std::vector<Resident> _resident;
+  std::size_t _hand;
+  std::size_t _resident_bytes;
+  std::size_t _chunks_read;
+  std::size_t _chunks_written;
+  // Counts the statements begun. A chunk read during the current one stays
+  // in memory.
+  std::atomic<std::uint64_t> _statement;
+};
+
+// The chunks of a table kept in a table store: where each was last
+// written, and whether it is in memory, changed or in use. Every chunk
+// changed since it was last written is in memory.
+class PagedTable {
+ public:
+  PagedTable(TableStore& store, Table& table);
+  ~PagedTable();
+  TableStore& store() const;
+  const Chunk& hold(std::size_t chunk);
+  const Chunk& pin(std::size_t chunk);
+  void unpin(std::size_t chunk);
+  Chunk& change(std::size_t chunk);
+  void changed(std::size_t chunk);
+  void add_saved(const SavedChunk& saved);
+  std::vector<SavedChunk> save();
+ private:
+  friend class TableStore;
+  PagedTable(const PagedTable&) = delete;
+  PagedTable& operator=(const PagedTable&) = delete;
+  struct Slot {
+    Slot();
+    // Where the chunk was last written, unless it is dirty
+    SavedChunk saved;
+    bool dirty;
+    bool reading;
+    // CLOCK: set when the chunk is used, cleared as the hand passes
+    bool referenced;
+    std::size_t pins;
+    std::size_t bytes;
+    // Where the chunk is in the store's resident chunks, if it is in memory
+    std::size_t position;
+    // The last statement the chunk was held for
+    std::atomic<std::uint64_t> held;
+  };
+  Chunk& resident(std::size_t chunk, std::unique_lock<std::mutex>& lock);
+  bool evictable(std::size_t chunk) const;
+  void page_out(std::size_t chunk);
+
+  TableStore& _store;
+  Table& _table;
+  // A slot for every chunk of the table. Slots never move, so a slot's
+  // statement can be checked without the store's mutex.
+  std::deque<Slot> _slots;
+};
+
+#endif  // __TABLE_FILE_H__
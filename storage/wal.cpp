@@ -0,0 +1,508 @@
+// SimpleSQL: Write-ahead log
+//
+// The log is a sequence of records, each a header giving the length and
+// CRC-32 of its body, then the body: the record's LSN and its encoded
+// tokens. A crash while a batch is being written can leave a torn record
+// at the end of the log; opening the log cuts it off at the last record
+// whose checksum matches. Integers are written in native byte order.
+
+#include "wal.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../AST/visitor.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+using std::uint8_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::unique_lock;
+using std::lock_guard;
+using std::mutex;
+using std::chrono::steady_clock;
+
+namespace {
+
+static_assert(Tokens::ERROR < 256, "Token types must fit in a byte");
+
+// The header of every record
+struct RecordHeader {
+  uint32_t length;
+  uint32_t checksum;
+};
+
+// Logs are read this many bytes at a time
+const size_t READ_SIZE = 1 << 20;
+
+template <typename T>
+void put(string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const char *&in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return value;
+}
+
+// Returns the CRC-32 of the given bytes
+uint32_t crc32(const char *data, size_t length) {
+  static const vector<uint32_t> table = []() {
+    vector<uint32_t> table(256);
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int bit = 0; bit < 8; ++bit) {
+	c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    return table;
+  }();
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < length; ++i) {
+    crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// Throws a StorageError describing the failed system call
+[[noreturn]] void io_error(const string& what, const string& path) {
+  throw StorageError(what + " " + path + ": " + std::strerror(errno));
+}
+
+// Appends the token of the given type to out, followed by text
+void put_text(string& out, Tokens type, const char *text, size_t length) {
+  put(out, static_cast<uint8_t>(type));
+  put(out, static_cast<uint32_t>(length));
+  out.append(text, length);
+}
+
+// Appends a literal token standing for value to out
+void put_value(string& out, const Value& value) {
+  switch (value.type()) {
+  case ValueType::NUL:
+    put(out, static_cast<uint8_t>(Tokens::NUL));
+    break;
+  case ValueType::INT:
+    put(out, static_cast<uint8_t>(Tokens::INTLIT));
+    put(out, value.int_value());
+    break;
+  case ValueType::UINT:
+    put(out, static_cast<uint8_t>(Tokens::UINTLIT));
+    put(out, value.uint_value());
+    break;
+  case ValueType::DOUBLE:
+    put(out, static_cast<uint8_t>(Tokens::DOUBLELIT));
+    put(out, value.double_value());
+    break;
+  case ValueType::STRING:
+    put_text(out, Tokens::STRINGLIT, value.string_data(), value.string_length());
+    break;
+  }
+}
+
+// Appends the encodings of the tokens in [begin, end) to out, replacing
+// placeholders by the values of parameters
+void encode(string& out, const FlatToken *begin, const FlatToken *end,
+	    const vector<Value>& parameters) {
+  size_t next_parameter = 0;
+  for (const FlatToken *it = begin; it != end; ++it) {
+    switch (it->type) {
+    case Tokens::IDENTIFIER:
+    case Tokens::ERROR:
+      put_text(out, it->type, it->text.data, it->text.length);
+      break;
+    case Tokens::STRINGLIT: {
+      string value = string_literal(*it);
+      put_text(out, it->type, value.data(), value.size());
+      break;
+    }
+    case Tokens::INTLIT:
+    case Tokens::UINTLIT:
+    case Tokens::DOUBLELIT:
+      put(out, static_cast<uint8_t>(it->type));
+      put(out, it->literal);
+      break;
+    case Tokens::PLACEHOLDER: {
+      size_t index = it->literal.int_value ? it->literal.int_value - 1 : next_parameter++;
+      if (index >= parameters.size()) {
+	throw StorageError("No value for parameter " + std::to_string(index + 1));
+      }
+      put_value(out, parameters[index]);
+      break;
+    }
+    default:
+      put(out, static_cast<uint8_t>(it->type));
+    }
+  }
+}
+
+// Reads the records of a log file in order
+class LogReader {
+ public:
+  LogReader(int fd, const string& path) : _fd(fd), _path(path), _offset(0), _start(0) {}
+
+  // Sets lsn and body to the next record and returns true, or returns false
+  // at the end of the log or at the first record that is torn or corrupt.
+  // The body stays valid until the next call.
+  bool next(Lsn& lsn, const char *&body, size_t& length) {
+    RecordHeader header;
+    if (!fill(sizeof(header))) {
+      return false;
+    }
+    std::memcpy(&header, _buffer.data() + _start, sizeof(header));
+    if (header.length < sizeof(Lsn) || !fill(sizeof(header) + header.length)) {
+      return false;
+    }
+    const char *data = _buffer.data() + _start + sizeof(header);
+    if (crc32(data, header.length) != header.checksum) {
+      return false;
+    }
+    lsn = get<Lsn>(data);
+    body = data;
+    length = header.length - sizeof(Lsn);
+    _start += sizeof(header) + header.length;
+    _offset += sizeof(header) + header.length;
+    return true;
+  }
+
+  // Returns the offset in the file just past the last record read
+  off_t offset() const {
+    return _offset;
+  }
+ private:
+  // Reads until at least bytes bytes after the current record's start are
+  // buffered. Returns false if the file ends first.
+  bool fill(size_t bytes) {
+    while (_buffer.size() - _start < bytes) {
+      _buffer.erase(0, _start);
+      _start = 0;
+      size_t have = _buffer.size();
+      size_t want = bytes > READ_SIZE ? bytes : READ_SIZE;
+      _buffer.resize(have + want);
+      ssize_t got = ::pread(_fd, &_buffer[have], want, _offset + have);
+      if (got < 0) {
+	io_error("Could not read", _path);
+      }
+      _buffer.resize(have + got);
+      if (got == 0) {
+	return false;
+      }
+    }
+    return true;
+  }
+
+  const int _fd;
+  const string& _path;
+  // Offset in the file of the current record
+  off_t _offset;
+  // The current record and any bytes after it that have been read
+  string _buffer;
+  size_t _start;
+};
+
+// Finds whether a statement changes the database
+class ChangeFinder : public Visitor {
+ public:
+  ChangeFinder() : changes(false) {}
+  void visitCreateTable(const CreateTable& node) { changes = true; }
+  void visitDropTable(const DropTable& node) { changes = true; }
+  void visitCreateIndex(const CreateIndex& node) { changes = true; }
+  void visitDropIndex(const DropIndex& node) { changes = true; }
+  void visitInsert(const Insert& node) { changes = true; }
+  void visitDelete(const Delete& node) { changes = true; }
+  void visitUpdate(const Update& node) { changes = true; }
+
+  bool changes;
+};
+
+}  // namespace
+
+// Returns true if statement changes the database, and so must be logged
+// before it is acknowledged. Besides INSERT, UPDATE and DELETE, CREATE
+// and DROP of tables and indexes are logged, since the catalog is not
+// otherwise durable and replaying changes needs the tables they were made
+// to.
+bool is_logged(const ASTNode& statement) {
+  ChangeFinder finder;
+  statement.accept(finder);
+  return finder.changes;
+}
+
+/*------------------------------------------------
+  LogRecord methods
+  ----------------------------------------------*/
+
+// Creates an empty record, to be filled by append()
+LogRecord::LogRecord() {}
+
+// Encodes the statement made of the given tokens. Placeholders are
+// replaced by the values of the parameters they stand for: ? placeholders
+// in order of appearance, and $n placeholders by parameter n. Throws a
+// StorageError if a placeholder has no parameter.
+LogRecord::LogRecord(const FlatToken *begin, const FlatToken *end, const vector<Value>& parameters) {
+  encode(_encoded, begin, end, parameters);
+}
+
+// Wraps a record encoded by another LogRecord
+LogRecord::LogRecord(const string& encoded) : _encoded(encoded) {}
+
+// Appends the encodings of the given tokens, which go on the statement
+// encoded so far, for statements that are read a piece at a time. The
+// tokens may not include placeholders.
+void LogRecord::append(const FlatToken *begin, const FlatToken *end) {
+  encode(_encoded, begin, end, vector<Value>());
+}
+
+const string& LogRecord::encoded() const {
+  return _encoded;
+}
+
+// Replaces the contents of tokens with the statement's tokens, ready to be
+// parsed. Their text refers into the record, so the record must outlive
+// them.
+void LogRecord::tokens(vector<FlatToken>& tokens) const {
+  tokens.clear();
+  const char *it = _encoded.data();
+  const char *end = it + _encoded.size();
+  while (it < end) {
+    FlatToken toke;
+    toke.type = static_cast<Tokens>(get<uint8_t>(it));
+    toke.text.data = "";
+    toke.text.length = 0;
+    toke.literal.int_value = 0;
+    switch (toke.type) {
+    case Tokens::IDENTIFIER:
+    case Tokens::STRINGLIT:
+    case Tokens::ERROR:
+      toke.text.length = get<uint32_t>(it);
+      toke.text.data = it;
+      it += toke.text.length;
+      break;
+    case Tokens::INTLIT:
+    case Tokens::UINTLIT:
+    case Tokens::DOUBLELIT:
+      std::memcpy(&toke.literal, it, sizeof(toke.literal));
+      it += sizeof(toke.literal);
+      break;
+    default:
+      break;
+    }
+    tokens.push_back(toke);
+  }
+}
+
+/*------------------------------------------------
+  WriteAheadLog methods
+  ----------------------------------------------*/
+
+const std::chrono::microseconds WriteAheadLog::DEFAULT_COMMIT_DELAY(100);
+
+// Opens the log at path, creating it if it does not exist, and starts the
+// group-commit thread. A torn record at the end of the log is removed.
+// Throws a StorageError if the file cannot be opened.
+WriteAheadLog::WriteAheadLog(const string& path, std::chrono::microseconds commit_delay,
+			     size_t batch_size)
+  : _path(path), _fd(-1), _commit_delay(commit_delay), _batch_size(batch_size ? batch_size : 1),
+    _pending_records(0), _next_lsn(1), _durable_lsn(0), _closing(false), _commits(0),
+    _fsyncs(0), _stats_start(steady_clock::now()) {
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (_fd < 0) {
+    io_error("Could not open", path);
+  }
+  try {
+    LogReader reader(_fd, _path);
+    Lsn lsn;
+    const char *body;
+    size_t length;
+    while (reader.next(lsn, body, length)) {
+      _next_lsn = lsn + 1;
+    }
+    if (::ftruncate(_fd, reader.offset()) != 0) {
+      io_error("Could not truncate", path);
+    }
+    if (::lseek(_fd, 0, SEEK_END) < 0) {
+      io_error("Could not seek in", path);
+    }
+  } catch (const StorageError&) {
+    ::close(_fd);
+    throw;
+  }
+  _durable_lsn = _next_lsn - 1;
+  _writer = std::thread(&WriteAheadLog::group_commit, this);
+}
+
+// Waits for every record appended to be written, then closes the log
+WriteAheadLog::~WriteAheadLog() {
+  {
+    lock_guard<mutex> lock(_mutex);
+    _closing = true;
+  }
+  _appended.notify_one();
+  _writer.join();
+  ::close(_fd);
+}
+
+// Calls apply with every record in the log, in order. Meant for recovery,
+// before any records are appended.
+void WriteAheadLog::replay(const std::function<void(Lsn, const LogRecord&)>& apply) const {
+  LogReader reader(_fd, _path);
+  Lsn lsn;
+  const char *body;
+  size_t length;
+  while (reader.next(lsn, body, length)) {
+    apply(lsn, LogRecord(string(body, length)));
+  }
+}
+
+// Adds record to the next batch and returns its LSN, without waiting for
+// it to be written. Throws a StorageError if an earlier batch failed.
+Lsn WriteAheadLog::append(const LogRecord& record) {
+  const string& encoded = record.encoded();
+  lock_guard<mutex> lock(_mutex);
+  if (!_error.empty()) {
+    throw StorageError(_error);
+  }
+  Lsn lsn = _next_lsn++;
+  uint32_t length = static_cast<uint32_t>(sizeof(lsn) + encoded.size());
+  size_t start = _pending.size();
+  put(_pending, RecordHeader{length, 0});
+  put(_pending, lsn);
+  _pending += encoded;
+  char *body = &_pending[start + sizeof(RecordHeader)];
+  uint32_t checksum = crc32(body, length);
+  std::memcpy(&_pending[start + offsetof(RecordHeader, checksum)], &checksum, sizeof(checksum));
+  // The writer waits for the first record of a batch, and for a full one
+  ++_pending_records;
+  if (_pending_records == 1 || _pending_records == _batch_size) {
+    _appended.notify_one();
+  }
+  return lsn;
+}
+
+// Waits until the record with the given LSN is on disk. Throws a
+// StorageError if the batch holding it could not be written.
+void WriteAheadLog::wait(Lsn lsn) {
+  unique_lock<mutex> lock(_mutex);
+  _synced.wait(lock, [&]() { return _durable_lsn >= lsn || !_error.empty(); });
+  if (_durable_lsn < lsn) {
+    throw StorageError(_error);
+  }
+}
+
+// Appends record and waits until it is on disk, then returns its LSN
+Lsn WriteAheadLog::commit(const LogRecord& record) {
+  steady_clock::time_point start = steady_clock::now();
+  Lsn lsn = append(record);
+  wait(lsn);
+  std::chrono::nanoseconds latency = steady_clock::now() - start;
+  lock_guard<mutex> lock(_mutex);
+  ++_commits;
+  _latencies.record(latency.count());
+  return lsn;
+}
+
+// Returns the LSN of the last record known to be on disk
+Lsn WriteAheadLog::durable_lsn() const {
+  lock_guard<mutex> lock(_mutex);
+  return _durable_lsn;
+}
+
+// Returns the number of commits since the statistics were reset
+size_t WriteAheadLog::commits() const {
+  lock_guard<mutex> lock(_mutex);
+  return _commits;
+}
+
+// Returns the number of batches synced since the statistics were reset
+size_t WriteAheadLog::fsyncs() const {
+  lock_guard<mutex> lock(_mutex);
+  return _fsyncs;
+}
+
+// Returns the rate of syncs since the statistics were reset
+double WriteAheadLog::fsyncs_per_second() const {
+  lock_guard<mutex> lock(_mutex);
+  std::chrono::duration<double> elapsed = steady_clock::now() - _stats_start;
+  return elapsed.count() > 0 ? _fsyncs / elapsed.count() : 0.0;
+}
+
+// Returns the commit latency, in microseconds, that the given percentage
+// of commits since the statistics were reset did not exceed
+double WriteAheadLog::commit_latency(double percent) const {
+  lock_guard<mutex> lock(_mutex);
+  return _latencies.percentile(percent) / 1000.0;
+}
+
+// Zeroes the commit and sync counts and forgets the commit latencies
+void WriteAheadLog::reset_stats() {
+  lock_guard<mutex> lock(_mutex);
+  _commits = 0;
+  _fsyncs = 0;
+  _stats_start = steady_clock::now();
+  _latencies.reset();
+}
+
+// Run by the group-commit thread: writes and syncs batches of records
+// until the log is closed and nothing is left to write
+void WriteAheadLog::group_commit() {
+  unique_lock<mutex> lock(_mutex);
+  while (true) {
+    _appended.wait(lock, [this]() { return _closing || _pending_records > 0; });
+    if (_pending_records == 0) {
+      return;
+    }
+    // Give other statements the commit delay to join the batch
+    if (_commit_delay.count() > 0 && !_closing) {
+      _appended.wait_until(lock, steady_clock::now() + _commit_delay, [this]() {
+	  return _closing || _pending_records >= _batch_size;
+	});
+    }
+    _writing.swap(_pending);
+    _pending.clear();
+    _pending_records = 0;
+    Lsn last = _next_lsn - 1;
+    lock.unlock();
+    string error;
+    try {
+      write_batch();
+    } catch (const StorageError& e) {
+      error = e.what();
+    }
+    lock.lock();
+    if (error.empty()) {
+      _durable_lsn = last;
+      ++_fsyncs;
+    } else if (_error.empty()) {
+      _error = error;
+    }
+    _synced.notify_all();
+  }
+}
+
+// Writes the batch to the end of the log and waits for it to reach the
+// disk
+void WriteAheadLog::write_batch() {
+  const char *data = _writing.data();
+  size_t left = _writing.size();
+  while (left > 0) {
+    ssize_t written = ::write(_fd, data, left);
+    if (written < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      io_error("Could not write", _path);
+    }
+    data += written;
+    left -= written;
+  }
+  if (::fdatasync(_fd) != 0) {
+    io_error("Could not sync", _path);
+  }
+}
@@ -0,0 +1,109 @@
+// SimpleSQL: Write-ahead log
+//
+// Makes statements that change the database durable by appending them to
+// a log file before they are acknowledged, so that they can be replayed
+// after a crash. Statements are logged as their tokens, with the values of
+// their parameters substituted for their placeholders, and are replayed by
+// parsing and applying them again.
+//
+// Committing a statement waits until its record has reached the disk. A
+// single group-commit thread writes whatever records are waiting with one
+// write and one fdatasync, so statements committed at about the same time
+// share the cost of syncing. The thread waits up to the commit delay after
+// the first record of a batch arrives, or until the batch size is reached,
+// for more records to join the batch.
+
+#ifndef __WAL_H__
+#define __WAL_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "schema.h"
+#include "../AST/ast.h"
+#include "../AST/value.h"
+#include "../lexer/lexer.h"
+#include "../util/histogram.h"
+
+// Log sequence numbers number records from 1 in the order they are logged
+typedef std::uint64_t Lsn;
+
+// A logged statement, encoded as its tokens. The encoding refers to no
+// other memory, so a record can outlive the statement it was made from.
+class LogRecord {
+ public:
+  LogRecord();
+  LogRecord(const FlatToken *begin, const FlatToken *end,
+	    const std::vector<Value>& parameters = std::vector<Value>());
+  explicit LogRecord(const std::string& encoded);
+  void append(const FlatToken *begin, const FlatToken *end);
+  const std::string& encoded() const;
+  void tokens(std::vector<FlatToken>& tokens) const;
+ private:
+  std::string _encoded;
+};
+
+bool is_logged(const ASTNode& statement);
+
+class WriteAheadLog {
+ public:
+  WriteAheadLog(const std::string& path,
+		std::chrono::microseconds commit_delay = DEFAULT_COMMIT_DELAY,
+		std::size_t batch_size = DEFAULT_BATCH_SIZE);
+  ~WriteAheadLog();
+  void replay(const std::function<void(Lsn, const LogRecord&)>& apply) const;
+  Lsn append(const LogRecord& record);
+  void wait(Lsn lsn);
+  Lsn commit(const LogRecord& record);
+  Lsn durable_lsn() const;
+
+  std::size_t commits() const;
+  std::size_t fsyncs() const;
+  double fsyncs_per_second() const;
+  double commit_latency(double percent) const;
+  void reset_stats();
+
+  static const std::chrono::microseconds DEFAULT_COMMIT_DELAY;
+  static const std::size_t DEFAULT_BATCH_SIZE = 64;
+ private:
+  WriteAheadLog(const WriteAheadLog&) = delete;
+  WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+  void group_commit();
+  void write_batch();
+
+  const std::string _path;
+  int _fd;
+  const std::chrono::microseconds _commit_delay;
+  const std::size_t _batch_size;
+  mutable std::mutex _mutex;
+  // Signalled when records are appended, and when the log is closed
+  std::condition_variable _appended;
+  // Signalled when a batch reaches the disk, or fails to
+  std::condition_variable _synced;
+  // Encoded records waiting to be written, and the batch being written.
+  // Only the group-commit thread touches _writing.
+  std::string _pending;
+  std::string _writing;
+  std::size_t _pending_records;
+  Lsn _next_lsn;
+  Lsn _durable_lsn;
+  // Set if a batch could not be written; every later commit fails
+  std::string _error;
+  bool _closing;
+
+  std::size_t _commits;
+  std::size_t _fsyncs;
+  std::chrono::steady_clock::time_point _stats_start;
+  // Commit latencies in nanoseconds
+  Histogram _latencies;
+
+  std::thread _writer;
+};
+
+#endif  // __WAL_H__
@@ -0,0 +1,148 @@
+// SimpleSQL: Aggregation tests
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../exec/aggregate.h"
+#include "../exec/morsel.h"
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Enough rows for four morsels, so that four drivers aggregate into tables
+// of their own
+const size_t ROWS = 4 * MORSEL_ROWS;
+const size_t GROUPS = 1000;
+
+// Returns a table of ROWS rows with a nullable group key k, a nullable
+// integer v that repeats within groups, and a double d
+unique_ptr<Table> make_table() {
+  Schema schema;
+  schema.add_column(ColumnSchema{"k", INT_T, 0, true, nullptr});
+  schema.add_column(ColumnSchema{"v", INT_T, 0, true, nullptr});
+  schema.add_column(ColumnSchema{"d", DOUBLE_T, 0, false, nullptr});
+  unique_ptr<Table> table(new Table("t", schema));
+  vector<vector<Value>> values;
+  for (size_t i = 0; i < ROWS; ++i) {
+    values.push_back(vector<Value>{
+	i % 997 == 0 ? Value() : Value(static_cast<long long>(i % GROUPS)),
+	i % 13 == 0 ? Value() : Value(static_cast<long long>(i % 50) - 20),
+	Value((i % 8) * 0.5)});
+  }
+  table->append(values);
+  return table;
+}
+
+// The aggregates of a group, worked out one row at a time
+struct Expected {
+  long long rows = 0;
+  long long values = 0;
+  long long sum = 0;
+  long long min = 0;
+  long long max = 0;
+  std::set<long long> distinct;
+  double total = 0;
+};
+
+// Returns the rows aggregate_rows should return for the test table grouped
+// by k, or as one group if grouped is false, one string per group
+vector<string> expected_groups(const Table& table, bool grouped) {
+  std::map<string, Expected> groups;
+  if (!grouped) {
+    groups[""];
+  }
+  for (size_t i = 0; i < table.rows(); ++i) {
+    Expected& group = groups[grouped ? table.value(i, 0).toString() + "|" : ""];
+    ++group.rows;
+    group.total += table.value(i, 2).double_value();
+    Value v = table.value(i, 1);
+    if (!v.is_null()) {
+      group.min = group.values ? std::min(group.min, v.int_value()) : v.int_value();
+      group.max = group.values ? std::max(group.max, v.int_value()) : v.int_value();
+      ++group.values;
+      group.sum += v.int_value();
+      group.distinct.insert(v.int_value());
+    }
+  }
+  vector<string> rows;
+  for (auto it = groups.begin(); it != groups.end(); ++it) {
+    const Expected& group = it->second;
+    string row = it->first + std::to_string(group.rows) + "|" + std::to_string(group.values) + "|";
+    if (group.values) {
+      row += std::to_string(group.sum) + "|" + std::to_string(group.min) + "|" +
+	std::to_string(group.max) + "|";
+    } else {
+      row += "NULL|NULL|NULL|";
+    }
+    row += std::to_string(group.distinct.size()) + "|";
+    row += group.rows ? Value(group.total / group.rows).toString() + "|" : "NULL|";
+    rows.push_back(row);
+  }
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+// Aggregates the rows of table, grouped by k unless grouped is false, on
+// pool, and returns the result one string per group
+vector<string> aggregate(const Table& table, bool grouped, ThreadPool *pool) {
+  vector<size_t> rows(table.rows());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i] = i;
+  }
+  vector<size_t> keys;
+  if (grouped) {
+    keys.push_back(0);
+  }
+  const vector<AggregateSpec> aggregates{
+    {AggregateFunction::COUNT, -1, false},
+    {AggregateFunction::COUNT, 1, false},
+    {AggregateFunction::SUM, 1, false},
+    {AggregateFunction::MIN, 1, false},
+    {AggregateFunction::MAX, 1, false},
+    {AggregateFunction::COUNT, 1, true},
+    {AggregateFunction::AVG, 2, false}};
+  unique_ptr<Table> result = aggregate_rows(table, rows, keys, aggregates, pool);
+  vector<string> groups;
+  for (size_t row = 0; row < result->rows(); ++row) {
+    string text;
+    for (size_t i = 0; i < result->schema().size(); ++i) {
+      text += result->value(row, i).toString() + "|";
+    }
+    groups.push_back(text);
+  }
+  std::sort(groups.begin(), groups.end());
+  return groups;
+}
+
+// The groups drivers aggregate on their own are merged into one row per
+// group, the same as aggregating on one thread, NULL keys included
+RegisterTest merges_groups("aggregate/merges_groups", [] {
+    unique_ptr<Table> table = make_table();
+    const vector<string> expected = expected_groups(*table, true);
+    CHECK_EQ(GROUPS + 1, expected.size());
+    ThreadPool pool(4);
+    CHECK(morsel_drivers(&pool, ROWS) > 1);
+    CHECK(aggregate(*table, true, &pool) == expected);
+    CHECK(aggregate(*table, true, nullptr) == expected);
+  });
+
+// Without keys there is one group, even with no rows
+RegisterTest single_group("aggregate/single_group", [] {
+    unique_ptr<Table> table = make_table();
+    ThreadPool pool(4);
+    CHECK(aggregate(*table, false, &pool) == expected_groups(*table, false));
+    unique_ptr<Table> empty(new Table("e", table->schema()));
+    const vector<string> none = aggregate(*empty, false, &pool);
+    CHECK_EQ(size_t(1), none.size());
+    CHECK(none == expected_groups(*empty, false));
+  });
+
+}  // namespace
@@ -0,0 +1,72 @@
+// SimpleSQL: B+-tree tests
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test.h"
+#include "../storage/btree.h"
+
+using std::size_t;
+using std::string;
+using std::uint64_t;
+
+namespace {
+
+// Returns a key that sorts in the order of i
+const string ordered_key(uint64_t i) {
+  string key(8, '\0');
+  for (size_t byte = 0; byte < 8; ++byte) {
+    key[byte] = static_cast<char>(i >> (56 - 8 * byte));
+  }
+  return key;
+}
+
+// Lookups of keys already inserted find them while a writer keeps
+// splitting the leaves they are in. Ascending keys split the rightmost
+// leaf over and over, moving the keys readers are after to new siblings.
+RegisterTest lookup_during_split("btree/lookup_during_split", [] {
+    const uint64_t keys = 200000;
+    const size_t readers = 3;
+    BTree tree;
+    // Keys below published have been inserted
+    std::atomic<uint64_t> published(0);
+    std::atomic<size_t> missed(0);
+    std::atomic<size_t> wrong(0);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < readers; ++r) {
+      threads.push_back(std::thread([&, r] {
+	    uint64_t state = r + 1;
+	    uint64_t count;
+	    while ((count = published.load()) < keys) {
+	      if (count == 0) {
+		std::this_thread::yield();
+		continue;
+	      }
+	      // Mostly the newest keys, whose leaf is the one splitting
+	      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	      uint64_t back = (state >> 33) % (state & 1 ? 64 : count);
+	      uint64_t i = count - 1 - (back < count ? back : 0);
+	      uint64_t value;
+	      if (!tree.find(ordered_key(i), value)) {
+		++missed;
+	      } else if (value != i) {
+		++wrong;
+	      }
+	    }
+	  }));
+    }
+    for (uint64_t i = 0; i < keys; ++i) {
+      tree.insert(ordered_key(i), i);
+      published.store(i + 1);
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+      it->join();
+    }
+    CHECK_EQ(0u, missed.load());
+    CHECK_EQ(0u, wrong.load());
+    CHECK_EQ(keys, tree.size());
+  });
+
+}  // namespace
@@ -0,0 +1,171 @@
+// SimpleSQL: Catalog tests
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../lexer/statement_reader.h"
+#include "../parser/parser.h"
+#include "../storage/catalog.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Parses script and applies its statements to catalog
+void run(Catalog& catalog, const string& script) {
+  vector<FlatToken> tokes;
+  tokenize_command(script, tokes);
+  Arena arena;
+  vector<const ASTNode*> statements = parse(tokes, arena);
+  for (auto it = statements.begin(); it != statements.end(); ++it) {
+    (*it)->accept(catalog);
+  }
+}
+
+// Reads the INSERT ... VALUES statements of script through a reader with
+// the given buffer size and loads them into catalog, as the shell does,
+// in batches of batch_rows rows
+void load(Catalog& catalog, const string& script, size_t buffer_size, size_t batch_rows) {
+  std::istringstream input(script);
+  StatementReader reader(input, buffer_size);
+  ValuesLoader loader(catalog, batch_rows);
+  vector<FlatToken> tokes;
+  while (reader.next(tokes)) {
+    CHECK(loader.start(tokes.data(), tokes.data() + tokes.size()));
+    while (true) {
+      const FlatToken *end = tokes.data() + tokes.size();
+      const FlatToken *rest = loader.load(tokes.data(), end, !reader.partial());
+      if (!reader.partial()) {
+	break;
+      }
+      if (rest != end) {
+	reader.resume_at(*rest);
+      }
+      reader.next(tokes);
+    }
+    CHECK(loader.done());
+  }
+}
+
+// Returns an INSERT into t (a, b, c) of the given rows of INSERT ... VALUES
+// rows, the row with key repeat, if any, taking the key of row 0
+const string values(size_t rows, size_t repeat = 0) {
+  std::ostringstream statement;
+  statement << "INSERT INTO t (b, a) VALUES ";
+  for (size_t i = 0; i < rows; ++i) {
+    statement << (i ? ", " : "") << "('it''s row " << i << "', " << (i == repeat ? 0 : i) << ")";
+  }
+  statement << ";";
+  return statement.str();
+}
+
+// Returns the number of rows of table that are not deleted
+size_t live_rows(const Table& table) {
+  return table.rows() - table.deleted_rows();
+}
+
+// An INSERT ... SELECT whose rows conflict with the table's primary key
+// after several batches have been appended inserts none of them
+RegisterTest insert_select_is_atomic("catalog/insert_select_is_atomic", [] {
+    Catalog catalog;
+    std::ostringstream script;
+    script << "CREATE TABLE source (a INT, b INT);"
+	   << "CREATE TABLE target (a INT, b INT, PRIMARY KEY (a));"
+	   << "CREATE INDEX target_b ON target (b);"
+	   << "INSERT INTO target VALUES (5999, 1);"
+	   << "INSERT INTO source VALUES ";
+    for (size_t i = 0; i < 6000; ++i) {
+      script << (i ? ", " : "") << "(" << i << ", " << i * 2 << ")";
+    }
+    script << ";";
+    run(catalog, script.str());
+
+    bool failed = false;
+    try {
+      run(catalog, "INSERT INTO target SELECT a, b FROM source;");
+    } catch (const StorageError&) {
+      failed = true;
+    }
+    CHECK(failed);
+    const Table& target = *catalog.table("target");
+    CHECK_EQ(1u, live_rows(target));
+    size_t row;
+    CHECK(!target.find(vector<Value>{Value(0LL)}, row));
+    CHECK(target.find(vector<Value>{Value(5999LL)}, row));
+    CHECK_EQ(1u, target.index("target_b")->size());
+
+    // The keys of the rows taken back can be inserted again
+    run(catalog, "INSERT INTO target SELECT a, b FROM source WHERE a < 5999;");
+    CHECK_EQ(6000u, live_rows(target));
+    CHECK_EQ(6000u, target.index("target_b")->size());
+  });
+
+// Rows read in pieces much shorter than the statement, and parsed in
+// batches that end part way through pieces, are all loaded, with the
+// columns not listed left null
+RegisterTest load_values("catalog/load_values", [] {
+    Catalog catalog;
+    run(catalog, "CREATE TABLE t (a INT, b VARCHAR(20), c INT, PRIMARY KEY (a));"
+	"CREATE INDEX t_b ON t (b);");
+    load(catalog, values(3000), 256, 100);
+    const Table& t = *catalog.table("t");
+    CHECK_EQ(3000u, live_rows(t));
+    CHECK_EQ(3000u, t.index("t_b")->size());
+    for (size_t i = 0; i < 3000; i += 7) {
+      size_t row;
+      CHECK(t.find(vector<Value>{Value(static_cast<long long>(i))}, row));
+      CHECK_EQ("it's row " + std::to_string(i), t.value(row, 1).string_value());
+      CHECK(t.value(row, 2).is_null());
+    }
+  });
+
+// A load that fails part way, on a repeated key or a row that does not
+// parse, takes back the rows it appended before the failure
+RegisterTest load_values_is_atomic("catalog/load_values_is_atomic", [] {
+    Catalog catalog;
+    run(catalog, "CREATE TABLE t (a INT, b VARCHAR(20), c INT, PRIMARY KEY (a));"
+	"CREATE INDEX t_b ON t (b);");
+    bool failed = false;
+    try {
+      load(catalog, values(3000, 2500), 256, 100);
+    } catch (const StorageError&) {
+      failed = true;
+    }
+    CHECK(failed);
+    const Table& t = *catalog.table("t");
+    CHECK_EQ(0u, live_rows(t));
+    CHECK_EQ(0u, t.index("t_b")->size());
+
+    string statement = values(3000);
+    statement.insert(statement.find("('it''s row 2500'"), "garbage ");
+    failed = false;
+    try {
+      load(catalog, statement, 256, 100);
+    } catch (const ParseError& e) {
+      failed = true;
+      // Token indices count from the start of the statement
+      CHECK_EQ(9u + 2500 * 6, e.token());
+    }
+    CHECK(failed);
+    CHECK_EQ(0u, live_rows(t));
+
+    // The same statement through the parser, in several batches, is no
+    // different
+    failed = false;
+    try {
+      run(catalog, values(3000, 2500));
+    } catch (const StorageError&) {
+      failed = true;
+    }
+    CHECK(failed);
+    CHECK_EQ(0u, live_rows(t));
+    CHECK_EQ(0u, t.index("t_b")->size());
+
+    load(catalog, values(3000), 256, 100);
+    CHECK_EQ(3000u, live_rows(t));
+  });
+
+}  // namespace
@@ -0,0 +1,216 @@
+// SimpleSQL: Column encoding tests
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../storage/encoding.h"
+#include "../storage/table.h"
+
+using std::int64_t;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const BinaryOp OPERATORS[] = {BinaryOp::EQUAL, BinaryOp::NEQUAL, BinaryOp::GTHAN,
+			      BinaryOp::LTHAN, BinaryOp::GEQ, BinaryOp::LEQ};
+
+// Returns the result of comparing left with right by op
+template <typename T>
+bool compare(BinaryOp op, T left, T right) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return left == right;
+  case BinaryOp::NEQUAL:
+    return left != right;
+  case BinaryOp::GTHAN:
+    return left > right;
+  case BinaryOp::LTHAN:
+    return left < right;
+  case BinaryOp::GEQ:
+    return left >= right;
+  default:
+    return left <= right;
+  }
+}
+
+// Returns true if row is not null in validity
+bool valid(const vector<uint64_t>& validity, size_t row) {
+  return (validity[row / 64] >> (row % 64)) & 1;
+}
+
+// Returns a validity bitmap for rows rows in which the first three rows
+// and every seventh row are null
+vector<uint64_t> make_validity(size_t rows) {
+  vector<uint64_t> validity((rows + 63) / 64);
+  for (size_t i = 0; i < rows; ++i) {
+    if (i >= 3 && i % 7 != 0) {
+      validity[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+  return validity;
+}
+
+// Encodes values, whose null rows hold values unlike the others, checks
+// that they are encoded as expected, and that every row that is not null
+// reads back and compares with each constant as it was
+template <typename T>
+void check_round_trip(const string& name, vector<T> values, Encoding expected,
+		      const vector<T>& constants) {
+  const size_t rows = values.size();
+  const vector<uint64_t> validity = make_validity(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    if (!valid(validity, i)) {
+      values[i] = static_cast<T>(123456789 + i);
+    }
+  }
+  unique_ptr<EncodedColumn> column = EncodedColumn::encode(values.data(), validity.data(), rows);
+  if (!column) {
+    report_failure(__FILE__, __LINE__, name + " was not encoded");
+    return;
+  }
+  if (column->encoding() != expected) {
+    report_failure(__FILE__, __LINE__, name + " has the wrong encoding");
+  }
+  CHECK(column->bytes() < rows * sizeof(T));
+  for (size_t i = 0; i < rows; ++i) {
+    if (valid(validity, i) && !(column->template at<T>(i) == values[i])) {
+      report_failure(__FILE__, __LINE__, name + " reads back wrong at row " + std::to_string(i));
+      return;
+    }
+  }
+  // Runs that start and end on and off 64-row boundaries
+  const size_t firsts[] = {0, 1, 64, 70, rows - 1};
+  for (size_t first : firsts) {
+    const size_t count = rows - first;
+    vector<T> decoded(count);
+    column->decode(first, count, decoded.data());
+    for (size_t i = 0; i < count; ++i) {
+      if (valid(validity, first + i) && !(decoded[i] == values[first + i])) {
+	report_failure(__FILE__, __LINE__, name + " decodes wrong at row " +
+		       std::to_string(first + i) + " from " + std::to_string(first));
+	return;
+      }
+    }
+    for (BinaryOp op : OPERATORS) {
+      for (T constant : constants) {
+	vector<uint64_t> bits(count / 64 + 1);
+	column->compare(op, constant, first, count, bits.data());
+	for (size_t i = 0; i < count; ++i) {
+	  bool bit = (bits[i / 64] >> (i % 64)) & 1;
+	  if (valid(validity, first + i) && bit != compare(op, values[first + i], constant)) {
+	    report_failure(__FILE__, __LINE__, name + " compares wrong at row " +
+			   std::to_string(first + i) + " with operator " +
+			   std::to_string(static_cast<int>(op)));
+	    return;
+	  }
+	}
+      }
+    }
+  }
+}
+
+// Integers in a narrow range far from zero are stored as offsets from the
+// smallest
+RegisterTest frame("encoding/frame", [] {
+    vector<int64_t> values;
+    for (size_t i = 0; i < 1000; ++i) {
+      values.push_back(1000000000000ll - 500 + static_cast<int64_t>(i * 7919 % 1000));
+    }
+    check_round_trip<int64_t>("frame", values, Encoding::FRAME,
+			      {1000000000000ll, 999999999499ll, 999999999500ll, 1000000000499ll,
+				  1000000000500ll, 0, std::numeric_limits<int64_t>::min()});
+  });
+
+// Integers that rise by about the same step are stored as deltas from a
+// line through each group of 64 rows
+RegisterTest delta("encoding/delta", [] {
+    vector<uint64_t> values;
+    for (size_t i = 0; i < 1000; ++i) {
+      values.push_back(5000000000ull + i * 100 + i * 37 % 5);
+    }
+    check_round_trip<uint64_t>("delta", values, Encoding::DELTA,
+			       {5000000000ull, 5000006400ull, 5000006401ull, 5000050000ull,
+				   5000099999ull, 0, ~0ull});
+  });
+
+// Long runs of equal values are stored once per run
+RegisterTest run_length("encoding/run_length", [] {
+    vector<double> values;
+    for (size_t i = 0; i < 1000; ++i) {
+      values.push_back(i / 150 * 1e15 - 2.5);
+    }
+    check_round_trip<double>("run_length", values, Encoding::RUN_LENGTH,
+			     {-2.5, 1e15 - 2.5, 1e15, 6e15 - 2.5, -1e300,
+				 std::numeric_limits<double>::infinity(),
+				 std::numeric_limits<double>::quiet_NaN()});
+  });
+
+// A few distinct values far apart are stored as positions in a list of
+// them
+RegisterTest dictionary("encoding/dictionary", [] {
+    const int64_t distinct[] = {-4000000000000000000ll, -3, 17, 900000000000ll,
+				4000000000000000000ll};
+    vector<int64_t> values;
+    for (size_t i = 0; i < 1000; ++i) {
+      values.push_back(distinct[i * 13 % 5]);
+    }
+    check_round_trip<int64_t>("dictionary", values, Encoding::DICTIONARY,
+			      {-3, 17, 0, 900000000001ll, std::numeric_limits<int64_t>::min(),
+				  std::numeric_limits<int64_t>::max()});
+  });
+
+// Doubles, negative ones included, can have dictionaries too
+RegisterTest double_dictionary("encoding/double_dictionary", [] {
+    const double distinct[] = {-1e300, -0.5, 2.5, 3.25, 1e300};
+    vector<double> values;
+    for (size_t i = 0; i < 1000; ++i) {
+      values.push_back(distinct[i * 13 % 5]);
+    }
+    check_round_trip<double>("double_dictionary", values, Encoding::DICTIONARY,
+			     {-0.5, 0.0, 3.0, 1e300, -std::numeric_limits<double>::infinity(),
+				 std::numeric_limits<double>::quiet_NaN()});
+  });
+
+// Null rows of sealed chunks read back as NULL, whatever the encoding of
+// their column, and the rows around them as they were written
+RegisterTest sealed_nulls("encoding/sealed_nulls", [] {
+    Schema schema;
+    schema.add_column(ColumnSchema{"frame", INT_T, 0, true, nullptr});
+    schema.add_column(ColumnSchema{"delta", UINT_T, 0, true, nullptr});
+    schema.add_column(ColumnSchema{"runs", DOUBLE_T, 0, true, nullptr});
+    schema.add_column(ColumnSchema{"dictionary", INT_T, 0, true, nullptr});
+    Table table("t", schema, 256);
+    vector<vector<Value>> rows;
+    for (size_t i = 0; i < 1000; ++i) {
+      bool null = i < 3 || i % 7 == 0;
+      rows.push_back(vector<Value>{
+	  null ? Value() : Value(static_cast<long long>(1000000 + i * 7919 % 1000)),
+	  null ? Value() : Value(static_cast<unsigned long long>(5000000000ull + i * 100)),
+	  null ? Value() : Value(i / 150 * 0.5),
+	  null ? Value() : Value(i % 3 ? -4000000000000000000ll : 4000000000000000000ll)});
+    }
+    table.append(rows);
+    for (size_t c = 0; c + 1 < table.chunk_count(); ++c) {
+      for (size_t column = 0; column < schema.size(); ++column) {
+	CHECK(table.chunk(c).column(column).encoded() != nullptr);
+      }
+    }
+    for (size_t i = 0; i < rows.size(); ++i) {
+      for (size_t column = 0; column < schema.size(); ++column) {
+	if (table.value(i, column).toString() != rows[i][column].toString()) {
+	  report_failure(__FILE__, __LINE__, "Row " + std::to_string(i) + " column " +
+			 std::to_string(column) + " is " + table.value(i, column).toString());
+	  return;
+	}
+      }
+    }
+  });
+
+}  // namespace
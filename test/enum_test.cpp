@@ -0,0 +1,136 @@
+// SimpleSQL: ENUM and SET tests
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../exec/query.h"
+#include "../parser/parser.h"
+#include "../storage/catalog.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Parses script and applies its statements to catalog
+void run(Catalog& catalog, const string& script) {
+  vector<FlatToken> tokes;
+  tokenize_command(script, tokes);
+  Arena arena;
+  vector<const ASTNode*> statements = parse(tokes, arena);
+  for (auto it = statements.begin(); it != statements.end(); ++it) {
+    (*it)->accept(catalog);
+  }
+}
+
+// Runs the SELECT statement query on catalog and returns its rows in the
+// order it gives them, each in brackets with its values separated by
+// spaces
+string select(Catalog& catalog, const string& query) {
+  run(catalog, query);
+  std::unique_ptr<QueryResult> result = catalog.take_result();
+  const Table& table = *result->rows;
+  string rows;
+  for (size_t row = 0; row < table.rows(); ++row) {
+    if (table.is_deleted(row)) {
+      continue;
+    }
+    rows += "[";
+    for (size_t i = 0; i < table.schema().size(); ++i) {
+      rows += (i ? " " : "") + table.value(row, i).toString();
+    }
+    rows += "]";
+  }
+  return rows;
+}
+
+// Returns true if applying script to catalog throws a StorageError
+bool rejects(Catalog& catalog, const string& script) {
+  try {
+    run(catalog, script);
+  } catch (const StorageError&) {
+    return true;
+  }
+  return false;
+}
+
+// Creates table t with an ENUM c whose members are not in string order, a
+// SET s, and a row of each member and a few sets
+void create_table(Catalog& catalog) {
+  run(catalog,
+      "CREATE TABLE t (id INT, c ENUM('zebra', 'apple', 'mango'), s SET('x', 'y', 'z'));"
+      "INSERT INTO t VALUES (1, 'zebra', 'z,x'), (2, 'apple', ''), (3, 'mango', 'y'),"
+      " (4, NULL, NULL), (5, 'apple', 'x,y,z'), (6, 'zebra', 'x,z');");
+}
+
+// Members map to their positions, and sets to masks with a bit per member,
+// read back with their members in declaration order
+RegisterTest dictionary_codes("enum/dictionary_codes", [] {
+    Dictionary dictionary(vector<string>{"red", "green", "blue"});
+    CHECK_EQ(0, dictionary.index_of("red", 3));
+    CHECK_EQ(2, dictionary.index_of("blue", 4));
+    CHECK_EQ(-1, dictionary.index_of("pink", 4));
+    std::uint64_t mask;
+    CHECK(dictionary.set_mask("blue,red", 8, mask));
+    CHECK_EQ(std::uint64_t(5), mask);
+    CHECK_EQ(string("red,blue"), dictionary.set_value(mask).string_value());
+    CHECK_EQ(string("green"), dictionary.set_value(2).string_value());
+    CHECK(dictionary.set_mask("", 0, mask));
+    CHECK_EQ(std::uint64_t(0), mask);
+    CHECK_EQ(string(""), dictionary.set_value(0).string_value());
+    CHECK(!dictionary.set_mask("red,pink", 8, mask));
+  });
+
+// Values are stored as codes but read back, compared and sorted as their
+// strings. A SET value is written with its members in declaration order,
+// so a string listing them in another order equals no value.
+RegisterTest compare_as_strings("enum/compare_as_strings", [] {
+    Catalog catalog;
+    create_table(catalog);
+    CHECK_EQ(string("[1 'zebra' 'x,z'][2 'apple' ''][3 'mango' 'y'][4 NULL NULL]"
+		    "[5 'apple' 'x,y,z'][6 'zebra' 'x,z']"),
+	     select(catalog, "SELECT id, c, s FROM t;"));
+    CHECK_EQ(string("[2][5]"), select(catalog, "SELECT id FROM t WHERE c = 'apple';"));
+    CHECK_EQ(string("[2][5]"), select(catalog, "SELECT id FROM t WHERE c < 'mango';"));
+    CHECK_EQ(string("[1][3][6]"), select(catalog, "SELECT id FROM t WHERE c >= 'mango';"));
+    CHECK_EQ(string("[1][3][6]"), select(catalog, "SELECT id FROM t WHERE NOT c = 'apple';"));
+    CHECK_EQ(string("[1][6]"),
+	     select(catalog, "SELECT id FROM t WHERE c IN ('zebra', 'kiwi');"));
+    CHECK_EQ(string(""), select(catalog, "SELECT id FROM t WHERE c = 'kiwi';"));
+    CHECK_EQ(string("[1][6]"), select(catalog, "SELECT id FROM t WHERE s = 'x,z';"));
+    CHECK_EQ(string(""), select(catalog, "SELECT id FROM t WHERE s = 'z,x';"));
+    CHECK_EQ(string("[2][3][5]"), select(catalog, "SELECT id FROM t WHERE s <> 'x,z';"));
+    CHECK_EQ(string("[2][3]"), select(catalog, "SELECT id FROM t WHERE s IN ('', 'y');"));
+    CHECK_EQ(string("[4][2][5][3][1][6]"),
+	     select(catalog, "SELECT id FROM t ORDER BY c, id;"));
+    CHECK_EQ(string("[1][6][3][2][5][4]"),
+	     select(catalog, "SELECT id FROM t ORDER BY c DESC, id;"));
+  });
+
+// Conditions on members keep working after values change
+RegisterTest update_codes("enum/update_codes", [] {
+    Catalog catalog;
+    create_table(catalog);
+    run(catalog, "UPDATE t SET c = 'mango', s = 'y,x' WHERE c = 'zebra';");
+    CHECK_EQ(string("[1][3][6]"),
+	     select(catalog, "SELECT id FROM t WHERE c = 'mango' ORDER BY id;"));
+    CHECK_EQ(string("[1 'x,y'][6 'x,y']"),
+	     select(catalog, "SELECT id, s FROM t WHERE s = 'x,y' ORDER BY id;"));
+    CHECK_EQ(string(""), select(catalog, "SELECT id FROM t WHERE c = 'zebra';"));
+  });
+
+// Values that are not members are rejected, and leave the table as it was
+RegisterTest rejects_non_members("enum/rejects_non_members", [] {
+    Catalog catalog;
+    create_table(catalog);
+    CHECK(rejects(catalog, "INSERT INTO t VALUES (7, 'kiwi', '');"));
+    CHECK(rejects(catalog, "INSERT INTO t VALUES (7, 'apple', 'x,w');"));
+    CHECK(rejects(catalog, "UPDATE t SET c = 'kiwi' WHERE id = 1;"));
+    CHECK_EQ(string("[1 'zebra'][2 'apple'][3 'mango'][4 NULL][5 'apple'][6 'zebra']"),
+	     select(catalog, "SELECT id, c FROM t;"));
+  });
+
+}  // namespace
@@ -0,0 +1,206 @@
+// SimpleSQL: Filter tests
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../AST/select.h"
+#include "../exec/filter.h"
+#include "../parser/parser.h"
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const size_t ROWS = 3000;
+const size_t CHUNK_ROWS = 1000;
+
+// Truth values of three-valued logic
+enum Truth {
+  UNKNOWN = -1,
+  FALSE = 0,
+  TRUE = 1
+};
+
+// The values of row i of the test table, null where a member is unset
+struct Row {
+  bool has_a;
+  long long a;
+  double b;
+  bool has_s;
+  string s;
+};
+
+// Returns the values of row i
+Row row(size_t i) {
+  return Row{i % 9 != 0, static_cast<long long>(i), i % 4 == 0 ? i : i + 0.5,
+      i % 5 != 0, "row " + std::to_string(i)};
+}
+
+// Returns a table of ROWS rows with a nullable integer a, a double b equal
+// to a in every fourth row, and a nullable string s, in chunks of
+// CHUNK_ROWS rows, all but the last of which are sealed
+unique_ptr<Table> make_table() {
+  Schema schema;
+  schema.add_column(ColumnSchema{"a", INT_T, 0, true, nullptr});
+  schema.add_column(ColumnSchema{"b", DOUBLE_T, 0, false, nullptr});
+  schema.add_column(ColumnSchema{"s", VARCHAR_T, 20, true, nullptr});
+  unique_ptr<Table> table(new Table("t", schema, CHUNK_ROWS));
+  vector<vector<Value>> values;
+  vector<string> strings(ROWS);
+  for (size_t i = 0; i < ROWS; ++i) {
+    Row r = row(i);
+    strings[i] = r.s;
+    values.push_back(vector<Value>{
+	r.has_a ? Value(r.a) : Value(),
+	Value(r.b),
+	r.has_s ? Value(strings[i].data(), strings[i].size()) : Value()});
+  }
+  table->append(values);
+  return table;
+}
+
+// Returns the WHERE condition of a SELECT from t, parsed into arena
+const Expression *parse_condition(const string& condition, Arena& arena) {
+  vector<FlatToken> tokes;
+  tokenize_command("SELECT * FROM t WHERE " + condition + ";", tokes);
+  const ASTNode *statement = parse(tokes, arena).front();
+  return static_cast<const Select*>(statement)->exp()->where_expr()->condition();
+}
+
+// Runs filter over every batch of table and returns the rows it selects
+// for want, starting from every live row of each batch, or only from its
+// odd positions if odd is set. The selection is narrowed in place, and
+// must stay in increasing order.
+vector<size_t> select_rows(const Table& table, const Filter& filter, bool want, bool odd) {
+  vector<size_t> rows;
+  BatchRow sel[BATCH_SIZE];
+  for (size_t c = 0; c < table.chunk_count(); ++c) {
+    const Chunk *chunk = &table.chunk(c);
+    for (size_t offset = 0; offset < chunk->size(); offset += BATCH_SIZE) {
+      Batch batch{chunk, offset, std::min(BATCH_SIZE, chunk->size() - offset)};
+      size_t count = select_all(batch, sel);
+      if (odd) {
+	count = std::remove_if(sel, sel + count, [](BatchRow i) { return i % 2 == 0; }) - sel;
+      }
+      count = filter.select(batch, sel, count, want, sel);
+      CHECK(std::is_sorted(sel, sel + count));
+      for (size_t i = 0; i < count; ++i) {
+	rows.push_back(c * CHUNK_ROWS + offset + sel[i]);
+      }
+    }
+  }
+  return rows;
+}
+
+// Checks that condition selects, for either truth value, exactly the rows
+// of table for which expected gives that value, and none for which it is
+// unknown
+void check_filter(const Table& table, const string& condition,
+		  const std::function<Truth(const Row&)>& expected) {
+  Arena arena;
+  unique_ptr<Filter> filter = compile_filter(table, parse_condition(condition, arena),
+					     vector<Value>());
+  for (int odd = 0; odd < 2; ++odd) {
+    for (int want = 0; want < 2; ++want) {
+      vector<size_t> wanted;
+      for (size_t i = 0; i < ROWS; ++i) {
+	if (!table.is_deleted(i) && (!odd || i % 2 == 1) &&
+	    expected(row(i)) == (want ? TRUE : FALSE)) {
+	  wanted.push_back(i);
+	}
+      }
+      vector<size_t> selected = select_rows(table, *filter, want, odd);
+      if (selected != wanted) {
+	report_failure(__FILE__, __LINE__, condition + " selected " +
+		       std::to_string(selected.size()) + " row(s) for " +
+		       (want ? "true" : "false") + ", expected " + std::to_string(wanted.size()));
+      }
+    }
+  }
+}
+
+// Returns the truth value of a condition that cannot be unknown
+Truth truth(bool value) {
+  return value ? TRUE : FALSE;
+}
+
+// The connectives of three-valued logic
+Truth operator&&(Truth left, Truth right) {
+  if (left == FALSE || right == FALSE) {
+    return FALSE;
+  }
+  return left == UNKNOWN || right == UNKNOWN ? UNKNOWN : TRUE;
+}
+
+Truth operator||(Truth left, Truth right) {
+  if (left == TRUE || right == TRUE) {
+    return TRUE;
+  }
+  return left == UNKNOWN || right == UNKNOWN ? UNKNOWN : FALSE;
+}
+
+Truth operator!(Truth value) {
+  return value == UNKNOWN ? UNKNOWN : truth(value == FALSE);
+}
+
+// Compares a with a constant, unknown if a is null
+Truth a_is(const Row& r, const std::function<bool(long long)>& test) {
+  return r.has_a ? truth(test(r.a)) : UNKNOWN;
+}
+
+// Runs the checks of every condition on table
+void check_conditions(const Table& table) {
+  check_filter(table, "a < 1500", [](const Row& r) {
+      return a_is(r, [](long long a) { return a < 1500; });
+    });
+  check_filter(table, "b >= 1200.5", [](const Row& r) { return truth(r.b >= 1200.5); });
+  check_filter(table, "a = b", [](const Row& r) {
+      return a_is(r, [&](long long a) { return a == r.b; });
+    });
+  check_filter(table, "a < 2.5", [](const Row& r) {
+      return a_is(r, [](long long a) { return a < 2.5; });
+    });
+  check_filter(table, "NOT (a BETWEEN 100 AND 2000)", [](const Row& r) {
+      return !a_is(r, [](long long a) { return a >= 100 && a <= 2000; });
+    });
+  check_filter(table, "a IN (7, 1, 2999, 1000, 5000)", [](const Row& r) {
+      return a_is(r, [](long long a) { return a == 1 || a == 7 || a == 1000 || a == 2999; });
+    });
+  check_filter(table, "a < 10 OR s IS NULL", [](const Row& r) {
+      return a_is(r, [](long long a) { return a < 10; }) || truth(!r.has_s);
+    });
+  check_filter(table, "a > 2000 AND s = 'row 2501'", [](const Row& r) {
+      return a_is(r, [](long long a) { return a > 2000; }) &&
+	(r.has_s ? truth(r.s == "row 2501") : UNKNOWN);
+    });
+  check_filter(table, "NOT (s < 'row 2' OR a > 100)", [](const Row& r) {
+      return !((r.has_s ? truth(r.s < "row 2") : UNKNOWN) ||
+	       a_is(r, [](long long a) { return a > 100; }));
+    });
+}
+
+// Filters select rows by truth value, with unknown rows selected for
+// neither, whether or not the selection starts with every row
+RegisterTest selects_by_truth_value("filter/selects_by_truth_value", [] {
+    unique_ptr<Table> table = make_table();
+    check_conditions(*table);
+  });
+
+// Deleted rows are never selected
+RegisterTest skips_deleted("filter/skips_deleted", [] {
+    unique_ptr<Table> table = make_table();
+    vector<size_t> erased;
+    for (size_t i = 0; i < ROWS; i += 3) {
+      erased.push_back(i);
+    }
+    table->erase(erased);
+    check_conditions(*table);
+  });
+
+}  // namespace
@@ -0,0 +1,120 @@
+// SimpleSQL: Join tests
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../exec/query.h"
+#include "../parser/parser.h"
+#include "../storage/catalog.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Parses script and applies its statements to catalog
+void run(Catalog& catalog, const string& script) {
+  vector<FlatToken> tokes;
+  tokenize_command(script, tokes);
+  Arena arena;
+  vector<const ASTNode*> statements = parse(tokes, arena);
+  for (auto it = statements.begin(); it != statements.end(); ++it) {
+    (*it)->accept(catalog);
+  }
+}
+
+// Runs the SELECT statement query on catalog and returns its rows, each
+// with its values separated by spaces, in sorted order
+vector<string> select(Catalog& catalog, const string& query) {
+  run(catalog, query);
+  std::unique_ptr<QueryResult> result = catalog.take_result();
+  vector<string> rows;
+  const Table& table = *result->rows;
+  for (size_t row = 0; row < table.rows(); ++row) {
+    if (table.is_deleted(row)) {
+      continue;
+    }
+    string text;
+    for (size_t i = 0; i < table.schema().size(); ++i) {
+      text += (i ? " " : "") + table.value(row, i).toString();
+    }
+    rows.push_back(text);
+  }
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+// Returns the rows of a query result written one after another
+string rows(const vector<string>& result) {
+  std::ostringstream text;
+  for (auto it = result.begin(); it != result.end(); ++it) {
+    text << "[" << *it << "]";
+  }
+  return text.str();
+}
+
+// Creates tables l (a INT, s VARCHAR) and r (d DOUBLE, u UNSIGNED, t
+// VARCHAR) whose numbers are equal across types in some rows only
+void create_tables(Catalog& catalog) {
+  run(catalog,
+      "CREATE TABLE l (a INT, s VARCHAR(8));"
+      "CREATE TABLE r (d DOUBLE, u UNSIGNED, t VARCHAR(8));"
+      "INSERT INTO l VALUES (1, 'x'), (2, 'y'), (3, 'z'), (NULL, 'n'), (0, 'm');"
+      "INSERT INTO r VALUES (1.0, 1, 'x'), (2.5, 2, 'q'), (3.0, 4, 'z'), (NULL, NULL, 'n');");
+}
+
+// Numbers of different types that are equal join, whether the key is
+// hashed or compared, and NULL keys join nothing
+RegisterTest mixed_numeric_keys("join/mixed_numeric_keys", [] {
+    Catalog catalog;
+    create_tables(catalog);
+    CHECK_EQ(string("[1 1.000000][3 3.000000]"),
+	     rows(select(catalog, "SELECT a, d FROM l JOIN r ON a = d;")));
+    CHECK_EQ(string("[1 1][2 2]"), rows(select(catalog, "SELECT a, u FROM l JOIN r ON u = a;")));
+    CHECK_EQ(string("[1 1 'x'][3 4 'z']"),
+	     rows(select(catalog, "SELECT a, u, t FROM l JOIN r ON a = d AND s = t;")));
+  });
+
+// Rows of an outer join's side that match nothing are kept once, with
+// NULLs for the other side, and rows that match are not
+RegisterTest outer_matched("join/outer_matched", [] {
+    Catalog catalog;
+    create_tables(catalog);
+    CHECK_EQ(string("[0 NULL][1 1.000000][2 NULL][3 3.000000][NULL NULL]"),
+	     rows(select(catalog, "SELECT a, d FROM l LEFT JOIN r ON a = d;")));
+    CHECK_EQ(string("[1 1.000000][3 3.000000][NULL 2.500000][NULL NULL]"),
+	     rows(select(catalog, "SELECT a, d FROM l RIGHT JOIN r ON a = d;")));
+    CHECK_EQ(string("[0 NULL][1 1.000000][2 NULL][3 3.000000][NULL 2.500000][NULL NULL]"
+		    "[NULL NULL]"),
+	     rows(select(catalog, "SELECT a, d FROM l FULL JOIN r ON a = d;")));
+  });
+
+// A row whose key matches but whose residual condition fails counts as
+// unmatched for an outer join
+RegisterTest residual_condition("join/residual_condition", [] {
+    Catalog catalog;
+    create_tables(catalog);
+    CHECK_EQ(string("[1 'x' 'x']"),
+	     rows(select(catalog, "SELECT a, s, t FROM l JOIN r ON a = u AND s = t;")));
+    CHECK_EQ(string("[0 'm' NULL][1 'x' 'x'][2 'y' NULL][3 'z' NULL][NULL 'n' NULL]"),
+	     rows(select(catalog, "SELECT a, s, t FROM l LEFT JOIN r ON a = u AND s = t;")));
+  });
+
+// Conditions with no equality between the tables are checked on every
+// pair of rows
+RegisterTest nested_loop("join/nested_loop", [] {
+    Catalog catalog;
+    create_tables(catalog);
+    CHECK_EQ(string("[1 2.500000][1 3.000000][2 2.500000][2 3.000000]"),
+	     rows(select(catalog, "SELECT a, d FROM l JOIN r ON a < d AND a > 0 AND d > 2;")));
+    CHECK_EQ(string("[1 'x'][3 'z']"),
+	     rows(select(catalog, "SELECT a, t FROM l JOIN r ON a = d OR a = u AND s = t;")));
+    CHECK_EQ(string("[0 NULL][1 1.000000][2 NULL][3 3.000000][NULL NULL]"),
+	     rows(select(catalog, "SELECT a, d FROM l LEFT JOIN r ON a = d OR d IS NULL AND a > 5;")));
+  });
+
+}  // namespace
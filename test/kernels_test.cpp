@@ -0,0 +1,165 @@
+// SimpleSQL: Comparison kernel tests
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../exec/kernels.h"
+
+using std::int64_t;
+using std::size_t;
+using std::string;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+namespace {
+
+const BinaryOp OPERATORS[] = {BinaryOp::EQUAL, BinaryOp::NEQUAL, BinaryOp::GTHAN,
+			      BinaryOp::LTHAN, BinaryOp::GEQ, BinaryOp::LEQ};
+
+// Row counts that end on, just before and just after the boundaries of
+// vectors and bitmap words
+const size_t ROW_COUNTS[] = {0, 1, 3, 4, 5, 31, 32, 33, 63, 64, 65, 100, 257};
+
+// Returns the result of comparing left with right by op
+template <typename T>
+bool compare(BinaryOp op, T left, T right) {
+  switch (op) {
+  case BinaryOp::EQUAL:
+    return left == right;
+  case BinaryOp::NEQUAL:
+    return left != right;
+  case BinaryOp::GTHAN:
+    return left > right;
+  case BinaryOp::LTHAN:
+    return left < right;
+  case BinaryOp::GEQ:
+    return left >= right;
+  default:
+    return left <= right;
+  }
+}
+
+// Returns count values of type T drawn from a few values at the edges of
+// the type's range and small values that repeat often, so that every
+// operator holds for some rows and not others
+template <typename T>
+vector<T> make_values(size_t count, std::mt19937_64& random) {
+  const vector<T> edges{std::numeric_limits<T>::lowest(), std::numeric_limits<T>::max(),
+      static_cast<T>(0), static_cast<T>(1),
+      static_cast<T>(std::numeric_limits<T>::max() / 2 + 1)};
+  vector<T> values;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t r = random();
+    values.push_back(r % 4 == 0 ? edges[r / 4 % edges.size()] : static_cast<T>(r / 4 % 8));
+  }
+  return values;
+}
+
+// As above, with NaN, infinities and negative zero among the doubles
+template <>
+vector<double> make_values<double>(size_t count, std::mt19937_64& random) {
+  const vector<double> edges{-std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN(),
+      -0.0, 0.0, 2.5, std::numeric_limits<double>::lowest()};
+  vector<double> values;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t r = random();
+    values.push_back(r % 4 == 0 ? edges[r / 4 % edges.size()] : (r / 4 % 8) * 0.5);
+  }
+  return values;
+}
+
+// Returns true if bit i of bits is set
+bool bit(const vector<uint64_t>& bits, size_t i) {
+  return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+// Reports a failure for the first row whose bit differs from the result
+// of comparing it directly, if any
+void check_bits(const string& kernel, const vector<uint64_t>& bits, size_t rows,
+		const std::function<bool(size_t)>& expected) {
+  for (size_t i = 0; i < rows; ++i) {
+    if (bit(bits, i) != expected(i)) {
+      report_failure(__FILE__, __LINE__, kernel + " differs at row " + std::to_string(i) +
+		     " of " + std::to_string(rows));
+      return;
+    }
+  }
+}
+
+// Checks the constant kernels for T at the current level against direct
+// comparisons, with constants drawn like the values
+template <typename T>
+void check_constant_kernels(const string& type, std::mt19937_64& random) {
+  for (size_t rows : ROW_COUNTS) {
+    vector<T> values = make_values<T>(rows + 1, random);
+    vector<T> constants = make_values<T>(8, random);
+    for (BinaryOp op : OPERATORS) {
+      ConstantKernel<T> kernel = constant_kernel<T>(op);
+      for (T constant : constants) {
+	vector<uint64_t> bits(rows / 64 + 1);
+	kernel(values.data(), constant, rows, bits.data());
+	check_bits(type + " constant kernel " + std::to_string(static_cast<int>(op)), bits, rows,
+		   [&](size_t i) { return compare(op, values[i], constant); });
+      }
+    }
+  }
+}
+
+// Checks the column kernels for T at the current level against direct
+// comparisons
+template <typename T>
+void check_column_kernels(const string& type, std::mt19937_64& random) {
+  for (size_t rows : ROW_COUNTS) {
+    vector<T> left = make_values<T>(rows + 1, random);
+    vector<T> right = make_values<T>(rows + 1, random);
+    for (BinaryOp op : OPERATORS) {
+      vector<uint64_t> bits(rows / 64 + 1);
+      column_kernel<T>(op)(left.data(), right.data(), rows, bits.data());
+      check_bits(type + " column kernel " + std::to_string(static_cast<int>(op)), bits, rows,
+		 [&](size_t i) { return compare(op, left[i], right[i]); });
+    }
+  }
+}
+
+// Checks every kernel at the current level
+void check_kernels() {
+  std::mt19937_64 random(42);
+  check_constant_kernels<int64_t>("int64", random);
+  check_constant_kernels<uint64_t>("uint64", random);
+  check_constant_kernels<double>("double", random);
+  check_constant_kernels<uint8_t>("uint8", random);
+  check_constant_kernels<uint16_t>("uint16", random);
+  check_constant_kernels<uint32_t>("uint32", random);
+  check_column_kernels<int64_t>("int64", random);
+  check_column_kernels<uint64_t>("uint64", random);
+  check_column_kernels<double>("double", random);
+  check_column_kernels<uint8_t>("uint8", random);
+}
+
+// The scalar kernels agree with comparing values one by one
+RegisterTest scalar("kernels/scalar", [] {
+    KernelLevel level = kernel_level();
+    CHECK(set_kernel_level(KernelLevel::SCALAR));
+    check_kernels();
+    set_kernel_level(level);
+  });
+
+// The AVX2 kernels agree with comparing values one by one, and so with
+// the scalar kernels, on CPUs that have them
+RegisterTest avx2("kernels/avx2", [] {
+    KernelLevel level = kernel_level();
+    if (set_kernel_level(KernelLevel::AVX2)) {
+      check_kernels();
+    }
+    set_kernel_level(level);
+  });
+
+}  // namespace
@@ -0,0 +1,131 @@
+// SimpleSQL: Sort tests
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../exec/morsel.h"
+#include "../exec/sort.h"
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns a table of the given number of rows with a nullable integer k
+// that repeats often, a nullable string s, a double d and an unsigned u,
+// with negative numbers, unsigned values past the largest integer, and
+// strings that are prefixes of others
+unique_ptr<Table> make_table(size_t rows) {
+  Schema schema;
+  schema.add_column(ColumnSchema{"k", INT_T, 0, true, nullptr});
+  schema.add_column(ColumnSchema{"s", VARCHAR_T, 20, true, nullptr});
+  schema.add_column(ColumnSchema{"d", DOUBLE_T, 0, false, nullptr});
+  schema.add_column(ColumnSchema{"u", UINT_T, 0, false, nullptr});
+  unique_ptr<Table> table(new Table("t", schema));
+  vector<vector<Value>> values;
+  vector<string> strings(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    strings[i] = string(i % 3, 'a') + std::to_string(i % 101);
+    values.push_back(vector<Value>{
+	i % 7 == 0 ? Value() : Value(static_cast<long long>(i % 23) - 11),
+	i % 5 == 0 ? Value() : Value(strings[i].data(), strings[i].size()),
+	Value((static_cast<double>(i % 37) - 18) * 0.75),
+	Value(i % 2 ? ~0ull - i % 17 : static_cast<unsigned long long>(i % 17))});
+  }
+  table->append(values);
+  return table;
+}
+
+// Compares two values of one column as index keys do: NULLs first,
+// numbers by value and strings bytewise
+int compare_values(const Value& a, const Value& b) {
+  if (a.is_null() || b.is_null()) {
+    return b.is_null() - a.is_null();
+  }
+  switch (a.type()) {
+  case ValueType::INT:
+    return (a.int_value() > b.int_value()) - (a.int_value() < b.int_value());
+  case ValueType::UINT:
+    return (a.uint_value() > b.uint_value()) - (a.uint_value() < b.uint_value());
+  case ValueType::DOUBLE:
+    return (a.double_value() > b.double_value()) - (a.double_value() < b.double_value());
+  default:
+    return a.string_value().compare(b.string_value());
+  }
+}
+
+// Returns every row of table in the order sort_rows gives them, found with
+// a stable sort
+vector<size_t> expected_order(const Table& table, const vector<SortKey>& keys) {
+  vector<size_t> rows(table.rows());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i] = i;
+  }
+  std::stable_sort(rows.begin(), rows.end(), [&](size_t a, size_t b) {
+      for (auto it = keys.begin(); it != keys.end(); ++it) {
+	int order = compare_values(table.value(a, it->column), table.value(b, it->column));
+	if (order != 0) {
+	  return it->descending ? order > 0 : order < 0;
+	}
+      }
+      return false;
+    });
+  return rows;
+}
+
+// Sorts every row of table by keys, keeping the first limit, on pool
+vector<size_t> sorted(const Table& table, const vector<SortKey>& keys, size_t limit,
+		      ThreadPool *pool) {
+  vector<size_t> rows(table.rows());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i] = i;
+  }
+  sort_rows(table, rows, keys, limit, pool);
+  return rows;
+}
+
+// Checks that every sort of table by keys, whole or limited, on one
+// thread or on pool, gives the rows in the order of a stable sort
+void check_sorts(const Table& table, const vector<SortKey>& keys, ThreadPool& pool) {
+  const vector<size_t> expected = expected_order(table, keys);
+  CHECK(sorted(table, keys, expected.size(), nullptr) == expected);
+  CHECK(sorted(table, keys, expected.size(), &pool) == expected);
+  const size_t limit = expected.size() / 3;
+  const vector<size_t> first(expected.begin(), expected.begin() + limit);
+  CHECK(sorted(table, keys, limit, nullptr) == first);
+  CHECK(sorted(table, keys, limit, &pool) == first);
+}
+
+// NULLs come first in ascending order and last in descending order, and
+// each type of key is encoded to sort by value, whatever its direction
+RegisterTest null_and_desc_keys("sort/null_and_desc_keys", [] {
+    unique_ptr<Table> table = make_table(2000);
+    ThreadPool pool(4);
+    for (size_t column = 0; column < table->schema().size(); ++column) {
+      check_sorts(*table, vector<SortKey>{{column, false}}, pool);
+      check_sorts(*table, vector<SortKey>{{column, true}}, pool);
+    }
+    check_sorts(*table, vector<SortKey>{{1, true}, {0, false}, {2, true}}, pool);
+    check_sorts(*table, vector<SortKey>{{3, false}, {1, false}}, pool);
+  });
+
+// Sorts whose keys outgrow the memory limit spill runs and merge them
+// back in order, keeping equal keys in row order
+RegisterTest spills_runs("sort/spills_runs", [] {
+    unique_ptr<Table> table = make_table(3 * MORSEL_ROWS);
+    ThreadPool pool(4);
+    const size_t memory = sort_memory_limit();
+    set_sort_memory_limit(1 << 16);
+    vector<SortKey> keys{{0, true}, {1, false}};
+    const vector<size_t> expected = expected_order(*table, keys);
+    CHECK(sorted(*table, keys, expected.size(), nullptr) == expected);
+    CHECK(sorted(*table, keys, expected.size(), &pool) == expected);
+    set_sort_memory_limit(memory);
+  });
+
+}  // namespace
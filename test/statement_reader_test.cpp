@@ -0,0 +1,113 @@
+// SimpleSQL: Statement reader tests
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../lexer/statement_reader.h"
+#include "../parser/parser.h"
+#include "../storage/catalog.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Returns an INSERT of the given number of rows into t
+const string long_insert(size_t rows) {
+  std::ostringstream statement;
+  statement << "INSERT INTO t VALUES ";
+  for (size_t i = 0; i < rows; ++i) {
+    statement << (i ? ", " : "") << "(" << i << ", 'row " << i << "')";
+  }
+  statement << ";";
+  return statement.str();
+}
+
+// Returns true if both token lists have the same types and spans
+bool same_tokens(const vector<FlatToken>& a, const vector<FlatToken>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].type != b[i].type || a[i].text.str() != b[i].text.str()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A statement longer than the buffer comes back in pieces, which complete()
+// joins into the statement's tokens
+RegisterTest reader_joins_pieces("statement_reader/joins_pieces", [] {
+    const string statement = long_insert(500);
+    std::istringstream input("SELECT a FROM t; " + statement + " SELECT b FROM t;");
+    StatementReader reader(input, 256);
+    vector<FlatToken> tokes;
+    vector<FlatToken> expected;
+
+    CHECK(reader.next(tokes));
+    CHECK(!reader.partial());
+    CHECK(reader.next(tokes));
+    CHECK(reader.partial());
+    reader.complete(tokes);
+    CHECK(!reader.partial());
+    tokenize_command(statement, expected);
+    CHECK(same_tokens(expected, tokes));
+
+    CHECK(reader.next(tokes));
+    reader.complete(tokes);
+    const string last = "SELECT b FROM t;";
+    expected.clear();
+    tokenize_command(last, expected);
+    CHECK(same_tokens(expected, tokes));
+    CHECK(!reader.next(tokes));
+    CHECK_EQ(3u, reader.statements_read());
+  });
+
+// A statement whose tokens hold more text than the reader joins is
+// skipped, and the statements after it are read as usual
+RegisterTest reader_skips_oversized("statement_reader/skips_oversized", [] {
+    const string statement = long_insert(500);
+    std::istringstream input(statement + " SELECT b FROM t;");
+    StatementReader reader(input, 256, 1024);
+    vector<FlatToken> tokes;
+    CHECK(reader.next(tokes));
+    CHECK(reader.partial());
+    CHECK(!reader.complete(tokes));
+    CHECK(tokes.empty());
+    CHECK(!reader.partial());
+
+    CHECK(reader.next(tokes));
+    CHECK(reader.complete(tokes));
+    vector<FlatToken> expected;
+    const string last = "SELECT b FROM t;";
+    tokenize_command(last, expected);
+    CHECK(same_tokens(expected, tokes));
+    CHECK(!reader.next(tokes));
+  });
+
+// Every row of an INSERT longer than the buffer is loaded
+RegisterTest reader_loads_long_insert("statement_reader/loads_long_insert", [] {
+    std::istringstream input("CREATE TABLE t (a INT, b VARCHAR(20)); " + long_insert(2000));
+    StatementReader reader(input, 1024);
+    vector<FlatToken> tokes;
+    Catalog catalog;
+    Arena arena;
+    while (reader.next(tokes)) {
+      reader.complete(tokes);
+      vector<const ASTNode*> statements = parse(tokes, arena);
+      for (auto it = statements.begin(); it != statements.end(); ++it) {
+	(*it)->accept(catalog);
+      }
+      arena.reset();
+    }
+    const Table *table = catalog.table("t");
+    CHECK(table != nullptr);
+    if (table) {
+      CHECK_EQ(2000u, table->rows());
+      CHECK_EQ(string("1999"), table->value(1999, 0).toString());
+    }
+  });
+
+}  // namespace
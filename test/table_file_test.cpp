@@ -0,0 +1,262 @@
+// SimpleSQL: Table file tests
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../parser/parser.h"
+#include "../storage/buffer_pool.h"
+#include "../storage/catalog.h"
+#include "../storage/table_file.h"
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns a table of the given number of rows, with an integer key, a
+// nullable string, a double and an enum, split into small chunks
+unique_ptr<Table> make_table(const string& name, size_t rows, size_t chunk_rows) {
+  Schema schema;
+  schema.add_column(ColumnSchema{"id", INT_T, 0, false, nullptr});
+  schema.add_column(ColumnSchema{"label", VARCHAR_T, 40, true, nullptr});
+  schema.add_column(ColumnSchema{"score", DOUBLE_T, 0, false, nullptr});
+  schema.add_column(ColumnSchema{"color", ENUM_T, 0, true,
+	std::make_shared<Dictionary>(vector<string>{"red", "green", "blue"})});
+  schema.set_primary_key(vector<string>{"id"});
+  unique_ptr<Table> table(new Table(name, schema, chunk_rows));
+  vector<vector<Value>> values;
+  vector<string> labels(rows);
+  const char *colors[] = {"red", "green", "blue"};
+  for (size_t i = 0; i < rows; ++i) {
+    labels[i] = "label " + std::to_string(i);
+    values.push_back(vector<Value>{
+	Value(static_cast<long long>(i)),
+	i % 7 == 0 ? Value() : Value(labels[i].data(), labels[i].size()),
+	Value(i * 0.5),
+	i % 11 == 0 ? Value() : Value(colors[i % 3], std::strlen(colors[i % 3]))});
+  }
+  table->append(values);
+  return table;
+}
+
+// Returns the live rows of table, one string per row
+vector<string> live_rows(const Table& table) {
+  vector<string> rows;
+  for (size_t row = 0; row < table.rows(); ++row) {
+    if (table.is_deleted(row)) {
+      continue;
+    }
+    string text;
+    for (size_t i = 0; i < table.schema().size(); ++i) {
+      text += table.value(row, i).toString() + "|";
+    }
+    rows.push_back(text);
+  }
+  return rows;
+}
+
+// Parses script and applies its statements to catalog
+void run(Catalog& catalog, const string& script) {
+  vector<FlatToken> tokes;
+  tokenize_command(script, tokes);
+  Arena arena;
+  vector<const ASTNode*> statements = parse(tokes, arena);
+  for (auto it = statements.begin(); it != statements.end(); ++it) {
+    (*it)->accept(catalog);
+  }
+}
+
+// Runs the SELECT statement query on catalog and returns its rows, each in
+// brackets with its values separated by spaces
+string select(Catalog& catalog, const string& query) {
+  run(catalog, query);
+  unique_ptr<QueryResult> result = catalog.take_result();
+  const Table& table = *result->rows;
+  string rows;
+  for (size_t row = 0; row < table.rows(); ++row) {
+    rows += "[";
+    for (size_t i = 0; i < table.schema().size(); ++i) {
+      rows += (i ? " " : "") + table.value(row, i).toString();
+    }
+    rows += "]";
+  }
+  return rows;
+}
+
+// A saved database opens with the same live rows, primary keys and
+// indexes, and the LSN it was saved with
+RegisterTest round_trip("table_file/round_trip", [] {
+    const string path = scratch_path();
+    Catalog saved;
+    {
+      unique_ptr<Table> table = make_table("t", 2500, 1000);
+      vector<size_t> erased{0, 5, 999, 1000, 2499};
+      table->erase(erased);
+      table->create_index("t_label", IndexKind::ORDERED, vector<string>{"label"});
+      PageFile file(path);
+      BufferPool pool(file, 1 << 20);
+      vector<const Table*> tables{table.get()};
+      file.set_root(save_database(pool, tables, 42));
+      pool.flush_all();
+      file.sync();
+    }
+
+    unique_ptr<Table> expected = make_table("t", 2500, 1000);
+    expected->erase(vector<size_t>{0, 5, 999, 1000, 2499});
+    const SecondaryIndex& expected_index =
+      expected->create_index("t_label", IndexKind::ORDERED, vector<string>{"label"});
+    {
+      PageFile file(path);
+      Catalog loaded;
+      CHECK_EQ(42u, loaded.open(file));
+      const Table *table = loaded.table("t");
+      CHECK(table != nullptr);
+      if (!table) {
+	return;
+      }
+      CHECK(live_rows(*expected) == live_rows(*table));
+      // Deleted rows keep their numbers
+      CHECK_EQ(2500u, table->rows());
+      CHECK_EQ(5u, table->deleted_rows());
+      CHECK_EQ(1000u, table->chunk_rows());
+      size_t row;
+      CHECK(table->find(vector<Value>{Value(7LL)}, row));
+      CHECK(!table->find(vector<Value>{Value(5LL)}, row));
+      const SecondaryIndex *index = table->index("t_label");
+      CHECK(index != nullptr);
+      if (index) {
+	CHECK_EQ(expected_index.size(), index->size());
+	CHECK(index->kind() == IndexKind::ORDERED);
+      }
+      // Nothing changed, so saving again writes no chunk
+      loaded.save(43);
+      CHECK_EQ(0u, loaded.store()->chunks_written());
+    }
+
+    // Opening the file again agrees
+    PageFile file(path);
+    Catalog reloaded;
+    CHECK_EQ(43u, reloaded.open(file));
+    CHECK(reloaded.table("t") != nullptr);
+    if (reloaded.table("t")) {
+      CHECK(live_rows(*expected) == live_rows(*reloaded.table("t")));
+    }
+    std::remove(path.c_str());
+  });
+
+// A table kept in a file with a budget smaller than one of its chunks
+// writes its chunks to the file as they fill, reads them back through the
+// pool when statements use them, and pages them out again once they are
+// done. Its changes are written back when it is saved, and only the
+// chunks they touched are written.
+RegisterTest pages_chunks("table_file/pages_chunks", [] {
+    const string path = scratch_path();
+    const size_t rows = 4 * Table::DEFAULT_CHUNK_ROWS;
+    const size_t budget = 1 << 20;
+    long long low_sum = 0;
+    size_t low_rows = 0;
+    for (size_t i = 1000; i < rows; ++i) {
+      if (i % 100 < 10) {
+	low_sum += i % 100;
+	++low_rows;
+      }
+    }
+    const string low = "[" + std::to_string(low_rows) + " " + std::to_string(low_sum) + "]";
+    {
+      PageFile file(path);
+      Catalog catalog;
+      CHECK_EQ(0u, catalog.open(file, budget));
+      const TableStore& store = *catalog.store();
+      run(catalog, "CREATE TABLE t (id INT, v INT, label VARCHAR(20), PRIMARY KEY (id));");
+      Table& table = *catalog.table("t");
+      vector<vector<Value>> values;
+      vector<string> labels(rows);
+      for (size_t i = 0; i < rows; ++i) {
+	labels[i] = "label " + std::to_string(i);
+	values.push_back(vector<Value>{Value(static_cast<long long>(i)),
+	      Value(static_cast<long long>(i % 100)), Value(labels[i].data(), labels[i].size())});
+      }
+      table.append(values);
+      CHECK(store.chunks_written() >= 3);
+      CHECK(store.resident_bytes() <= store.chunk_budget());
+
+      run(catalog, "DELETE FROM t WHERE id < 1000;");
+      CHECK_EQ(string("[0]"), select(catalog, "SELECT COUNT(*) FROM t WHERE v > 100;"));
+      CHECK(store.chunks_read() >= 4);
+      CHECK(store.resident_bytes() <= store.chunk_budget());
+      CHECK_EQ(low, select(catalog, "SELECT COUNT(*), SUM(v) FROM t WHERE v < 10;"));
+      run(catalog, "UPDATE t SET label = 'changed' WHERE id = 70000;");
+      const size_t written = store.chunks_written();
+      catalog.save(9);
+      // The first chunk, with the deleted rows, and the last, with the
+      // updated row, were changed since they were last paged out
+      CHECK(store.chunks_written() - written <= 2);
+    }
+
+    PageFile file(path);
+    Catalog catalog;
+    CHECK_EQ(9u, catalog.open(file, budget));
+    CHECK_EQ(string("[3]"), select(catalog, "SELECT COUNT(*) FROM t WHERE id BETWEEN 998 AND 1002;"));
+    CHECK_EQ(string("[70000 0 'changed']"), select(catalog, "SELECT * FROM t WHERE id = 70000;"));
+    CHECK_EQ(string("[1 'label 70001']"), select(catalog, "SELECT COUNT(*), label FROM t WHERE id = 70001 GROUP BY label;"));
+    CHECK_EQ(low, select(catalog, "SELECT COUNT(*), SUM(v) FROM t WHERE v < 10;"));
+    CHECK(catalog.store()->resident_bytes() > 0);
+    run(catalog, "DROP TABLE t;");
+    CHECK_EQ(0u, catalog.store()->resident_bytes());
+    std::remove(path.c_str());
+  });
+
+// A saved table is scanned a chunk at a time through a buffer pool much
+// smaller than the table, which reads its pages from the file
+RegisterTest scan_through_pool("table_file/scan_through_pool", [] {
+    const string path = scratch_path();
+    const size_t rows = 100000;
+    PageId directory;
+    {
+      unique_ptr<Table> table = make_table("big", rows, 8192);
+      PageFile file(path);
+      BufferPool pool(file, 4 << 20);
+      directory = save_table(pool, *table);
+      pool.flush_all();
+    }
+
+    PageFile file(path);
+    const size_t frames = 32;
+    BufferPool pool(file, frames * file.page_size());
+    TableReader reader(pool, directory);
+    CHECK_EQ(string("big"), reader.name());
+    CHECK_EQ(4u, reader.schema().size());
+    vector<vector<Value>> chunk;
+    size_t scanned = 0;
+    long long id_sum = 0;
+    size_t null_labels = 0;
+    size_t chunks = 0;
+    while (reader.next(chunk)) {
+      ++chunks;
+      for (auto it = chunk.begin(); it != chunk.end(); ++it) {
+	id_sum += (*it)[0].int_value();
+	null_labels += (*it)[1].is_null();
+	if (!(*it)[1].is_null()) {
+	  CHECK_EQ("label " + std::to_string((*it)[0].int_value()),
+		   string((*it)[1].string_data(), (*it)[1].string_length()));
+	}
+      }
+      scanned += chunk.size();
+    }
+    CHECK_EQ(rows, scanned);
+    CHECK_EQ((rows + 8191) / 8192, chunks);
+    CHECK_EQ(static_cast<long long>(rows * (rows - 1) / 2), id_sum);
+    CHECK_EQ((rows + 6) / 7, null_labels);
+    CHECK_EQ(frames, pool.frames());
+    // Every page came from the file, and the table did not fit in the pool
+    CHECK(pool.misses() > frames);
+    CHECK(pool.evictions() > 0);
+    std::remove(path.c_str());
+  });
+
+}  // namespace
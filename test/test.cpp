@@ -0,0 +1,51 @@
+// SimpleSQL: Test harness
+
+#include "test.h"
+#include <cstdio>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+// Returns every registered test, in registration order
+vector<Test>& tests() {
+  static vector<Test> all;
+  return all;
+}
+
+RegisterTest::RegisterTest(const string& name, std::function<void()> body) {
+  tests().push_back(Test{name, body});
+}
+
+namespace {
+
+// The number of failed checks so far
+std::size_t failures = 0;
+
+}  // namespace
+
+// Prints a failed check. The runner counts a test as failed once any of its
+// checks is reported.
+void report_failure(const char *file, int line, const string& message) {
+  ++failures;
+  std::cout << "  " << file << ":" << line << ": " << message << std::endl;
+}
+
+// Returns the number of failed checks reported since the program started
+std::size_t failure_count() {
+  return failures;
+}
+
+// Returns the path of a file that does not exist yet, for tests that need
+// one. The caller removes the file when done.
+const string scratch_path() {
+  char path[] = "/tmp/simplesql_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  std::remove(path);
+  return path;
+}
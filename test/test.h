@@ -0,0 +1,54 @@
+// SimpleSQL: Test harness
+//
+// Tests register themselves with a name and a body. The runner calls each
+// body in turn and reports the checks that failed; a test passes when its
+// body returns without a failed check or an escaping exception.
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <cstddef>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A registered test
+struct Test {
+  std::string name;
+  std::function<void()> body;
+};
+
+std::vector<Test>& tests();
+void report_failure(const char *file, int line, const std::string& message);
+std::size_t failure_count();
+const std::string scratch_path();
+
+// Registers a test when constructed. Meant to be used for static objects in
+// the files defining the tests.
+class RegisterTest {
+ public:
+  RegisterTest(const std::string& name, std::function<void()> body);
+};
+
+// Records a failure if condition is false, and carries on with the test
+#define CHECK(condition)						\
+  do {									\
+    if (!(condition)) {							\
+      report_failure(__FILE__, __LINE__, #condition);			\
+    }									\
+  } while (0)
+
+// Records a failure if expected != actual, printing both, and carries on
+#define CHECK_EQ(expected, actual)					\
+  do {									\
+    const auto& __expected = (expected);				\
+    const auto& __actual = (actual);					\
+    if (!(__expected == __actual)) {					\
+      std::ostringstream __message;					\
+      __message << #actual << " is " << __actual << ", expected " << __expected; \
+      report_failure(__FILE__, __LINE__, __message.str());		\
+    }									\
+  } while (0)
+
+#endif  // __TEST_H__
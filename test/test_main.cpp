@@ -0,0 +1,65 @@
+// SimpleSQL: Test runner
+//
+// Usage: simple_test [--list] [filter...]
+// Runs every registered test whose name contains one of the filters, or
+// all of them if there are none. Exits with a nonzero status if any failed.
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "test.h"
+
+using std::string;
+using std::vector;
+
+int main(int argc, char **argv) {
+  bool list = false;
+  vector<string> filters;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--list") {
+      list = true;
+    } else {
+      filters.push_back(arg);
+    }
+  }
+
+  // Registration order depends on link order, so sort for stable output
+  vector<Test> all = tests();
+  std::stable_sort(all.begin(), all.end(), [](const Test& a, const Test& b) {
+      return a.name < b.name;
+    });
+  std::size_t run = 0;
+  std::size_t failed = 0;
+  for (auto it = all.begin(); it != all.end(); ++it) {
+    bool selected = filters.empty();
+    for (auto filter = filters.begin(); filter != filters.end() && !selected; ++filter) {
+      selected = it->name.find(*filter) != string::npos;
+    }
+    if (!selected) {
+      continue;
+    }
+    if (list) {
+      std::cout << it->name << std::endl;
+      continue;
+    }
+    std::cout << it->name << std::endl;
+    std::size_t failures_before = failure_count();
+    try {
+      it->body();
+    } catch (const std::exception& e) {
+      report_failure(__FILE__, __LINE__, string("uncaught exception: ") + e.what());
+    }
+    ++run;
+    if (failure_count() != failures_before) {
+      std::cout << "FAILED " << it->name << std::endl;
+      ++failed;
+    }
+  }
+  if (!list) {
+    std::cout << run - failed << " of " << run << " test(s) passed" << std::endl;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+// SimpleSQL: Zone tests
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "test.h"
+#include "../AST/select.h"
+#include "../exec/filter.h"
+#include "../parser/parser.h"
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const size_t CHUNK_ROWS = 4 * ZONE_ROWS;
+const size_t ROWS = 2 * CHUNK_ROWS;
+
+// Returns a table of ROWS rows whose integer id is the row number, with a
+// nullable integer v that is null in the even rows of zone 5 only, in
+// chunks of four zones
+unique_ptr<Table> make_table() {
+  Schema schema;
+  schema.add_column(ColumnSchema{"id", INT_T, 0, false, nullptr});
+  schema.add_column(ColumnSchema{"v", INT_T, 0, true, nullptr});
+  unique_ptr<Table> table(new Table("t", schema, CHUNK_ROWS));
+  vector<vector<Value>> values;
+  for (size_t i = 0; i < ROWS; ++i) {
+    bool null = i / ZONE_ROWS == 5 && i % 2 == 0;
+    values.push_back(vector<Value>{Value(static_cast<long long>(i)),
+	  null ? Value() : Value(static_cast<long long>(i % 100))});
+  }
+  table->append(values);
+  return table;
+}
+
+// Returns the rows from first to last
+vector<size_t> row_range(size_t first, size_t last) {
+  vector<size_t> rows;
+  for (size_t i = first; i <= last; ++i) {
+    rows.push_back(i);
+  }
+  return rows;
+}
+
+// Returns, for every batch of table in order, whether the zones of its
+// columns let condition hold for any of its rows, as a string of 1s and 0s
+string batches_kept(const Table& table, const string& condition) {
+  Arena arena;
+  vector<FlatToken> tokes;
+  tokenize_command("SELECT * FROM t WHERE " + condition + ";", tokes);
+  const ASTNode *statement = parse(tokes, arena).front();
+  const Select *select = static_cast<const Select*>(statement);
+  unique_ptr<Filter> filter = compile_filter(table, select->exp()->where_expr()->condition(),
+					     vector<Value>());
+  string kept;
+  for (size_t c = 0; c < table.chunk_count(); ++c) {
+    const Chunk& chunk = table.chunk(c);
+    for (size_t offset = 0; offset < chunk.size(); offset += BATCH_SIZE) {
+      Batch batch{&chunk, offset, std::min(BATCH_SIZE, chunk.size() - offset)};
+      kept += filter->may_select(batch) ? "1" : "0";
+    }
+  }
+  return kept;
+}
+
+// Deleting rows narrows the zones they were in to the rows left, and a zone
+// left empty rules out every condition
+RegisterTest skip_after_delete("zones/skip_after_delete", [] {
+    unique_ptr<Table> table = make_table();
+    CHECK_EQ(string("01000000"), batches_kept(*table, "id BETWEEN 1500 AND 1600"));
+    table->erase(row_range(1024, 1700));
+    CHECK_EQ(string("00000000"), batches_kept(*table, "id BETWEEN 1500 AND 1600"));
+    CHECK_EQ(string("01000000"), batches_kept(*table, "id BETWEEN 1600 AND 1800"));
+    const Zone& zone = table->chunk(0).column(0).zone(1);
+    CHECK_EQ(string("1701"), zone.low.toString());
+    CHECK_EQ(string("2047"), zone.high.toString());
+
+    table->erase(row_range(2048, 3071));
+    CHECK_EQ(string("00000000"), batches_kept(*table, "id >= 2048 AND id < 3072"));
+    CHECK_EQ(string("11011111"), batches_kept(*table, "v IS NULL OR v IS NOT NULL"));
+  });
+
+// A zone whose null rows are deleted no longer holds for IS NULL, and one
+// whose other rows are deleted no longer holds for comparisons
+RegisterTest skip_nulls_after_delete("zones/skip_nulls_after_delete", [] {
+    unique_ptr<Table> table = make_table();
+    CHECK_EQ(string("00000100"), batches_kept(*table, "v IS NULL"));
+    vector<size_t> nulls;
+    for (size_t i = 5 * ZONE_ROWS; i < 6 * ZONE_ROWS; i += 2) {
+      nulls.push_back(i);
+    }
+    table->erase(nulls);
+    CHECK_EQ(string("00000000"), batches_kept(*table, "v IS NULL"));
+
+    unique_ptr<Table> other = make_table();
+    vector<size_t> values;
+    for (size_t i = 5 * ZONE_ROWS + 1; i < 6 * ZONE_ROWS; i += 2) {
+      values.push_back(i);
+    }
+    other->erase(values);
+    CHECK_EQ(string("11111011"), batches_kept(*other, "v >= 0"));
+    CHECK_EQ(string("00000100"), batches_kept(*other, "v IS NULL"));
+  });
+
+// Updated rows leave the zones of their old versions, which are narrowed
+// to the rows left, and their new versions widen the zones they are
+// appended to
+RegisterTest skip_after_update("zones/skip_after_update", [] {
+    unique_ptr<Table> table = make_table();
+    table->update(row_range(3 * ZONE_ROWS, 4 * ZONE_ROWS - 1),
+		  vector<std::pair<size_t, Value>>{{0, Value(100000ll)}});
+    table->update(row_range(4 * ZONE_ROWS, 4 * ZONE_ROWS + 9),
+		  vector<std::pair<size_t, Value>>{{0, Value(200000ll)}});
+    CHECK_EQ(string("0000000000"), batches_kept(*table, "id BETWEEN 3100 AND 3200"));
+    CHECK_EQ(string("0000000000"), batches_kept(*table, "id BETWEEN 4096 AND 4105"));
+    CHECK_EQ(string("0000100000"), batches_kept(*table, "id BETWEEN 4096 AND 4110"));
+    CHECK_EQ(string("0000000011"), batches_kept(*table, "id >= 100000"));
+    CHECK_EQ(string("0000000001"), batches_kept(*table, "id = 200000"));
+    const Zone& zone = table->chunk(1).column(0).zone(0);
+    CHECK_EQ(string("4106"), zone.low.toString());
+  });
+
+}  // namespace
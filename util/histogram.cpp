@@ -0,0 +1,99 @@
+// SimpleSQL: Histogram
+
+#include "histogram.h"
+
+using std::size_t;
+using std::uint64_t;
+
+namespace {
+
+// Each power of two is split into 2^SUB_BITS buckets
+const unsigned SUB_BITS = 4;
+const size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+const size_t BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+// Returns the position of the highest set bit of value, which is not 0
+unsigned log2(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+
+}  // namespace
+
+Histogram::Histogram() : _buckets(BUCKETS, 0), _count(0), _max(0), _sum(0.0) {}
+
+// Counts value
+void Histogram::record(uint64_t value) {
+  ++_buckets[bucket(value)];
+  ++_count;
+  _sum += static_cast<double>(value);
+  if (value > _max) {
+    _max = value;
+  }
+}
+
+// Returns the number of values counted
+uint64_t Histogram::count() const {
+  return _count;
+}
+
+// Returns the largest value counted, or 0 if there are none
+uint64_t Histogram::max() const {
+  return _max;
+}
+
+// Returns the mean of the values counted, or 0 if there are none
+double Histogram::mean() const {
+  return _count ? _sum / _count : 0.0;
+}
+
+// Returns an approximation of the value below which the given percentage
+// of the values fall, or 0 if there are none. The result is the middle of
+// the bucket holding that value, but never more than the largest value.
+uint64_t Histogram::percentile(double percent) const {
+  if (_count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(percent / 100.0 * _count);
+  if (rank >= _count) {
+    rank = _count - 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < _buckets.size(); ++i) {
+    seen += _buckets[i];
+    if (seen > rank) {
+      uint64_t low = lower_bound(i);
+      uint64_t high = i + 1 < _buckets.size() ? lower_bound(i + 1) - 1 : UINT64_MAX;
+      uint64_t middle = low + (high - low) / 2;
+      return middle < _max ? middle : _max;
+    }
+  }
+  return _max;
+}
+
+// Forgets every value counted
+void Histogram::reset() {
+  _buckets.assign(BUCKETS, 0);
+  _count = 0;
+  _max = 0;
+  _sum = 0.0;
+}
+
+// Returns the bucket counting value. Values below SUB_BUCKETS have a
+// bucket each; above that, the bucket is chosen by the highest set bit and
+// the SUB_BITS bits after it.
+size_t Histogram::bucket(uint64_t value) {
+  if (value < SUB_BUCKETS) {
+    return static_cast<size_t>(value);
+  }
+  unsigned shift = log2(value) - SUB_BITS;
+  return (shift + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+}
+
+// Returns the smallest value counted by the given bucket
+uint64_t Histogram::lower_bound(size_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS - 1);
+  return (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
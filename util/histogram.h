@@ -0,0 +1,34 @@
+// SimpleSQL: Histogram
+//
+// Counts values, such as latencies in nanoseconds, in logarithmic buckets
+// each split into 16 linear sub-buckets, so percentiles are accurate to
+// within about 6% of the value at any scale while the histogram stays a
+// fixed, small size. Not thread safe.
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Histogram {
+ public:
+  Histogram();
+  void record(std::uint64_t value);
+  std::uint64_t count() const;
+  std::uint64_t max() const;
+  double mean() const;
+  std::uint64_t percentile(double percent) const;
+  void reset();
+ private:
+  static std::size_t bucket(std::uint64_t value);
+  static std::uint64_t lower_bound(std::size_t bucket);
+
+  std::vector<std::uint64_t> _buckets;
+  std::uint64_t _count;
+  std::uint64_t _max;
+  double _sum;
+};
+
+#endif  // __HISTOGRAM_H__
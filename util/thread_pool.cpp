@@ -0,0 +1,260 @@
+// SimpleSQL: Thread pool
+
+#include "thread_pool.h"
+
+using std::size_t;
+using std::unique_lock;
+using std::mutex;
+
+namespace {
+
+// The pool the calling thread is a worker of, if any, and its position
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+// Starts a pool with the given number of worker threads
+ThreadPool::ThreadPool(size_t threads)
+  : _next_queue(0), _queued(0), _outstanding(0), _stopping(false) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    _queues.emplace_back(new Queue());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    _workers.push_back(std::thread(&ThreadPool::work, this, i));
+  }
+}
+
+// Finishes the tasks already submitted, then stops the workers
+ThreadPool::~ThreadPool() {
+  {
+    unique_lock<mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _task_ready.notify_all();
+  for (auto it = _workers.begin(); it != _workers.end(); ++it) {
+    it->join();
+  }
+}
+
+// Queues task to run on one of the workers: on the calling thread's own
+// deque if it is a worker, or else on the next worker's in turn
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    unique_lock<mutex> lock(_mutex);
+    ++_outstanding;
+  }
+  size_t index = worker();
+  if (index == size()) {
+    index = _next_queue++ % size();
+  }
+  {
+    Queue& queue = *_queues[index];
+    unique_lock<mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  ++_queued;
+  {
+    // Taken so that a worker about to sleep sees the task or the signal
+    unique_lock<mutex> lock(_mutex);
+  }
+  _task_ready.notify_one();
+}
+
+// Blocks until every submitted task has finished. If any task threw, the
+// first exception thrown is rethrown here.
+void ThreadPool::wait() {
+  unique_lock<mutex> lock(_mutex);
+  _all_done.wait(lock, [this] { return _outstanding == 0; });
+  if (_error) {
+    std::exception_ptr error = _error;
+    _error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+// Returns the number of worker threads. Counted by their deques, which are
+// all made before any worker starts.
+size_t ThreadPool::size() const {
+  return _queues.size();
+}
+
+// Returns the position of the calling thread among the workers, or size()
+// if it is not one of them
+size_t ThreadPool::worker() const {
+  return current_pool == this ? current_worker : size();
+}
+
+// Returns the number of threads the hardware can run at once
+size_t ThreadPool::default_threads() {
+  size_t threads = std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+// Takes a task for the worker at position self, or for a thread outside
+// the pool if self is size(): the oldest task of its own deque, or else the
+// newest of another's. Returns false if every deque is empty.
+bool ThreadPool::take(size_t self, std::function<void()>& task) {
+  const size_t workers = size();
+  if (self < workers) {
+    Queue& own = *_queues[self];
+    unique_lock<mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      --_queued;
+      return true;
+    }
+  }
+  for (size_t i = 1; i <= workers; ++i) {
+    const size_t victim = (self + i) % workers;
+    if (victim == self) {
+      continue;
+    }
+    Queue& other = *_queues[victim];
+    unique_lock<mutex> lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = std::move(other.tasks.back());
+      other.tasks.pop_back();
+      --_queued;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runs a task taken from a deque, keeping the first exception it throws
+// for wait()
+void ThreadPool::run(std::function<void()>& task) {
+  std::exception_ptr error;
+  try {
+    task();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  task = nullptr;
+  unique_lock<mutex> lock(_mutex);
+  if (error && !_error) {
+    _error = error;
+  }
+  if (--_outstanding == 0) {
+    _all_done.notify_all();
+  }
+}
+
+// Runs queued tasks on the calling thread until done returns true, and
+// sleeps while there are none. Whatever makes done true must call
+// wake_all().
+void ThreadPool::help_until(const std::function<bool()>& done) {
+  const size_t self = worker();
+  while (!done()) {
+    std::function<void()> task;
+    if (take(self, task)) {
+      run(task);
+      continue;
+    }
+    unique_lock<mutex> lock(_mutex);
+    _task_ready.wait(lock, [&] { return _queued > 0 || done(); });
+  }
+}
+
+// Wakes every thread sleeping for a task, so that those waiting for a
+// group see it finished
+void ThreadPool::wake_all() {
+  {
+    unique_lock<mutex> lock(_mutex);
+  }
+  _task_ready.notify_all();
+}
+
+// The loop run by each worker thread
+void ThreadPool::work(size_t index) {
+  current_pool = this;
+  current_worker = index;
+  while (true) {
+    std::function<void()> task;
+    if (take(index, task)) {
+      run(task);
+      continue;
+    }
+    unique_lock<mutex> lock(_mutex);
+    _task_ready.wait(lock, [this] { return _stopping || _queued > 0; });
+    if (_stopping && _queued <= 0) {
+      return;
+    }
+  }
+}
+
+/*---- Task groups ----*/
+
+TaskGroup::TaskGroup(ThreadPool *pool) : _pool(pool), _outstanding(0) {}
+
+// Waits for the tasks still running, ignoring their exceptions, since they
+// refer to the group
+TaskGroup::~TaskGroup() {
+  if (_pool) {
+    _pool->help_until([this] { return _outstanding == 0; });
+  }
+}
+
+// Submits task to the pool, or runs it at once if there is no pool
+void TaskGroup::run(std::function<void()> task) {
+  if (!_pool) {
+    std::exception_ptr error;
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    if (error) {
+      finish(error);
+    }
+    return;
+  }
+  ++_outstanding;
+  _pool->submit([this, task]() {
+      std::exception_ptr error;
+      try {
+	task();
+      } catch (...) {
+	error = std::current_exception();
+      }
+      finish(error);
+    });
+}
+
+// Blocks until every task of the group has finished, running queued tasks
+// meanwhile. If any task threw, the first exception thrown is rethrown
+// here.
+void TaskGroup::wait() {
+  if (_pool) {
+    _pool->help_until([this] { return _outstanding == 0; });
+  }
+  unique_lock<mutex> lock(_mutex);
+  if (_error) {
+    std::exception_ptr error = _error;
+    _error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+// Records that a task finished, having thrown error unless it is null
+void TaskGroup::finish(std::exception_ptr error) {
+  if (error) {
+    unique_lock<mutex> lock(_mutex);
+    if (!_error) {
+      _error = error;
+    }
+  }
+  if (!_pool) {
+    return;
+  }
+  // The group may be gone as soon as the count reaches zero
+  ThreadPool *pool = _pool;
+  if (--_outstanding == 0) {
+    pool->wake_all();
+  }
+}
@@ -0,0 +1,99 @@
+// SimpleSQL: Thread pool
+//
+// A fixed set of worker threads that run submitted tasks. Used wherever
+// independent pieces of work can run in parallel.
+//
+// Every worker has a deque of tasks of its own. Tasks a worker submits go
+// to the back of its own deque, and tasks submitted from other threads are
+// dealt to the workers' deques in turn. A worker runs the tasks of its own
+// deque from the front, in the order they were queued, and once it is
+// empty steals from the back of the others', so no worker idles while
+// another has tasks waiting. The pool is not aware of NUMA nodes.
+//
+// Work that must be waited for on its own, such as the tasks of one query
+// while other queries share the pool, is submitted through a TaskGroup.
+// Waiting for a group runs queued tasks on the waiting thread until the
+// group's tasks are done, so tasks may wait for groups of their own.
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t threads = default_threads());
+  ~ThreadPool();
+  void submit(std::function<void()> task);
+  void wait();
+  std::size_t size() const;
+  std::size_t worker() const;
+
+  static std::size_t default_threads();
+ private:
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  friend class TaskGroup;
+
+  // The tasks queued on one worker
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+  bool take(std::size_t self, std::function<void()>& task);
+  void run(std::function<void()>& task);
+  void help_until(const std::function<bool()>& done);
+  void wake_all();
+  void work(std::size_t index);
+
+  std::vector<std::unique_ptr<Queue>> _queues;
+  std::vector<std::thread> _workers;
+  // The queue the next task submitted from outside the pool goes to
+  std::atomic<std::size_t> _next_queue;
+  // Tasks queued but not yet taken. It may dip below zero while a task is
+  // taken between being queued and being counted.
+  std::atomic<long> _queued;
+  std::mutex _mutex;
+  // Signalled when a task is submitted, a group finishes or the pool shuts
+  // down
+  std::condition_variable _task_ready;
+  // Signalled when the last outstanding task finishes
+  std::condition_variable _all_done;
+  // Tasks submitted but not yet finished
+  std::size_t _outstanding;
+  // The first exception thrown by a task since the last wait()
+  std::exception_ptr _error;
+  bool _stopping;
+};
+
+// Tasks submitted to a pool that can be waited for apart from the pool's
+// other tasks. Without a pool, tasks run as they are submitted.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool *pool);
+  ~TaskGroup();
+  void run(std::function<void()> task);
+  void wait();
+ private:
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+  void finish(std::exception_ptr error);
+
+  ThreadPool *const _pool;
+  // Tasks run but not yet finished
+  std::atomic<std::size_t> _outstanding;
+  std::mutex _mutex;
+  // The first exception thrown by a task since the last wait()
+  std::exception_ptr _error;
+};
+
+#endif  // __THREAD_POOL_H__